@@ -49,23 +49,38 @@ BufferPoolManagerInstance::~BufferPoolManagerInstance() {
 
 bool BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) {
   // Make sure you call DiskManager::WritePage!
-  // latch_.lock(); // We could use manual lock or automatic lock.
-  std::lock_guard<std::mutex> guard(latch_);
-  auto iter = page_table_.find(page_id); //Set the iterator found by page_id in page_table_.
-  if (iter == page_table_.end()){
-    // Page is not be found.
-    // latch_.unlock();
-    return false;
+  Page *page;
+  frame_id_t frame_id;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    auto iter = page_table_.find(page_id);
+    if (iter == page_table_.end()) {
+      return false;
+    }
+    // Pinned, the page stays in its frame while it is written out without the latch.
+    frame_id = iter->second;
+    page = pages_ + frame_id;
+    page->pin_count_++;
+    replacer_->Pin(frame_id);
+    // Whoever unpins the page dirty from now on makes it dirty again.
+    page->is_dirty_ = false;
   }
 
-    // Page is found.
-    frame_id_t frame_id = iter->second;
-    Page *page = pages_ + frame_id; // Set the address of page.
-    page->is_dirty_ = false;
-    disk_manager_->WritePage(page_id, page->GetData()); //Write the page in the buffer into disk.
-    // latch_.unlock();
-    return true;
+  // A change is made under the write latch of the page, and stamped with the LSN of its log record at the end. The
+  // image written out must not catch a change without its LSN, which recovery would then apply a second time.
+  page->RLatch();
+  WriteBackPage(page);
+  // Any change made after the write is logged with an LSN at least as large as the next LSN right now.
+  const lsn_t next_lsn = enable_logging && log_manager_ != nullptr ? log_manager_->GetNextLSN() : INVALID_LSN;
+  page->RUnlatch();
 
+  std::lock_guard<std::mutex> guard(latch_);
+  page->rec_lsn_ = page->pin_count_ > 1 || page->is_dirty_ ? next_lsn : INVALID_LSN;
+  page->pin_count_--;
+  if (page->pin_count_ == 0) {
+    replacer_->Unpin(frame_id);
+  }
+  return true;
 }
 
 void BufferPoolManagerInstance::FlushAllPgsImp() {
@@ -76,7 +91,12 @@ void BufferPoolManagerInstance::FlushAllPgsImp() {
       iter != page_table_.end(); 
       iter++){ // Use iterator to traverse the page table.
         Page *page = pages_ + iter->second;
-        disk_manager_->WritePage(iter->first, page->GetData()); //Write the page in the buffer into disk.
+        WriteBackPage(page);  // Write the page in the buffer into disk.
+        page->is_dirty_ = false;
+        page->rec_lsn_ = INVALID_LSN;
+        if (page->pin_count_ > 0) {
+          TrackRecLSN(page);
+        }
   }
   // latch_.unlock();
 }
@@ -101,7 +121,7 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
   else if (replacer_->Victim(&frame_id)) { // If no page is free and page is as the replacer's victim.
     P = pages_ + frame_id; // Set the P's pointer as the extracted page from the free list.
     if (P->IsDirty()) { // If P has dirty flag, modified.
-      disk_manager_->WritePage(P->GetPageId(), P->GetData()); // Write P back to the disk.
+      WriteBackPage(P);  // Write P back to the disk.
     }
     page_table_.erase(P->GetPageId()); // Remove P from page table.
   }
@@ -112,6 +132,8 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
     P->page_id_ = *page_id;
     P->is_dirty_ = false;
     P->pin_count_ = 1;
+    P->rec_lsn_ = INVALID_LSN;
+    TrackRecLSN(P);
     P->ResetMemory();
     page_table_[*page_id] = frame_id;
     replacer_->Pin(frame_id);
@@ -143,6 +165,7 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
     // return &pages_[frame_id];
     Page *page = &pages_[frame_id];
     page->pin_count_++;
+    TrackRecLSN(page);
     replacer_->Pin(frame_id);
     return page;
   }
@@ -156,7 +179,7 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
     else if (replacer_->Victim(&frame_id)) { // Find R in the replacer.
       R = &pages_[frame_id];
       if (R->IsDirty()) { // If R is dirty, write it back to the disk.
-        disk_manager_->WritePage(R->GetPageId(), R->GetData());
+        WriteBackPage(R);
       }
       page_table_.erase(R->GetPageId());
     }
@@ -168,6 +191,8 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
       R->page_id_ = page_id; // Update R's meta value.
       R->pin_count_ = 1;
       R->is_dirty_ = false;
+      R->rec_lsn_ = INVALID_LSN;
+      TrackRecLSN(R);
     }
     return R;
 
@@ -193,13 +218,14 @@ bool BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) {
     }
 
       if (page->IsDirty()) {
-        disk_manager_->WritePage(page_id, page->GetData());
+        WriteBackPage(page);
       }
       page_table_.erase(page->GetPageId()); // After write it back to disk, erase it from page table.
       replacer_->Pin(frame_id);
       page->pin_count_ = 0; // Update page's metadata.
       page->page_id_ = INVALID_PAGE_ID;
       page->is_dirty_ = false;
+      page->rec_lsn_ = INVALID_LSN;
       page->ResetMemory();
       free_list_.push_back(frame_id);
       return true;
@@ -226,11 +252,42 @@ bool BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) {
     page->pin_count_--;
     if (page->GetPinCount() <= 0) {
       replacer_->Unpin(frame_id);
+      // Nobody changed the page since it was last written, so there is nothing to recover for it.
+      if (!page->is_dirty_) {
+        page->rec_lsn_ = INVALID_LSN;
+      }
     }
     return true;
   
   }
 
+void BufferPoolManagerInstance::WriteBackPage(Page *page) {
+  // WAL: every log record up to the page LSN must be persistent before the page itself reaches the disk.
+  if (enable_logging && log_manager_ != nullptr && page->GetLSN() > log_manager_->GetPersistentLSN()) {
+    log_manager_->Flush();
+  }
+  disk_manager_->WritePage(page->GetPageId(), page->GetData());
+}
+
+void BufferPoolManagerInstance::TrackRecLSN(Page *page) {
+  // Any change made while the page is pinned is logged with an LSN at least as large as the next LSN right now.
+  if (page->rec_lsn_ == INVALID_LSN && !page->is_dirty_ && enable_logging && log_manager_ != nullptr) {
+    page->rec_lsn_ = log_manager_->GetNextLSN();
+  }
+}
+
+std::vector<std::pair<page_id_t, lsn_t>> BufferPoolManagerInstance::GetDirtyPageTable() {
+  std::lock_guard<std::mutex> guard(latch_);
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+  for (const auto &[page_id, frame_id] : page_table_) {
+    Page *page = pages_ + frame_id;
+    if (page->rec_lsn_ != INVALID_LSN) {
+      dirty_pages.emplace_back(page_id, page->rec_lsn_);
+    }
+  }
+  return dirty_pages;
+}
+
 page_id_t BufferPoolManagerInstance::AllocatePage() {
   const page_id_t next_page_id = next_page_id_;
   next_page_id_ += num_instances_;
@@ -43,6 +43,17 @@ size_t ParallelBufferPoolManager::GetPoolSize() {
   return num_instances_ * pool_size_;
 }
 
+std::vector<std::pair<page_id_t, lsn_t>> ParallelBufferPoolManager::GetDirtyPageTable() {
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+  for (size_t i = 0; i < num_instances_; i++) {
+    auto instance_dirty_pages = managers_[i]->GetDirtyPageTable();
+    dirty_pages.insert(dirty_pages.end(), instance_dirty_pages.begin(), instance_dirty_pages.end());
+  }
+  return dirty_pages;
+}
+
+LogManager *ParallelBufferPoolManager::GetLogManager() { return managers_[0]->GetLogManager(); }
+
 BufferPoolManager *ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) {
   // Get BufferPoolManager responsible for handling given page id. You can use this method in your other methods.
   return *(managers_ + page_id % num_instances_); // Get the pointer of the buffer pool.
@@ -18,6 +18,12 @@ std::atomic<bool> enable_logging(false);
 
 std::chrono::duration<int64_t> log_timeout = std::chrono::seconds(1);
 
+std::chrono::microseconds group_commit_window = std::chrono::microseconds(1000);
+
+std::chrono::milliseconds standby_poll_interval = std::chrono::milliseconds(10);
+
 std::chrono::milliseconds cycle_detection_interval = std::chrono::milliseconds(50);
 
+std::chrono::milliseconds lock_stats_interval = std::chrono::milliseconds(0);
+
 }  // namespace bustub
@@ -0,0 +1,158 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// rwlatch.cpp
+//
+// Identification: src/common/rwlatch.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/rwlatch.h"
+
+#include <climits>
+#include <thread>  // NOLINT
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bustub {
+
+namespace {
+
+/** How often a waiting thread checks the latch again before it goes to sleep. */
+constexpr int SPIN_ROUNDS = 64;
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+}  // namespace
+
+void ReaderWriterLatch::WLockSlow() {
+  int spins = 0;
+  // Enter as the writer, which keeps new readers out.
+  uint32_t state = state_.load(std::memory_order_relaxed);
+  while (true) {
+    if ((state & WRITER) == 0) {
+      if (state_.compare_exchange_weak(state, state | WRITER, std::memory_order_acquire)) {
+        break;
+      }
+      continue;
+    }
+    if (spins++ < SPIN_ROUNDS) {
+      CpuRelax();
+      state = state_.load(std::memory_order_relaxed);
+      continue;
+    }
+    if ((state & SLEEPERS) == 0 && !state_.compare_exchange_weak(state, state | SLEEPERS)) {
+      continue;
+    }
+    Wait(state | SLEEPERS);
+    state = state_.load(std::memory_order_relaxed);
+  }
+
+  // Wait for the readers that were inside to leave.
+  spins = 0;
+  state = state_.load(std::memory_order_acquire);
+  while ((state & READERS) != 0) {
+    if (spins++ < SPIN_ROUNDS) {
+      CpuRelax();
+      state = state_.load(std::memory_order_acquire);
+      continue;
+    }
+    if ((state & SLEEPERS) == 0 && !state_.compare_exchange_weak(state, state | SLEEPERS)) {
+      continue;
+    }
+    Wait(state | SLEEPERS);
+    state = state_.load(std::memory_order_acquire);
+  }
+}
+
+void ReaderWriterLatch::RLockSlow() {
+  int spins = 0;
+  uint32_t state = state_.load(std::memory_order_relaxed);
+  while (true) {
+    if ((state & WRITER) == 0 && (state & READERS) != MAX_READERS) {
+      if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire)) {
+        return;
+      }
+      continue;
+    }
+    if (spins++ < SPIN_ROUNDS) {
+      CpuRelax();
+      state = state_.load(std::memory_order_relaxed);
+      continue;
+    }
+    if ((state & SLEEPERS) == 0 && !state_.compare_exchange_weak(state, state | SLEEPERS)) {
+      continue;
+    }
+    Wait(state | SLEEPERS);
+    state = state_.load(std::memory_order_relaxed);
+  }
+}
+
+#ifdef __linux__
+
+void ReaderWriterLatch::Wait(uint32_t expected) {
+  // Returns right away if the word is not expected anymore, so a wakeup between the check and the sleep is not lost.
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+void ReaderWriterLatch::WakeAll() {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+// Without futexes, sleepers poll the word.
+void ReaderWriterLatch::Wait(uint32_t expected) {
+  if (state_.load(std::memory_order_relaxed) == expected) {
+    std::this_thread::yield();
+  }
+}
+
+void ReaderWriterLatch::WakeAll() {}
+
+#endif
+
+size_t DistributedReaderWriterLatch::SlotOfThisThread() {
+  // Threads take the slots in turn, which spreads them better than hashing their ids would.
+  static std::atomic<size_t> next_slot{0};
+  thread_local const size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % RWLATCH_READER_SLOTS;
+  return slot;
+}
+
+void DistributedReaderWriterLatch::WLock() {
+  writer_latch_.WLock();
+  writer_entered_.store(true);
+  for (ReaderSlot &slot : readers_) {
+    int spins = 0;
+    while (slot.count_.load() != 0) {
+      if (spins++ < SPIN_ROUNDS) {
+        CpuRelax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+}
+
+void DistributedReaderWriterLatch::RLockSlow(ReaderSlot *slot) {
+  // The writer holds writer_latch_ for as long as writer_entered_ is set, so holding it shared keeps the next writer
+  // out until this reader is counted.
+  writer_latch_.RLock();
+  slot->count_.fetch_add(1);
+  writer_latch_.RUnlock();
+}
+
+}  // namespace bustub
@@ -12,31 +12,824 @@
 
 #include "concurrency/lock_manager.h"
 
+#include <algorithm>
+#include <sstream>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "common/logger.h"
+#include "common/macros.h"
+#include "common/util/hash_util.h"
+
 namespace bustub {
 
-bool LockManager::LockShared(Transaction *txn, const RID &rid) {
+size_t LockStats::WaitBucket(std::chrono::microseconds wait_time) {
+  size_t bucket = 0;
+  for (auto us = static_cast<uint64_t>(std::max<int64_t>(wait_time.count(), 0)); us != 0; us >>= 1) {
+    bucket++;
+  }
+  return std::min(bucket, WAIT_BUCKETS - 1);
+}
+
+std::string LockStats::ToString() const {
+  static const char *mode_names[LOCK_MODES] = {"S", "X", "IS", "IX", "SIX"};
+  std::ostringstream os;
+  uint64_t total = 0;
+  for (uint64_t acquisitions : acquisitions_) {
+    total += acquisitions;
+  }
+  os << total << " locks (";
+  for (size_t mode = 0; mode < LOCK_MODES; mode++) {
+    os << (mode == 0 ? "" : ", ") << mode_names[mode] << " " << acquisitions_[mode];
+  }
+  os << "), " << waits_ << " waits for " << wait_time_.count() << " us, " << upgrade_conflicts_
+     << " upgrade conflicts, " << deadlock_aborts_ << " deadlock aborts, max queue depth " << max_queue_depth_;
+  if (waits_ != 0) {
+    os << "\nwaits by length:";
+    const char *separator = " ";
+    for (size_t bucket = 0; bucket < WAIT_BUCKETS; bucket++) {
+      if (wait_histogram_[bucket] == 0) {
+        continue;
+      }
+      os << separator;
+      separator = ", ";
+      if (bucket == WAIT_BUCKETS - 1) {
+        os << "longer " << wait_histogram_[bucket];
+      } else {
+        os << "<" << (uint64_t{1} << bucket) << " us " << wait_histogram_[bucket];
+      }
+    }
+  }
+  for (const LockContention &hot : hot_targets_) {
+    os << "\nhot: " << hot.target_ << ", " << hot.waits_ << " waits for " << hot.wait_time_.count() << " us";
+  }
+  return os.str();
+}
+
+LockManager::LockManager(DeadlockPolicy deadlock_policy, size_t escalation_threshold)
+    : deadlock_policy_(deadlock_policy), escalation_threshold_(escalation_threshold) {
+  if (deadlock_policy_ == DeadlockPolicy::DETECTION) {
+    enable_cycle_detection_ = true;
+    cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
+  }
+  if (lock_stats_interval.count() > 0) {
+    enable_stats_report_ = true;
+    stats_report_thread_ = new std::thread(&LockManager::RunStatsReport, this);
+  }
+}
+
+LockManager::~LockManager() {
+  if (cycle_detection_thread_ != nullptr) {
+    {
+      std::scoped_lock guard(cycle_detection_latch_);
+      enable_cycle_detection_ = false;
+    }
+    cycle_detection_cv_.notify_all();
+    cycle_detection_thread_->join();
+    delete cycle_detection_thread_;
+  }
+  if (stats_report_thread_ != nullptr) {
+    {
+      std::scoped_lock guard(stats_report_latch_);
+      enable_stats_report_ = false;
+    }
+    stats_report_cv_.notify_all();
+    stats_report_thread_->join();
+    delete stats_report_thread_;
+  }
+}
+
+bool LockManager::LockShared(Transaction *txn, const RID &rid, table_oid_t oid) {
+  if (!CanLock(txn, LockMode::SHARED)) {
+    return false;
+  }
+  if (txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid) || IsRowCovered(txn, oid, rid, LockMode::SHARED)) {
+    return true;
+  }
+  if (!LockRowParents(txn, oid, rid, LockMode::SHARED) ||
+      !Acquire(txn, LockTarget::Row(rid), LockMode::SHARED, false)) {
+    return false;
+  }
   txn->GetSharedLockSet()->emplace(rid);
-  return true;
+  return AddRowLock(txn, oid, rid);
 }
 
-bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
+bool LockManager::LockExclusive(Transaction *txn, const RID &rid, table_oid_t oid) {
+  if (txn->IsSharedLocked(rid)) {
+    return LockUpgrade(txn, rid, oid);
+  }
+  if (!CanLock(txn, LockMode::EXCLUSIVE)) {
+    return false;
+  }
+  if (txn->IsExclusiveLocked(rid) || IsRowCovered(txn, oid, rid, LockMode::EXCLUSIVE)) {
+    return true;
+  }
+  if (!LockRowParents(txn, oid, rid, LockMode::EXCLUSIVE) ||
+      !Acquire(txn, LockTarget::Row(rid), LockMode::EXCLUSIVE, false)) {
+    return false;
+  }
   txn->GetExclusiveLockSet()->emplace(rid);
-  return true;
+  return AddRowLock(txn, oid, rid);
 }
 
-bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
+bool LockManager::LockUpgrade(Transaction *txn, const RID &rid, table_oid_t oid) {
+  if (!CanLock(txn, LockMode::EXCLUSIVE)) {
+    return false;
+  }
+  if (txn->IsExclusiveLocked(rid) || IsRowCovered(txn, oid, rid, LockMode::EXCLUSIVE)) {
+    return true;
+  }
+  if (!txn->IsSharedLocked(rid)) {
+    return false;
+  }
+  if (!LockRowParents(txn, oid, rid, LockMode::EXCLUSIVE) ||
+      !Acquire(txn, LockTarget::Row(rid), LockMode::EXCLUSIVE, true)) {
+    return false;
+  }
   txn->GetSharedLockSet()->erase(rid);
   txn->GetExclusiveLockSet()->emplace(rid);
-  return true;
+  return AddRowLock(txn, oid, rid);
 }
 
 bool LockManager::Unlock(Transaction *txn, const RID &rid) {
   txn->GetSharedLockSet()->erase(rid);
   txn->GetExclusiveLockSet()->erase(rid);
+  auto table_row_locks = txn->GetTableRowLockSet();
+  for (auto it = table_row_locks->begin(); it != table_row_locks->end(); ++it) {
+    if (it->second.erase(rid) != 0) {
+      if (it->second.empty()) {
+        table_row_locks->erase(it);
+      }
+      break;
+    }
+  }
+  return ReleaseAndShrink(txn, LockTarget::Row(rid));
+}
+
+bool LockManager::LockTable(Transaction *txn, table_oid_t oid, LockMode mode) {
+  if (!CanLock(txn, mode)) {
+    return false;
+  }
+  return LockOrUpgrade(txn, LockTarget::Table(oid), txn->GetTableLockSet().get(), oid, mode);
+}
+
+bool LockManager::LockPage(Transaction *txn, table_oid_t oid, page_id_t page_id, LockMode mode) {
+  if (!CanLock(txn, mode)) {
+    return false;
+  }
+  if (oid != INVALID_TABLE_OID) {
+    auto table_locks = txn->GetTableLockSet();
+    auto held = table_locks->find(oid);
+    if (held != table_locks->end() && CoversContents(held->second, mode)) {
+      return true;
+    }
+    if (!LockTable(txn, oid, IntentionFor(mode))) {
+      return false;
+    }
+  }
+  return LockOrUpgrade(txn, LockTarget::Page(page_id), txn->GetPageLockSet().get(), page_id, mode);
+}
+
+bool LockManager::UnlockTable(Transaction *txn, table_oid_t oid) {
+  txn->GetTableLockSet()->erase(oid);
+  return ReleaseAndShrink(txn, LockTarget::Table(oid));
+}
+
+bool LockManager::UnlockPage(Transaction *txn, page_id_t page_id) {
+  txn->GetPageLockSet()->erase(page_id);
+  return ReleaseAndShrink(txn, LockTarget::Page(page_id));
+}
+
+bool LockManager::LockKey(Transaction *txn, int64_t name, LockMode mode) {
+  if (!CanLock(txn, mode)) {
+    return false;
+  }
+  return LockOrUpgrade(txn, LockTarget::Key(name), txn->GetKeyLockSet().get(), name, mode);
+}
+
+bool LockManager::UnlockKey(Transaction *txn, int64_t name) {
+  txn->GetKeyLockSet()->erase(name);
+  return ReleaseAndShrink(txn, LockTarget::Key(name));
+}
+
+int64_t LockManager::KeyLockName(uint32_t index_id, const char *key, size_t size) {
+  // The end of an index hashes like a key of its own, one no real key is likely to collide with.
+  static constexpr uint64_t END_OF_INDEX = 0x8000000000000000ULL;
+  const hash_t key_hash = key == nullptr ? HashUtil::Hash(&END_OF_INDEX) : HashUtil::HashBytes(key, size);
+  return static_cast<int64_t>(HashUtil::CombineHashes(HashUtil::Hash(&index_id), key_hash));
+}
+
+bool LockManager::AreCompatible(LockMode held, LockMode requested) {
+  // Indexed by the values of LockMode: SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE and
+  // SHARED_INTENTION_EXCLUSIVE.
+  static constexpr bool COMPATIBLE[5][5] = {
+      {true, false, true, false, false},  {false, false, false, false, false}, {true, false, true, true, true},
+      {false, false, true, true, false}, {false, false, true, false, false},
+  };
+  return COMPATIBLE[static_cast<int>(held)][static_cast<int>(requested)];
+}
+
+bool LockManager::CanLock(Transaction *txn, LockMode mode) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED && mode != LockMode::EXCLUSIVE &&
+      mode != LockMode::INTENTION_EXCLUSIVE) {
+    AbortImplicitly(txn, AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED);
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    AbortImplicitly(txn, AbortReason::LOCK_ON_SHRINKING);
+  }
+  return true;
+}
+
+bool LockManager::Covers(LockMode held, LockMode requested) {
+  switch (held) {
+    case LockMode::EXCLUSIVE:
+      return true;
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return requested != LockMode::EXCLUSIVE;
+    case LockMode::SHARED:
+      return requested == LockMode::SHARED || requested == LockMode::INTENTION_SHARED;
+    case LockMode::INTENTION_EXCLUSIVE:
+      return requested == LockMode::INTENTION_EXCLUSIVE || requested == LockMode::INTENTION_SHARED;
+    case LockMode::INTENTION_SHARED:
+      return requested == LockMode::INTENTION_SHARED;
+  }
+  return false;
+}
+
+bool LockManager::CoversContents(LockMode parent, LockMode mode) {
+  if (parent == LockMode::EXCLUSIVE) {
+    return true;
+  }
+  return (parent == LockMode::SHARED || parent == LockMode::SHARED_INTENTION_EXCLUSIVE) &&
+         (mode == LockMode::SHARED || mode == LockMode::INTENTION_SHARED);
+}
+
+LockMode LockManager::IntentionFor(LockMode mode) {
+  return mode == LockMode::SHARED || mode == LockMode::INTENTION_SHARED ? LockMode::INTENTION_SHARED
+                                                                        : LockMode::INTENTION_EXCLUSIVE;
+}
+
+bool LockManager::IsRowCovered(Transaction *txn, table_oid_t oid, const RID &rid, LockMode mode) {
+  if (oid != INVALID_TABLE_OID) {
+    auto table_locks = txn->GetTableLockSet();
+    auto held = table_locks->find(oid);
+    if (held != table_locks->end() && CoversContents(held->second, mode)) {
+      return true;
+    }
+  }
+  auto page_locks = txn->GetPageLockSet();
+  auto held = page_locks->find(rid.GetPageId());
+  return held != page_locks->end() && CoversContents(held->second, mode);
+}
+
+bool LockManager::LockRowParents(Transaction *txn, table_oid_t oid, const RID &rid, LockMode mode) {
+  const LockMode intention = IntentionFor(mode);
+  if (oid != INVALID_TABLE_OID && !LockTable(txn, oid, intention)) {
+    return false;
+  }
+  return LockOrUpgrade(txn, LockTarget::Page(rid.GetPageId()), txn->GetPageLockSet().get(), rid.GetPageId(),
+                       intention);
+}
+
+bool LockManager::AddRowLock(Transaction *txn, table_oid_t oid, const RID &rid) {
+  if (oid == INVALID_TABLE_OID) {
+    return true;
+  }
+  auto &rows = (*txn->GetTableRowLockSet())[oid];
+  rows.emplace(rid);
+  if (escalation_threshold_ == 0 || rows.size() < escalation_threshold_) {
+    return true;
+  }
+  return Escalate(txn, oid);
+}
+
+bool LockManager::Escalate(Transaction *txn, table_oid_t oid) {
+  auto table_row_locks = txn->GetTableRowLockSet();
+  auto exclusive_locks = txn->GetExclusiveLockSet();
+  const std::unordered_set<RID> &rows = table_row_locks->at(oid);
+  const bool exclusive = std::any_of(rows.begin(), rows.end(),
+                                     [&](const RID &rid) { return exclusive_locks->count(rid) != 0; });
+  auto table_locks = txn->GetTableLockSet();
+  if (!LockOrUpgrade(txn, LockTarget::Table(oid), table_locks.get(), oid,
+                     exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED)) {
+    return false;
+  }
+  const LockMode table_mode = table_locks->at(oid);
+
+  // The table lock covers the records now, releasing them does not end the growing phase.
+  LockMode mode;
+  std::unordered_set<page_id_t> pages;
+  for (const RID &rid : rows) {
+    txn->GetSharedLockSet()->erase(rid);
+    exclusive_locks->erase(rid);
+    Release(txn, LockTarget::Row(rid), &mode);
+    pages.emplace(rid.GetPageId());
+  }
+  table_row_locks->erase(oid);
+  auto page_locks = txn->GetPageLockSet();
+  for (page_id_t page_id : pages) {
+    auto held = page_locks->find(page_id);
+    if (held != page_locks->end() && CoversContents(table_mode, held->second)) {
+      page_locks->erase(held);
+      Release(txn, LockTarget::Page(page_id), &mode);
+    }
+  }
+  return true;
+}
+
+template <typename Id>
+bool LockManager::LockOrUpgrade(Transaction *txn, const LockTarget &target, std::unordered_map<Id, LockMode> *lock_set,
+                                Id id, LockMode mode) {
+  auto held = lock_set->find(id);
+  if (held == lock_set->end()) {
+    if (!Acquire(txn, target, mode, false)) {
+      return false;
+    }
+    lock_set->emplace(id, mode);
+    return true;
+  }
+  if (Covers(held->second, mode)) {
+    return true;
+  }
+  // Neither of SHARED and INTENTION_EXCLUSIVE covers the other, SHARED_INTENTION_EXCLUSIVE covers both.
+  const LockMode upgraded = Covers(mode, held->second) ? mode : LockMode::SHARED_INTENTION_EXCLUSIVE;
+  if (!Acquire(txn, target, upgraded, true)) {
+    lock_set->erase(id);
+    return false;
+  }
+  (*lock_set)[id] = upgraded;
+  return true;
+}
+
+bool LockManager::Acquire(Transaction *txn, const LockTarget &target, LockMode mode, bool upgrade) {
+  LockTablePartition *partition = GetPartition(target);
+  std::unique_lock guard(partition->latch_);
+  LockRequestQueue *queue = GetQueue(partition, target);
+  auto &requests = queue->request_queue_;
+  std::list<LockRequest>::iterator request;
+  if (!upgrade) {
+    request = AddRequest(partition, queue, txn, mode);
+    partition->stats_.max_queue_depth_ = std::max(partition->stats_.max_queue_depth_, requests.size());
+  } else {
+    request = std::find_if(requests.begin(), requests.end(), [txn](const LockRequest &request) {
+      return request.txn_id_ == txn->GetTransactionId();
+    });
+    BUSTUB_ASSERT(request != requests.end() && request->granted_, "Upgrading a lock that is not held");
+    if (queue->upgrading_ != INVALID_TXN_ID) {
+      partition->stats_.upgrade_conflicts_++;
+      AbortImplicitly(txn, AbortReason::UPGRADE_CONFLICT);
+    }
+    // The upgrade goes ahead of every waiting request, and is granted once the incompatible locks are released.
+    auto first_waiting = std::find_if(requests.begin(), requests.end(),
+                                      [](const LockRequest &request) { return !request.granted_; });
+    requests.splice(first_waiting, requests, request);
+    request->lock_mode_ = mode;
+    request->granted_ = false;
+    queue->upgrading_ = txn->GetTransactionId();
+  }
+  if (!WaitForGrant(partition, &guard, txn, target, queue, request)) {
+    return false;
+  }
+  if (queue->upgrading_ == txn->GetTransactionId()) {
+    queue->upgrading_ = INVALID_TXN_ID;
+  }
+  partition->stats_.acquisitions_[static_cast<size_t>(mode)]++;
+  return true;
+}
+
+bool LockManager::Release(Transaction *txn, const LockTarget &target, LockMode *mode) {
+  LockTablePartition *partition = GetPartition(target);
+  std::scoped_lock guard(partition->latch_);
+  auto it = partition->lock_table_.find(target);
+  if (it == partition->lock_table_.end()) {
+    return false;
+  }
+  LockRequestQueue *queue = &it->second;
+  auto &requests = queue->request_queue_;
+  auto request = std::find_if(requests.begin(), requests.end(), [txn](const LockRequest &request) {
+    return request.txn_id_ == txn->GetTransactionId();
+  });
+  if (request == requests.end() || !request->granted_) {
+    return false;
+  }
+  *mode = request->lock_mode_;
+  RemoveRequest(partition, target, queue, request);
   return true;
 }
 
+bool LockManager::ReleaseAndShrink(Transaction *txn, const LockTarget &target) {
+  LockMode mode;
+  if (!Release(txn, target, &mode)) {
+    return false;
+  }
+  // Under READ_COMMITTED, read locks are released right after the read and do not end the growing phase.
+  const bool read_lock = mode == LockMode::SHARED || mode == LockMode::INTENTION_SHARED;
+  if (txn->GetState() == TransactionState::GROWING &&
+      !(read_lock && txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED)) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+  return true;
+}
+
+size_t LockManager::LockTargetHash::operator()(const LockTarget &target) const {
+  return HashUtil::CombineHashes(static_cast<hash_t>(target.level_), HashUtil::Hash(&target.id_));
+}
+
+LockManager::LockTablePartition *LockManager::GetPartition(const LockTarget &target) {
+  return &partitions_[LockTargetHash{}(target) % LOCK_TABLE_PARTITIONS];
+}
+
+LockManager::LockRequestQueue *LockManager::GetQueue(LockTablePartition *partition, const LockTarget &target) {
+  auto it = partition->lock_table_.find(target);
+  if (it != partition->lock_table_.end()) {
+    return &it->second;
+  }
+  if (partition->free_queues_.empty()) {
+    return &partition->lock_table_[target];
+  }
+  auto node = std::move(partition->free_queues_.back());
+  partition->free_queues_.pop_back();
+  node.key() = target;
+  return &partition->lock_table_.insert(std::move(node)).position->second;
+}
+
+std::list<LockManager::LockRequest>::iterator LockManager::AddRequest(LockTablePartition *partition,
+                                                                      LockRequestQueue *queue, Transaction *txn,
+                                                                      LockMode mode) {
+  auto &requests = queue->request_queue_;
+  if (partition->free_requests_.empty()) {
+    return requests.emplace(requests.end(), txn, mode);
+  }
+  auto node = partition->free_requests_.begin();
+  *node = LockRequest(txn, mode);
+  requests.splice(requests.end(), partition->free_requests_, node);
+  return node;
+}
+
+void LockManager::RemoveRequest(LockTablePartition *partition, const LockTarget &target, LockRequestQueue *queue,
+                                std::list<LockRequest>::iterator request) {
+  auto &requests = queue->request_queue_;
+  if (partition->free_requests_.size() < LockTablePartition::MAX_SPARES) {
+    partition->free_requests_.splice(partition->free_requests_.begin(), requests, request);
+  } else {
+    requests.erase(request);
+  }
+  if (!requests.empty()) {
+    queue->cv_.notify_all();
+    return;
+  }
+  // Nobody waits on an empty queue: every waiter has a request in it.
+  auto node = partition->lock_table_.extract(target);
+  if (partition->free_queues_.size() < LockTablePartition::MAX_SPARES) {
+    partition->free_queues_.push_back(std::move(node));
+  }
+}
+
+bool LockManager::IsGrantable(const LockRequestQueue &queue, std::list<LockRequest>::const_iterator request) {
+  for (auto it = queue.request_queue_.begin(); it != request; ++it) {
+    if (!AreCompatible(it->lock_mode_, request->lock_mode_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LockManager::WaitForGrant(LockTablePartition *partition, std::unique_lock<std::mutex> *guard, Transaction *txn,
+                               const LockTarget &target, LockRequestQueue *queue,
+                               std::list<LockRequest>::iterator request) {
+  const bool prevent = deadlock_policy_ != DeadlockPolicy::DETECTION;
+  bool blocked = false;
+  bool waited = false;
+  std::chrono::steady_clock::time_point wait_start;
+  while (txn->GetState() != TransactionState::ABORTED && !IsGrantable(*queue, request)) {
+    if (!waited) {
+      waited = true;
+      wait_start = std::chrono::steady_clock::now();
+    }
+    if (prevent && !blocked) {
+      // Registered before the state is checked again, so that a wound either shows up there or finds the waiter.
+      std::scoped_lock blocked_guard(blocked_on_latch_);
+      blocked_on_.insert_or_assign(txn->GetTransactionId(), target);
+      blocked = true;
+      continue;
+    }
+    if (prevent) {
+      PreventDeadlock(guard, txn, queue, request);
+      if (txn->GetState() == TransactionState::ABORTED || IsGrantable(*queue, request)) {
+        break;
+      }
+    }
+    queue->cv_.wait(*guard);
+  }
+  if (blocked) {
+    std::scoped_lock blocked_guard(blocked_on_latch_);
+    blocked_on_.erase(txn->GetTransactionId());
+  }
+  if (waited) {
+    RecordWait(partition, target,
+               std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wait_start));
+  }
+  if (txn->GetState() == TransactionState::ABORTED) {
+    if (queue->upgrading_ == txn->GetTransactionId()) {
+      queue->upgrading_ = INVALID_TXN_ID;
+    }
+    RemoveRequest(partition, target, queue, request);
+    return false;
+  }
+  request->granted_ = true;
+  return true;
+}
+
+void LockManager::PreventDeadlock(std::unique_lock<std::mutex> *guard, Transaction *txn, LockRequestQueue *queue,
+                                  std::list<LockRequest>::iterator request) {
+  std::vector<Transaction *> wounded;
+  for (auto ahead = queue->request_queue_.begin(); ahead != request; ++ahead) {
+    if (ahead->txn_id_ == txn->GetTransactionId() || AreCompatible(ahead->lock_mode_, request->lock_mode_)) {
+      continue;
+    }
+    if (deadlock_policy_ == DeadlockPolicy::WAIT_DIE) {
+      if (ahead->txn_id_ < txn->GetTransactionId()) {
+        txn->SetState(TransactionState::ABORTED);
+        deadlock_aborts_++;
+        return;
+      }
+    } else if (ahead->txn_id_ > txn->GetTransactionId() && ahead->txn_->GetState() != TransactionState::ABORTED) {
+      ahead->txn_->SetState(TransactionState::ABORTED);
+      deadlock_aborts_++;
+      wounded.push_back(ahead->txn_);
+    }
+  }
+  if (wounded.empty()) {
+    return;
+  }
+
+  // Wake up the wounded transactions that are blocked, here or on another queue. The latch of another partition is
+  // only taken without this one, so that no two partition latches are ever held together.
+  queue->cv_.notify_all();
+  std::vector<LockTarget> targets;
+  {
+    std::scoped_lock blocked_guard(blocked_on_latch_);
+    for (Transaction *wounded_txn : wounded) {
+      auto blocked = blocked_on_.find(wounded_txn->GetTransactionId());
+      if (blocked != blocked_on_.end()) {
+        targets.push_back(blocked->second);
+      }
+    }
+  }
+  if (targets.empty()) {
+    return;
+  }
+  guard->unlock();
+  for (const LockTarget &target : targets) {
+    LockTablePartition *partition = GetPartition(target);
+    std::scoped_lock partition_guard(partition->latch_);
+    auto it = partition->lock_table_.find(target);
+    if (it != partition->lock_table_.end()) {
+      it->second.cv_.notify_all();
+    }
+  }
+  guard->lock();
+}
+
+void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {
+  std::scoped_lock guard(waits_for_latch_);
+  auto &edges = waits_for_[t1];
+  auto it = std::lower_bound(edges.begin(), edges.end(), t2);
+  if (it == edges.end() || *it != t2) {
+    edges.insert(it, t2);
+  }
+}
+
+void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
+  std::scoped_lock guard(waits_for_latch_);
+  auto edges = waits_for_.find(t1);
+  if (edges == waits_for_.end()) {
+    return;
+  }
+  auto it = std::lower_bound(edges->second.begin(), edges->second.end(), t2);
+  if (it != edges->second.end() && *it == t2) {
+    edges->second.erase(it);
+  }
+  if (edges->second.empty()) {
+    waits_for_.erase(edges);
+  }
+}
+
+bool LockManager::HasCycle(txn_id_t *txn_id) {
+  std::scoped_lock guard(waits_for_latch_);
+  std::vector<txn_id_t> starts;
+  starts.reserve(waits_for_.size());
+  for (const auto &[waiter, edges] : waits_for_) {
+    starts.push_back(waiter);
+  }
+  std::sort(starts.begin(), starts.end());
+  std::unordered_map<txn_id_t, bool> visited;
+  std::vector<txn_id_t> on_path;
+  for (txn_id_t start : starts) {
+    if (!visited[start] && FindCycle(start, &on_path, &visited, txn_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LockManager::FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *on_path,
+                            std::unordered_map<txn_id_t, bool> *visited, txn_id_t *victim) {
+  (*visited)[txn_id] = true;
+  on_path->push_back(txn_id);
+  auto edges = waits_for_.find(txn_id);
+  if (edges != waits_for_.end()) {
+    for (txn_id_t next : edges->second) {
+      auto cycle_start = std::find(on_path->begin(), on_path->end(), next);
+      if (cycle_start != on_path->end()) {
+        *victim = *std::max_element(cycle_start, on_path->end());
+        on_path->clear();
+        return true;
+      }
+      if (!(*visited)[next] && FindCycle(next, on_path, visited, victim)) {
+        return true;
+      }
+    }
+  }
+  on_path->pop_back();
+  return false;
+}
+
+std::vector<std::pair<txn_id_t, txn_id_t>> LockManager::GetEdgeList() {
+  std::scoped_lock guard(waits_for_latch_);
+  std::vector<std::pair<txn_id_t, txn_id_t>> edge_list;
+  for (const auto &[waiter, edges] : waits_for_) {
+    for (txn_id_t holder : edges) {
+      edge_list.emplace_back(waiter, holder);
+    }
+  }
+  return edge_list;
+}
+
+void LockManager::RunCycleDetection() {
+  std::unique_lock lock(cycle_detection_latch_);
+  while (enable_cycle_detection_) {
+    cycle_detection_cv_.wait_for(lock, cycle_detection_interval);
+    if (!enable_cycle_detection_) {
+      break;
+    }
+    BuildWaitsForGraph();
+    txn_id_t victim;
+    while (HasCycle(&victim)) {
+      std::scoped_lock guard(waits_for_latch_);
+      AbortVictim(victim, waiting_on_.at(victim));
+      // The victim stops waiting, which may break other cycles too.
+      waits_for_.erase(victim);
+      for (auto &[waiter, edges] : waits_for_) {
+        edges.erase(std::remove(edges.begin(), edges.end(), victim), edges.end());
+      }
+    }
+  }
+}
+
+void LockManager::BuildWaitsForGraph() {
+  std::scoped_lock guard(waits_for_latch_);
+  waits_for_.clear();
+  waiting_on_.clear();
+  for (auto &partition : partitions_) {
+    std::scoped_lock partition_guard(partition.latch_);
+    for (const auto &[target, queue] : partition.lock_table_) {
+      const auto &requests = queue.request_queue_;
+      for (auto request = requests.begin(); request != requests.end(); ++request) {
+        if (request->granted_) {
+          continue;
+        }
+        // A request waits for every incompatible request ahead of it, see IsGrantable.
+        for (auto ahead = requests.begin(); ahead != request; ++ahead) {
+          if (ahead->txn_id_ != request->txn_id_ && !AreCompatible(ahead->lock_mode_, request->lock_mode_)) {
+            waits_for_[request->txn_id_].push_back(ahead->txn_id_);
+          }
+        }
+        waiting_on_.insert_or_assign(request->txn_id_, target);
+      }
+    }
+  }
+  for (auto &[waiter, edges] : waits_for_) {
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+  }
+}
+
+void LockManager::AbortVictim(txn_id_t txn_id, const LockTarget &target) {
+  LockTablePartition *partition = GetPartition(target);
+  std::scoped_lock guard(partition->latch_);
+  auto it = partition->lock_table_.find(target);
+  if (it == partition->lock_table_.end()) {
+    return;
+  }
+  const auto &requests = it->second.request_queue_;
+  auto victim = std::find_if(requests.begin(), requests.end(), [txn_id](const LockRequest &request) {
+    return request.txn_id_ == txn_id && !request.granted_;
+  });
+  if (victim == requests.end()) {
+    return;
+  }
+  victim->txn_->SetState(TransactionState::ABORTED);
+  deadlock_aborts_++;
+  it->second.cv_.notify_all();
+}
+
+void LockManager::AbortImplicitly(Transaction *txn, AbortReason abort_reason) {
+  txn->SetState(TransactionState::ABORTED);
+  throw TransactionAbortException(txn->GetTransactionId(), abort_reason);
+}
+
+void LockManager::RecordWait(LockTablePartition *partition, const LockTarget &target,
+                             std::chrono::microseconds wait_time) {
+  PartitionStats &stats = partition->stats_;
+  stats.waits_++;
+  stats.wait_time_ += wait_time;
+  stats.wait_histogram_[LockStats::WaitBucket(wait_time)]++;
+  auto it = stats.target_waits_.find(target);
+  if (it == stats.target_waits_.end()) {
+    if (stats.target_waits_.size() >= PartitionStats::MAX_CONTENDED) {
+      return;
+    }
+    it = stats.target_waits_.emplace(target, TargetWaits{}).first;
+  }
+  it->second.waits_++;
+  it->second.wait_time_ += wait_time;
+}
+
+std::string LockManager::TargetName(const LockTarget &target) {
+  std::ostringstream os;
+  switch (target.level_) {
+    case LockTarget::Level::TABLE:
+      os << "table " << target.id_;
+      break;
+    case LockTarget::Level::PAGE:
+      os << "page " << target.id_;
+      break;
+    case LockTarget::Level::ROW: {
+      RID rid(target.id_);
+      os << "row " << rid.GetPageId() << ":" << rid.GetSlotNum();
+      break;
+    }
+    case LockTarget::Level::KEY:
+      os << "key " << std::hex << static_cast<uint64_t>(target.id_);
+      break;
+  }
+  return os.str();
+}
+
+LockStats LockManager::GetStats(size_t top_n) {
+  LockStats stats;
+  std::vector<std::pair<LockTarget, TargetWaits>> contended;
+  for (auto &partition : partitions_) {
+    std::scoped_lock guard(partition.latch_);
+    const PartitionStats &partition_stats = partition.stats_;
+    for (size_t mode = 0; mode < LockStats::LOCK_MODES; mode++) {
+      stats.acquisitions_[mode] += partition_stats.acquisitions_[mode];
+    }
+    stats.waits_ += partition_stats.waits_;
+    stats.wait_time_ += partition_stats.wait_time_;
+    for (size_t bucket = 0; bucket < LockStats::WAIT_BUCKETS; bucket++) {
+      stats.wait_histogram_[bucket] += partition_stats.wait_histogram_[bucket];
+    }
+    stats.upgrade_conflicts_ += partition_stats.upgrade_conflicts_;
+    stats.max_queue_depth_ = std::max(stats.max_queue_depth_, partition_stats.max_queue_depth_);
+    contended.insert(contended.end(), partition_stats.target_waits_.begin(), partition_stats.target_waits_.end());
+  }
+  stats.deadlock_aborts_ = deadlock_aborts_;
+
+  const size_t hot = std::min(top_n, contended.size());
+  std::partial_sort(contended.begin(), contended.begin() + hot, contended.end(), [](const auto &a, const auto &b) {
+    return a.second.waits_ != b.second.waits_ ? a.second.waits_ > b.second.waits_
+                                              : a.second.wait_time_ > b.second.wait_time_;
+  });
+  for (size_t i = 0; i < hot; i++) {
+    stats.hot_targets_.push_back({TargetName(contended[i].first), contended[i].second.waits_,
+                                  contended[i].second.wait_time_});
+  }
+  return stats;
+}
+
+void LockManager::ResetHotTargets() {
+  for (auto &partition : partitions_) {
+    std::scoped_lock guard(partition.latch_);
+    partition.stats_.target_waits_.clear();
+  }
+}
+
+void LockManager::RunStatsReport() {
+  std::unique_lock lock(stats_report_latch_);
+  while (enable_stats_report_) {
+    stats_report_cv_.wait_for(lock, lock_stats_interval);
+    if (!enable_stats_report_) {
+      break;
+    }
+    LOG_INFO("Lock manager: %s", GetStats().ToString().c_str());
+    ResetHotTargets();
+  }
+}
+
 }  // namespace bustub
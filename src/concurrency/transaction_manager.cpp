@@ -12,31 +12,76 @@
 
 #include "concurrency/transaction_manager.h"
 
+#include <algorithm>
+#include <functional>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 #include "catalog/catalog.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
-std::shared_mutex TransactionManager::txn_map_mutex = {};
+Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level,
+                                       DurabilityMode durability_mode, ConcurrencyControl concurrency_control) {
+  if (txn == nullptr) {
+    txn = new Transaction(next_txn_id_++, isolation_level, durability_mode, concurrency_control);
+  }
+  EnterRunning(txn);
+  BUSTUB_ASSERT(txn->GetConcurrencyControl() != ConcurrencyControl::OPTIMISTIC ||
+                    txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION,
+                "Optimistic transactions validate their reads instead.");
+  txn_registry_.Register(txn);
 
-Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level) {
-  // Acquire the global transaction latch in shared mode.
-  global_txn_latch_.RLock();
+  // Any other transaction never looks at its read timestamp.
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+    EnterVersioned();
+    // Taken under the latch the watermark is computed under, so that no version the snapshot reads is collected.
+    std::scoped_lock guard(snapshots_latch_);
+    txn->SetReadTs(last_commit_ts_);
+    snapshots_.insert(txn->GetReadTs());
+  } else if (txn->GetConcurrencyControl() == ConcurrencyControl::OPTIMISTIC) {
+    EnterVersioned();
+    // Validation checks the commits after the read timestamp, which keep their writes for it from now on.
+    std::scoped_lock guard(commit_latch_);
+    txn->SetReadTs(last_commit_ts_);
+    optimistic_txns_.insert(txn->GetReadTs());
+  }
 
-  if (txn == nullptr) {
-    txn = new Transaction(next_txn_id_++, isolation_level);
+  // A read-only transaction has nothing to redo or undo, so recovery and checkpoints need not know of it.
+  if (enable_logging && log_manager_ != nullptr && !txn->IsReadOnly()) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+    txn->SetBeginLSN(txn->GetPrevLSN());
+    RunningTxnSlot &slot = SlotOf(txn);
+    std::scoped_lock guard(slot.logged_txns_latch_);
+    slot.logged_txns_[txn->GetTransactionId()] = txn;
   }
-  txn_map_mutex.lock();
-  txn_map[txn->GetTransactionId()] = txn;
-  txn_map_mutex.unlock();
   return txn;
 }
 
 void TransactionManager::Commit(Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    EndReadOnly(txn, TransactionState::COMMITTED);
+    return;
+  }
+  // An optimistic transaction applies its writes only now, and commits only if what it read is still current.
+  if (txn->InReadPhase() && !InstallWrites(txn)) {
+    Abort(txn);
+    return;
+  }
+  // The transaction reads no more, so its snapshot does not hold back the garbage collection of its own writes.
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+    std::scoped_lock guard(snapshots_latch_);
+    snapshots_.erase(snapshots_.find(txn->GetReadTs()));
+  }
+  // Stamp the writes while the write set still names them.
+  if (!CommitVersions(txn)) {
+    Abort(txn);
+    return;
+  }
   txn->SetState(TransactionState::COMMITTED);
 
   // Perform all deletes before we commit.
@@ -52,16 +97,59 @@ void TransactionManager::Commit(Transaction *txn) {
   }
   write_set->clear();
 
+  // Unless the transaction is asynchronous, the commit record must be durable before the locks go.
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+    lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+    txn->SetPrevLSN(lsn);
+    switch (txn->GetDurabilityMode()) {
+      case DurabilityMode::SYNCHRONOUS:
+        log_manager_->Flush();
+        break;
+      case DurabilityMode::GROUP:
+        // Concurrent committers share one log flush.
+        log_manager_->WaitUntilPersistent(lsn);
+        break;
+      case DurabilityMode::ASYNCHRONOUS:
+        // The flush thread persists the commit record later.
+        break;
+    }
+  }
+  if (txn->GetBeginLSN() != INVALID_LSN) {
+    RunningTxnSlot &slot = SlotOf(txn);
+    std::scoped_lock guard(slot.logged_txns_latch_);
+    slot.logged_txns_.erase(txn->GetTransactionId());
+  }
+
   // Release all the locks.
   ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
+  if (IsVersioned(txn)) {
+    versioned_txns_.fetch_sub(1);
+  }
+  txn_registry_.Deregister(txn);
+  ExitRunning(txn);
 }
 
 void TransactionManager::Abort(Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    EndReadOnly(txn, TransactionState::ABORTED);
+    return;
+  }
   txn->SetState(TransactionState::ABORTED);
+  // The buffered writes of an optimistic transaction never took effect.
+  if (txn->GetConcurrencyControl() == ConcurrencyControl::OPTIMISTIC) {
+    txn->EndReadPhase();
+    txn->GetBufferedWriteSet()->clear();
+    std::scoped_lock guard(commit_latch_);
+    optimistic_txns_.erase(optimistic_txns_.find(txn->GetReadTs()));
+  }
   // Rollback before releasing the lock.
   auto table_write_set = txn->GetWriteSet();
+  std::vector<std::pair<TableHeap *, RID>> written;
+  written.reserve(table_write_set->size());
+  for (const auto &item : *table_write_set) {
+    written.emplace_back(item.table_, item.rid_);
+  }
   while (!table_write_set->empty()) {
     auto &item = table_write_set->back();
     auto table = item.table_;
@@ -76,6 +164,10 @@ void TransactionManager::Abort(Transaction *txn) {
     table_write_set->pop_back();
   }
   table_write_set->clear();
+  // With the tuples rolled back, the values the writes saved are the current ones again.
+  for (const auto &[table, rid] : written) {
+    table->AbortVersion(rid, txn);
+  }
   // Rollback index updates
   auto index_write_set = txn->GetIndexWriteSet();
   while (!index_write_set->empty()) {
@@ -102,14 +194,220 @@ void TransactionManager::Abort(Transaction *txn) {
   table_write_set->clear();
   index_write_set->clear();
 
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+  }
+  if (txn->GetBeginLSN() != INVALID_LSN) {
+    RunningTxnSlot &slot = SlotOf(txn);
+    std::scoped_lock guard(slot.logged_txns_latch_);
+    slot.logged_txns_.erase(txn->GetTransactionId());
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+    std::scoped_lock guard(snapshots_latch_);
+    snapshots_.erase(snapshots_.find(txn->GetReadTs()));
+  }
+
   // Release all the locks.
   ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
+  if (IsVersioned(txn)) {
+    versioned_txns_.fetch_sub(1);
+  }
+  txn_registry_.Deregister(txn);
+  ExitRunning(txn);
+}
+
+void TransactionManager::EndReadOnly(Transaction *txn, TransactionState state) {
+  {
+    std::scoped_lock guard(snapshots_latch_);
+    snapshots_.erase(snapshots_.find(txn->GetReadTs()));
+  }
+  txn->SetState(state);
+  versioned_txns_.fetch_sub(1);
+  txn_registry_.Deregister(txn);
+  ExitRunning(txn);
+}
+
+std::vector<std::tuple<txn_id_t, lsn_t, lsn_t>> TransactionManager::GetActiveTransactions() {
+  std::vector<std::tuple<txn_id_t, lsn_t, lsn_t>> active_txns;
+  for (RunningTxnSlot &slot : running_txns_) {
+    std::scoped_lock guard(slot.logged_txns_latch_);
+    for (const auto &[txn_id, txn] : slot.logged_txns_) {
+      active_txns.emplace_back(txn_id, txn->GetBeginLSN(), txn->GetPrevLSN());
+    }
+  }
+  return active_txns;
+}
+
+timestamp_t TransactionManager::GetWatermark() {
+  std::scoped_lock guard(snapshots_latch_);
+  return snapshots_.empty() ? last_commit_ts_.load() : *snapshots_.begin();
+}
+
+bool TransactionManager::CommitVersions(Transaction *txn) {
+  const bool optimistic = txn->GetConcurrencyControl() == ConcurrencyControl::OPTIMISTIC;
+  auto write_set = txn->GetWriteSet();
+  if (write_set->empty() && !optimistic) {
+    return true;
+  }
+  if (!IsVersioned(txn)) {
+    std::atomic<int64_t> &unlatched_commits = SlotOf(txn).unlatched_commits_;
+    unlatched_commits.fetch_add(1);
+    if (versioned_txns_ == 0) {
+      // Nobody reads the versions, so they are garbage as soon as the writes are stamped.
+      const timestamp_t commit_ts = last_commit_ts_;
+      txn->SetCommitTs(commit_ts);
+      for (const auto &item : *write_set) {
+        item.table_->CommitVersion(item.rid_, txn, commit_ts);
+        item.table_->PruneVersions(item.rid_, commit_ts);
+      }
+      unlatched_commits.fetch_sub(1);
+      return true;
+    }
+    unlatched_commits.fetch_sub(1);
+  }
+  std::scoped_lock guard(commit_latch_);
+  if (optimistic) {
+    if (!Validate(txn)) {
+      return false;
+    }
+    optimistic_txns_.erase(optimistic_txns_.find(txn->GetReadTs()));
+    if (write_set->empty()) {
+      return true;
+    }
+  }
+  const timestamp_t commit_ts = last_commit_ts_ + 1;
+  txn->SetCommitTs(commit_ts);
+  for (const auto &item : *write_set) {
+    item.table_->CommitVersion(item.rid_, txn, commit_ts);
+  }
+  // Snapshots taken from now on see all of the writes, the older ones none of them.
+  last_commit_ts_ = commit_ts;
+  const timestamp_t watermark = GetWatermark();
+  for (const auto &item : *write_set) {
+    item.table_->PruneVersions(item.rid_, watermark);
+  }
+
+  // Keep the writes for the optimistic transactions that began before, and forget those no one validates against.
+  if (!optimistic_txns_.empty()) {
+    std::vector<RID> rids;
+    rids.reserve(write_set->size());
+    for (const auto &item : *write_set) {
+      rids.push_back(item.rid_);
+    }
+    committed_writes_.emplace_back(commit_ts, std::move(rids));
+  }
+  const timestamp_t oldest = optimistic_txns_.empty() ? commit_ts : *optimistic_txns_.begin();
+  while (!committed_writes_.empty() && committed_writes_.front().first <= oldest) {
+    committed_writes_.pop_front();
+  }
+  return true;
 }
 
-void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
+bool TransactionManager::InstallWrites(Transaction *txn) {
+  txn->EndReadPhase();
+  auto buffered_write_set = txn->GetBufferedWriteSet();
+  std::vector<RID> rids;
+  rids.reserve(buffered_write_set->size());
+  for (const auto &[rid, write] : *buffered_write_set) {
+    rids.push_back(rid);
+  }
+  std::sort(rids.begin(), rids.end(), [](const RID &a, const RID &b) { return a.Get() < b.Get(); });
+  try {
+    // Lock first, in RID order: the table pages lock with the page latched, and two transactions installing at once
+    // would otherwise wait for each other's locks and latches.
+    if (enable_logging) {
+      for (const RID &rid : rids) {
+        if (!txn->IsExclusiveLocked(rid) &&
+            !lock_manager_->LockExclusive(txn, rid, buffered_write_set->at(rid).table_->GetTableOid())) {
+          return false;
+        }
+      }
+    }
+    for (const RID &rid : rids) {
+      const TableWriteRecord &write = buffered_write_set->at(rid);
+      const bool written = write.wtype_ == WType::DELETE ? write.table_->MarkDelete(rid, txn)
+                                                         : write.table_->UpdateTuple(write.tuple_, rid, txn);
+      if (!written || txn->GetState() == TransactionState::ABORTED) {
+        return false;
+      }
+    }
+  } catch (TransactionAbortException &e) {
+    return false;
+  }
+  buffered_write_set->clear();
+  return true;
+}
 
-void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
+bool TransactionManager::Validate(Transaction *txn) {
+  auto read_set = txn->GetReadSet();
+  for (auto it = committed_writes_.rbegin(); it != committed_writes_.rend() && it->first > txn->GetReadTs(); ++it) {
+    for (const RID &rid : it->second) {
+      if (read_set->count(rid) > 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void TransactionManager::BlockAllTransactions() {
+  std::unique_lock latch(block_latch_);
+  // One blocker at a time.
+  unblocked_cv_.wait(latch, [this] { return !blocked_; });
+  blocked_ = true;
+  exited_cv_.wait(latch, [this] { return AllExited(); });
+}
+
+void TransactionManager::ResumeTransactions() {
+  {
+    std::scoped_lock guard(block_latch_);
+    blocked_ = false;
+  }
+  unblocked_cv_.notify_all();
+}
+
+TransactionManager::RunningTxnSlot &TransactionManager::SlotOf(Transaction *txn) {
+  // Fibonacci hashing spreads the thread ids, whose low bits tend to be alike.
+  const uint64_t hash = std::hash<std::thread::id>{}(txn->GetThreadId()) * 0x9E3779B97F4A7C15ULL;
+  return running_txns_[(hash >> 32) % TXN_COUNTER_SLOTS];
+}
+
+void TransactionManager::EnterVersioned() {
+  versioned_txns_.fetch_add(1);
+  for (const RunningTxnSlot &slot : running_txns_) {
+    while (slot.unlatched_commits_ != 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void TransactionManager::EnterRunning(Transaction *txn) {
+  RunningTxnSlot &counter = SlotOf(txn);
+  // Count first and check blocked_ second, while BlockAllTransactions sets blocked_ first and checks the counters
+  // second: one of the two sees the other.
+  counter.count_.fetch_add(1);
+  while (blocked_) {
+    ExitRunning(txn);
+    {
+      std::unique_lock latch(block_latch_);
+      unblocked_cv_.wait(latch, [this] { return !blocked_; });
+    }
+    counter.count_.fetch_add(1);
+  }
+}
+
+void TransactionManager::ExitRunning(Transaction *txn) {
+  SlotOf(txn).count_.fetch_sub(1);
+  if (blocked_) {
+    std::scoped_lock guard(block_latch_);
+    exited_cv_.notify_all();
+  }
+}
+
+bool TransactionManager::AllExited() const {
+  return std::all_of(running_txns_.begin(), running_txns_.end(),
+                     [](const RunningTxnSlot &slot) { return slot.count_ == 0; });
+}
 
 }  // namespace bustub
@@ -0,0 +1,63 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.cpp
+//
+// Identification: src/concurrency/transaction_registry.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/transaction_registry.h"
+
+#include <mutex>  // NOLINT
+
+namespace bustub {
+
+void TransactionRegistry::Register(Transaction *txn) {
+  Slot &slot = slots_[SlotOf(txn->GetTransactionId())];
+  txn_id_t expected = INVALID_TXN_ID;
+  if (slot.txn_id_.compare_exchange_strong(expected, CLAIMED_TXN_ID)) {
+    slot.txn_.store(txn);
+    slot.txn_id_.store(txn->GetTransactionId(), std::memory_order_release);
+    return;
+  }
+  std::unique_lock latch(overflow_latch_);
+  overflow_[txn->GetTransactionId()] = txn;
+  overflow_size_++;
+}
+
+void TransactionRegistry::Deregister(Transaction *txn) {
+  Slot &slot = slots_[SlotOf(txn->GetTransactionId())];
+  if (slot.txn_id_.load(std::memory_order_relaxed) == txn->GetTransactionId()) {
+    slot.txn_.store(nullptr, std::memory_order_relaxed);
+    slot.txn_id_.store(INVALID_TXN_ID, std::memory_order_release);
+    return;
+  }
+  std::unique_lock latch(overflow_latch_);
+  if (overflow_.erase(txn->GetTransactionId()) > 0) {
+    overflow_size_--;
+  }
+}
+
+Transaction *TransactionRegistry::Find(txn_id_t txn_id) const {
+  const Slot &slot = slots_[SlotOf(txn_id)];
+  if (slot.txn_id_.load(std::memory_order_acquire) == txn_id) {
+    Transaction *txn = slot.txn_.load(std::memory_order_acquire);
+    // Unless the slot changed hands in between, txn is the transaction with the id.
+    if (slot.txn_id_.load(std::memory_order_relaxed) == txn_id) {
+      return txn;
+    }
+    return nullptr;
+  }
+  if (overflow_size_ == 0) {
+    return nullptr;
+  }
+  std::shared_lock latch(overflow_latch_);
+  auto it = overflow_.find(txn_id);
+  return it == overflow_.end() ? nullptr : it->second;
+}
+
+}  // namespace bustub
@@ -10,6 +10,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <utility>
@@ -18,15 +20,48 @@
 #include "common/exception.h"
 #include "common/logger.h"
 #include "common/rid.h"
+#include "common/util/hash_util.h"
 #include "container/hash/extendible_hash_table.h"
+#include "recovery/log_manager.h"
 
 namespace bustub {
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 HASH_TABLE_TYPE::ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
-                                     const KeyComparator &comparator, HashFunction<KeyType> hash_fn)
-    : buffer_pool_manager_(buffer_pool_manager), comparator_(comparator), hash_fn_(std::move(hash_fn)) {
-  //  implement me!
+                                     const KeyComparator &comparator, HashFunction<KeyType> hash_fn,
+                                     page_id_t directory_page_id)
+    : directory_page_id_(directory_page_id),
+      index_id_(static_cast<uint32_t>(HashUtil::HashBytes(name.data(), name.size()))),
+      buffer_pool_manager_(buffer_pool_manager),
+      comparator_(comparator),
+      hash_fn_(std::move(hash_fn)) {
+  if (directory_page_id_ != INVALID_PAGE_ID) {
+    return;
+  }
+  // A new table starts out with a single bucket that every key maps to.
+  Page *page = buffer_pool_manager_->NewPage(&directory_page_id_);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot allocate the directory page");
+  }
+  auto *dir_page = reinterpret_cast<HashTableDirectoryPage *>(page->GetData());
+  page_id_t bucket_page_id;
+  page = buffer_pool_manager_->NewPage(&bucket_page_id);
+  if (page == nullptr) {
+    buffer_pool_manager_->UnpinPage(directory_page_id_, false);
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot allocate the first bucket page");
+  }
+  auto *bucket_page = reinterpret_cast<HASH_TABLE_BUCKET_TYPE *>(page->GetData());
+
+  std::vector<char> dir_before = CopyForLog(dir_page);
+  std::vector<char> bucket_before = CopyForLog(bucket_page);
+  dir_page->SetPageId(directory_page_id_);
+  dir_page->SetBucketPageId(0, bucket_page_id);
+  dir_page->SetLocalDepth(0, 0);
+  bucket_page->SetPageId(bucket_page_id);
+  LogPageWrite(dir_page, dir_before);
+  LogPageWrite(bucket_page, bucket_before);
+  buffer_pool_manager_->UnpinPage(bucket_page_id, true);
+  buffer_pool_manager_->UnpinPage(directory_page_id_, true);
 }
 
 /*****************************************************************************
@@ -46,22 +81,74 @@ uint32_t HASH_TABLE_TYPE::Hash(KeyType key) {
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 inline uint32_t HASH_TABLE_TYPE::KeyToDirectoryIndex(KeyType key, HashTableDirectoryPage *dir_page) {
-  return 0;
+  return Hash(key) & dir_page->GetGlobalDepthMask();
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 inline uint32_t HASH_TABLE_TYPE::KeyToPageId(KeyType key, HashTableDirectoryPage *dir_page) {
-  return 0;
+  return dir_page->GetBucketPageId(KeyToDirectoryIndex(key, dir_page));
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 HashTableDirectoryPage *HASH_TABLE_TYPE::FetchDirectoryPage() {
-  return nullptr;
+  Page *page = buffer_pool_manager_->FetchPage(directory_page_id_);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch the directory page");
+  }
+  return reinterpret_cast<HashTableDirectoryPage *>(page->GetData());
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+HASH_TABLE_BUCKET_TYPE *HASH_TABLE_TYPE::FetchBucketPage(page_id_t bucket_page_id, Page **page) {
+  Page *bucket_page = buffer_pool_manager_->FetchPage(bucket_page_id);
+  if (bucket_page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch a bucket page");
+  }
+  if (page != nullptr) {
+    *page = bucket_page;
+  }
+  return reinterpret_cast<HASH_TABLE_BUCKET_TYPE *>(bucket_page->GetData());
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+std::vector<char> HASH_TABLE_TYPE::CopyForLog(const void *page) const {
+  if (!enable_logging || buffer_pool_manager_->GetLogManager() == nullptr) {
+    return {};
+  }
+  const auto *data = static_cast<const char *>(page);
+  return std::vector<char>(data, data + PAGE_SIZE);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+template <typename P>
+void HASH_TABLE_TYPE::LogPageWrite(P *page, const std::vector<char> &before) {
+  if (before.empty()) {
+    return;
+  }
+  LogRecord log_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::INDEX_PAGE_WRITE, page->GetPageId(),
+                       before.data(), reinterpret_cast<const char *>(page));
+  if (!log_record.GetPageWriteRanges().empty()) {
+    page->SetLSN(buffer_pool_manager_->GetLogManager()->AppendLogRecord(&log_record));
+  }
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-HASH_TABLE_BUCKET_TYPE *HASH_TABLE_TYPE::FetchBucketPage(page_id_t bucket_page_id) {
-  return nullptr;
+void HASH_TABLE_TYPE::LogEntry(LogRecordType log_record_type, HASH_TABLE_BUCKET_TYPE *bucket_page,
+                               uint32_t bucket_idx, const KeyType &key, const ValueType &value,
+                               Transaction *transaction) {
+  if (!enable_logging || buffer_pool_manager_->GetLogManager() == nullptr) {
+    return;
+  }
+  const txn_id_t txn_id = transaction == nullptr ? INVALID_TXN_ID : transaction->GetTransactionId();
+  const lsn_t prev_lsn = transaction == nullptr ? INVALID_LSN : transaction->GetPrevLSN();
+  const MappingType item(key, value);
+  LogRecord log_record(txn_id, prev_lsn, log_record_type, index_id_, bucket_page->GetPageId(), bucket_idx,
+                       reinterpret_cast<const char *>(&item), sizeof(MappingType));
+  const lsn_t lsn = buffer_pool_manager_->GetLogManager()->AppendLogRecord(&log_record);
+  bucket_page->SetLSN(lsn);
+  if (transaction != nullptr) {
+    transaction->SetPrevLSN(lsn);
+  }
 }
 
 /*****************************************************************************
@@ -69,7 +156,18 @@ HASH_TABLE_BUCKET_TYPE *HASH_TABLE_TYPE::FetchBucketPage(page_id_t bucket_page_i
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result) {
-  return false;
+  table_latch_.RLock();
+  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
+  const page_id_t bucket_page_id = KeyToPageId(key, dir_page);
+  Page *page;
+  HASH_TABLE_BUCKET_TYPE *bucket_page = FetchBucketPage(bucket_page_id, &page);
+  page->RLatch();
+  const bool found = bucket_page->GetValue(key, comparator_, result);
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(bucket_page_id, false);
+  buffer_pool_manager_->UnpinPage(directory_page_id_, false);
+  table_latch_.RUnlock();
+  return found;
 }
 
 /*****************************************************************************
@@ -77,12 +175,97 @@ bool HASH_TABLE_TYPE::GetValue(Transaction *transaction, const KeyType &key, std
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::Insert(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  return false;
+  table_latch_.RLock();
+  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
+  const page_id_t bucket_page_id = KeyToPageId(key, dir_page);
+  Page *page;
+  HASH_TABLE_BUCKET_TYPE *bucket_page = FetchBucketPage(bucket_page_id, &page);
+  page->WLatch();
+  const bool full = bucket_page->IsFull();
+  uint32_t bucket_idx;
+  const bool inserted = !full && bucket_page->Insert(key, value, comparator_, &bucket_idx);
+  if (inserted) {
+    LogEntry(LogRecordType::HASH_INSERT, bucket_page, bucket_idx, key, value, transaction);
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(bucket_page_id, inserted);
+  buffer_pool_manager_->UnpinPage(directory_page_id_, false);
+  table_latch_.RUnlock();
+  return full ? SplitInsert(transaction, key, value) : inserted;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  return false;
+  table_latch_.WLock();
+  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
+  bool dir_dirty = false;
+  bool inserted = false;
+  // Split until the key's bucket has room, which may take more than one split if the keys keep hashing alike.
+  while (true) {
+    const uint32_t bucket_idx = KeyToDirectoryIndex(key, dir_page);
+    const page_id_t bucket_page_id = dir_page->GetBucketPageId(bucket_idx);
+    HASH_TABLE_BUCKET_TYPE *bucket_page = FetchBucketPage(bucket_page_id);
+    if (!bucket_page->IsFull()) {
+      uint32_t slot;
+      inserted = bucket_page->Insert(key, value, comparator_, &slot);
+      if (inserted) {
+        LogEntry(LogRecordType::HASH_INSERT, bucket_page, slot, key, value, transaction);
+      }
+      buffer_pool_manager_->UnpinPage(bucket_page_id, inserted);
+      break;
+    }
+    std::vector<ValueType> values;
+    bucket_page->GetValue(key, comparator_, &values);
+    const bool duplicate = std::find(values.begin(), values.end(), value) != values.end();
+    const uint32_t local_depth = dir_page->GetLocalDepth(bucket_idx);
+    if (duplicate || (local_depth == dir_page->GetGlobalDepth() && dir_page->Size() * 2 > DIRECTORY_ARRAY_SIZE)) {
+      buffer_pool_manager_->UnpinPage(bucket_page_id, false);
+      break;
+    }
+
+    page_id_t image_page_id;
+    Page *page = buffer_pool_manager_->NewPage(&image_page_id);
+    if (page == nullptr) {
+      buffer_pool_manager_->UnpinPage(bucket_page_id, false);
+      buffer_pool_manager_->UnpinPage(directory_page_id_, dir_dirty);
+      table_latch_.WUnlock();
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot allocate a bucket page to split into");
+    }
+    auto *image_page = reinterpret_cast<HASH_TABLE_BUCKET_TYPE *>(page->GetData());
+    std::vector<char> dir_before = CopyForLog(dir_page);
+    std::vector<char> bucket_before = CopyForLog(bucket_page);
+    std::vector<char> image_before = CopyForLog(image_page);
+
+    if (local_depth == dir_page->GetGlobalDepth()) {
+      dir_page->IncrGlobalDepth();
+    }
+    // Of the slots pointing to the bucket, those with the new high bit set now point to its split image.
+    const uint32_t high_bit = 1U << local_depth;
+    for (uint32_t idx = 0; idx < dir_page->Size(); idx++) {
+      if (dir_page->GetBucketPageId(idx) == bucket_page_id) {
+        dir_page->IncrLocalDepth(idx);
+        if ((idx & high_bit) != 0) {
+          dir_page->SetBucketPageId(idx, image_page_id);
+        }
+      }
+    }
+    image_page->SetPageId(image_page_id);
+    for (uint32_t slot = 0; slot < BUCKET_ARRAY_SIZE && bucket_page->IsOccupied(slot); slot++) {
+      if (bucket_page->IsReadable(slot) && (Hash(bucket_page->KeyAt(slot)) & high_bit) != 0) {
+        image_page->Insert(bucket_page->KeyAt(slot), bucket_page->ValueAt(slot), comparator_);
+        bucket_page->RemoveAt(slot);
+      }
+    }
+    LogPageWrite(dir_page, dir_before);
+    LogPageWrite(bucket_page, bucket_before);
+    LogPageWrite(image_page, image_before);
+    dir_dirty = true;
+    buffer_pool_manager_->UnpinPage(image_page_id, true);
+    buffer_pool_manager_->UnpinPage(bucket_page_id, true);
+  }
+  buffer_pool_manager_->UnpinPage(directory_page_id_, dir_dirty);
+  table_latch_.WUnlock();
+  return inserted;
 }
 
 /*****************************************************************************
@@ -90,14 +273,82 @@ bool HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key,
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  return false;
+  table_latch_.RLock();
+  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
+  const page_id_t bucket_page_id = KeyToPageId(key, dir_page);
+  Page *page;
+  HASH_TABLE_BUCKET_TYPE *bucket_page = FetchBucketPage(bucket_page_id, &page);
+  page->WLatch();
+  uint32_t bucket_idx;
+  const bool removed = bucket_page->Remove(key, value, comparator_, &bucket_idx);
+  if (removed) {
+    LogEntry(LogRecordType::HASH_DELETE, bucket_page, bucket_idx, key, value, transaction);
+  }
+  const bool empty = bucket_page->IsEmpty();
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(bucket_page_id, removed);
+  buffer_pool_manager_->UnpinPage(directory_page_id_, false);
+  table_latch_.RUnlock();
+  if (removed && empty) {
+    Merge(transaction, key, value);
+  }
+  return removed;
 }
 
 /*****************************************************************************
  * MERGE
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
-void HASH_TABLE_TYPE::Merge(Transaction *transaction, const KeyType &key, const ValueType &value) {}
+void HASH_TABLE_TYPE::Merge(Transaction *transaction, const KeyType &key, const ValueType &value) {
+  table_latch_.WLock();
+  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
+  const uint32_t bucket_idx = KeyToDirectoryIndex(key, dir_page);
+  const page_id_t bucket_page_id = dir_page->GetBucketPageId(bucket_idx);
+  const uint32_t local_depth = dir_page->GetLocalDepth(bucket_idx);
+  HASH_TABLE_BUCKET_TYPE *bucket_page = FetchBucketPage(bucket_page_id);
+  const bool empty = bucket_page->IsEmpty();
+  buffer_pool_manager_->UnpinPage(bucket_page_id, false);
+
+  const uint32_t image_idx = dir_page->GetSplitImageIndex(bucket_idx);
+  if (!empty || local_depth == 0 || dir_page->GetLocalDepth(image_idx) != local_depth) {
+    buffer_pool_manager_->UnpinPage(directory_page_id_, false);
+    table_latch_.WUnlock();
+    return;
+  }
+
+  const page_id_t image_page_id = dir_page->GetBucketPageId(image_idx);
+  std::vector<char> dir_before = CopyForLog(dir_page);
+  for (uint32_t idx = 0; idx < dir_page->Size(); idx++) {
+    const page_id_t page_id = dir_page->GetBucketPageId(idx);
+    if (page_id == bucket_page_id || page_id == image_page_id) {
+      dir_page->SetBucketPageId(idx, image_page_id);
+      dir_page->DecrLocalDepth(idx);
+    }
+  }
+  while (dir_page->CanShrink()) {
+    dir_page->DecrGlobalDepth();
+  }
+  LogPageWrite(dir_page, dir_before);
+  buffer_pool_manager_->UnpinPage(directory_page_id_, true);
+  buffer_pool_manager_->DeletePage(bucket_page_id);
+  table_latch_.WUnlock();
+}
+
+/*****************************************************************************
+ * RECOVERY
+ *****************************************************************************/
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::Undo(LogRecord *log_record) {
+  BUSTUB_ASSERT(log_record->GetIndexId() == index_id_ && log_record->GetEntry().size() == sizeof(MappingType),
+                "Undo of a pair of another index");
+  MappingType item;
+  memcpy(reinterpret_cast<void *>(&item), log_record->GetEntry().data(), sizeof(MappingType));
+  if (log_record->GetLogRecordType() == LogRecordType::HASH_INSERT) {
+    Remove(nullptr, item.first, item.second);
+  } else {
+    Insert(nullptr, item.first, item.second);
+  }
+}
 
 /*****************************************************************************
  * GETGLOBALDEPTH - DO NOT TOUCH
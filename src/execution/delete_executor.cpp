@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 
 #include <memory>
+#include <vector>
 
 #include "execution/executors/delete_executor.h"
 
@@ -18,10 +19,41 @@ namespace bustub {
 
 DeleteExecutor::DeleteExecutor(ExecutorContext *exec_ctx, const DeletePlanNode *plan,
                                std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx) {}
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      table_info_(exec_ctx->GetCatalog()->GetTable(plan->TableOid())),
+      child_executor_(std::move(child_executor)) {}
 
-void DeleteExecutor::Init() {}
+void DeleteExecutor::Init() {
+  child_executor_->Init();
+  locked_ = table_info_->table_->LockTable(GetExecutorContext()->GetTransaction(), LockMode::INTENTION_EXCLUSIVE);
+}
 
-bool DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) { return false; }
+bool DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
+  if (!locked_) {
+    return false;
+  }
+  Transaction *txn = GetExecutorContext()->GetTransaction();
+  Catalog *catalog = GetExecutorContext()->GetCatalog();
+  TableHeap *table = table_info_->table_.get();
+  const std::vector<IndexInfo *> indexes = catalog->GetTableIndexes(table_info_->name_);
+  Tuple child_tuple;
+  RID child_rid;
+  while (child_executor_->Next(&child_tuple, &child_rid)) {
+    // The child may not output every column, and the index keys are taken from the whole tuple.
+    Tuple old_tuple;
+    if (!table->GetTuple(child_rid, &old_tuple, txn) || !table->MarkDelete(child_rid, txn)) {
+      return false;
+    }
+    for (IndexInfo *index_info : indexes) {
+      index_info->index_->DeleteEntry(
+          old_tuple.KeyFromTuple(table_info_->schema_, index_info->key_schema_, index_info->index_->GetKeyAttrs()),
+          child_rid, txn);
+      txn->GetIndexWriteSet()->emplace_back(child_rid, table_info_->oid_, WType::DELETE, old_tuple, Tuple{},
+                                            index_info->index_oid_, catalog);
+    }
+  }
+  return false;
+}
 
 }  // namespace bustub
@@ -13,10 +13,67 @@
 
 namespace bustub {
 IndexScanExecutor::IndexScanExecutor(ExecutorContext *exec_ctx, const IndexScanPlanNode *plan)
-    : AbstractExecutor(exec_ctx) {}
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      index_info_(exec_ctx->GetCatalog()->GetIndex(plan->GetIndexOid())),
+      table_info_(exec_ctx->GetCatalog()->GetTable(index_info_->table_name_)) {}
 
-void IndexScanExecutor::Init() {}
+void IndexScanExecutor::Init() {
+  tree_ = dynamic_cast<BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>> *>(index_info_->index_.get());
+  BUSTUB_ASSERT(tree_ != nullptr, "Index scans need a B+ tree index on 8-byte keys.");
+  locks_keys_ = tree_->LocksScans(GetExecutorContext()->GetTransaction());
+  scanned_any_ = false;
+  if (!locks_keys_) {
+    iterator_ = std::make_unique<IndexIterator<GenericKey<8>, RID, GenericComparator<8>>>(tree_->GetBeginIterator());
+  }
+}
 
-bool IndexScanExecutor::Next(Tuple *tuple, RID *rid) { return false; }
+bool IndexScanExecutor::Next(Tuple *tuple, RID *rid) {
+  Transaction *txn = GetExecutorContext()->GetTransaction();
+  const Schema *schema = &table_info_->schema_;
+  const AbstractExpression *predicate = plan_->GetPredicate();
+  std::pair<GenericKey<8>, RID> entry;
+  while (NextEntry(&entry)) {
+    Tuple cur;
+    if (!table_info_->table_->GetTuple(entry.second, &cur, txn)) {
+      continue;
+    }
+    // The version read, a snapshot's say, may have another key than the entry, which belongs to a newer version.
+    GenericKey<8> key;
+    key.SetFromKey(cur.KeyFromTuple(*schema, *tree_->GetKeySchema(), tree_->GetKeyAttrs()));
+    if (GenericComparator<8>(tree_->GetKeySchema())(key, entry.first) != 0) {
+      continue;
+    }
+    if (predicate != nullptr && !predicate->Evaluate(&cur, schema).GetAs<bool>()) {
+      continue;
+    }
+    std::vector<Value> values;
+    values.reserve(GetOutputSchema()->GetColumnCount());
+    for (const Column &column : GetOutputSchema()->GetColumns()) {
+      values.push_back(column.GetExpr()->Evaluate(&cur, schema));
+    }
+    *tuple = Tuple(values, GetOutputSchema());
+    *rid = cur.GetRid();
+    return true;
+  }
+  return false;
+}
+
+bool IndexScanExecutor::NextEntry(std::pair<GenericKey<8>, RID> *entry) {
+  if (!locks_keys_) {
+    if (iterator_->IsEnd()) {
+      return false;
+    }
+    *entry = **iterator_;
+    ++(*iterator_);
+    return true;
+  }
+  if (!tree_->ScanNext(scanned_any_ ? &last_key_ : nullptr, entry, GetExecutorContext()->GetTransaction())) {
+    return false;
+  }
+  last_key_ = entry->first;
+  scanned_any_ = true;
+  return true;
+}
 
 }  // namespace bustub
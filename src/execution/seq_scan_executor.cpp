@@ -14,10 +14,47 @@
 
 namespace bustub {
 
-SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNode *plan) : AbstractExecutor(exec_ctx) {}
+SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNode *plan)
+    : AbstractExecutor(exec_ctx), plan_(plan), table_info_(exec_ctx->GetCatalog()->GetTable(plan->GetTableOid())) {}
 
-void SeqScanExecutor::Init() {}
+void SeqScanExecutor::Init() {
+  Transaction *txn = GetExecutorContext()->GetTransaction();
+  TableHeap *table = table_info_->table_.get();
+  // Repeatable read locks the whole table, inserts into it included, where read committed locks tuple by tuple.
+  bool locked = true;
+  switch (txn->GetIsolationLevel()) {
+    case IsolationLevel::REPEATABLE_READ:
+      locked = table->LockTable(txn, LockMode::SHARED);
+      break;
+    case IsolationLevel::READ_COMMITTED:
+      locked = table->LockTable(txn, LockMode::INTENTION_SHARED);
+      break;
+    default:
+      break;
+  }
+  iterator_ = std::make_unique<TableIterator>(locked ? table->Begin(txn) : table->End());
+}
 
-bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) { return false; }
+bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
+  const TableIterator end = table_info_->table_->End();
+  const Schema *schema = &table_info_->schema_;
+  const AbstractExpression *predicate = plan_->GetPredicate();
+  for (; *iterator_ != end; ++(*iterator_)) {
+    const Tuple &cur = **iterator_;
+    if (predicate != nullptr && !predicate->Evaluate(&cur, schema).GetAs<bool>()) {
+      continue;
+    }
+    std::vector<Value> values;
+    values.reserve(GetOutputSchema()->GetColumnCount());
+    for (const Column &column : GetOutputSchema()->GetColumns()) {
+      values.push_back(column.GetExpr()->Evaluate(&cur, schema));
+    }
+    *tuple = Tuple(values, GetOutputSchema());
+    *rid = cur.GetRid();
+    ++(*iterator_);
+    return true;
+  }
+  return false;
+}
 
 }  // namespace bustub
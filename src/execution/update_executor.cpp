@@ -10,6 +10,7 @@
 //
 //===----------------------------------------------------------------------===//
 #include <memory>
+#include <vector>
 
 #include "execution/executors/update_executor.h"
 
@@ -17,11 +18,48 @@ namespace bustub {
 
 UpdateExecutor::UpdateExecutor(ExecutorContext *exec_ctx, const UpdatePlanNode *plan,
                                std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx) {}
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      table_info_(exec_ctx->GetCatalog()->GetTable(plan->TableOid())),
+      child_executor_(std::move(child_executor)) {}
 
-void UpdateExecutor::Init() {}
+void UpdateExecutor::Init() {
+  child_executor_->Init();
+  locked_ = table_info_->table_->LockTable(GetExecutorContext()->GetTransaction(), LockMode::INTENTION_EXCLUSIVE);
+}
 
-bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) { return false; }
+bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
+  if (!locked_) {
+    return false;
+  }
+  Transaction *txn = GetExecutorContext()->GetTransaction();
+  Catalog *catalog = GetExecutorContext()->GetCatalog();
+  TableHeap *table = table_info_->table_.get();
+  const std::vector<IndexInfo *> indexes = catalog->GetTableIndexes(table_info_->name_);
+  Tuple child_tuple;
+  RID child_rid;
+  while (child_executor_->Next(&child_tuple, &child_rid)) {
+    // The child may not output every column, so the update starts from the whole tuple.
+    Tuple old_tuple;
+    if (!table->GetTuple(child_rid, &old_tuple, txn)) {
+      return false;
+    }
+    Tuple new_tuple = GenerateUpdatedTuple(old_tuple);
+    if (!table->UpdateTuple(new_tuple, child_rid, txn)) {
+      return false;
+    }
+    for (IndexInfo *index_info : indexes) {
+      const std::vector<uint32_t> &key_attrs = index_info->index_->GetKeyAttrs();
+      index_info->index_->DeleteEntry(old_tuple.KeyFromTuple(table_info_->schema_, index_info->key_schema_, key_attrs),
+                                      child_rid, txn);
+      index_info->index_->InsertEntry(new_tuple.KeyFromTuple(table_info_->schema_, index_info->key_schema_, key_attrs),
+                                      child_rid, txn);
+      txn->GetIndexWriteSet()->emplace_back(child_rid, table_info_->oid_, WType::UPDATE, new_tuple, old_tuple,
+                                            index_info->index_oid_, catalog);
+    }
+  }
+  return false;
+}
 
 Tuple UpdateExecutor::GenerateUpdatedTuple(const Tuple &src_tuple) {
   const auto &update_attrs = plan_->GetUpdateAttr();
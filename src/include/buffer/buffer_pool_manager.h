@@ -15,6 +15,8 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
@@ -87,6 +89,15 @@ class BufferPoolManager {
   /** @return size of the buffer pool */
   virtual size_t GetPoolSize() = 0;
 
+  /**
+   * Takes a snapshot of the dirty page table for a checkpoint, without flushing anything.
+   * @return the page id and recovery LSN of every page whose copy on disk may be missing logged changes
+   */
+  virtual std::vector<std::pair<page_id_t, lsn_t>> GetDirtyPageTable() = 0;
+
+  /** @return the log manager that changes to pages of this buffer pool are logged with, nullptr if there is none */
+  virtual LogManager *GetLogManager() = 0;
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -55,6 +55,11 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override { return pool_size_; }
 
+  /** @return the id and recovery LSN of every dirty or pinned page */
+  std::vector<std::pair<page_id_t, lsn_t>> GetDirtyPageTable() override;
+
+  LogManager *GetLogManager() override { return log_manager_; }
+
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
@@ -114,6 +119,15 @@ class BufferPoolManagerInstance : public BufferPoolManager {
     // This is a no-nop right now without a more complex data structure to track deallocated pages
   }
 
+  /**
+   * Write a page back to disk, forcing the log first if the page LSN is not yet persistent.
+   * @param page the page to write
+   */
+  void WriteBackPage(Page *page);
+
+  /** Starts tracking the recovery LSN of a page that has just been pinned, unless it already has one. */
+  void TrackRecLSN(Page *page);
+
   /**
    * Validate that the page_id being used is accessible to this BPI. This can be used in all of the functions to
    * validate input data and ensure that a parallel BPM is routing requests to the correct BPI
@@ -135,7 +149,7 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. */
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
   /** Page table for keeping track of buffer pool pages. */
   std::unordered_map<page_id_t, frame_id_t> page_table_;
   /** Replacer to find unpinned pages for replacement. */
@@ -40,6 +40,12 @@ class ParallelBufferPoolManager : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override;
 
+  /** @return the dirty page tables of all the instances, combined */
+  std::vector<std::pair<page_id_t, lsn_t>> GetDirtyPageTable() override;
+
+  /** @return the log manager all the instances share */
+  LogManager *GetLogManager() override;
+
  protected:
   /**
    * @param page_id id of page
@@ -21,6 +21,7 @@
 #include "buffer/buffer_pool_manager.h"
 #include "catalog/schema.h"
 #include "container/hash/hash_function.h"
+#include "storage/index/b_plus_tree_index.h"
 #include "storage/index/extendible_hash_table_index.h"
 #include "storage/index/index.h"
 #include "storage/table/table_heap.h"
@@ -34,6 +35,9 @@ using table_oid_t = uint32_t;
 using column_oid_t = uint32_t;
 using index_oid_t = uint32_t;
 
+/** The kinds of index the catalog can build. */
+enum class IndexType { BPlusTreeIndex, HashTableIndex };
+
 /**
  * The TableInfo class maintains metadata about a table.
  */
@@ -112,7 +116,17 @@ class Catalog {
    * @param log_manager The log manager in use by the system
    */
   Catalog(BufferPoolManager *bpm, LockManager *lock_manager, LogManager *log_manager)
-      : bpm_{bpm}, lock_manager_{lock_manager}, log_manager_{log_manager} {}
+      : bpm_{bpm}, lock_manager_{lock_manager}, log_manager_{log_manager} {
+    // B+ tree indexes keep their roots in the header page, which has to be the first page allocated, before the first
+    // page of any table. If it is not, the caller set up the header page already.
+    page_id_t header_page_id;
+    if (bpm_->NewPage(&header_page_id) != nullptr) {
+      bpm_->UnpinPage(header_page_id, true);
+      if (header_page_id != HEADER_PAGE_ID) {
+        bpm_->DeletePage(header_page_id);
+      }
+    }
+  }
 
   /**
    * Create a new table and return its metadata.
@@ -126,12 +140,12 @@ class Catalog {
       return NULL_TABLE_INFO;
     }
 
-    // Construct the table heap
-    auto table = std::make_unique<TableHeap>(bpm_, lock_manager_, log_manager_, txn);
-
     // Fetch the table OID for the new table
     const auto table_oid = next_table_oid_.fetch_add(1);
 
+    // Construct the table heap
+    auto table = std::make_unique<TableHeap>(bpm_, lock_manager_, log_manager_, txn, table_oid);
+
     // Construct the table information
     auto meta = std::make_unique<TableInfo>(schema, table_name, std::move(table), table_oid);
     auto *tmp = meta.get();
@@ -185,13 +199,17 @@ class Catalog {
    * @param key_schema The schema of the key
    * @param key_attrs Key attributes
    * @param keysize Size of the key
-   * @param hash_function The hash function for the index
+   * @param hash_function The hash function for a hash table index
+   * @param index_type The kind of index. A hash table, the default, allows duplicate keys. A B+ tree keeps its keys
+   * in order, bulk loads them and next-key locks them for the transactions of the catalog's lock manager, but keeps
+   * every key once: creating one throws on a table with duplicate keys
    * @return A (non-owning) pointer to the metadata of the new table
    */
   template <class KeyType, class ValueType, class KeyComparator>
   IndexInfo *CreateIndex(Transaction *txn, const std::string &index_name, const std::string &table_name,
                          const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs,
-                         std::size_t keysize, HashFunction<KeyType> hash_function) {
+                         std::size_t keysize, HashFunction<KeyType> hash_function,
+                         IndexType index_type = IndexType::HashTableIndex) {
     // Reject the creation request for nonexistent table
     if (table_names_.find(table_name) == table_names_.end()) {
       return NULL_INDEX_INFO;
@@ -211,18 +229,29 @@ class Catalog {
     auto meta = std::make_unique<IndexMetadata>(index_name, table_name, &schema, key_attrs);
 
     // Construct the index, take ownership of metadata
-    // TODO(Kyle): We should update the API for CreateIndex
-    // to allow specification of the index type itself, not
-    // just the key, value, and comparator types
-    auto index = std::make_unique<ExtendibleHashTableIndex<KeyType, ValueType, KeyComparator>>(std::move(meta), bpm_,
-                                                                                               hash_function);
+    std::unique_ptr<Index> index;
+    if (index_type == IndexType::HashTableIndex) {
+      index = std::make_unique<ExtendibleHashTableIndex<KeyType, ValueType, KeyComparator>>(std::move(meta), bpm_,
+                                                                                            hash_function);
+    } else {
+      index = std::make_unique<BPlusTreeIndex<KeyType, ValueType, KeyComparator>>(std::move(meta), bpm_, lock_manager_);
+    }
 
-    // Populate the index with all tuples in table heap
+    // Populate the index with all tuples in table heap, in one go, which a B+ tree turns into a bulk load
     auto *table_meta = GetTable(table_name);
     auto *heap = table_meta->table_.get();
-    for (auto tuple = heap->Begin(txn); tuple != heap->End(); ++tuple) {
-      index->InsertEntry(tuple->KeyFromTuple(schema, key_schema, key_attrs), tuple->GetRid(), txn);
-    }
+    auto tuple = heap->Begin(txn);
+    index->BulkLoad(
+        [&](Tuple *key, RID *rid) {
+          if (tuple == heap->End()) {
+            return false;
+          }
+          *key = tuple->KeyFromTuple(schema, key_schema, key_attrs);
+          *rid = tuple->GetRid();
+          ++tuple;
+          return true;
+        },
+        txn);
 
     // Get the next OID for the new index
     const auto index_oid = next_index_oid_.fetch_add(1);
@@ -23,11 +23,16 @@ namespace bustub {
 
 class BustubInstance {
  public:
-  explicit BustubInstance(const std::string &db_file_name) {
+  /**
+   * @param db_file_name the database file
+   * @param primary_db_file_name for a hot standby, the database file of the primary whose log it replays (see
+   * HotStandby)
+   */
+  explicit BustubInstance(const std::string &db_file_name, const std::string &primary_db_file_name = "") {
     enable_logging = false;
 
     // storage related
-    disk_manager_ = new DiskManager(db_file_name);
+    disk_manager_ = new DiskManager(db_file_name, LOG_SEGMENT_SIZE, primary_db_file_name);
 
     // log related
     log_manager_ = new LogManager(disk_manager_);
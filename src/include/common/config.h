@@ -27,6 +27,15 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** Committing transactions that arrive within GROUP_COMMIT_WINDOW of the first waiter share one log flush. */
+extern std::chrono::microseconds group_commit_window;
+
+/** A hot standby that has replayed all of the primary's log looks for more every STANDBY_POLL_INTERVAL. */
+extern std::chrono::milliseconds standby_poll_interval;
+
+/** A lock manager logs its statistics every LOCK_STATS_INTERVAL, or never if it is zero. */
+extern std::chrono::milliseconds lock_stats_interval;
+
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
@@ -35,11 +44,25 @@ static constexpr int PAGE_SIZE = 4096;                                        //
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int LOG_SEGMENT_SIZE = 16 * LOG_BUFFER_SIZE;                 // size of a log segment file in byte
+static constexpr int LOG_SEGMENT_SPARES = 2;                                  // recycled log segments kept for reuse
+static constexpr int RECOVERY_READ_SIZE = 4 * LOG_BUFFER_SIZE;                // log bytes read ahead during recovery
+static constexpr int RECOVERY_REDO_THREADS = 4;                               // default number of redo workers
+static constexpr int LOCK_TABLE_PARTITIONS = 16;                              // independently latched lock tables
+static constexpr int LOCK_ESCALATION_THRESHOLD = 1000;                        // row locks on a table to escalate at
+static constexpr int LOCK_STATS_TOP_N = 10;                                   // most contended locks to report
+static constexpr int CACHE_LINE_SIZE = 64;                                    // size of a cache line in byte
+static constexpr int TXN_COUNTER_SLOTS = 64;                                  // counters of running transactions
+static constexpr int RWLATCH_READER_SLOTS = 32;                               // reader counts of a distributed latch
+static constexpr int TXN_REGISTRY_SLOTS = 4096;                               // running transactions without overflow
+static constexpr int SORT_RUN_SIZE = 16384 * PAGE_SIZE;                       // bytes an external sort sorts in memory
+static constexpr double BULK_LOAD_FILL_FACTOR = 0.9;                          // how full bulk loading fills index pages
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
 using txn_id_t = int32_t;      // transaction id type
-using lsn_t = int32_t;         // log sequence number type
+using lsn_t = int64_t;         // log sequence number type
+using timestamp_t = int64_t;   // commit timestamp type
 using slot_offset_t = size_t;  // slot offset type
 using oid_t = uint16_t;
 
@@ -12,25 +12,30 @@
 
 #pragma once
 
-#include <climits>
-#include <condition_variable>  // NOLINT
-#include <mutex>               // NOLINT
+#include <array>
+#include <atomic>
+#include <cstdint>
 
+#include "common/config.h"
 #include "common/macros.h"
 
 namespace bustub {
 
 /**
- * Reader-Writer latch backed by std::mutex.
+ * Reader-Writer latch kept in a single atomic word.
+ *
+ * The word holds the number of readers, a bit for the writer and a bit telling that some thread sleeps on the word.
+ * Uncontended RLock, RUnlock, WLock and WUnlock are a single atomic operation each. A thread that has to wait spins
+ * for a moment and then sleeps on the word (a futex on Linux), and a release only wakes the sleepers when the bit
+ * says there are any.
+ *
+ * Writers are preferred: once a writer has entered, new readers wait, and the writer waits for the readers already
+ * inside to leave.
  */
 class ReaderWriterLatch {
-  using mutex_t = std::mutex;
-  using cond_t = std::condition_variable;
-  static const uint32_t MAX_READERS = UINT_MAX;
-
  public:
   ReaderWriterLatch() = default;
-  ~ReaderWriterLatch() { std::lock_guard<mutex_t> guard(mutex_); }
+  ~ReaderWriterLatch() = default;
 
   DISALLOW_COPY(ReaderWriterLatch);
 
@@ -38,13 +43,9 @@ class ReaderWriterLatch {
    * Acquire a write latch.
    */
   void WLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_) {
-      reader_.wait(latch);
-    }
-    writer_entered_ = true;
-    while (reader_count_ > 0) {
-      writer_.wait(latch);
+    uint32_t state = 0;
+    if (!state_.compare_exchange_strong(state, WRITER, std::memory_order_acquire)) {
+      WLockSlow();
     }
   }
 
@@ -52,45 +53,111 @@ class ReaderWriterLatch {
    * Release a write latch.
    */
   void WUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    writer_entered_ = false;
-    reader_.notify_all();
+    if ((state_.fetch_and(~(WRITER | SLEEPERS), std::memory_order_release) & SLEEPERS) != 0) {
+      WakeAll();
+    }
   }
 
   /**
    * Acquire a read latch.
    */
   void RLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_ || reader_count_ == MAX_READERS) {
-      reader_.wait(latch);
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if ((state & WRITER) != 0 || (state & READERS) == MAX_READERS ||
+        !state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire)) {
+      RLockSlow();
     }
-    reader_count_++;
   }
 
   /**
    * Release a read latch.
    */
   void RUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    reader_count_--;
-    if (writer_entered_) {
-      if (reader_count_ == 0) {
-        writer_.notify_one();
-      }
-    } else {
-      if (reader_count_ == MAX_READERS - 1) {
-        reader_.notify_one();
-      }
+    const uint32_t state = state_.fetch_sub(1, std::memory_order_release);
+    // Wake the writer waiting for the last reader, or a reader waiting for a free reader count.
+    if ((state & SLEEPERS) != 0 && ((state & READERS) == 1 || (state & READERS) == MAX_READERS)) {
+      WakeAll();
     }
   }
 
  private:
-  mutex_t mutex_;
-  cond_t writer_;
-  cond_t reader_;
-  uint32_t reader_count_{0};
-  bool writer_entered_{false};
+  static constexpr uint32_t WRITER = 1U << 31;
+  static constexpr uint32_t SLEEPERS = 1U << 30;
+  static constexpr uint32_t READERS = SLEEPERS - 1;
+  static constexpr uint32_t MAX_READERS = READERS;
+
+  void WLockSlow();
+  void RLockSlow();
+  /** Sleeps until the word may have changed from expected, which has SLEEPERS set. */
+  void Wait(uint32_t expected);
+  void WakeAll();
+
+  std::atomic<uint32_t> state_{0};
+};
+
+/**
+ * Reader-Writer latch for read-mostly data, which counts readers per core.
+ *
+ * Every thread counts itself as a reader in one of RWLATCH_READER_SLOTS cache lines, so that readers on different
+ * cores do not contend for the same line. The price is paid by writers, which have to check every slot, and by the
+ * size of the latch: use it for a few hot latches that are rarely taken exclusively, not for every page.
+ *
+ * Writers are preferred as with ReaderWriterLatch, and exclude each other with one. A read latch has to be released by
+ * the thread that acquired it.
+ */
+class DistributedReaderWriterLatch {
+ public:
+  DistributedReaderWriterLatch() = default;
+  ~DistributedReaderWriterLatch() = default;
+
+  DISALLOW_COPY(DistributedReaderWriterLatch);
+
+  /**
+   * Acquire a write latch.
+   */
+  void WLock();
+
+  /**
+   * Release a write latch.
+   */
+  void WUnlock() {
+    writer_entered_.store(false);
+    writer_latch_.WUnlock();
+  }
+
+  /**
+   * Acquire a read latch.
+   */
+  void RLock() {
+    ReaderSlot &slot = readers_[SlotOfThisThread()];
+    // Count first and check for a writer second, while a writer announces itself first and checks the counts second:
+    // one of the two sees the other.
+    slot.count_.fetch_add(1);
+    if (writer_entered_.load()) {
+      slot.count_.fetch_sub(1);
+      RLockSlow(&slot);
+    }
+  }
+
+  /**
+   * Release a read latch.
+   */
+  void RUnlock() { readers_[SlotOfThisThread()].count_.fetch_sub(1, std::memory_order_release); }
+
+ private:
+  struct alignas(CACHE_LINE_SIZE) ReaderSlot {
+    std::atomic<int64_t> count_{0};
+  };
+
+  /** @return the slot of the calling thread, fixed for the lifetime of the thread */
+  static size_t SlotOfThisThread();
+
+  void RLockSlow(ReaderSlot *slot);
+
+  std::array<ReaderSlot, RWLATCH_READER_SLOTS> readers_;
+  std::atomic<bool> writer_entered_{false};
+  /** Held by the writer, and waited on by readers that find writer_entered_ set. */
+  ReaderWriterLatch writer_latch_;
 };
 
 }  // namespace bustub
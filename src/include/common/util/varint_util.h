@@ -0,0 +1,91 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// varint_util.h
+//
+// Identification: src/include/common/util/varint_util.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+
+namespace bustub {
+
+/**
+ * Variable-length integers: 7 bits per byte, least significant group first, with the high bit of every byte but the
+ * last one set. Signed values are zigzag encoded first, so that small negative values such as the invalid ids stay
+ * short as well.
+ */
+class VarintUtil {
+ public:
+  /** The longest encoding of a 64-bit value. */
+  static constexpr int MAX_SIZE = 10;
+
+  static inline uint64_t ZigZag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+  }
+
+  static inline int64_t UnZigZag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  /** @return the number of bytes value takes up when encoded */
+  static inline int Size(uint64_t value) {
+    int size = 1;
+    while (value >= 0x80) {
+      value >>= 7;
+      size++;
+    }
+    return size;
+  }
+
+  static inline int SignedSize(int64_t value) { return Size(ZigZag(value)); }
+
+  /**
+   * Encodes value at dest.
+   * @return the position right after the encoded value
+   */
+  static inline char *Encode(uint64_t value, char *dest) {
+    while (value >= 0x80) {
+      *dest++ = static_cast<char>((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    *dest++ = static_cast<char>(value);
+    return dest;
+  }
+
+  static inline char *EncodeSigned(int64_t value, char *dest) { return Encode(ZigZag(value), dest); }
+
+  /**
+   * Decodes the value at *src and advances *src past it.
+   * @return false if the encoding runs past end or is longer than any 64-bit value
+   */
+  static inline bool Decode(const char **src, const char *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 7 * MAX_SIZE && *src < end; shift += 7) {
+      const auto byte = static_cast<uint8_t>(*(*src)++);
+      result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static inline bool DecodeSigned(const char **src, const char *end, int64_t *value) {
+    uint64_t result;
+    if (!Decode(src, end, &result)) {
+      return false;
+    }
+    *value = UnZigZag(result);
+    return true;
+  }
+};
+
+}  // namespace bustub
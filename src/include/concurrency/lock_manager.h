@@ -13,10 +13,15 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>              // NOLINT
 #include <condition_variable>  // NOLINT
 #include <list>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -30,15 +35,116 @@ namespace bustub {
 class TransactionManager;
 
 /**
- * LockManager handles transactions asking for locks on records.
+ * How the lock manager deals with deadlocks. Transaction ids double as timestamps: a lower id is an older transaction.
+ *
+ * DETECTION: transactions wait for each other freely, a background thread aborts the youngest transaction of every
+ * cycle in the waits-for graph, see LockManager.
+ *
+ * WOUND_WAIT: an older transaction that has to wait for a younger one aborts ("wounds") it, a younger one waits for
+ * an older one. A wounded transaction that is blocked on a lock wakes up right away; one that holds the lock keeps it
+ * until it notices the abort at its next lock request, or is rolled back.
+ *
+ * WAIT_DIE: an older transaction waits for a younger one, a younger one that would have to wait for an older one
+ * aborts itself ("dies") instead.
  */
-class LockManager {
-  enum class LockMode { SHARED, EXCLUSIVE };
+enum class DeadlockPolicy { DETECTION, WOUND_WAIT, WAIT_DIE };
+
+/** How often transactions had to wait for the lock on one table, page, record or index key. */
+struct LockContention {
+  /** What is locked: "table <oid>", "page <page id>", "row <page id>:<slot>" or "key <name>". */
+  std::string target_;
+  uint64_t waits_{0};
+  std::chrono::microseconds wait_time_{0};
+};
+
+/** A snapshot of the counters of a lock manager, see LockManager::GetStats. */
+struct LockStats {
+  static constexpr size_t LOCK_MODES = 5;
+  static constexpr size_t WAIT_BUCKETS = 24;
+
+  /** Locks granted, upgrades included, by LockMode. */
+  std::array<uint64_t, LOCK_MODES> acquisitions_{};
+  /** Requests that were not granted right away, and how long they waited altogether. */
+  uint64_t waits_{0};
+  std::chrono::microseconds wait_time_{0};
+  /**
+   * Waits by how long they took: bucket 0 counts those under 1 us, bucket i > 0 those from 2^(i-1) us to under 2^i us,
+   * and the last bucket everything longer.
+   */
+  std::array<uint64_t, WAIT_BUCKETS> wait_histogram_{};
+  /** Upgrades refused because another transaction was upgrading on the same target. */
+  uint64_t upgrade_conflicts_{0};
+  /** Transactions aborted to break a deadlock, or to prevent one under WOUND_WAIT and WAIT_DIE. */
+  uint64_t deadlock_aborts_{0};
+  /** The most requests ever queued on one target at once. */
+  size_t max_queue_depth_{0};
+  /** The targets waited for the most since the last LockManager::ResetHotTargets, most waits first. */
+  std::vector<LockContention> hot_targets_;
+
+  /** @return the bucket of wait_histogram_ that a wait of the given length falls into */
+  static size_t WaitBucket(std::chrono::microseconds wait_time);
 
+  /** @return the counters in a few lines of text, as the periodic report logs them */
+  std::string ToString() const;
+};
+
+/**
+ * LockManager handles transactions asking for locks on tables, pages and records.
+ *
+ * Locks follow two-phase locking: a transaction that released a lock can not take another one. Requests on the
+ * same table, page or record are granted in FIFO order, each one once it is compatible with all the requests ahead of
+ * it. Two modes are compatible as follows:
+ *
+ *            IS    IX    S     SIX   X
+ *     IS     yes   yes   yes   yes   no
+ *     IX     yes   yes   no    no    no
+ *     S      yes   no    yes   no    no
+ *     SIX    yes   no    no    no    no
+ *     X      no    no    no    no    no
+ *
+ * Locks are hierarchical: a table contains its pages, and a page the records on it. Locking a page or a record takes
+ * the matching intention lock on what contains it first, unless a lock held there already covers it; a transaction
+ * holding a shared lock on a table therefore reads every record of it without any record lock. Records are tied to
+ * their table by the table oid the caller passes along, and to their page by their RID. Asking for a stronger mode
+ * on a table or page already locked upgrades the lock, to SHARED_INTENTION_EXCLUSIVE for SHARED plus
+ * INTENTION_EXCLUSIVE.
+ *
+ * A transaction that piles up record locks on one table has them escalated: once it holds escalation_threshold of
+ * them, its intention lock on the table is upgraded to SHARED, or to EXCLUSIVE if any of the records is locked
+ * exclusively, and the record locks and the page intention locks the table lock now covers are released. Only records
+ * locked with their table oid count. The table lock is granted before anything is released, so the records stay
+ * locked throughout, and releasing them does not end the growing phase.
+ *
+ * Keys of an index are locked apart from the hierarchy, by a name derived from the index and the key (KeyLockName).
+ * An index uses them for next-key locking, see BPlusTree: a scan locks every key it reads and the key after the last
+ * one, or the end of the index, in SHARED mode, and an insert or delete locks its key in EXCLUSIVE mode and the key
+ * after it in INTENTION_EXCLUSIVE mode, which conflicts with the scans that read the gap but not with other writers.
+ * Two keys may share a name; that only makes their locks conflict needlessly.
+ *
+ * Under DeadlockPolicy::DETECTION, deadlocks are broken by a background thread that wakes up every
+ * cycle_detection_interval, builds the waits-for graph from the request queues and aborts the youngest transaction, the
+ * one with the highest id, of every cycle it finds. The graph is built one partition at a time, each under its own
+ * latch only, so it is not a consistent snapshot; a victim is therefore only aborted if it is still waiting where the
+ * graph says it was. Cycles are searched from the lowest transaction id up and along the lowest ids first, so the same
+ * graph always yields the same victims.
+ *
+ * The lock table is split into LOCK_TABLE_PARTITIONS partitions by the hash of what is locked. Each partition has a
+ * latch and request queues of its own, so transactions locking different records mostly do not contend. Released
+ * request nodes and emptied queues are kept in the partition for reuse, so that a lock and unlock pair does not
+ * allocate once the partition has warmed up.
+ *
+ * Every partition counts the locks it grants, the waits and the deepest queue under its latch, and GetStats sums the
+ * partitions up. It also counts the waits per target, for the hottest targets, but only for up to
+ * PartitionStats::MAX_CONTENDED targets since the last ResetHotTargets. If lock_stats_interval is set, a background
+ * thread logs GetStats every interval and resets the hottest targets.
+ */
+class LockManager {
   class LockRequest {
    public:
-    LockRequest(txn_id_t txn_id, LockMode lock_mode) : txn_id_(txn_id), lock_mode_(lock_mode), granted_(false) {}
+    LockRequest(Transaction *txn, LockMode lock_mode)
+        : txn_(txn), txn_id_(txn->GetTransactionId()), lock_mode_(lock_mode), granted_(false) {}
 
+    Transaction *txn_;
     txn_id_t txn_id_;
     LockMode lock_mode_;
     bool granted_;
@@ -47,19 +153,82 @@ class LockManager {
   class LockRequestQueue {
    public:
     std::list<LockRequest> request_queue_;
-    // for notifying blocked transactions on this rid
+    // for notifying blocked transactions on this resource
     std::condition_variable cv_;
     // txn_id of an upgrading transaction (if any)
     txn_id_t upgrading_ = INVALID_TXN_ID;
   };
 
+  /** What a lock is on: a table by oid, a page by page id, a record by RID or an index key by its lock name. */
+  class LockTarget {
+   public:
+    enum class Level : uint8_t { TABLE, PAGE, ROW, KEY };
+
+    static LockTarget Table(table_oid_t oid) { return {Level::TABLE, oid}; }
+    static LockTarget Page(page_id_t page_id) { return {Level::PAGE, page_id}; }
+    static LockTarget Row(const RID &rid) { return {Level::ROW, rid.Get()}; }
+    static LockTarget Key(int64_t name) { return {Level::KEY, name}; }
+
+    bool operator==(const LockTarget &other) const { return level_ == other.level_ && id_ == other.id_; }
+
+    Level level_;
+    int64_t id_;
+  };
+
+  struct LockTargetHash {
+    size_t operator()(const LockTarget &target) const;
+  };
+
+  using LockTableMap = std::unordered_map<LockTarget, LockRequestQueue, LockTargetHash>;
+
+  /** The waits for one target, see PartitionStats. */
+  struct TargetWaits {
+    uint64_t waits_{0};
+    std::chrono::microseconds wait_time_{0};
+  };
+
+  /** The counters of a partition, see LockStats for what they count. */
+  class PartitionStats {
+   public:
+    /** The number of targets a partition counts the waits of at most, until the hottest targets are reset. */
+    static constexpr size_t MAX_CONTENDED = 1024;
+
+    std::array<uint64_t, LockStats::LOCK_MODES> acquisitions_{};
+    uint64_t waits_{0};
+    std::chrono::microseconds wait_time_{0};
+    std::array<uint64_t, LockStats::WAIT_BUCKETS> wait_histogram_{};
+    uint64_t upgrade_conflicts_{0};
+    size_t max_queue_depth_{0};
+    std::unordered_map<LockTarget, TargetWaits, LockTargetHash> target_waits_;
+  };
+
+  /** One partition of the lock table, with the request queues of the resources that hash to it. */
+  class LockTablePartition {
+   public:
+    /** The number of spare request nodes and queues a partition keeps at most. */
+    static constexpr size_t MAX_SPARES = 256;
+
+    std::mutex latch_;
+    LockTableMap lock_table_;
+    // counted under latch_
+    PartitionStats stats_;
+    // request nodes of released locks, spliced into a queue by the next request
+    std::list<LockRequest> free_requests_;
+    // map nodes of emptied queues, reinserted under the next resource that needs a queue
+    std::vector<LockTableMap::node_type> free_queues_;
+  };
+
  public:
   /**
    * Creates a new lock manager configured for the deadlock prevention policy.
+   * @param deadlock_policy how deadlocks are broken or prevented
+   * @param escalation_threshold the number of record locks of a transaction on a table at which they are escalated to
+   * a table lock, 0 to never escalate
    */
-  LockManager() = default;
+  explicit LockManager(DeadlockPolicy deadlock_policy = DeadlockPolicy::DETECTION,
+                       size_t escalation_threshold = LOCK_ESCALATION_THRESHOLD);
 
-  ~LockManager() = default;
+  ~LockManager();
 
   /*
    * [LOCK_NOTE]: For all locking functions, we:
@@ -74,26 +243,29 @@ class LockManager {
    * Acquire a lock on RID in shared mode. See [LOCK_NOTE] in header file.
    * @param txn the transaction requesting the shared lock
    * @param rid the RID to be locked in shared mode
+   * @param oid the table of the record, INVALID_TABLE_OID to lock it without its table
    * @return true if the lock is granted, false otherwise
    */
-  bool LockShared(Transaction *txn, const RID &rid);
+  bool LockShared(Transaction *txn, const RID &rid, table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Acquire a lock on RID in exclusive mode. See [LOCK_NOTE] in header file.
    * @param txn the transaction requesting the exclusive lock
    * @param rid the RID to be locked in exclusive mode
+   * @param oid the table of the record, INVALID_TABLE_OID to lock it without its table
    * @return true if the lock is granted, false otherwise
    */
-  bool LockExclusive(Transaction *txn, const RID &rid);
+  bool LockExclusive(Transaction *txn, const RID &rid, table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Upgrade a lock from a shared lock to an exclusive lock.
    * @param txn the transaction requesting the lock upgrade
    * @param rid the RID that should already be locked in shared mode by the
    * requesting transaction
+   * @param oid the table of the record, INVALID_TABLE_OID to lock it without its table
    * @return true if the upgrade is successful, false otherwise
    */
-  bool LockUpgrade(Transaction *txn, const RID &rid);
+  bool LockUpgrade(Transaction *txn, const RID &rid, table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Release the lock held by the transaction.
@@ -104,11 +276,253 @@ class LockManager {
    */
   bool Unlock(Transaction *txn, const RID &rid);
 
+  /**
+   * Acquire or upgrade a lock on a table. See [LOCK_NOTE] in header file.
+   * @param txn the transaction requesting the lock
+   * @param oid the table to be locked
+   * @param mode the lock mode
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockTable(Transaction *txn, table_oid_t oid, LockMode mode);
+
+  /**
+   * Acquire or upgrade a lock on a page, after the matching intention lock on its table. See [LOCK_NOTE] in header
+   * file.
+   * @param txn the transaction requesting the lock
+   * @param oid the table the page belongs to, INVALID_TABLE_OID to lock the page without its table
+   * @param page_id the page to be locked
+   * @param mode the lock mode
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockPage(Transaction *txn, table_oid_t oid, page_id_t page_id, LockMode mode);
+
+  /**
+   * Release the lock held by the transaction on a table.
+   * @param txn the transaction releasing the lock
+   * @param oid the locked table
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockTable(Transaction *txn, table_oid_t oid);
+
+  /**
+   * Release the lock held by the transaction on a page.
+   * @param txn the transaction releasing the lock
+   * @param page_id the locked page
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockPage(Transaction *txn, page_id_t page_id);
+
+  /**
+   * Acquire or upgrade a lock on an index key. See [LOCK_NOTE] in header file.
+   * @param txn the transaction requesting the lock
+   * @param name the lock name of the key, see KeyLockName
+   * @param mode the lock mode
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockKey(Transaction *txn, int64_t name, LockMode mode);
+
+  /**
+   * Release the lock held by the transaction on an index key.
+   * @param txn the transaction releasing the lock
+   * @param name the lock name of the locked key
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockKey(Transaction *txn, int64_t name);
+
+  /**
+   * @param index_id the index the key belongs to
+   * @param key the bytes of the key, nullptr for the end of the index, the gap after its last key
+   * @param size the number of bytes of the key
+   * @return the name the key is locked by
+   */
+  static int64_t KeyLockName(uint32_t index_id, const char *key, size_t size);
+
+  /** @return whether a lock in mode held is compatible with another transaction's lock in mode requested */
+  static bool AreCompatible(LockMode held, LockMode requested);
+
+  /*** Graph API ***/
+  /**
+   * Adds an edge from t1 -> t2, meaning t1 waits for t2.
+   * @param t1 the waiting transaction
+   * @param t2 the transaction being waited for
+   */
+  void AddEdge(txn_id_t t1, txn_id_t t2);
+
+  /**
+   * Removes an edge from t1 -> t2.
+   * @param t1 the waiting transaction
+   * @param t2 the transaction being waited for
+   */
+  void RemoveEdge(txn_id_t t1, txn_id_t t2);
+
+  /**
+   * Checks if the graph has a cycle, returning the newest transaction ID in the cycle if so.
+   * @param[out] txn_id if the graph has a cycle, will contain the newest transaction ID
+   * @return false if the graph has no cycle, otherwise stores the newest transaction ID in the cycle to txn_id
+   */
+  bool HasCycle(txn_id_t *txn_id);
+
+  /** @return the set of all edges in the graph, used for testing only! */
+  std::vector<std::pair<txn_id_t, txn_id_t>> GetEdgeList();
+
+  /** Runs cycle detection in the background until the lock manager is destroyed. */
+  void RunCycleDetection();
+
+  /**
+   * @param top_n the number of hottest targets to list
+   * @return the counters of the lock manager since it was created, and the hottest targets since the last
+   * ResetHotTargets
+   */
+  LockStats GetStats(size_t top_n = LOCK_STATS_TOP_N);
+
+  /** Forgets the waits counted per target, so that the hottest targets are counted afresh. */
+  void ResetHotTargets();
+
+  /** Logs the statistics every lock_stats_interval until the lock manager is destroyed. */
+  void RunStatsReport();
+
  private:
-  std::mutex latch_;
+  /**
+   * Checks that the transaction may take a lock in the given mode, aborting it if it may not.
+   * @return false if the transaction is aborted already
+   */
+  static bool CanLock(Transaction *txn, LockMode mode);
+
+  /** @return whether a lock in mode held gives a transaction everything a lock in mode requested would */
+  static bool Covers(LockMode held, LockMode requested);
+
+  /** @return whether a lock in mode parent on a table or page gives a transaction mode on everything it contains */
+  static bool CoversContents(LockMode parent, LockMode mode);
+
+  /** @return the intention lock a table or page needs before something it contains is locked in mode */
+  static LockMode IntentionFor(LockMode mode);
+
+  /** @return whether the table or page lock of the transaction on what contains a record covers mode on the record */
+  static bool IsRowCovered(Transaction *txn, table_oid_t oid, const RID &rid, LockMode mode);
+
+  /** Takes the intention locks on the table and page of a record that is about to be locked in mode. */
+  bool LockRowParents(Transaction *txn, table_oid_t oid, const RID &rid, LockMode mode);
+
+  /**
+   * Records a lock on a record granted under its table, and escalates the record locks of the transaction on the table
+   * once there are enough of them.
+   * @return false if the transaction was aborted while escalating
+   */
+  bool AddRowLock(Transaction *txn, table_oid_t oid, const RID &rid);
+
+  /**
+   * Replaces the record locks of the transaction on a table with a table lock.
+   * @return false if the transaction was aborted while waiting for the table lock
+   */
+  bool Escalate(Transaction *txn, table_oid_t oid);
+
+  /**
+   * Locks a table or page in mode, or upgrades the lock the transaction holds on it to mode, and records the lock in
+   * the given lock set of the transaction.
+   */
+  template <typename Id>
+  bool LockOrUpgrade(Transaction *txn, const LockTarget &target, std::unordered_map<Id, LockMode> *lock_set, Id id,
+                     LockMode mode);
+
+  /**
+   * Queues a request and blocks until it is granted, or, for an upgrade, turns the granted request of the transaction
+   * into a waiting request in the new mode ahead of every other waiting request.
+   * @return whether the lock was granted; a failed upgrade loses the lock held before
+   */
+  bool Acquire(Transaction *txn, const LockTarget &target, LockMode mode, bool upgrade);
+
+  /**
+   * Releases the lock of the transaction on the target.
+   * @param[out] mode the mode of the lock released
+   * @return whether the transaction held a lock there
+   */
+  bool Release(Transaction *txn, const LockTarget &target, LockMode *mode);
+
+  /** Releases the lock of the transaction on the target, which moves a growing transaction to the shrinking phase. */
+  bool ReleaseAndShrink(Transaction *txn, const LockTarget &target);
+
+  /** @return the partition of the lock table that the target belongs to */
+  LockTablePartition *GetPartition(const LockTarget &target);
+
+  /**
+   * Appends a request to a queue, reusing a spare request node if there is one. The partition latch must be held.
+   * @return the new request
+   */
+  std::list<LockRequest>::iterator AddRequest(LockTablePartition *partition, LockRequestQueue *queue, Transaction *txn,
+                                              LockMode mode);
+
+  /** Takes a request out of its queue, and the queue out of the table once it is empty. The latch must be held. */
+  void RemoveRequest(LockTablePartition *partition, const LockTarget &target, LockRequestQueue *queue,
+                     std::list<LockRequest>::iterator request);
+
+  /** @return the queue of the target, which is created if there is none. The partition latch must be held. */
+  LockRequestQueue *GetQueue(LockTablePartition *partition, const LockTarget &target);
+
+  /** @return whether the request can be granted, given the requests ahead of it */
+  static bool IsGrantable(const LockRequestQueue &queue, std::list<LockRequest>::const_iterator request);
+
+  /**
+   * Blocks until the request is granted or the transaction is aborted, in which case the request is removed.
+   * @return whether the request was granted
+   */
+  bool WaitForGrant(LockTablePartition *partition, std::unique_lock<std::mutex> *guard, Transaction *txn,
+                    const LockTarget &target, LockRequestQueue *queue, std::list<LockRequest>::iterator request);
+
+  /**
+   * Applies the wound-wait or wait-die policy to a request that is not grantable: aborts the transaction itself, or
+   * the younger transactions it waits for, waking up those that are blocked. May release the partition latch in
+   * between.
+   */
+  void PreventDeadlock(std::unique_lock<std::mutex> *guard, Transaction *txn, LockRequestQueue *queue,
+                       std::list<LockRequest>::iterator request);
+
+  /** Rebuilds the waits-for graph from the request queues, noting what every waiting transaction waits on. */
+  void BuildWaitsForGraph();
+
+  /** Depth-first search for a cycle through txn_id; on_path holds the transactions of the current path, in order. */
+  bool FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *on_path, std::unordered_map<txn_id_t, bool> *visited,
+                 txn_id_t *victim);
+
+  /** Aborts a deadlock victim that still waits on the same target, and wakes it up. */
+  void AbortVictim(txn_id_t txn_id, const LockTarget &target);
+
+  /** Aborts the transaction and throws the matching TransactionAbortException. */
+  [[noreturn]] static void AbortImplicitly(Transaction *txn, AbortReason abort_reason);
+
+  /** Counts a wait for the target in the statistics of its partition. The partition latch must be held. */
+  static void RecordWait(LockTablePartition *partition, const LockTarget &target, std::chrono::microseconds wait_time);
+
+  /** @return what the target is, as LockContention::target_ names it */
+  static std::string TargetName(const LockTarget &target);
+
+  DeadlockPolicy deadlock_policy_;
+  size_t escalation_threshold_;
+
+  /** What each transaction blocked on a lock waits on, kept under the deadlock prevention policies only. */
+  std::unordered_map<txn_id_t, LockTarget> blocked_on_;
+  std::mutex blocked_on_latch_;
+
+  /** Waits-for graph: the transactions each waiting transaction waits for, sorted. */
+  std::unordered_map<txn_id_t, std::vector<txn_id_t>> waits_for_;
+  /** What each transaction of the waits-for graph waits on. */
+  std::unordered_map<txn_id_t, LockTarget> waiting_on_;
+  std::mutex waits_for_latch_;
+
+  bool enable_cycle_detection_{false};
+  std::thread *cycle_detection_thread_{nullptr};
+  std::mutex cycle_detection_latch_;
+  std::condition_variable cycle_detection_cv_;
+
+  bool enable_stats_report_{false};
+  std::thread *stats_report_thread_{nullptr};
+  std::mutex stats_report_latch_;
+  std::condition_variable stats_report_cv_;
+
+  /** Deadlock aborts are counted here rather than per partition, as the victim's partition latch is not always held. */
+  std::atomic<uint64_t> deadlock_aborts_{0};
 
-  /** Lock table for lock requests. */
-  std::unordered_map<RID, LockRequestQueue> lock_table_;
+  /** The partitions of the lock table, by hash of what is locked. */
+  std::array<LockTablePartition, LOCK_TABLE_PARTITIONS> partitions_;
 };
 
 }  // namespace bustub
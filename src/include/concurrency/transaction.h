@@ -14,9 +14,11 @@
 
 #include <atomic>
 #include <deque>
+#include <limits>
 #include <memory>
 #include <string>
 #include <thread>  // NOLINT
+#include <unordered_map>
 #include <unordered_set>
 
 #include "common/config.h"
@@ -45,8 +47,60 @@ enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 /**
  * Transaction isolation level.
+ *
+ * SNAPSHOT_ISOLATION: reads see the database as of the last commit before the transaction began, plus its own writes.
+ * They take no locks and never wait; the table heap keeps the older versions of the tuples they read. Writes still
+ * lock, and a transaction that writes a tuple another transaction has written since its snapshot aborts (first
+ * updater wins).
+ */
+enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SNAPSHOT_ISOLATION };
+
+/**
+ * How long Commit waits before it reports a transaction as committed, and what survives a crash.
+ *
+ * SYNCHRONOUS: Commit forces the log right away and returns once the commit record is on disk. A committed
+ * transaction survives any crash.
+ *
+ * GROUP: Commit returns once the commit record is on disk, but the flush may be held back for up to
+ * group_commit_window so that concurrent commits share one log write. Same guarantee as SYNCHRONOUS, at a slightly
+ * higher latency and a much lower flush rate.
+ *
+ * ASYNCHRONOUS: Commit returns as soon as the commit record is in the log buffer; the flush thread persists it
+ * later, at the latest after log_timeout. A crash may lose the transactions committed since the last log flush:
+ * recovery finds no commit record for them and rolls them back like any other loser, so the database stays
+ * consistent but their effects are gone. Commits are still ordered by the log, so a later non-asynchronous commit
+ * (or a WAL-forced flush) makes every earlier asynchronous commit durable as well.
  */
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED };
+enum class DurabilityMode { SYNCHRONOUS, GROUP, ASYNCHRONOUS };
+
+/**
+ * How a transaction is kept apart from the others.
+ *
+ * TWO_PHASE_LOCKING: the transaction locks what it reads and writes, see LockManager.
+ *
+ * OPTIMISTIC: the transaction reads the last committed value of every tuple without locking it, and remembers what it
+ * read in its read set. Updates and deletes are buffered in the transaction until it commits; inserts take effect
+ * right away, since they have to hand out a RID. Commit applies the buffered writes, locking the tuples they write,
+ * and then validates that no transaction has committed a write to a tuple of the read set since the transaction
+ * began. If that fails, the transaction aborts instead. Whatever its isolation level, which must not be
+ * SNAPSHOT_ISOLATION, this rules out lost updates and read skew on the tuples it read. It is not serializable:
+ * only the tuples read are validated, not the ranges scanned, so tuples another transaction inserts into them
+ * (phantoms) go unnoticed, and so do the transaction's own inserts, which are never validated.
+ *
+ * READ_ONLY: the transaction only reads, from the snapshot as of its Begin, whatever the isolation level it was asked
+ * for. It takes no locks, keeps no lock or write sets and writes no log records, and its commit only gives up the
+ * snapshot. A write aborts it.
+ */
+enum class ConcurrencyControl { TWO_PHASE_LOCKING, OPTIMISTIC, READ_ONLY };
+
+/**
+ * Lock modes, for multi-granularity locking of tables, pages and records.
+ *
+ * An intention lock on a table or page announces locks of the same kind on what it contains: INTENTION_SHARED
+ * shared locks, INTENTION_EXCLUSIVE exclusive ones. SHARED_INTENTION_EXCLUSIVE is a shared lock on the whole table or
+ * page together with exclusive locks on some of its contents. Records are only locked SHARED or EXCLUSIVE.
+ */
+enum class LockMode { SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE };
 
 /**
  * Type of write operation.
@@ -57,6 +111,7 @@ class TableHeap;
 class Catalog;
 using table_oid_t = uint32_t;
 using index_oid_t = uint32_t;
+static constexpr table_oid_t INVALID_TABLE_OID = std::numeric_limits<table_oid_t>::max();
 
 /**
  * WriteRecord tracks information related to a write.
@@ -154,19 +209,34 @@ class TransactionAbortException : public std::exception {
  */
 class Transaction {
  public:
-  explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ)
+  explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ,
+                       DurabilityMode durability_mode = DurabilityMode::GROUP,
+                       ConcurrencyControl concurrency_control = ConcurrencyControl::TWO_PHASE_LOCKING)
       : state_(TransactionState::GROWING),
-        isolation_level_(isolation_level),
+        isolation_level_(concurrency_control == ConcurrencyControl::READ_ONLY ? IsolationLevel::SNAPSHOT_ISOLATION
+                                                                              : isolation_level),
+        durability_mode_(durability_mode),
+        concurrency_control_(concurrency_control),
+        in_read_phase_(concurrency_control == ConcurrencyControl::OPTIMISTIC),
         thread_id_(std::this_thread::get_id()),
         txn_id_(txn_id),
-        prev_lsn_(INVALID_LSN),
-        shared_lock_set_{new std::unordered_set<RID>},
-        exclusive_lock_set_{new std::unordered_set<RID>} {
+        prev_lsn_(INVALID_LSN) {
+    if (concurrency_control == ConcurrencyControl::READ_ONLY) {
+      return;
+    }
     // Initialize the sets that will be tracked.
+    shared_lock_set_ = std::make_shared<std::unordered_set<RID>>();
+    exclusive_lock_set_ = std::make_shared<std::unordered_set<RID>>();
+    page_lock_set_ = std::make_shared<std::unordered_map<page_id_t, LockMode>>();
+    table_lock_set_ = std::make_shared<std::unordered_map<table_oid_t, LockMode>>();
+    table_row_lock_set_ = std::make_shared<std::unordered_map<table_oid_t, std::unordered_set<RID>>>();
+    key_lock_set_ = std::make_shared<std::unordered_map<int64_t, LockMode>>();
     table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
     index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
     page_set_ = std::make_shared<std::deque<bustub::Page *>>();
     deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
+    read_set_ = std::make_shared<std::unordered_set<RID>>();
+    buffered_write_set_ = std::make_shared<std::unordered_map<RID, TableWriteRecord>>();
   }
 
   ~Transaction() = default;
@@ -182,6 +252,35 @@ class Transaction {
   /** @return the isolation level of this transaction */
   inline IsolationLevel GetIsolationLevel() const { return isolation_level_; }
 
+  /** @return the durability mode of this transaction */
+  inline DurabilityMode GetDurabilityMode() const { return durability_mode_; }
+
+  /**
+   * Set the durability mode, which takes effect at commit.
+   * @param durability_mode new durability mode
+   */
+  inline void SetDurabilityMode(DurabilityMode durability_mode) { durability_mode_ = durability_mode; }
+
+  /** @return how the transaction is kept apart from the others */
+  inline ConcurrencyControl GetConcurrencyControl() const { return concurrency_control_; }
+
+  /** @return true if the transaction is READ_ONLY, in which case it has none of the lock, write and read sets */
+  inline bool IsReadOnly() const { return concurrency_control_ == ConcurrencyControl::READ_ONLY; }
+
+  /** @return true while an OPTIMISTIC transaction reads without locks and buffers its writes, i.e. until it commits */
+  inline bool InReadPhase() const { return in_read_phase_; }
+
+  /** Ends the read phase: from now on, the writes of the transaction take effect and lock as usual. */
+  inline void EndReadPhase() { in_read_phase_ = false; }
+
+  /** @return the tuples an OPTIMISTIC transaction has read, which commit validates */
+  inline std::shared_ptr<std::unordered_set<RID>> GetReadSet() { return read_set_; }
+
+  /** @return the updates and deletes an OPTIMISTIC transaction has buffered, by tuple; an update holds the new value */
+  inline std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> GetBufferedWriteSet() {
+    return buffered_write_set_;
+  }
+
   /** @return the list of table write records of this transaction */
   inline std::shared_ptr<std::deque<TableWriteRecord>> GetWriteSet() { return table_write_set_; }
 
@@ -228,6 +327,20 @@ class Transaction {
   /** @return the set of resources under an exclusive lock */
   inline std::shared_ptr<std::unordered_set<RID>> GetExclusiveLockSet() { return exclusive_lock_set_; }
 
+  /** @return the pages under a lock, with the mode of each lock */
+  inline std::shared_ptr<std::unordered_map<page_id_t, LockMode>> GetPageLockSet() { return page_lock_set_; }
+
+  /** @return the tables under a lock, with the mode of each lock */
+  inline std::shared_ptr<std::unordered_map<table_oid_t, LockMode>> GetTableLockSet() { return table_lock_set_; }
+
+  /** @return the locked records that were locked under their table, by table */
+  inline std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> GetTableRowLockSet() {
+    return table_row_lock_set_;
+  }
+
+  /** @return the locked index keys, by the name LockManager::KeyLockName gives them, with the mode of each lock */
+  inline std::shared_ptr<std::unordered_map<int64_t, LockMode>> GetKeyLockSet() { return key_lock_set_; }
+
   /** @return true if rid is shared locked by this transaction */
   bool IsSharedLocked(const RID &rid) { return shared_lock_set_->find(rid) != shared_lock_set_->end(); }
 
@@ -252,11 +365,44 @@ class Transaction {
    */
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  /** @return the LSN of the transaction's BEGIN record, where undoing it stops */
+  inline lsn_t GetBeginLSN() { return begin_lsn_; }
+
+  /**
+   * Set the LSN of the BEGIN record.
+   * @param begin_lsn new begin lsn
+   */
+  inline void SetBeginLSN(lsn_t begin_lsn) { begin_lsn_ = begin_lsn; }
+
+  /** @return the commit timestamp of the snapshot the transaction reads */
+  inline timestamp_t GetReadTs() const { return read_ts_; }
+
+  /**
+   * Set the read timestamp.
+   * @param read_ts new read timestamp
+   */
+  inline void SetReadTs(timestamp_t read_ts) { read_ts_ = read_ts; }
+
+  /** @return the commit timestamp of the transaction, 0 if it did not commit any write */
+  inline timestamp_t GetCommitTs() const { return commit_ts_; }
+
+  /**
+   * Set the commit timestamp.
+   * @param commit_ts new commit timestamp
+   */
+  inline void SetCommitTs(timestamp_t commit_ts) { commit_ts_ = commit_ts; }
+
  private:
   /** The current transaction state. */
   TransactionState state_;
   /** The isolation level of the transaction. */
   IsolationLevel isolation_level_;
+  /** What Commit waits for before it returns. */
+  DurabilityMode durability_mode_;
+  /** How the transaction is kept apart from the others. */
+  ConcurrencyControl concurrency_control_;
+  /** Whether an OPTIMISTIC transaction has yet to commit. */
+  bool in_read_phase_;
   /** The thread ID, used in single-threaded transactions. */
   std::thread::id thread_id_;
   /** The ID of this transaction. */
@@ -264,10 +410,20 @@ class Transaction {
 
   /** The undo set of table tuples. */
   std::shared_ptr<std::deque<TableWriteRecord>> table_write_set_;
+  /** OPTIMISTIC: the tuples read. */
+  std::shared_ptr<std::unordered_set<RID>> read_set_;
+  /** OPTIMISTIC: the updates and deletes to apply at commit. */
+  std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> buffered_write_set_;
   /** The undo set of indexes. */
   std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
   /** The LSN of the last record written by the transaction. */
   lsn_t prev_lsn_;
+  /** The LSN of the first record written by the transaction. */
+  lsn_t begin_lsn_{INVALID_LSN};
+  /** The timestamp of the last commit the transaction's snapshot includes. */
+  timestamp_t read_ts_{0};
+  /** The timestamp of the transaction's commit. */
+  timestamp_t commit_ts_{0};
 
   /** Concurrent index: the pages that were latched during index operation. */
   std::shared_ptr<std::deque<Page *>> page_set_;
@@ -278,6 +434,14 @@ class Transaction {
   std::shared_ptr<std::unordered_set<RID>> shared_lock_set_;
   /** LockManager: the set of exclusive-locked tuples held by this transaction. */
   std::shared_ptr<std::unordered_set<RID>> exclusive_lock_set_;
+  /** LockManager: the locked pages and their lock modes. */
+  std::shared_ptr<std::unordered_map<page_id_t, LockMode>> page_lock_set_;
+  /** LockManager: the locked tables and their lock modes. */
+  std::shared_ptr<std::unordered_map<table_oid_t, LockMode>> table_lock_set_;
+  /** LockManager: the records of shared_lock_set_ and exclusive_lock_set_ that were locked under a table. */
+  std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> table_row_lock_set_;
+  /** LockManager: the locked index keys and their lock modes. */
+  std::shared_ptr<std::unordered_map<int64_t, LockMode>> key_lock_set_;
 };
 
 }  // namespace bustub
@@ -12,14 +12,22 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
-#include <shared_mutex>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>  // NOLINT
+#include <set>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
+#include "concurrency/transaction_registry.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
@@ -39,12 +47,17 @@ class TransactionManager {
    * Begins a new transaction.
    * @param txn an optional transaction object to be initialized, otherwise a new transaction is created.
    * @param isolation_level an optional isolation level of the transaction.
+   * @param durability_mode an optional durability mode of the transaction, see DurabilityMode.
+   * @param concurrency_control whether the transaction locks, is OPTIMISTIC or READ_ONLY, see ConcurrencyControl.
    * @return an initialized transaction
    */
-  Transaction *Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ);
+  Transaction *Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ,
+                     DurabilityMode durability_mode = DurabilityMode::GROUP,
+                     ConcurrencyControl concurrency_control = ConcurrencyControl::TWO_PHASE_LOCKING);
 
   /**
-   * Commits a transaction.
+   * Commits a transaction. When this returns, the commit is durable unless the transaction is ASYNCHRONOUS.
+   * An OPTIMISTIC transaction that fails validation is aborted instead, which leaves it in the ABORTED state.
    * @param txn the transaction to commit
    */
   void Commit(Transaction *txn);
@@ -56,34 +69,71 @@ class TransactionManager {
   void Abort(Transaction *txn);
 
   /**
-   * Global list of running transactions
+   * Locates and returns a running transaction. Wait-free, see TransactionRegistry.
+   * @param txn_id the id of the transaction to be found
+   * @return the transaction with the given transaction id, nullptr if it has committed or aborted
    */
+  Transaction *GetTransaction(txn_id_t txn_id) const { return txn_registry_.Find(txn_id); }
 
-  /** The transaction map is a global list of all the running transactions in the system. */
-  static std::unordered_map<txn_id_t, Transaction *> txn_map;
-  static std::shared_mutex txn_map_mutex;
+  /**
+   * Takes a snapshot of the logged transactions that have neither committed nor aborted yet, used for checkpointing.
+   * @return the id, begin LSN and last LSN of each of them
+   */
+  std::vector<std::tuple<txn_id_t, lsn_t, lsn_t>> GetActiveTransactions();
+
+  /** @return the timestamp of the last commit, which the snapshot of a transaction beginning now includes */
+  timestamp_t GetLastCommitTs() const { return last_commit_ts_; }
 
   /**
-   * Locates and returns the transaction with the given transaction ID.
-   * @param txn_id the id of the transaction to be found, it must exist!
-   * @return the transaction with the given transaction id
+   * @return the read timestamp of the oldest snapshot in use, or the last commit if no snapshot transaction is
+   * running. Tuple versions older than the one current at the watermark can be garbage collected.
    */
-  static Transaction *GetTransaction(txn_id_t txn_id) {
-    TransactionManager::txn_map_mutex.lock_shared();
-    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-    auto *res = TransactionManager::txn_map[txn_id];
-    assert(res != nullptr);
-    TransactionManager::txn_map_mutex.unlock_shared();
-    return res;
-  }
+  timestamp_t GetWatermark();
 
-  /** Prevents all transactions from performing operations, used for checkpointing. */
+  /**
+   * Prevents all transactions from performing operations, used for checkpointing: waits for the running transactions
+   * to finish, and holds off new ones until ResumeTransactions.
+   */
   void BlockAllTransactions();
 
   /** Resumes all transactions, used for checkpointing. */
   void ResumeTransactions();
 
  private:
+  /** The running transactions that began on some of the threads, on a cache line of its own. */
+  struct alignas(CACHE_LINE_SIZE) RunningTxnSlot {
+    std::atomic<int64_t> count_{0};
+    /** Number of them in CommitVersions without commit_latch_, see versioned_txns_. */
+    std::atomic<int64_t> unlatched_commits_{0};
+    /** The ones that have a BEGIN record in the log, for checkpoints. */
+    std::unordered_map<txn_id_t, Transaction *> logged_txns_;
+    std::mutex logged_txns_latch_;
+  };
+
+  /** @return the slot txn counts in, picked by the thread it began on */
+  RunningTxnSlot &SlotOf(Transaction *txn);
+
+  /** @return true if txn reads versions or validates against the commits of others, see versioned_txns_ */
+  static bool IsVersioned(Transaction *txn) {
+    return txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION ||
+           txn->GetConcurrencyControl() == ConcurrencyControl::OPTIMISTIC;
+  }
+
+  /** Counts a SNAPSHOT_ISOLATION or OPTIMISTIC transaction in versioned_txns_, once no commit skips the latch. */
+  void EnterVersioned();
+
+  /** Counts txn as running, once BlockAllTransactions lets it. */
+  void EnterRunning(Transaction *txn);
+
+  /** Stops counting txn as running. */
+  void ExitRunning(Transaction *txn);
+
+  /** @return true if no transaction is running; the caller holds block_latch_ */
+  bool AllExited() const;
+
+  /** Ends a READ_ONLY transaction, which has nothing to apply, roll back, log or unlock. */
+  void EndReadOnly(Transaction *txn, TransactionState state);
+
   /**
    * Releases all the locks held by the given transaction.
    * @param txn the transaction whose locks should be released
@@ -99,14 +149,89 @@ class TransactionManager {
     for (auto locked_rid : lock_set) {
       lock_manager_->Unlock(txn, locked_rid);
     }
+    std::vector<int64_t> locked_keys;
+    for (const auto &[name, mode] : *txn->GetKeyLockSet()) {
+      locked_keys.push_back(name);
+    }
+    for (int64_t name : locked_keys) {
+      lock_manager_->UnlockKey(txn, name);
+    }
+    // Then pages and tables, so that an intention lock outlives the locks under it.
+    std::vector<page_id_t> locked_pages;
+    for (const auto &[page_id, mode] : *txn->GetPageLockSet()) {
+      locked_pages.push_back(page_id);
+    }
+    for (page_id_t page_id : locked_pages) {
+      lock_manager_->UnlockPage(txn, page_id);
+    }
+    std::vector<table_oid_t> locked_tables;
+    for (const auto &[oid, mode] : *txn->GetTableLockSet()) {
+      locked_tables.push_back(oid);
+    }
+    for (table_oid_t oid : locked_tables) {
+      lock_manager_->UnlockTable(txn, oid);
+    }
   }
 
+  /**
+   * Stamps the writes of a committing transaction with its commit timestamp, see TableHeap::CommitVersion. An
+   * OPTIMISTIC transaction is validated first, in the same critical section.
+   * @return false if validation failed
+   */
+  bool CommitVersions(Transaction *txn);
+
+  /**
+   * Applies the buffered writes of an OPTIMISTIC transaction, ending its read phase.
+   * @return false if a write failed, and the transaction has to abort
+   */
+  bool InstallWrites(Transaction *txn);
+
+  /**
+   * Backward validation: checks the read set of an OPTIMISTIC transaction against the writes committed since it
+   * began. The caller holds commit_latch_.
+   * @return true if none of them wrote a tuple the transaction read
+   */
+  bool Validate(Transaction *txn);
+
   std::atomic<txn_id_t> next_txn_id_{0};
-  LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
+  /** The running transactions. */
+  TransactionRegistry txn_registry_;
+  LockManager *lock_manager_;
+  LogManager *log_manager_;
+
+  /**
+   * Commit timestamps are handed out in commit order, under commit_latch_. While versioned_txns_ is zero, nobody reads
+   * versions or validates against a commit, and a transaction that neither reads at a snapshot nor is OPTIMISTIC
+   * commits without the latch and without a timestamp of its own: it stamps its writes with last_commit_ts_, which
+   * any snapshot taken later includes. It counts itself in its slot's unlatched_commits_ first and checks
+   * versioned_txns_ second, while a versioned transaction counts itself first and waits for the unlatched commits to
+   * drain second: one of the two sees the other.
+   */
+  std::atomic<int64_t> versioned_txns_{0};
+  std::atomic<timestamp_t> last_commit_ts_{0};
+  std::mutex commit_latch_;
+  /** The read timestamps of the running OPTIMISTIC transactions, under commit_latch_. */
+  std::multiset<timestamp_t> optimistic_txns_;
+  /**
+   * The tuples written by the commits that a running OPTIMISTIC transaction has to validate against, oldest first,
+   * with their commit timestamps. Under commit_latch_.
+   */
+  std::deque<std::pair<timestamp_t, std::vector<RID>>> committed_writes_;
+  /** The read timestamps of the running SNAPSHOT_ISOLATION transactions. */
+  std::multiset<timestamp_t> snapshots_;
+  std::mutex snapshots_latch_;
 
-  /** The global transaction latch is used for checkpointing. */
-  ReaderWriterLatch global_txn_latch_;
+  /**
+   * For checkpointing, BlockAllTransactions sets blocked_ and waits for the counters of running transactions to drop to
+   * zero. A transaction that begins and ends only touches its own thread's slot, plus reads of blocked_, which only
+   * changes around checkpoints, and of versioned_txns_.
+   */
+  std::array<RunningTxnSlot, TXN_COUNTER_SLOTS> running_txns_;
+  std::atomic<bool> blocked_{false};
+  /** Guards the waits for blocked_ to clear and for the counters to drain. */
+  std::mutex block_latch_;
+  std::condition_variable unblocked_cv_;
+  std::condition_variable exited_cv_;
 };
 
 }  // namespace bustub
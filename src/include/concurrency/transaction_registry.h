@@ -0,0 +1,74 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.h
+//
+// Identification: src/include/concurrency/transaction_registry.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "common/config.h"
+#include "common/macros.h"
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+/**
+ * The running transactions of a transaction manager, by id.
+ *
+ * Transaction ids are handed out in sequence, so the transactions running at the same time almost always fall into
+ * different slots of an array indexed by id modulo TXN_REGISTRY_SLOTS. A slot is only written by the transaction it
+ * holds, when it begins and when it ends, after which the slot is free again for the id TXN_REGISTRY_SLOTS later.
+ * Find reads the slot without taking a latch or retrying, so it is wait-free. The rare transaction whose slot is still
+ * taken by an older one that is still running goes to an overflow map under a latch.
+ */
+class TransactionRegistry {
+ public:
+  TransactionRegistry() = default;
+
+  DISALLOW_COPY(TransactionRegistry);
+
+  /** Adds a transaction that begins. */
+  void Register(Transaction *txn);
+
+  /** Removes a transaction that has committed or aborted. */
+  void Deregister(Transaction *txn);
+
+  /**
+   * @param txn_id the id of a transaction
+   * @return the transaction, nullptr if it is not running. It may end, and be deleted, at any time after; only look
+   * up transactions that are known to be running.
+   */
+  Transaction *Find(txn_id_t txn_id) const;
+
+ private:
+  /** Marks a slot that a transaction has claimed, but not filled in yet. */
+  static constexpr txn_id_t CLAIMED_TXN_ID = INVALID_TXN_ID - 1;
+
+  /** A transaction and its id, on a cache line of its own. txn_id_ is written last, and read first and last. */
+  struct alignas(CACHE_LINE_SIZE) Slot {
+    std::atomic<txn_id_t> txn_id_{INVALID_TXN_ID};
+    std::atomic<Transaction *> txn_{nullptr};
+  };
+
+  static size_t SlotOf(txn_id_t txn_id) { return static_cast<uint32_t>(txn_id) % TXN_REGISTRY_SLOTS; }
+
+  std::array<Slot, TXN_REGISTRY_SLOTS> slots_;
+
+  /** The transactions that found their slot taken. Find only looks here while it is not empty. */
+  std::atomic<size_t> overflow_size_{0};
+  std::unordered_map<txn_id_t, Transaction *> overflow_;
+  mutable std::shared_mutex overflow_latch_;
+};
+
+}  // namespace bustub
@@ -17,8 +17,10 @@
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "common/rwlatch.h"
 #include "concurrency/transaction.h"
 #include "container/hash/hash_function.h"
+#include "recovery/log_record.h"
 #include "storage/page/hash_table_bucket_page.h"
 #include "storage/page/hash_table_directory_page.h"
 
@@ -30,6 +32,9 @@ namespace bustub {
  * Implementation of extendible hash table that is backed by a buffer pool
  * manager. Non-unique keys are supported. Supports insert and delete. The
  * table grows/shrinks dynamically as buckets become full/empty.
+ *
+ * If logging is enabled, inserting or removing a pair is logged as a HASH_INSERT or HASH_DELETE of the transaction,
+ * and every page a split or merge changes as a redo-only INDEX_PAGE_WRITE, see BPlusTree.
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class ExtendibleHashTable {
@@ -40,9 +45,11 @@ class ExtendibleHashTable {
    * @param buffer_pool_manager buffer pool manager to be used
    * @param comparator comparator for keys
    * @param hash_fn the hash function
+   * @param directory_page_id the directory of an existing table to open, INVALID_PAGE_ID to create a new one
    */
   explicit ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
-                               const KeyComparator &comparator, HashFunction<KeyType> hash_fn);
+                               const KeyComparator &comparator, HashFunction<KeyType> hash_fn,
+                               page_id_t directory_page_id = INVALID_PAGE_ID);
 
   /**
    * Inserts a key-value pair into the hash table.
@@ -84,6 +91,21 @@ class ExtendibleHashTable {
    */
   void VerifyIntegrity();
 
+  /**
+   * @return the page id of the directory, to open the table again with
+   */
+  page_id_t GetDirectoryPageId() const { return directory_page_id_; }
+
+  /**
+   * @return the id that log records of this table's pairs carry
+   */
+  uint32_t GetIndexId() const { return index_id_; }
+
+  /**
+   * Logically undoes the insert or remove of a pair, as handed out by LogRecovery (see LogRecovery::RegisterIndex).
+   */
+  void Undo(LogRecord *log_record);
+
  private:
   /**
    * Hash - simple helper to downcast MurmurHash's 64-bit hash to 32-bit
@@ -132,9 +154,10 @@ class ExtendibleHashTable {
    * Fetches the a bucket page from the buffer pool manager using the bucket's page_id.
    *
    * @param bucket_page_id the page_id to fetch
+   * @param[out] page if not null, set to the frame holding the bucket page, e.g. to latch it
    * @return a pointer to a bucket page
    */
-  HASH_TABLE_BUCKET_TYPE *FetchBucketPage(page_id_t bucket_page_id);
+  HASH_TABLE_BUCKET_TYPE *FetchBucketPage(page_id_t bucket_page_id, Page **page = nullptr);
 
   /**
    * Performs insertion with an optional bucket splitting.
@@ -161,13 +184,32 @@ class ExtendibleHashTable {
    */
   void Merge(Transaction *transaction, const KeyType &key, const ValueType &value);
 
+  /**
+   * @return a copy of the page to log later changes against with LogPageWrite, empty if nothing is logged
+   */
+  std::vector<char> CopyForLog(const void *page) const;
+
+  /**
+   * Logs the bytes of a directory or bucket page that changed since before was copied from it as a redo-only
+   * INDEX_PAGE_WRITE, and stamps the page with the record's LSN. Does nothing if before is empty.
+   */
+  template <typename P>
+  void LogPageWrite(P *page, const std::vector<char> &before);
+
+  /**
+   * Logs the pair at bucket_idx of the bucket page as inserted or removed by the transaction.
+   */
+  void LogEntry(LogRecordType log_record_type, HASH_TABLE_BUCKET_TYPE *bucket_page, uint32_t bucket_idx,
+                const KeyType &key, const ValueType &value, Transaction *transaction);
+
   // member variables
   page_id_t directory_page_id_;
+  uint32_t index_id_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
 
   // Readers includes inserts and removes, writers are splits and merges
-  ReaderWriterLatch table_latch_;
+  DistributedReaderWriterLatch table_latch_;
   HashFunction<KeyType> hash_fn_;
 };
 
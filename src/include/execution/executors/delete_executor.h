@@ -26,6 +26,9 @@ namespace bustub {
 /**
  * DeletedExecutor executes a delete on a table.
  * Deleted values are always pulled from a child.
+ *
+ * Init takes an INTENTION_EXCLUSIVE lock on the table, under which every tuple deleted is locked exclusively. If the
+ * lock is not granted, the transaction is aborted and nothing is deleted.
  */
 class DeleteExecutor : public AbstractExecutor {
  public:
@@ -58,7 +61,11 @@ class DeleteExecutor : public AbstractExecutor {
  private:
   /** The delete plan node to be executed */
   const DeletePlanNode *plan_;
+  /** Metadata identifying the table that should be deleted from */
+  const TableInfo *table_info_;
   /** The child executor from which RIDs for deleted tuples are pulled */
   std::unique_ptr<AbstractExecutor> child_executor_;
+  /** Whether Init locked the table */
+  bool locked_{false};
 };
 }  // namespace bustub
@@ -12,20 +12,30 @@
 
 #pragma once
 
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "common/rid.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/index_scan_plan.h"
+#include "storage/index/b_plus_tree_index.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
 
 /**
- * IndexScanExecutor executes an index scan over a table.
+ * IndexScanExecutor executes an index scan over a table, in key order. The index has to be a B+ tree on 8-byte keys.
+ *
+ * Under SNAPSHOT_ISOLATION the tuples are read as of the transaction's snapshot, without locks. The index itself has no
+ * versions, though: entries of tuples the snapshot does not see are skipped, and so are entries whose key the tuple
+ * does not have in the snapshot. A tuple deleted from the index, or given another key, after the snapshot was taken is
+ * therefore missing from the scan; a sequential scan finds it.
+ *
+ * Under REPEATABLE_READ, if the index locks keys, the scan reads the index one key at a time with next-key locking
+ * (see BPlusTree::ScanNext), so that no entry can go into the range it has scanned until the transaction ends.
  */
-
 class IndexScanExecutor : public AbstractExecutor {
  public:
   /**
@@ -42,7 +52,23 @@ class IndexScanExecutor : public AbstractExecutor {
   bool Next(Tuple *tuple, RID *rid) override;
 
  private:
+  /** Moves the scan to the next entry of the index. @return false at the end */
+  bool NextEntry(std::pair<GenericKey<8>, RID> *entry);
+
   /** The index scan plan node to be executed. */
   const IndexScanPlanNode *plan_;
+  /** The index being scanned */
+  const IndexInfo *index_info_;
+  /** The table the index is on */
+  const TableInfo *table_info_;
+  /** The index as a B+ tree */
+  BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>> *tree_{nullptr};
+  /** Whether the scan takes next-key locks, reading the index by key instead of with iterator_ */
+  bool locks_keys_{false};
+  /** The position of the scan, set up by Init */
+  std::unique_ptr<IndexIterator<GenericKey<8>, RID, GenericComparator<8>>> iterator_;
+  /** The last key a locking scan read, if scanned_any_ */
+  GenericKey<8> last_key_;
+  bool scanned_any_{false};
 };
 }  // namespace bustub
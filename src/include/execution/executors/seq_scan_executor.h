@@ -12,17 +12,24 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/seq_scan_plan.h"
+#include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
 
 /**
  * The SeqScanExecutor executor executes a sequential table scan.
+ *
+ * Init locks the table: REPEATABLE_READ in SHARED mode, which covers every tuple of it, and READ_COMMITTED in
+ * INTENTION_SHARED mode, under which every tuple read is locked. If the lock is not granted, the transaction is aborted
+ * and the scan yields nothing. Under SNAPSHOT_ISOLATION the scan reads the table as of the transaction's snapshot and
+ * takes no locks.
  */
 class SeqScanExecutor : public AbstractExecutor {
  public:
@@ -50,5 +57,9 @@ class SeqScanExecutor : public AbstractExecutor {
  private:
   /** The sequential scan plan node to be executed */
   const SeqScanPlanNode *plan_;
+  /** The table being scanned */
+  const TableInfo *table_info_;
+  /** The position of the scan, set up by Init */
+  std::unique_ptr<TableIterator> iterator_;
 };
 }  // namespace bustub
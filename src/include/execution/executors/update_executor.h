@@ -27,6 +27,9 @@ namespace bustub {
 /**
  * UpdateExecutor executes an update on a table.
  * Updated values are always pulled from a child.
+ *
+ * Init takes an INTENTION_EXCLUSIVE lock on the table, under which every tuple updated is locked exclusively. If the
+ * lock is not granted, the transaction is aborted and nothing is updated.
  */
 class UpdateExecutor : public AbstractExecutor {
   friend class UpdatePlanNode;
@@ -72,5 +75,7 @@ class UpdateExecutor : public AbstractExecutor {
   const TableInfo *table_info_;
   /** The child executor to obtain value from */
   std::unique_ptr<AbstractExecutor> child_executor_;
+  /** Whether Init locked the table */
+  bool locked_{false};
 };
 }  // namespace bustub
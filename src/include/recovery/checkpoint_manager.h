@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <thread>  // NOLINT
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
@@ -19,7 +21,14 @@
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager takes fuzzy checkpoints, which neither block transactions nor wait for the buffer pool to be
+ * flushed.
+ *
+ * BeginCheckpoint logs a CHECKPOINT_BEGIN record, takes a snapshot of the active transaction table and the dirty page
+ * table, logs both in a CHECKPOINT_END record and, once that record is persistent, points the master record at it.
+ * Recovery then reads the log from the oldest record that an active transaction or a dirty page may still need, and
+ * redoes only from the smallest recovery LSN of the dirty pages. A background thread writes the pages of the snapshot
+ * out one at a time, so that the next checkpoint can start further ahead; EndCheckpoint waits for it to finish.
  */
 class CheckpointManager {
  public:
@@ -29,15 +38,17 @@ class CheckpointManager {
         log_manager_(log_manager),
         buffer_pool_manager_(buffer_pool_manager) {}
 
-  ~CheckpointManager() = default;
+  ~CheckpointManager() { EndCheckpoint(); }
 
   void BeginCheckpoint();
   void EndCheckpoint();
 
  private:
-  TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  /** Writes out the dirty pages of the last checkpoint. */
+  std::thread *flush_thread_{nullptr};
 };
 
 }  // namespace bustub
@@ -0,0 +1,126 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hot_standby.h
+//
+// Identification: src/include/recovery/hot_standby.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <thread>  // NOLINT
+#include <utility>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/rwlatch.h"
+#include "recovery/log_manager.h"
+#include "recovery/log_recovery.h"
+#include "storage/table/table_heap.h"
+
+namespace bustub {
+
+/**
+ * A read-only copy of a primary database on the same host, kept up to date by replaying the primary's log.
+ *
+ * The standby has a database file and buffer pool of its own, but its disk manager reads the log segments and the
+ * master record of the primary (see the log_db_file argument of DiskManager). Its database file starts out empty, or
+ * as a copy of the primary's taken after the primary's last checkpoint began. The log is replayed with the regular
+ * redo path of LogRecovery, run continuously: either by a background thread that polls the log for new records every
+ * standby_poll_interval (Start), or on demand (CatchUp).
+ *
+ * Queries read the standby's buffer pool between BeginRead and EndRead, which hold off replay, so they see the
+ * database as of a single point of the log, GetReplayedLSN. That point may be in the middle of transactions of the
+ * primary, whose changes are on the pages as soon as they are logged. Tuples read through GetTuple leave those out and
+ * are as of the last commit replayed; replay keeps the writes of every unfinished transaction in memory for that.
+ *
+ * The primary's checkpoints release the log segments recovery no longer needs, which the standby may not have replayed
+ * yet. The standby therefore keeps a retention record (DiskManager::WriteRetentionRecord) at the oldest log offset it
+ * still needs, its replay position or the first record of an unfinished transaction, and the primary does not release
+ * the log from there on. The record lives as long as the standby object does; a standby that crashes leaves it behind,
+ * holding on to the primary's log, until it is dropped. If the log the standby needs is released anyway, by a primary
+ * started before the standby published the record, replay cannot go on: CatchUp throws, and the background replay
+ * logs an error and stops.
+ *
+ * Promote turns the standby into a primary once the original one is gone: it replays what is left of the log, rolls
+ * back the transactions that never finished and continues the log where the primary left it.
+ *
+ * Replay writes pages without logging them, and enable_logging is a switch for the whole process. A standby
+ * therefore has to live in a process of its own, or at least replay only while logging is off.
+ */
+class HotStandby {
+ public:
+  /**
+   * @param disk_manager the standby's disk manager, reading the primary's log
+   * @param buffer_pool_manager the standby's buffer pool
+   * @param log_manager the log manager the standby is going to write with once promoted
+   * @param from_checkpoint whether the database file is a copy of the primary's that allows replay to start at the
+   * primary's last checkpoint, rather than at the start of the log
+   */
+  HotStandby(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager,
+             bool from_checkpoint = false);
+
+  ~HotStandby();
+
+  /** Starts replaying the log in the background. */
+  void Start();
+
+  /** Stops replaying the log in the background, leaving the standby as of the last record replayed. */
+  void Stop();
+
+  /**
+   * Replays the log the primary has written so far. Blocks while readers are active. Throws an Exception if the log
+   * the standby has to replay next has been released.
+   * @return the LSN of the last record replayed, INVALID_LSN if none
+   */
+  lsn_t CatchUp();
+
+  /** Starts a read of the standby's pages, which holds off replay until the matching EndRead. */
+  void BeginRead() { replay_latch_.RLock(); }
+  void EndRead() { replay_latch_.RUnlock(); }
+
+  /** @return the LSN of the last record replayed, that is, the state of the log readers see */
+  lsn_t GetReplayedLSN() const { return replayed_lsn_; }
+
+  /**
+   * Reads a tuple of a table of the standby as of the last commit replayed, between BeginRead and EndRead.
+   * @return whether the tuple existed as of that commit
+   */
+  bool GetTuple(TableHeap *table, const RID &rid, Tuple *tuple, Transaction *txn) {
+    return log_recovery_.GetCommittedTuple(rid, tuple, table->GetTuple(rid, tuple, txn));
+  }
+
+  /** Registers an index whose entries Promote may have to roll back, see LogRecovery::RegisterIndex. */
+  void RegisterIndex(uint32_t index_id, LogRecovery::IndexUndoHandler handler) {
+    log_recovery_.RegisterIndex(index_id, std::move(handler));
+  }
+
+  /**
+   * Replays the rest of the log, rolls back the transactions that did not finish and makes the log manager append
+   * to the log after the last record of the primary. Logging is still off when Promote returns; running the log
+   * manager's flush thread turns it on. The standby cannot replay any more after that.
+   * @return the LSN of the last record of the primary
+   */
+  lsn_t Promote();
+
+ private:
+  /** Body of the background replay thread. */
+  void RunReplay();
+
+  DiskManager *disk_manager_;
+  LogManager *log_manager_;
+  LogRecovery log_recovery_;
+  /** Replay holds it exclusively, readers shared. */
+  ReaderWriterLatch replay_latch_;
+  std::atomic<lsn_t> replayed_lsn_{INVALID_LSN};
+  bool promoted_{false};
+
+  std::atomic<bool> replaying_{false};
+  std::thread *replay_thread_{nullptr};
+};
+
+}  // namespace bustub
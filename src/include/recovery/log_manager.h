@@ -13,32 +13,59 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>              // NOLINT
 #include <condition_variable>  // NOLINT
 #include <future>              // NOLINT
+#include <map>
 #include <mutex>               // NOLINT
+#include <thread>              // NOLINT
 
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
 
 namespace bustub {
 
+/** Counters describing how well group commit batches committing transactions, see LogManager::WaitUntilPersistent. */
+struct GroupCommitStats {
+  /** Number of log flushes that made at least one waiting commit durable. */
+  uint64_t num_batches_{0};
+  /** Number of commits that waited for their commit record to become durable. */
+  uint64_t num_commits_{0};
+  /** Largest number of waiting commits made durable by a single log flush. */
+  uint64_t max_batch_size_{0};
+  /** Total time commits spent waiting for durability, in microseconds. */
+  uint64_t total_wait_us_{0};
+  /** Longest time a single commit spent waiting for durability, in microseconds. */
+  uint64_t max_wait_us_{0};
+};
+
 /**
  * LogManager maintains a separate thread that is awakened whenever the log buffer is full or whenever a timeout
  * happens. When the thread is awakened, the log buffer's content is written into the disk log file.
+ *
+ * Appending does not take a latch. A single fetch-add on the reservation word hands out both the LSN of a record and
+ * its byte range in the active log buffer, and the record is then serialized into that range concurrently with other
+ * appenders. To flush, the flush thread seals the active buffer by swapping in the other one, waits until every
+ * reservation made against the sealed buffer has been filled, and writes the filled prefix to disk.
+ *
+ * Committing transactions use group commit: the flush thread holds back a flush requested by a commit for at most
+ * group_commit_window, so that every commit arriving within the window is made durable by the same write and sync.
  */
 class LogManager {
  public:
   explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-    flush_buffer_ = new char[LOG_BUFFER_SIZE];
+      : persistent_lsn_(INVALID_LSN), log_end_offset_(disk_manager->GetLogSize()), disk_manager_(disk_manager) {
+    for (auto &log_buffer : log_buffers_) {
+      log_buffer = new char[LOG_BUFFER_SIZE];
+    }
   }
 
   ~LogManager() {
-    delete[] log_buffer_;
-    delete[] flush_buffer_;
-    log_buffer_ = nullptr;
-    flush_buffer_ = nullptr;
+    for (auto &log_buffer : log_buffers_) {
+      delete[] log_buffer;
+      log_buffer = nullptr;
+    }
   }
 
   void RunFlushThread();
@@ -46,29 +73,121 @@ class LogManager {
 
   lsn_t AppendLogRecord(LogRecord *log_record);
 
-  inline lsn_t GetNextLSN() { return next_lsn_; }
+  /**
+   * Forces every record appended so far to disk, returning once they are persistent. Used by the buffer pool manager
+   * to honour the WAL protocol before it writes out a page whose LSN is newer than the persistent LSN.
+   */
+  void Flush();
+
+  /**
+   * Blocks until every log record up to and including lsn is persistent. Committing transactions that wait here
+   * within the same group commit window share a single log write and sync.
+   * @param lsn the LSN that must become persistent, usually that of a commit record
+   */
+  void WaitUntilPersistent(lsn_t lsn);
+
+  /** @return a snapshot of the group commit counters */
+  GroupCommitStats GetGroupCommitStats();
+
+  /**
+   * Locates a persistent log record in the log file, for checkpoints to tell recovery where to start reading.
+   * @param lsn the LSN of a persistent log record
+   * @return the offset of a record boundary at or before the record, 0 if the record is older than this log manager
+   */
+  int64_t GetLogOffset(lsn_t lsn);
+
+  /** Forgets the log offsets of records that are older than lsn and no longer needed by GetLogOffset. */
+  void DiscardLogOffsets(lsn_t lsn);
+
+  lsn_t GetNextLSN();
+
+  /**
+   * Continues a log that is already on disk, such as the one a promoted hot standby replayed: records appended from
+   * now on get LSNs from next_lsn on and go after the current end of the log. Only before the first append.
+   */
+  void ResumeLog(lsn_t next_lsn);
+
   inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
-  inline char *GetLogBuffer() { return log_buffer_; }
+  inline char *GetLogBuffer() { return log_buffers_[EpochOf(reservation_.load()) & 1]; }
+  inline DiskManager *GetDiskManager() { return disk_manager_; }
 
  private:
-  // TODO(students): you may add your own member variables
+  /*
+   * Layout of the reservation word (high to low bits):
+   * -------------------------------------------------------
+   * | buffer epoch (8) | record count (24) | byte offset (32) |
+   * -------------------------------------------------------
+   * The epoch names the active buffer (epoch & 1). The record count gives the LSN relative to the first LSN of the
+   * epoch and the byte offset the start of the reserved range, so one fetch-add of (1 << 32) + size reserves both.
+   */
+  static constexpr uint64_t RESERVATION_COUNT_ONE = 1ULL << 32;
+  static constexpr int RESERVATION_EPOCH_SHIFT = 56;
+
+  static inline uint32_t EpochOf(uint64_t reservation) {
+    return static_cast<uint32_t>(reservation >> RESERVATION_EPOCH_SHIFT);
+  }
+  static inline uint32_t CountOf(uint64_t reservation) {
+    return static_cast<uint32_t>(reservation >> 32) & ((1U << (RESERVATION_EPOCH_SHIFT - 32)) - 1);
+  }
+  static inline uint32_t OffsetOf(uint64_t reservation) { return static_cast<uint32_t>(reservation); }
+
+  /** Serializes the log record into dest, which must have room for log_record->GetSize() bytes. */
+  void SerializeLogRecord(LogRecord *log_record, char *dest);
 
-  /** The atomic counter which records the next log sequence number. */
-  std::atomic<lsn_t> next_lsn_;
+  /** Writes the segment of each record into the first size bytes of buffer, about to be appended to the log. */
+  void StampSegments(char *buffer, uint32_t size);
+
+  /**
+   * Seals the active log buffer, waits for its outstanding reservations to be filled and writes it to disk.
+   * Only one caller at a time, serialized by flush_latch_.
+   */
+  void FlushLogBuffer();
+
+  /** The reservation word, see the layout above. */
+  std::atomic<uint64_t> reservation_{0};
   /** The log records before and including the persistent lsn have been written to disk. */
   std::atomic<lsn_t> persistent_lsn_;
 
-  char *log_buffer_;
-  char *flush_buffer_;
+  /** The two log buffers; appenders fill log_buffers_[epoch & 1] while the other one is being flushed. */
+  char *log_buffers_[2];
+  /** The LSN handed to the first record of the epoch currently using each buffer. */
+  lsn_t base_lsn_[2]{0, 0};
+  /** Number of reservations made against each buffer that have been filled (or given up because of overflow). */
+  std::atomic<uint32_t> finished_[2]{0, 0};
+  /** End of the filled prefix of a buffer that overflowed, written by the reservation that crossed the end. */
+  uint32_t overflow_offset_[2]{0, 0};
 
+  /** Protects flush_requested_ and the condition variables below, never taken on the append fast path. */
   std::mutex latch_;
-
-  std::thread *flush_thread_ __attribute__((__unused__));
-
+  /** Serializes FlushLogBuffer, which keeps the writes to the disk manager in buffer order. */
+  std::mutex flush_latch_;
+  bool flush_requested_{false};
+  /** Number of commits waiting for the next flush, and when the first of them arrived. Protected by latch_. */
+  uint64_t pending_commits_{0};
+  std::chrono::steady_clock::time_point first_commit_arrival_;
+  /**
+   * The first LSN of every buffer written to the log file, mapped to the offset it was written at. Protected by
+   * latch_.
+   */
+  std::map<lsn_t, int64_t> buffer_offsets_;
+  /** The size of the log file, only touched by FlushLogBuffer. */
+  int64_t log_end_offset_;
+
+  std::atomic<uint64_t> num_commit_batches_{0};
+  std::atomic<uint64_t> num_commits_{0};
+  std::atomic<uint64_t> max_commit_batch_size_{0};
+  std::atomic<uint64_t> total_commit_wait_us_{0};
+  std::atomic<uint64_t> max_commit_wait_us_{0};
+
+  std::thread *flush_thread_{nullptr};
+
+  /** Wakes up the flush thread. */
   std::condition_variable cv_;
+  /** Signalled by the flush thread whenever a buffer is sealed or written to disk. */
+  std::condition_variable flushed_cv_;
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
 };
 
 }  // namespace bustub
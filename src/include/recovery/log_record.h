@@ -13,9 +13,13 @@
 #pragma once
 
 #include <cassert>
+#include <cstring>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
+#include "common/util/varint_util.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
@@ -32,15 +36,36 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** Start and end of a fuzzy checkpoint, see CheckpointManager. */
+  CHECKPOINT_BEGIN,
+  CHECKPOINT_END,
+  /** Inserting and deleting an entry of a B+ tree leaf or internal page, see BPlusTreePage. */
+  BTREE_INSERT,
+  BTREE_DELETE,
+  /** Inserting and deleting an entry of an extendible hash bucket page, see HashTableBucketPageBase. */
+  HASH_INSERT,
+  HASH_DELETE,
+  /** The bytes of an index page changed by a split, merge, redistribution or directory change. Redo only. */
+  INDEX_PAGE_WRITE,
+  /** Compensation of a table record undone by recovery, see LogRecovery::Undo. Redo only. */
+  CLR,
 };
 
 /**
  * For every write operation on the table page, you should write ahead a corresponding log record.
  *
- * For EACH log record, HEADER is like (5 fields in common, 20 bytes in total).
- *---------------------------------------------
- * | size | LSN | transID | prevLSN | LogType |
- *---------------------------------------------
+ * Every field is a varint (see VarintUtil), signed ones zigzag encoded, except for the LogType (1 byte), the LSN
+ * (8 bytes), the segment (4 bytes) and raw tuple data. The LSN and the segment are the header fields of fixed width:
+ * the LSN is only assigned once the record's space in the log buffer has been reserved, and the segment, the number
+ * of the log segment the record starts in, once the log manager writes the buffer out, so the record's size must not
+ * depend on them. Recovery only takes a record for one if it names the segment it was read from: a recycled segment
+ * still holds the records of the segment it used to be past the end of the log (see DiskManager).
+ *
+ * For EACH log record, HEADER is like (6 fields in common, at least MIN_SIZE bytes).
+ *-------------------------------------------------------
+ * | size | LogType | LSN | segment | transID | prevLSN |
+ *-------------------------------------------------------
+ * A tuple_rid is | page_id | slot_num |.
  * For insert type log record
  *---------------------------------------------------------------
  * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
@@ -49,14 +74,43 @@ enum class LogRecordType {
  *----------------------------------------------------------------
  * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
  *---------------------------------------------------------------
- * For update type log record
+ * For update type log record, if the update changes the size of the tuple
  *-----------------------------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
+ * | HEADER | tuple_rid | old_tuple_size | new_tuple_size | old_tuple_data | new_tuple_data |
  *-----------------------------------------------------------------------------------
+ * and otherwise only the byte ranges that differ, each starting gap bytes after the end of the previous one
+ *-----------------------------------------------------------------------------------------------------------
+ * | HEADER | tuple_rid | tuple_size | tuple_size | range_count | (gap, length, old_data, new_data)... |
+ *-----------------------------------------------------------------------------------------------------------
  * For new page type log record
- *--------------------------
- * | HEADER | prev_page_id |
- *--------------------------
+ *------------------------------------
+ * | HEADER | prev_page_id | page_id |
+ *------------------------------------
+ * For checkpoint end type log record (checkpoint begin is just a HEADER)
+ *------------------------------------------------------------------------------------------------------------
+ * | HEADER | redo_lsn | scan_offset | txn_count | (txn_id, last_lsn)... | page_count | (page_id, rec_lsn)... |
+ *------------------------------------------------------------------------------------------------------------
+ *
+ * Index pages are logged physiologically: a record names one page, and redo repeats the change on that page. Inserting
+ * or deleting an entry (key + value, as stored on the page) logs the entry and its slot on the page
+ *-----------------------------------------------------------------
+ * | HEADER | index_id | page_id | slot | entry_size | entry_data |
+ *-----------------------------------------------------------------
+ * Undo of an entry is logical, through the index it belongs to, since the entry may have moved to another page by
+ * then (see LogRecovery::RegisterIndex). Structure modifications log the bytes they changed on each page they touched,
+ * each range starting gap bytes after the end of the previous one
+ *--------------------------------------------------------------------
+ * | HEADER | page_id | range_count | (gap, length, new_data)... |
+ *--------------------------------------------------------------------
+ * These, like the entry changes a structure modification makes in internal pages, are logged outside of any
+ * transaction (with INVALID_TXN_ID), so that they survive the transaction that caused them being rolled back.
+ *
+ * Recovery logs the undo of an insert, delete or update as a compensation log record, which holds the LSN of the next
+ * record of the transaction left to undo and the type and body of the record it undid
+ *-----------------------------------------------------------------
+ * | HEADER | undo_next_lsn | undone LogType | undone record body |
+ *-----------------------------------------------------------------
+ * Redo repeats the undo on the page, and an undo interrupted by a crash carries on from undo_next_lsn.
  */
 class LogRecord {
   friend class LogManager;
@@ -67,7 +121,9 @@ class LogRecord {
 
   // constructor for Transaction type(BEGIN/COMMIT/ABORT)
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type)
-      : size_(HEADER_SIZE), txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {}
+      : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {
+    SetSize(0);
+  }
 
   // constructor for INSERT/DELETE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &rid, const Tuple &tuple)
@@ -82,7 +138,7 @@ class LogRecord {
       delete_tuple_ = tuple;
     }
     // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + tuple.GetLength();
+    SetSize(RIDSize(rid) + TupleSize(tuple));
   }
 
   // constructor for UPDATE type
@@ -94,20 +150,97 @@ class LogRecord {
         update_rid_(update_rid),
         old_tuple_(old_tuple),
         new_tuple_(new_tuple) {
-    // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
+    // calculate log record size, only logging what changed if the tuple keeps its size
+    size_t body_size = RIDSize(update_rid) + VarintUtil::Size(old_tuple.GetLength()) +
+                       VarintUtil::Size(new_tuple.GetLength());
+    if (old_tuple.GetLength() != new_tuple.GetLength()) {
+      body_size += old_tuple.GetLength() + new_tuple.GetLength();
+    } else {
+      DiffUpdate();
+      body_size += VarintUtil::Size(update_ranges_.size());
+      uint32_t range_end = 0;
+      for (const auto &[offset, length] : update_ranges_) {
+        body_size += VarintUtil::Size(offset - range_end) + VarintUtil::Size(length) + 2 * length;
+        range_end = offset + length;
+      }
+    }
+    SetSize(body_size);
   }
 
   // constructor for NEWPAGE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t prev_page_id, page_id_t page_id)
-      : size_(HEADER_SIZE),
-        txn_id_(txn_id),
+      : txn_id_(txn_id),
         prev_lsn_(prev_lsn),
         log_record_type_(log_record_type),
         prev_page_id_(prev_page_id),
         page_id_(page_id) {
-    // calculate log record size, header size + sizeof(prev_page_id) + sizeof(page_id)
-    size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
+    // calculate log record size, header size + prev_page_id + page_id
+    SetSize(VarintUtil::SignedSize(prev_page_id) + VarintUtil::SignedSize(page_id));
+  }
+
+  // constructor for BTREE_INSERT/BTREE_DELETE/HASH_INSERT/HASH_DELETE type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, uint32_t index_id, page_id_t page_id,
+            uint32_t slot, const char *entry, size_t entry_size)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        page_id_(page_id),
+        index_id_(index_id),
+        slot_(slot),
+        index_data_(entry, entry + entry_size) {
+    assert(log_record_type == LogRecordType::BTREE_INSERT || log_record_type == LogRecordType::BTREE_DELETE ||
+           log_record_type == LogRecordType::HASH_INSERT || log_record_type == LogRecordType::HASH_DELETE);
+    SetSize(VarintUtil::Size(index_id) + VarintUtil::SignedSize(page_id) + VarintUtil::Size(slot) +
+            VarintUtil::Size(entry_size) + entry_size);
+  }
+
+  // constructor for INDEX_PAGE_WRITE type, logging the bytes that differ between two images of a page
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t page_id, const char *before,
+            const char *after)
+      : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type), page_id_(page_id) {
+    Diff(before, after, PAGE_SIZE, &update_ranges_);
+    size_t body_size = VarintUtil::SignedSize(page_id) + VarintUtil::Size(update_ranges_.size());
+    uint32_t range_end = 0;
+    for (const auto &[offset, length] : update_ranges_) {
+      body_size += VarintUtil::Size(offset - range_end) + VarintUtil::Size(length) + length;
+      index_data_.insert(index_data_.end(), after + offset, after + offset + length);
+      range_end = offset + length;
+    }
+    SetSize(body_size);
+  }
+
+  // constructor for CHECKPOINT_END type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, lsn_t redo_lsn, int64_t scan_offset,
+            std::vector<std::pair<txn_id_t, lsn_t>> active_txns, std::vector<std::pair<page_id_t, lsn_t>> dirty_pages)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        redo_lsn_(redo_lsn),
+        scan_offset_(scan_offset),
+        active_txns_(std::move(active_txns)),
+        dirty_pages_(std::move(dirty_pages)) {
+    // calculate log record size, header size + redo lsn + scan offset + both tables with their lengths
+    size_t body_size = VarintUtil::SignedSize(redo_lsn) + VarintUtil::Size(scan_offset) +
+                       VarintUtil::Size(active_txns_.size()) + VarintUtil::Size(dirty_pages_.size());
+    for (const auto &[active_txn_id, last_lsn] : active_txns_) {
+      body_size += VarintUtil::SignedSize(active_txn_id) + VarintUtil::SignedSize(last_lsn);
+    }
+    for (const auto &[page_id, rec_lsn] : dirty_pages_) {
+      body_size += VarintUtil::SignedSize(page_id) + VarintUtil::SignedSize(rec_lsn);
+    }
+    SetSize(body_size);
+  }
+
+  // constructor for CLR type, compensating a record of a table page
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, const LogRecord &undone) : LogRecord(undone) {
+    assert(undone.log_record_type_ >= LogRecordType::INSERT && undone.log_record_type_ <= LogRecordType::UPDATE);
+    txn_id_ = txn_id;
+    prev_lsn_ = prev_lsn;
+    lsn_ = INVALID_LSN;
+    log_record_type_ = LogRecordType::CLR;
+    undone_type_ = undone.log_record_type_;
+    undo_next_lsn_ = undone.prev_lsn_;
+    SetSize(VarintUtil::SignedSize(undo_next_lsn_) + 1 + undone.size_ - undone.HeaderSize());
   }
 
   ~LogRecord() = default;
@@ -120,14 +253,59 @@ class LogRecord {
 
   inline RID &GetInsertRID() { return insert_rid_; }
 
+  // An update record read back from the log may only carry the bytes that changed, in which case these two tuples
+  // are only valid within the update ranges; RedoUpdate and UndoUpdate work either way.
   inline Tuple &GetOriginalTuple() { return old_tuple_; }
 
   inline Tuple &GetUpdateTuple() { return new_tuple_; }
 
+  /** @return the tuple after the update, given the tuple before it */
+  inline Tuple RedoUpdate(const Tuple &old_tuple) const { return PatchTuple(old_tuple, new_tuple_); }
+
+  /** @return the tuple before the update, given the tuple after it */
+  inline Tuple UndoUpdate(const Tuple &new_tuple) const { return PatchTuple(new_tuple, old_tuple_); }
+
   inline RID &GetUpdateRID() { return update_rid_; }
 
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
+  /** @return the index an entry record belongs to */
+  inline uint32_t GetIndexId() { return index_id_; }
+
+  /** @return the index page an entry or page write record changes */
+  inline page_id_t GetIndexPageId() { return page_id_; }
+
+  inline uint32_t GetSlot() { return slot_; }
+
+  /** @return the entry of an entry record, as stored on the page */
+  inline const std::vector<char> &GetEntry() { return index_data_; }
+
+  /** @return the (offset, length) of every range of bytes a page write record changes */
+  inline const std::vector<std::pair<uint32_t, uint32_t>> &GetPageWriteRanges() { return update_ranges_; }
+
+  /** Copies the bytes of a page write record over the page at data. */
+  inline void RedoPageWrite(char *data) const {
+    const char *src = index_data_.data();
+    for (const auto &[offset, length] : update_ranges_) {
+      memcpy(data + offset, src, length);
+      src += length;
+    }
+  }
+
+  inline lsn_t GetRedoLSN() { return redo_lsn_; }
+
+  inline int64_t GetScanOffset() { return scan_offset_; }
+
+  inline std::vector<std::pair<txn_id_t, lsn_t>> &GetActiveTxns() { return active_txns_; }
+
+  inline std::vector<std::pair<page_id_t, lsn_t>> &GetDirtyPages() { return dirty_pages_; }
+
+  /** @return the type of the record a compensation log record undid, whose fields it carries */
+  inline LogRecordType GetUndoneType() { return undone_type_; }
+
+  /** @return the LSN of the record of the transaction to undo after the one a compensation log record undid */
+  inline lsn_t GetUndoNextLSN() { return undo_next_lsn_; }
+
   inline int32_t GetSize() { return size_; }
 
   inline lsn_t GetLSN() { return lsn_; }
@@ -152,6 +330,75 @@ class LogRecord {
   }
 
  private:
+  /** Two ranges of changed bytes no more than this many bytes apart are logged as one range. */
+  static constexpr uint32_t UPDATE_RANGE_GAP = 2;
+
+  static inline size_t RIDSize(const RID &rid) {
+    return VarintUtil::SignedSize(rid.GetPageId()) + VarintUtil::Size(rid.GetSlotNum());
+  }
+
+  static inline size_t TupleSize(const Tuple &tuple) { return VarintUtil::Size(tuple.GetLength()) + tuple.GetLength(); }
+
+  /** @return the size of the header of a record whose size_ is set */
+  inline size_t HeaderSize() const {
+    return VarintUtil::Size(size_) + 1 + sizeof(lsn_t) + sizeof(uint32_t) + VarintUtil::SignedSize(txn_id_) +
+           VarintUtil::SignedSize(prev_lsn_);
+  }
+
+  /** Sets size_ from the size of the fields following the header. */
+  inline void SetSize(size_t body_size) {
+    const size_t size = 1 + sizeof(lsn_t) + sizeof(uint32_t) + VarintUtil::SignedSize(txn_id_) +
+                        VarintUtil::SignedSize(prev_lsn_) + body_size;
+    // the size field counts itself
+    int width = VarintUtil::Size(size);
+    while (VarintUtil::Size(size + width) > width) {
+      width++;
+    }
+    size_ = static_cast<int32_t>(size + width);
+  }
+
+  /** Collects the ranges of bytes that differ between old_tuple_ and new_tuple_, which have the same size. */
+  inline void DiffUpdate() {
+    Diff(old_tuple_.GetData(), new_tuple_.GetData(), old_tuple_.GetLength(), &update_ranges_);
+  }
+
+  /** Collects the ranges of bytes that differ between the length bytes at old_data and new_data. */
+  static inline void Diff(const char *old_data, const char *new_data, uint32_t length,
+                          std::vector<std::pair<uint32_t, uint32_t>> *ranges) {
+    uint32_t i = 0;
+    while (i < length) {
+      if (old_data[i] == new_data[i]) {
+        i++;
+        continue;
+      }
+      uint32_t end = i + 1;
+      for (uint32_t j = end; j < length && j - end < UPDATE_RANGE_GAP; j++) {
+        if (old_data[j] != new_data[j]) {
+          end = j + 1;
+        }
+      }
+      ranges->emplace_back(i, end - i);
+      i = end;
+    }
+  }
+
+  /** Copies the update ranges of image over tuple, or returns image as a whole if the update changed the size. */
+  inline Tuple PatchTuple(const Tuple &tuple, const Tuple &image) const {
+    if (old_tuple_.GetLength() != new_tuple_.GetLength() || tuple.GetLength() != image.GetLength()) {
+      return image;
+    }
+    const uint32_t length = tuple.GetLength();
+    std::vector<char> storage(sizeof(uint32_t) + length);
+    memcpy(storage.data(), &length, sizeof(uint32_t));
+    memcpy(storage.data() + sizeof(uint32_t), tuple.GetData(), length);
+    for (const auto &[offset, range_length] : update_ranges_) {
+      memcpy(storage.data() + sizeof(uint32_t) + offset, image.GetData() + offset, range_length);
+    }
+    Tuple patched;
+    patched.DeserializeFrom(storage.data());
+    return patched;
+  }
+
   // the length of log record(for serialization, in bytes)
   int32_t size_{0};
   // must have fields
@@ -172,11 +419,31 @@ class LogRecord {
   RID update_rid_;
   Tuple old_tuple_;
   Tuple new_tuple_;
+  // (offset, length) of the byte ranges that differ, only used if the update keeps the size of the tuple, and for
+  // index page writes
+  std::vector<std::pair<uint32_t, uint32_t>> update_ranges_;
 
-  // case4: for new page operation
+  // case4: for new page operation, page_id_ is also the page of an index record
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
-  static const int HEADER_SIZE = 20;
+
+  // case5: for checkpoint end, where redo starts and where the log has to be read from, and the transaction table
+  // (txn id, last LSN) and dirty page table (page id, recovery LSN) at the time of the checkpoint
+  lsn_t redo_lsn_{INVALID_LSN};
+  int64_t scan_offset_{0};
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
+
+  // case6: for index records, the entry of an entry record, or the new bytes of a page write, range after range
+  uint32_t index_id_{0};
+  uint32_t slot_{0};
+  std::vector<char> index_data_;
+
+  // case7: for compensation log records, what the fields above belong to and where undo carries on
+  LogRecordType undone_type_{LogRecordType::INVALID};
+  lsn_t undo_next_lsn_{INVALID_LSN};
+  // size | LogType | LSN | segment | transID | prevLSN, with 1 byte for each varint
+  static const int MIN_SIZE = 4 + sizeof(lsn_t) + sizeof(uint32_t);
 };  // namespace bustub
 
 }  // namespace bustub
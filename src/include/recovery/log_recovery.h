@@ -13,22 +13,53 @@
 #pragma once
 
 #include <algorithm>
-#include <mutex>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
 #include "recovery/log_record.h"
+#include "storage/page/table_page.h"
 
 namespace bustub {
 
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Redo is parallel. A single reader scans the log in RECOVERY_READ_SIZE chunks, reading the next chunk in the
+ * background while it parses the current one, and hands every page-level record to one of the redo workers chosen by
+ * page id. Records of the same page therefore always go to the same worker and are applied in LSN order, while
+ * different pages are redone concurrently. Before a chunk is handed out, the reader fetches the pages it touches into
+ * the buffer pool so that the workers mostly find them already resident.
+ *
+ * If the master record points at a checkpoint, the log is only read from the checkpoint's scan offset on, and records
+ * older than the checkpoint are only redone for pages that were in its dirty page table at or after their recLSN.
+ *
+ * Index pages are redone like table pages, one page at a time. Undoing an index entry is up to the index, see
+ * RegisterIndex.
+ *
+ * Redo can also run continuously, as a hot standby does with the log of its primary (see HotStandby): BeginRedo once,
+ * RedoAvailableLog whenever the log may have grown, and EndRedo and ResumeLog before Undo. Redo is BeginRedo, one
+ * RedoAvailableLog, EndRedo and ResumeLog with the log manager of the buffer pool.
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
+  /** Reverts the insert or delete of an index entry that a BTREE_* or HASH_* log record describes. */
+  using IndexUndoHandler = std::function<void(LogRecord *log_record)>;
+
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager,
+              size_t num_redo_threads = RECOVERY_REDO_THREADS)
+      : disk_manager_(disk_manager),
+        buffer_pool_manager_(buffer_pool_manager),
+        num_redo_threads_(std::max<size_t>(num_redo_threads, 1)),
+        offset_(0) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
   }
 
@@ -38,19 +69,149 @@ class LogRecovery {
   }
 
   void Redo();
+
+  /**
+   * Reverts the transactions that neither committed nor aborted. Given a log manager by ResumeLog, it then writes the
+   * reverted pages out and logs the transactions as aborted, so that a later recovery leaves them alone.
+   */
   void Undo();
-  bool DeserializeLogRecord(const char *data, LogRecord *log_record);
+
+  /**
+   * Starts the redo workers and positions redo at the start of the log.
+   * @param from_checkpoint whether to start at the last checkpoint named by the master record, which requires the
+   * database file to be at least as new as the checkpoint's redo LSN
+   */
+  void BeginRedo(bool from_checkpoint = true);
+
+  /**
+   * Redoes the complete records past the ones redone so far and waits until their pages reflect them. A record that
+   * is only partially written yet is left for the next call.
+   * @return the LSN of the last record redone so far, INVALID_LSN if none
+   */
+  lsn_t RedoAvailableLog();
+
+  /** Stops the redo workers. */
+  void EndRedo();
+
+  /**
+   * Makes the log continue right after the last complete record redone, not at the fresh segment a restarted disk
+   * manager appends to, and the records log_manager appends from then on follow it in LSN order. Redo does so; a
+   * standby being promoted has to do it itself, once nobody else writes the log.
+   * @param log_manager the log manager to append to the log from now on, nullptr if none
+   */
+  void ResumeLog(LogManager *log_manager);
+
+  /** @return the offset of the first log byte that redo has not parsed yet */
+  int64_t GetRedoOffset() const { return offset_; }
+
+  /**
+   * @return the oldest log offset that redo or a later Undo still reads: the first record of the oldest unfinished
+   * transaction, or GetRedoOffset if there is none
+   */
+  int64_t GetRetainOffset() const;
+
+  bool DeserializeLogRecord(const char *data, LogRecord *log_record, int64_t offset);
+
+  /**
+   * Undo of index entries is logical: by the time a loser transaction is rolled back, a split or merge may have moved
+   * its entry to another page, and only the index knows how to find it there. Every index whose entries may need to be
+   * undone has to be registered by its index id before Undo; entries of unknown indexes are left alone.
+   */
+  void RegisterIndex(uint32_t index_id, IndexUndoHandler handler);
+
+  /**
+   * Makes redo keep the tuple writes of the transactions that have not finished yet, for GetCommittedTuple. Only
+   * needed by readers of a log being redone continuously; the writes are kept in memory until their transaction
+   * finishes.
+   */
+  void TrackUncommittedWrites() { track_uncommitted_ = true; }
+
+  /**
+   * Reverts the writes of the unfinished transactions to a tuple as of the last record redone, which gives the tuple
+   * as of the last commit redone. Requires TrackUncommittedWrites, and no redo in the meantime.
+   * @param rid the tuple
+   * @param[in,out] tuple the tuple as of the last record redone, if it exists; the committed version on return
+   * @param exists whether the tuple exists as of the last record redone
+   * @return whether the tuple exists as of the last commit redone
+   */
+  bool GetCommittedTuple(const RID &rid, Tuple *tuple, bool exists) const;
 
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** A record handed to a redo worker, together with the page the worker has to apply it to. */
+  struct RedoTask {
+    page_id_t page_id_;
+    LogRecord log_record_;
+  };
+
+  /** The queue of one redo worker. The reader blocks once MAX_QUEUED_TASKS records are waiting. */
+  struct RedoWorker {
+    static constexpr size_t MAX_QUEUED_TASKS = 1024;
+
+    std::mutex latch_;
+    std::condition_variable cv_;
+    std::deque<RedoTask> tasks_;
+    // whether the worker is applying a task it took off the queue
+    bool busy_{false};
+    bool done_{false};
+    std::thread thread_;
+  };
+
+  /** Appends a task to the worker owning its page. */
+  void Dispatch(RedoTask &&task);
+  /** Applies the tasks of one worker until the reader is done and its queue is empty. */
+  void RunRedoWorker(RedoWorker *worker);
+  /** Waits until every worker has applied every task handed to it. */
+  void WaitForRedoWorkers();
+  /** @return whether a record older than the checkpoint redo started at still has to be applied to the page */
+  bool NeedsRedo(page_id_t page_id, lsn_t lsn) const;
+  /** Applies a single record to a single page, unless the page already reflects it. */
+  void RedoPage(const RedoTask &task);
+  /**
+   * Reads the size field of the record at data, of which available bytes are readable.
+   * @return the size of the record, 0 if more bytes are needed to tell, -1 if there is no record at data
+   */
+  static int32_t PeekLogRecordSize(const char *data, size_t available);
+  /** Reverts a single record of a loser transaction, logging a compensation log record for a table record. */
+  void UndoRecord(LogRecord *log_record);
+  /** Reverts a table record of the given type, which may be carried by a compensation log record, on its page. */
+  static void UndoOnPage(TablePage *table_page, const LogRecord &log_record, LogRecordType type);
+  /** @return the page a table record of the given type changes, INVALID_PAGE_ID for any other record */
+  static page_id_t TablePageOf(const LogRecord &log_record, LogRecordType type);
+  /** Reads the end record of the last checkpoint, as named by the master record. */
+  bool ReadCheckpoint(LogRecord *checkpoint_record);
+  /** Fetches a page, waiting for a frame to become free if every frame is pinned by a redo worker. */
+  Page *FetchPage(page_id_t page_id);
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  /** The log manager appending to the log after ResumeLog, nullptr before. */
+  LogManager *log_manager_{nullptr};
+  size_t num_redo_threads_;
+  std::vector<std::unique_ptr<RedoWorker>> workers_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
+  /** The offset of the first record of every active transaction. */
+  std::unordered_map<txn_id_t, int64_t> txn_first_offsets_;
   /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  std::unordered_map<lsn_t, int64_t> lsn_mapping_;
+  /** The indexes that can undo their entries, by index id. */
+  std::unordered_map<uint32_t, IndexUndoHandler> index_undo_handlers_;
+  /** Whether redo keeps the tuple writes of unfinished transactions. */
+  bool track_uncommitted_{false};
+  /** The tuple writes of the unfinished transactions, by tuple and in log order. */
+  std::unordered_map<RID, std::vector<LogRecord>> uncommitted_writes_;
+  /** The tuples every unfinished transaction has written. */
+  std::unordered_map<txn_id_t, std::unordered_set<RID>> uncommitted_rids_;
 
-  int offset_ __attribute__((__unused__));
+  /** File offset of the first log byte that has not been parsed yet. */
+  int64_t offset_;
+  /** LSN of the last record parsed. */
+  lsn_t last_lsn_{INVALID_LSN};
+  /** The checkpoint redo started at: its end record, its redo LSN and its dirty page table. */
+  lsn_t checkpoint_lsn_{INVALID_LSN};
+  lsn_t checkpoint_redo_lsn_{INVALID_LSN};
+  std::unordered_map<page_id_t, lsn_t> checkpoint_dirty_pages_;
   char *log_buffer_;
 };
 
@@ -17,6 +17,7 @@
 #include <future>  // NOLINT
 #include <mutex>   // NOLINT
 #include <string>
+#include <vector>
 
 #include "common/config.h"
 
@@ -25,16 +26,28 @@ namespace bustub {
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * The log is addressed by a logical offset but stored in segment files of log_segment_size bytes, where segment n
+ * (named <db>.log.<n>) holds the offsets [n * log_segment_size, (n + 1) * log_segment_size). Segment files are
+ * preallocated, so appending to the log never extends a file. Segments that TruncateLog no longer needs are kept as
+ * spares (<db>.log.spare.<i>), which are renamed into place when the log reaches a new segment; the next segment is
+ * always prepared in the background while the current one is being written. A recycled segment still holds the
+ * records of the segment it used to be until they are overwritten: past the end of the log, a segment reads back
+ * as zeros or as such stale records, which every log record tells apart by the segment number in its header.
  */
 class DiskManager {
  public:
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
+   * @param log_segment_size the size of a log segment file
+   * @param log_db_file the database file whose log and master record to use, if not db_file's own; a hot standby
+   * reads the log of its primary this way
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, int log_segment_size = LOG_SEGMENT_SIZE,
+                       const std::string &log_db_file = "");
 
-  ~DiskManager() = default;
+  ~DiskManager() { ShutDown(); }
 
   /**
    * Shut down the disk manager and close all the file resources.
@@ -56,7 +69,7 @@ class DiskManager {
   void ReadPage(page_id_t page_id, char *page_data);
 
   /**
-   * Flush the entire log buffer into disk.
+   * Flush the entire log buffer into disk. Returns once the data is on stable storage.
    * @param log_data raw log data
    * @param size size of log entry
    */
@@ -69,7 +82,75 @@ class DiskManager {
    * @param offset offset of the log entry in the file
    * @return true if the read was successful, false otherwise
    */
-  bool ReadLog(char *log_data, int size, int offset);
+  bool ReadLog(char *log_data, int size, int64_t offset);
+
+  /** @return the size of a log segment in bytes */
+  int GetLogSegmentSize() const { return log_segment_size_; }
+
+  /** @return the logical size of the log in bytes, the offset the next WriteLog appends at */
+  int64_t GetLogSize();
+
+  /**
+   * Picks up the log segments another process has added or truncated since, for a reader that tails a log it does
+   * not write.
+   * @return the new logical size of the log
+   */
+  int64_t RefreshLogSize();
+
+  /**
+   * Makes WriteLog append at offset, the end of the last complete record as recovery found it, instead of at the
+   * fresh segment a restarted disk manager starts at, and zeroes the rest of the segment there, a torn record
+   * perhaps. Only for a log nobody else appends to.
+   * @param offset the end of the log, at most the logical size of the log
+   */
+  void ResumeLogAt(int64_t offset);
+
+  /**
+   * Releases the log segments that lie entirely before offset, or before the retention record if that is older,
+   * recycling them as spares while there are fewer than LOG_SEGMENT_SPARES and deleting them otherwise. Reading the
+   * log before the first remaining segment fails.
+   * @param offset the oldest log offset that is still needed, e.g. where recovery from the last checkpoint starts
+   */
+  void TruncateLog(int64_t offset);
+
+  /** @return the offset of the oldest log byte that can still be read, the start of the first segment */
+  int64_t GetLogStart() const;
+
+  /**
+   * Durably records the oldest log offset that a reader of the log other than recovery still needs, such as a hot
+   * standby, which may run in another process. TruncateLog keeps the segments from there on until the record moves
+   * forward or is dropped. A log has at most one retention record, next to its master record. The record is only
+   * rewritten when the offset moves to another segment.
+   * @param offset the oldest log offset the reader still needs
+   */
+  void WriteRetentionRecord(int64_t offset);
+
+  /** Deletes the retention record, if there is one. */
+  void DropRetentionRecord();
+
+  /** @return the number of log segment files, spares included */
+  int GetNumLogSegments();
+
+  /**
+   * Deletes every log segment file of a database, for tests that need to start with an empty log.
+   * @param db_file the file name of the database file
+   */
+  static void RemoveLogFiles(const std::string &db_file);
+
+  /**
+   * Durably replaces the master record, which tells recovery where the last complete checkpoint is.
+   * @param checkpoint_lsn LSN of the checkpoint's end record
+   * @param offset offset in the log file at or before the checkpoint's end record
+   */
+  void WriteMasterRecord(lsn_t checkpoint_lsn, int64_t offset);
+
+  /**
+   * Reads the master record.
+   * @param[out] checkpoint_lsn LSN of the last checkpoint's end record
+   * @param[out] offset offset in the log file at or before that record
+   * @return false if there is no valid master record for the current log file
+   */
+  bool ReadMasterRecord(lsn_t *checkpoint_lsn, int64_t *offset);
 
   /** @return the number of disk flushes */
   int GetNumFlushes() const;
@@ -91,9 +172,41 @@ class DiskManager {
 
  private:
   int GetFileSize(const std::string &file_name);
-  // stream to write log file
-  std::fstream log_io_;
+  /** @return the file name of a log segment */
+  std::string LogSegmentName(int segment) const;
+  /** Opens a log segment for writing, taking a spare or creating and preallocating the file if it does not exist. */
+  int OpenLogSegment(int segment);
+  /** Makes the given segment the one WriteLog appends to, and starts preparing the one after it. */
+  void SwitchLogSegment(int segment);
+  /** Sets the bounds of the log from its segment files and collects its spares. */
+  void ScanLogSegments();
+  /** Reads the retention record, false if there is none. */
+  bool ReadRetentionRecord(int64_t *offset);
+
+  // file descriptor of the log segment being written, written with pwrite(2) and synced with fdatasync(2)
+  int log_fd_{-1};
+  int log_fd_segment_{-1};
+  // file descriptor of the log segment ReadLog read last, kept open for the sequential reads of recovery
+  int read_fd_{-1};
+  int read_fd_segment_{-1};
+  std::mutex log_read_latch_;
+  int log_segment_size_;
+  // logical end of the log, only advanced by WriteLog, or by RefreshLogSize for a log written by someone else, and
+  // moved back by ResumeLogAt
+  std::atomic<int64_t> log_end_{0};
+  // the oldest log segment that has not been truncated
+  std::atomic<int> first_log_segment_{0};
+  // protects the spare segments and the truncation of the log
+  std::mutex log_io_latch_;
+  std::vector<std::string> spare_log_segments_;
+  int next_spare_id_{0};
+  // preparation of the segment after the one being written
+  std::future<void> next_log_segment_;
   std::string log_name_;
+  std::string master_name_;
+  std::string retention_name_;
+  // the offset WriteRetentionRecord last wrote, the start of a segment, -1 if none
+  int64_t retention_offset_{-1};
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
@@ -10,10 +10,14 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <queue>
 #include <string>
 #include <vector>
 
+#include "common/rwlatch.h"
+#include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
 #include "storage/index/index_iterator.h"
 #include "storage/page/b_plus_tree_internal_page.h"
@@ -32,6 +36,30 @@ namespace bustub {
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
+ *
+ * If logging is enabled, every change to a page is logged: inserting or deleting an entry as a BTREE_INSERT or
+ * BTREE_DELETE, everything else a split or merge does as an INDEX_PAGE_WRITE. Only the leaf entries belong to the
+ * transaction that inserts or deletes a key; the rest is logged outside of it, and is never undone, see Undo.
+ *
+ * Given a lock manager, the tree protects the key ranges that REPEATABLE_READ transactions scan with next-key
+ * locking (see LockManager::LockKey). ScanNext locks every key it returns and, at the end of a scan, the key after
+ * the last one, or the end of the index. Insert and Remove lock their key exclusively and the key after it, or the
+ * end of the index, in INTENTION_EXCLUSIVE mode, so that writing into a gap a scan has read waits for the scan's
+ * transaction, while writers into the same gap do not wait for each other. A lock is never waited for while latch_
+ * is held: the tree looks up the key after, locks it, and looks again under the latch, locking anew if another key
+ * went in between. Snapshot isolation and optimistic transactions do not lock keys.
+ *
+ * The tree is a B-link tree (Lehman and Yao): every page links to the next page on its level and has a high key, the
+ * lowest key of the next page, which bounds the keys of its own. A split moves the upper half of a page into a new
+ * page, linked in to its right, before the separator goes into the parent; a thread that reaches the old page in
+ * between finds its key past the high key and follows the link. Readers therefore latch one page at a time, shared, and
+ * never wait for a split to finish. A split latches only the pages it changes: the page split, then its parent,
+ * releasing one before latching the next, so a thread waits for a page latch holding none, except for a parent that
+ * latches the children it adopts.
+ *
+ * Lookups, scans, inserts, and deletes that leave their leaf at least half full hold latch_ shared. An insert into an
+ * empty tree, and a delete that would leave its leaf underfull, start over holding latch_ exclusively: merges and
+ * redistribution run alone, and rely on the parent page ids, which are only all up to date when no split is underway.
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTree {
@@ -40,7 +68,8 @@ class BPlusTree {
 
  public:
   explicit BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE);
+                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE,
+                     LockManager *lock_manager = nullptr);
 
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
@@ -51,9 +80,22 @@ class BPlusTree {
   // Remove a key and its value from this B+ tree.
   void Remove(const KeyType &key, Transaction *transaction = nullptr);
 
+  // Build the tree from count entries with increasing keys, which next produces one at a time, filling pages left to
+  // right up to fill_factor of their capacity and the inner levels bottom up. Returns false, reading no entry, if the
+  // tree is not empty. The pages are logged as written, not the entries: no transaction can undo them.
+  bool BulkLoad(size_t count, const std::function<void(MappingType *)> &next,
+                double fill_factor = BULK_LOAD_FILL_FACTOR);
+
   // return the value associated with a given key
   bool GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction = nullptr);
 
+  // Find the first entry with a key greater than after, or the first entry for nullptr, next-key locking it if the
+  // transaction's scans lock keys. Returns false at the end of the tree, or if the lock was not granted.
+  bool ScanNext(const KeyType *after, MappingType *entry, Transaction *transaction);
+
+  // whether the transaction's scans lock the keys they read and the gaps between them
+  bool LocksScans(Transaction *transaction) const;
+
   // index iterator
   INDEXITERATOR_TYPE Begin();
   INDEXITERATOR_TYPE Begin(const KeyType &key);
@@ -73,14 +115,66 @@ class BPlusTree {
   // expose for test purpose
   Page *FindLeafPage(const KeyType &key, bool leftMost = false);
 
+  // the id that log records of this tree's entries carry
+  uint32_t GetIndexId() const { return index_id_; }
+
+  // Logically undo the insert or delete of an entry, as handed out by LogRecovery (see LogRecovery::RegisterIndex).
+  void Undo(LogRecord *log_record);
+
  private:
-  void StartNewTree(const KeyType &key, const ValueType &value);
+  // A level of the tree that BulkLoad builds, whose page count is known up front.
+  struct BulkLevel {
+    // entries of the level: keys or children
+    size_t entries_;
+    size_t pages_;
+    size_t pages_started_{0};
+    // the page being filled, pinned, with its size when full and its state before the load for the log
+    Page *page_{nullptr};
+    int full_size_{0};
+    std::vector<char> before_;
+  };
+
+  // Start the next page of a level of a bulk load, whose first key is key, starting a new parent page if need be.
+  void StartBulkPage(std::vector<BulkLevel> *levels, size_t level, const KeyType &key);
+
+  // Log and release the page a level of a bulk load is filling.
+  void FinishBulkPage(BulkLevel *level);
+
+  void StartNewTree(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
+
+  // whether the transaction's inserts and deletes lock keys
+  bool LocksKeys(Transaction *transaction) const;
+
+  // the name the key, or the end of the tree for nullptr, is locked by
+  int64_t KeyLockName(const KeyType *key) const;
+
+  // Find the first entry with a key greater than after, or the first entry for nullptr. latch_ has to be held.
+  bool FindNextEntry(const KeyType *after, MappingType *entry);
+
+  // Lock key exclusively and the key after it in INTENTION_EXCLUSIVE mode, and take latch_, exclusively or shared,
+  // once the key locked is still the one after key. Returns false, without the latch, if a lock was not granted.
+  bool LockForWrite(const KeyType &key, Transaction *transaction, bool exclusive);
+
+  // Remove from the leaf with latch_ held shared, unless the leaf would be left underfull. Returns false, changing
+  // nothing, if it would.
+  bool RemoveOptimistic(const KeyType &key, Transaction *transaction);
 
   bool InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
 
-  void InsertIntoParent(BPlusTreePage *old_node, const KeyType &key, BPlusTreePage *new_node,
+  // Insert the separator of a page split off the one on old_page, which is latched exclusively, into the parent, or
+  // a new root. Releases old_page and new_node, which is not latched: no other thread knows it yet.
+  void InsertIntoParent(Page *old_page, const KeyType &key, BPlusTreePage *new_node,
                         Transaction *transaction = nullptr);
 
+  // Find the leaf that holds key, or the leftmost leaf, latched shared or exclusively. nullptr if the tree is empty.
+  Page *FindLeaf(const KeyType &key, bool left_most, bool exclusive);
+
+  // Follow the right links from the latched page to the page on its level that holds key, which is returned latched.
+  Page *MoveRight(Page *page, const KeyType &key, bool exclusive);
+
+  // Fetch and latch a page of the tree.
+  Page *FetchLatched(page_id_t page_id, bool exclusive);
+
   template <typename N>
   N *Split(N *node);
 
@@ -105,11 +199,18 @@ class BPlusTree {
 
   // member variable
   std::string index_name_;
-  page_id_t root_page_id_;
+  // changes under latch_ held shared when the root splits
+  std::atomic<page_id_t> root_page_id_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
   int leaf_max_size_;
   int internal_max_size_;
+  uint32_t index_id_;
+  // Held shared by readers and by writers that split pages, which latch the pages, and exclusively by writers that
+  // merge pages or start a new tree. Taken by every operation, hence counted per core. Does not cover iterators.
+  DistributedReaderWriterLatch latch_;
+  // for next-key locking, nullptr if the tree does not lock keys
+  LockManager *lock_manager_;
 };
 
 }  // namespace bustub
@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -26,14 +27,29 @@ namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeIndex : public Index {
  public:
-  BPlusTreeIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager);
+  /** @param lock_manager the lock manager for next-key locking, see BPlusTree, nullptr to not lock keys */
+  BPlusTreeIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager,
+                 LockManager *lock_manager = nullptr);
 
   void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
 
+  /** Removes the entry of the key only if it is the one of rid. */
   void DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) override;
 
   void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
 
+  /**
+   * Sorts the entries, externally if need be, and bulk loads the tree with them, if it is empty. Throws if two of the
+   * entries have the same key, which the tree could only keep one of.
+   */
+  void BulkLoad(const std::function<bool(Tuple *, RID *)> &next, Transaction *transaction) override;
+
+  bool ScanNext(const KeyType *after, MappingType *entry, Transaction *transaction) {
+    return container_.ScanNext(after, entry, transaction);
+  }
+
+  bool LocksScans(Transaction *transaction) const { return container_.LocksScans(transaction); }
+
   INDEXITERATOR_TYPE GetBeginIterator();
 
   INDEXITERATOR_TYPE GetBeginIterator(const KeyType &key);
@@ -43,6 +59,8 @@ class BPlusTreeIndex : public Index {
  protected:
   // comparator for key
   KeyComparator comparator_;
+  // for the runs of the sort of a bulk load
+  BufferPoolManager *buffer_pool_manager_;
   // container
   BPlusTree<KeyType, ValueType, KeyComparator> container_;
 };
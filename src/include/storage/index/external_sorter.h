@@ -0,0 +1,116 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// external_sorter.h
+//
+// Identification: src/include/storage/index/external_sorter.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/macros.h"
+#include "storage/page/b_plus_tree_page.h"
+
+namespace bustub {
+
+#define EXTERNAL_SORTER_TYPE ExternalSorter<KeyType, ValueType, KeyComparator>
+
+/**
+ * Sorts index entries by key, more of them than fit in memory, for BPlusTree::BulkLoad.
+ *
+ * Entries are gathered in memory up to run_size bytes at a time, sorted and written out as a run: a sequence of
+ * pages of the buffer pool, which the buffer pool writes to disk as it needs the frames. Finish merges the runs, as
+ * many at a time as the buffer pool has frames for, until one is left, and Next reads that one back. The pages of a
+ * run are deleted once read. Runs are not logged, and are lost in a crash.
+ *
+ * Keys are unique in the result: of the entries with the same key, the first one added is kept.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+class ExternalSorter {
+ public:
+  ExternalSorter(BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
+                 size_t run_size = SORT_RUN_SIZE);
+
+  /** Deletes the pages of the runs not read yet. */
+  ~ExternalSorter();
+
+  DISALLOW_COPY(ExternalSorter);
+
+  /** Adds an entry. Not after Finish. */
+  void Add(const KeyType &key, const ValueType &value);
+
+  /**
+   * Sorts the entries added.
+   * @return the number of entries Next is going to return, one per distinct key
+   */
+  size_t Finish();
+
+  /**
+   * Reads the next entry in key order. Only after Finish.
+   * @return false past the last entry
+   */
+  bool Next(MappingType *entry);
+
+ private:
+  /** Sorted entries on consecutive run pages, ENTRIES_PER_PAGE on every page but the last. */
+  struct Run {
+    std::vector<page_id_t> pages_;
+    size_t size_{0};
+  };
+
+  /** Reads a run from the start, deleting every page it is done with, and the pages left when destroyed. */
+  class RunReader {
+   public:
+    RunReader(BufferPoolManager *buffer_pool_manager, Run run)
+        : buffer_pool_manager_(buffer_pool_manager), run_(std::move(run)) {}
+    ~RunReader();
+    DISALLOW_COPY(RunReader);
+    /** @return the next entry of the run, valid until the next call, nullptr past the end of the run */
+    const MappingType *Next();
+
+   private:
+    void ReleasePage();
+
+    BufferPoolManager *buffer_pool_manager_;
+    Run run_;
+    size_t position_{0};
+    size_t next_page_{0};
+    Page *page_{nullptr};
+  };
+
+  static constexpr size_t ENTRIES_PER_PAGE = PAGE_SIZE / sizeof(MappingType);
+
+  /** Sorts the entries in memory and removes all but the first one of every key. */
+  void SortInMemory();
+
+  /** Writes the entries in memory out as a run. */
+  void Spill();
+
+  /** Appends an entry to a run that is being written, whose last page is pinned unless nullptr. */
+  void Append(Run *run, Page **page, const MappingType &entry);
+
+  /** Merges runs into a single one, keeping the first of the entries with the same key, earlier runs first. */
+  Run Merge(std::vector<Run> runs);
+
+  BufferPoolManager *buffer_pool_manager_;
+  KeyComparator comparator_;
+  size_t run_entries_;
+  bool finished_{false};
+  /** Entries not in a run yet, and all of them if there never was a run. */
+  std::vector<MappingType> entries_;
+  size_t next_entry_{0};
+  /** The runs written, in the order of their entries. */
+  std::vector<Run> runs_;
+  /** Reads the only run left after Finish, if there were runs. */
+  RunReader *reader_{nullptr};
+};
+
+}  // namespace bustub
@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -175,6 +176,20 @@ class Index {
    */
   virtual void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) = 0;
 
+  /**
+   * Insert the entries of a whole table, as when the index is created. Inserts them one by one, unless the index
+   * knows a faster way to build itself from all of them at once.
+   * @param next Produces the key and RID of the next entry, returns false past the last one
+   * @param transaction The transaction context
+   */
+  virtual void BulkLoad(const std::function<bool(Tuple *, RID *)> &next, Transaction *transaction) {
+    Tuple key;
+    RID rid;
+    while (next(&key, &rid)) {
+      InsertEntry(key, rid, transaction);
+    }
+  }
+
  private:
   /** The Index structure owns its metadata */
   std::unique_ptr<IndexMetadata> metadata_;
@@ -13,6 +13,7 @@
  * For range scan of b+ tree
  */
 #pragma once
+#include "buffer/buffer_pool_manager.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
 
 namespace bustub {
@@ -22,22 +23,37 @@ namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
  public:
-  // you may define your own constructor based on your member variables
-  IndexIterator();
+  /**
+   * Iterates from the index-th entry of the given leaf page on, which has to be pinned and is unpinned by the
+   * iterator. A null page makes the end iterator.
+   */
+  IndexIterator(BufferPoolManager *buffer_pool_manager, Page *page, int index);
   ~IndexIterator();  // NOLINT
 
+  IndexIterator(IndexIterator &&other) noexcept;
+  IndexIterator(const IndexIterator &) = delete;
+  IndexIterator &operator=(const IndexIterator &) = delete;
+
   bool IsEnd();
 
   const MappingType &operator*();
 
   IndexIterator &operator++();
 
-  bool operator==(const IndexIterator &itr) const { throw std::runtime_error("unimplemented"); }
+  bool operator==(const IndexIterator &itr) const { return page_ == itr.page_ && index_ == itr.index_; }
 
-  bool operator!=(const IndexIterator &itr) const { throw std::runtime_error("unimplemented"); }
+  bool operator!=(const IndexIterator &itr) const { return !(*this == itr); }
 
  private:
-  // add your own private member variables here
+  using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
+
+  /** Moves on to the next leaf while the current one has no entry at index_, until the end. */
+  void SkipExhaustedLeaves();
+
+  BufferPoolManager *buffer_pool_manager_;
+  Page *page_;
+  LeafPage *leaf_;
+  int index_;
 };
 
 }  // namespace bustub
@@ -17,8 +17,8 @@
 namespace bustub {
 
 #define B_PLUS_TREE_INTERNAL_PAGE_TYPE BPlusTreeInternalPage<KeyType, ValueType, KeyComparator>
-#define INTERNAL_PAGE_HEADER_SIZE 24
-#define INTERNAL_PAGE_SIZE ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE) / (sizeof(MappingType)))
+#define INTERNAL_PAGE_HEADER_SIZE 32
+#define INTERNAL_PAGE_SIZE ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE - sizeof(KeyType)) / (sizeof(MappingType)))
 /**
  * Store n indexed keys and n+1 child pointers (page_id) within internal page.
  * Pointer PAGE_ID(i) points to a subtree in which all keys K satisfy:
@@ -28,9 +28,13 @@ namespace bustub {
  * should ignore the first key.
  *
  * Internal page format (keys are stored in increasing order):
- *  --------------------------------------------------------------------------
- * | HEADER | KEY(1)+PAGE_ID(1) | KEY(2)+PAGE_ID(2) | ... | KEY(n)+PAGE_ID(n) |
- *  --------------------------------------------------------------------------
+ *  -----------------------------------------------------------------------------------------
+ * | HEADER | KEY(1)+PAGE_ID(1) | KEY(2)+PAGE_ID(2) | ... | KEY(n)+PAGE_ID(n) | ... | HIGH KEY |
+ *  -----------------------------------------------------------------------------------------
+ *
+ * The header is the one of BPlusTreePage followed by the next page id (4). As with leaf pages, the next page is the
+ * page to the right on the same level, which covers the keys from the high key on; the last page of a level has
+ * neither.
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeInternalPage : public BPlusTreePage {
@@ -38,6 +42,12 @@ class BPlusTreeInternalPage : public BPlusTreePage {
   // must call initialize method after "create" a new node
   void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = INTERNAL_PAGE_SIZE);
 
+  page_id_t GetNextPageId() const;
+  void SetNextPageId(page_id_t next_page_id);
+  // the lowest key of the next page, kept in the last bytes of the page; undefined without a next page
+  KeyType GetHighKey() const;
+  void SetHighKey(const KeyType &key);
+
   KeyType KeyAt(int index) const;
   void SetKeyAt(int index, const KeyType &key);
   int ValueIndex(const ValueType &value) const;
@@ -46,6 +56,8 @@ class BPlusTreeInternalPage : public BPlusTreePage {
   ValueType Lookup(const KeyType &key, const KeyComparator &comparator) const;
   void PopulateNewRoot(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value);
   int InsertNodeAfter(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value);
+  // add a child after the last one, as when building a tree bottom up; the child's parent page id is not changed
+  void Append(const KeyType &key, const ValueType &value);
   void Remove(int index);
   ValueType RemoveAndReturnOnlyChild();
 
@@ -56,11 +68,13 @@ class BPlusTreeInternalPage : public BPlusTreePage {
                         BufferPoolManager *buffer_pool_manager);
   void MoveLastToFrontOf(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                          BufferPoolManager *buffer_pool_manager);
+  void Adopt(page_id_t child_page_id, BufferPoolManager *buffer_pool_manager);
 
  private:
   void CopyNFrom(MappingType *items, int size, BufferPoolManager *buffer_pool_manager);
   void CopyLastFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
   void CopyFirstFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
+  page_id_t next_page_id_;
   // Flexible array member for page data.
   MappingType array_[1];
 };
@@ -14,8 +14,10 @@
 #include <climits>
 #include <cstdlib>
 #include <string>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "concurrency/transaction.h"
 #include "storage/index/generic_key.h"
 
 namespace bustub {
@@ -33,9 +35,9 @@ enum class IndexPageType { INVALID_INDEX_PAGE = 0, LEAF_PAGE, INTERNAL_PAGE };
  * It actually serves as a header part for each B+ tree page and
  * contains information shared by both leaf page and internal page.
  *
- * Header format (size in byte, 24 bytes in total):
+ * Header format (size in byte, 28 bytes in total):
  * ----------------------------------------------------------------------------
- * | PageType (4) | LSN (4) | CurrentSize (4) | MaxSize (4) |
+ * | PageType (4) | LSN (8) | CurrentSize (4) | MaxSize (4) |
  * ----------------------------------------------------------------------------
  * | ParentPageId (4) | PageId(4) |
  * ----------------------------------------------------------------------------
@@ -62,10 +64,43 @@ class BPlusTreePage {
 
   void SetLSN(lsn_t lsn = INVALID_LSN);
 
+  /**
+   * Inserts the entry_size bytes at entry as the entry at index, shifting the entries from index on to the right.
+   * Leaf and internal pages insert through here, and so does recovery, which does not know the key and value types.
+   */
+  void InsertEntryAt(int index, const char *entry, size_t entry_size);
+
+  /** Removes the entry_size bytes long entry at index, shifting the entries after it to the left. */
+  void RemoveEntryAt(int index, size_t entry_size);
+
+  /** @return a pointer to the entry_size bytes long entry at index */
+  char *EntryAt(int index, size_t entry_size);
+
+  /**
+   * Logs the entry_size bytes at entry as inserted into or deleted from this page at index, and stamps the page with
+   * the record's LSN. Without a transaction the record is redo-only, like any part of a structure modification. Does
+   * nothing unless logging is enabled.
+   */
+  void LogEntry(LogRecordType log_record_type, uint32_t index_id, int index, const char *entry, size_t entry_size,
+                Transaction *transaction, BufferPoolManager *buffer_pool_manager);
+
+  /** @return a copy of this page to log later changes against with LogPageWrite, empty if nothing is logged */
+  std::vector<char> CopyForLog(BufferPoolManager *buffer_pool_manager) const;
+
+  /**
+   * Logs the bytes of this page that changed since before was copied from it as a redo-only INDEX_PAGE_WRITE, and
+   * stamps the page with the record's LSN. Does nothing if before is empty.
+   */
+  void LogPageWrite(const std::vector<char> &before, BufferPoolManager *buffer_pool_manager);
+
+  /** @return whether changes to index pages made through buffer_pool_manager are logged */
+  static bool IsLogged(BufferPoolManager *buffer_pool_manager);
+
  private:
   // member variable, attributes that both internal and leaf page share
   IndexPageType page_type_ __attribute__((__unused__));
-  lsn_t lsn_ __attribute__((__unused__));
+  // packed to keep the LSN where Page::GetLSN expects it, right after the first 4 bytes
+  lsn_t lsn_ __attribute__((__unused__, __packed__));
   int size_ __attribute__((__unused__));
   int max_size_ __attribute__((__unused__));
   page_id_t parent_page_id_ __attribute__((__unused__));
@@ -20,6 +20,66 @@
 #include "storage/page/hash_table_page_defs.h"
 
 namespace bustub {
+/**
+ * The layout every bucket page shares, whatever its key and value types. Recovery redoes bucket changes through it.
+ *
+ * Bucket page format (size in byte):
+ *  -------------------------------------------------------------------------------------------------
+ * | PageId (4) | LSN (8) | Occupied (capacity / 8) | Readable (capacity / 8) | Entries (capacity * n)
+ *  -------------------------------------------------------------------------------------------------
+ *
+ * where n is the size of an entry and capacity follows from it, see Capacity. Entries are not aligned.
+ */
+class HashTableBucketPageBase {
+ public:
+  // Delete all constructor / destructor to ensure memory safety
+  HashTableBucketPageBase() = delete;
+
+  page_id_t GetPageId() const;
+  void SetPageId(page_id_t page_id);
+
+  lsn_t GetLSN() const;
+  void SetLSN(lsn_t lsn);
+
+  /**
+   * Copies the entry_size bytes at entry into the slot at bucket_idx and marks the slot occupied and readable.
+   */
+  void InsertEntryAt(uint32_t bucket_idx, const char *entry, size_t entry_size);
+
+  /**
+   * Marks the slot at bucket_idx no longer readable, leaving a tombstone.
+   */
+  void RemoveEntryAt(uint32_t bucket_idx, size_t entry_size);
+
+  /**
+   * @return the number of entry_size bytes long entries a bucket page holds
+   */
+  static constexpr size_t Capacity(size_t entry_size) {
+    return 4 * (PAGE_SIZE - HASH_BUCKET_PAGE_HEADER_SIZE) / (4 * entry_size + 1);
+  }
+
+ protected:
+  /** @return a pointer to the entry_size bytes long entry at bucket_idx */
+  char *EntryAt(uint32_t bucket_idx, size_t entry_size);
+  const char *EntryAt(uint32_t bucket_idx, size_t entry_size) const;
+
+  bool IsOccupied(uint32_t bucket_idx) const;
+  bool IsReadable(uint32_t bucket_idx, size_t entry_size) const;
+  void SetOccupied(uint32_t bucket_idx);
+  void SetReadable(uint32_t bucket_idx, size_t entry_size, bool readable);
+  uint32_t NumReadable(size_t entry_size) const;
+
+ private:
+  static constexpr size_t BitmapSize(size_t entry_size) { return (Capacity(entry_size) - 1) / 8 + 1; }
+
+  const char *Bitmaps() const { return reinterpret_cast<const char *>(this) + HASH_BUCKET_PAGE_HEADER_SIZE; }
+  char *Bitmaps() { return reinterpret_cast<char *>(this) + HASH_BUCKET_PAGE_HEADER_SIZE; }
+
+  page_id_t page_id_;
+  // packed to keep the LSN where Page::GetLSN expects it, right after the page id
+  lsn_t lsn_ __attribute__((__packed__));
+};
+
 /**
  * Store indexed key and and value together within bucket page. Supports
  * non-unique keys.
@@ -30,12 +90,13 @@ namespace bustub {
  *  ----------------------------------------------------------------
  *
  *  Here '+' means concatenation.
- *  The above format omits the space required for the occupied_ and
- *  readable_ arrays. More information is in storage/page/hash_table_page_defs.h.
+ *  The above format omits the header and the space required for the occupied
+ *  and readable bitmaps, see HashTableBucketPageBase. More information is in
+ *  storage/page/hash_table_page_defs.h.
  *
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
-class HashTableBucketPage {
+class HashTableBucketPage : public HashTableBucketPageBase {
  public:
   // Delete all constructor / destructor to ensure memory safety
   HashTableBucketPage() = delete;
@@ -53,16 +114,18 @@ class HashTableBucketPage {
    *
    * @param key key to insert
    * @param value value to insert
+   * @param[out] bucket_idx if not null, set to the index the pair was inserted at
    * @return true if inserted, false if duplicate KV pair or bucket is full
    */
-  bool Insert(KeyType key, ValueType value, KeyComparator cmp);
+  bool Insert(KeyType key, ValueType value, KeyComparator cmp, uint32_t *bucket_idx = nullptr);
 
   /**
    * Removes a key and value.
    *
+   * @param[out] bucket_idx if not null, set to the index the pair was removed from
    * @return true if removed, false if not found
    */
-  bool Remove(KeyType key, ValueType value, KeyComparator cmp);
+  bool Remove(KeyType key, ValueType value, KeyComparator cmp, uint32_t *bucket_idx = nullptr);
 
   /**
    * Gets the key at an index in the bucket.
@@ -136,13 +199,6 @@ class HashTableBucketPage {
    * Prints the bucket's occupancy information
    */
   void PrintBucket();
-
- private:
-  //  For more on BUCKET_ARRAY_SIZE see storage/page/hash_table_page_defs.h
-  char occupied_[(BUCKET_ARRAY_SIZE - 1) / 8 + 1];
-  // 0 if tombstone/brand new (never occupied), 1 otherwise.
-  char readable_[(BUCKET_ARRAY_SIZE - 1) / 8 + 1];
-  MappingType array_[1];
 };
 
 }  // namespace bustub
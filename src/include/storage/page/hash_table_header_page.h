@@ -26,9 +26,9 @@ namespace bustub {
  *
  * Header Page for linear probing hash table.
  *
- * Header format (size in byte, 16 bytes in total):
+ * Header format (size in byte, 20 bytes in total):
  * -------------------------------------------------------------
- * | LSN (4) | Size (4) | PageId(4) | NextBlockIndex(4)
+ * | LSN (8) | Size (4) | PageId(4) | NextBlockIndex(4)
  * -------------------------------------------------------------
  */
 class HashTableHeaderPage {
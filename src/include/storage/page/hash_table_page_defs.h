@@ -33,12 +33,14 @@
  */
 #define HASH_TABLE_BUCKET_TYPE HashTableBucketPage<KeyType, ValueType, KeyComparator>
 #define DIRECTORY_ARRAY_SIZE 512
+/** The page id and LSN at the start of every bucket page, see storage/page/hash_table_bucket_page.h. */
+#define HASH_BUCKET_PAGE_HEADER_SIZE 12
 
 /**
  * BUCKET_ARRAY_SIZE is the number of (key, value) pairs that can be stored in an extendible hashing bucket page.
  * It is an approximate calculation based on the size of MappingType (which is a std::pair of KeyType and ValueType).
- * For each key/value pair, we need two additional bits for occupied_ and readable_. 4 * (PAGE_SIZE - 4) / (4 * sizeof
- * (MappingType) + 1) = (PAGE_SIZE - 4)/(sizeof (MappingType) + 0.25) because 0.25 bytes = 2 bits is the space required
+ * For each key/value pair, we need two additional bits for occupied_ and readable_. 4 * (PAGE_SIZE - 12) / (4 * sizeof
+ * (MappingType) + 1) = (PAGE_SIZE - 12)/(sizeof (MappingType) + 0.25) because 0.25 bytes = 2 bits is the space required
  * to maintain the occupied and readable flags for a key value pair.
  */
-#define BUCKET_ARRAY_SIZE (4 * PAGE_SIZE / (4 * sizeof(MappingType) + 1))
+#define BUCKET_ARRAY_SIZE (HashTableBucketPageBase::Capacity(sizeof(MappingType)))
@@ -61,16 +61,21 @@ class Page {
   inline void RUnlatch() { rwlatch_.RUnlock(); }
 
   /** @return the page LSN. */
-  inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
+  inline lsn_t GetLSN() {
+    lsn_t lsn;
+    // The LSN follows the 4 byte page id, so it is not aligned.
+    memcpy(&lsn, GetData() + OFFSET_LSN, sizeof(lsn_t));
+    return lsn;
+  }
 
   /** Sets the page LSN. */
   inline void SetLSN(lsn_t lsn) { memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t)); }
 
  protected:
   static_assert(sizeof(page_id_t) == 4);
-  static_assert(sizeof(lsn_t) == 4);
+  static_assert(sizeof(lsn_t) == 8);
 
-  static constexpr size_t SIZE_PAGE_HEADER = 8;
+  static constexpr size_t SIZE_PAGE_HEADER = 12;
   static constexpr size_t OFFSET_PAGE_START = 0;
   static constexpr size_t OFFSET_LSN = 4;
 
@@ -86,6 +91,11 @@ class Page {
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
+  /**
+   * The recovery LSN of this page: no log record older than it describes a change that is missing on disk. Set when
+   * a clean page gets pinned, so it is INVALID_LSN only while the page is clean and unpinned (or logging is off).
+   */
+  lsn_t rec_lsn_ = INVALID_LSN;
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
 };
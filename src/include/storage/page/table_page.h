@@ -34,7 +34,7 @@ namespace bustub {
  *
  *  Header format (size in bytes):
  *  ----------------------------------------------------------------------------
- *  | PageId (4)| LSN (4)| PrevPageId (4)| NextPageId (4)| FreeSpacePointer(4) |
+ *  | PageId (4)| LSN (8)| PrevPageId (4)| NextPageId (4)| FreeSpacePointer(4) |
  *  ----------------------------------------------------------------------------
  *  ----------------------------------------------------------------
  *  | TupleCount (4) | Tuple_1 offset (4) | Tuple_1 size (4) | ... |
@@ -79,9 +79,11 @@ class TablePage : public Page {
    * @param txn transaction performing the insert
    * @param lock_manager the lock manager
    * @param log_manager the log manager
+   * @param oid the table the page belongs to, which the tuple is locked under
    * @return true if the insert is successful (i.e. there is enough space)
    */
-  bool InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager);
+  bool InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager,
+                   table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Mark a tuple as deleted. This does not actually delete the tuple.
@@ -89,9 +91,11 @@ class TablePage : public Page {
    * @param txn transaction performing the delete
    * @param lock_manager the lock manager
    * @param log_manager the log manager
+   * @param oid the table the page belongs to, which the tuple is locked under
    * @return true if marking the tuple as deleted is successful (i.e the tuple exists)
    */
-  bool MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager);
+  bool MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager,
+                  table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Update a tuple.
@@ -101,10 +105,11 @@ class TablePage : public Page {
    * @param txn transaction performing the update
    * @param lock_manager the lock manager
    * @param log_manager the log manager
+   * @param oid the table the page belongs to, which the tuple is locked under
    * @return true if updating the tuple succeeded
    */
   bool UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID &rid, Transaction *txn,
-                   LockManager *lock_manager, LogManager *log_manager);
+                   LockManager *lock_manager, LogManager *log_manager, table_oid_t oid = INVALID_TABLE_OID);
 
   /** To be called on commit or abort. Actually perform the delete or rollback an insert. */
   void ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
@@ -118,36 +123,48 @@ class TablePage : public Page {
    * @param[out] tuple the tuple that was read
    * @param txn transaction performing the read
    * @param lock_manager the lock manager
+   * @param oid the table the page belongs to, which the tuple is locked under
    * @return true if the read is successful (i.e. the tuple exists)
    */
-  bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager);
+  bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager,
+                table_oid_t oid = INVALID_TABLE_OID);
+
+  /**
+   * Read a tuple from a table without locking it, as snapshot reads do.
+   * @param rid rid of the tuple to read
+   * @param[out] tuple the tuple that was read
+   * @return true if the tuple exists and is not marked as deleted
+   */
+  bool ReadTuple(const RID &rid, Tuple *tuple);
 
   /** @return the rid of the first tuple in this page */
 
   /**
    * @param[out] first_rid the RID of the first tuple in this page
+   * @param all_slots whether to stop at every slot, including those of deleted tuples
    * @return true if the first tuple exists, false otherwise
    */
-  bool GetFirstTupleRid(RID *first_rid);
+  bool GetFirstTupleRid(RID *first_rid, bool all_slots = false);
 
   /**
    * @param cur_rid the RID of the current tuple
    * @param[out] next_rid the RID of the tuple following the current tuple
+   * @param all_slots whether to stop at every slot, including those of deleted tuples
    * @return true if the next tuple exists, false otherwise
    */
-  bool GetNextTupleRid(const RID &cur_rid, RID *next_rid);
+  bool GetNextTupleRid(const RID &cur_rid, RID *next_rid, bool all_slots = false);
 
  private:
   static_assert(sizeof(page_id_t) == 4);
 
-  static constexpr size_t SIZE_TABLE_PAGE_HEADER = 24;
+  static constexpr size_t SIZE_TABLE_PAGE_HEADER = 28;
   static constexpr size_t SIZE_TUPLE = 8;
-  static constexpr size_t OFFSET_PREV_PAGE_ID = 8;
-  static constexpr size_t OFFSET_NEXT_PAGE_ID = 12;
-  static constexpr size_t OFFSET_FREE_SPACE = 16;
-  static constexpr size_t OFFSET_TUPLE_COUNT = 20;
-  static constexpr size_t OFFSET_TUPLE_OFFSET = 24;  // Naming things is hard.
-  static constexpr size_t OFFSET_TUPLE_SIZE = 28;
+  static constexpr size_t OFFSET_PREV_PAGE_ID = 12;
+  static constexpr size_t OFFSET_NEXT_PAGE_ID = 16;
+  static constexpr size_t OFFSET_FREE_SPACE = 20;
+  static constexpr size_t OFFSET_TUPLE_COUNT = 24;
+  static constexpr size_t OFFSET_TUPLE_OFFSET = 28;  // Naming things is hard.
+  static constexpr size_t OFFSET_TUPLE_SIZE = 32;
 
   /** @return pointer to the end of the current free space, see header comment */
   uint32_t GetFreeSpacePointer() { return *reinterpret_cast<uint32_t *>(GetData() + OFFSET_FREE_SPACE); }
@@ -14,7 +14,7 @@ namespace bustub {
  * TmpTuplePage format:
  *
  * Sizes are in bytes.
- * | PageId (4) | LSN (4) | FreeSpace (4) | (free space) | TupleSize2 | TupleData2 | TupleSize1 | TupleData1 |
+ * | PageId (4) | LSN (8) | FreeSpace (4) | (free space) | TupleSize2 | TupleData2 | TupleSize1 | TupleData1 |
  *
  * We choose this format because DeserializeExpression expects to read Size followed by Data.
  */
@@ -12,6 +12,10 @@
 
 #pragma once
 
+#include <deque>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+
 #include "buffer/buffer_pool_manager.h"
 #include "recovery/log_manager.h"
 #include "storage/page/table_page.h"
@@ -23,6 +27,11 @@ namespace bustub {
 /**
  * TableHeap represents a physical table on disk.
  * This is just a doubly-linked list of pages.
+ *
+ * The pages hold the newest value of every tuple. For the sake of SNAPSHOT_ISOLATION readers, the heap also keeps the
+ * values the pages held before, in memory: every write saves the value it overwrites, and the commit stamps the new
+ * value with the commit timestamp. Versions no snapshot reads anymore are dropped as transactions commit, or by
+ * GarbageCollect.
  */
 class TableHeap {
   friend class TableIterator;
@@ -36,9 +45,10 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param first_page_id the id of the first page
+   * @param oid the oid of the table, which its tuples are locked under
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            page_id_t first_page_id);
+            page_id_t first_page_id, table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Create a table heap with a transaction. (create table)
@@ -46,9 +56,10 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param txn the creating transaction
+   * @param oid the oid of the table, which its tuples are locked under
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            Transaction *txn);
+            Transaction *txn, table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Insert a tuple into the table. If the tuple is too large (>= page_size), return false.
@@ -99,6 +110,47 @@ class TableHeap {
    */
   bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn);
 
+  /**
+   * Lock the whole table, for an executor about to read or write its tuples. A SHARED or EXCLUSIVE lock covers the
+   * tuples, which are then not locked one by one; an intention lock is what the tuple locks take on the table anyway.
+   * Snapshot and optimistic transactions take no locks, and are let through.
+   * @param txn the transaction reading or writing the table
+   * @param mode the lock mode
+   * @return false if the lock was not granted, and the transaction aborted
+   */
+  bool LockTable(Transaction *txn, LockMode mode);
+
+  /**
+   * Called on commit: makes the write of the transaction to a tuple current from commit_ts on.
+   * @param rid rid of the written tuple
+   * @param txn the committing transaction
+   * @param commit_ts the commit timestamp of the transaction
+   */
+  void CommitVersion(const RID &rid, Transaction *txn, timestamp_t commit_ts);
+
+  /**
+   * Called on abort, after the rollback of the tuple: drops the version the write of the transaction saved.
+   * @param rid rid of the written tuple
+   * @param txn the aborting transaction
+   */
+  void AbortVersion(const RID &rid, Transaction *txn);
+
+  /**
+   * Drops the versions of a tuple that no snapshot at or after the watermark reads.
+   * @param rid rid of the tuple
+   * @param watermark the oldest read timestamp in use, see TransactionManager::GetWatermark
+   */
+  void PruneVersions(const RID &rid, timestamp_t watermark);
+
+  /**
+   * Drops the versions of every tuple that no snapshot at or after the watermark reads.
+   * @param watermark the oldest read timestamp in use, see TransactionManager::GetWatermark
+   */
+  void GarbageCollect(timestamp_t watermark);
+
+  /** @return the number of old tuple versions kept */
+  size_t GetVersionCount();
+
   /** @return the begin iterator of this table */
   TableIterator Begin(Transaction *txn);
 
@@ -108,11 +160,75 @@ class TableHeap {
   /** @return the id of the first page of this table */
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
+  /** @return the oid of this table, INVALID_TABLE_OID if its tuples are locked without it */
+  inline table_oid_t GetTableOid() const { return oid_; }
+
  private:
+  /** A value a tuple had from the commit with timestamp begin_ts_ on; deleted_ if there was no tuple. */
+  struct TupleVersion {
+    timestamp_t begin_ts_;
+    bool deleted_;
+    Tuple tuple_;
+  };
+
+  /**
+   * The versions of a tuple besides the one on its page. The page holds the value writer_ wrote and has not committed
+   * yet, or, if there is no writer, the value committed at head_ts_. Older values come newest first.
+   */
+  struct VersionChain {
+    txn_id_t writer_{INVALID_TXN_ID};
+    timestamp_t head_ts_{0};
+    std::deque<TupleVersion> versions_;
+  };
+
+  /**
+   * First updater wins: a snapshot transaction may not write a tuple that another transaction has written and not
+   * committed yet, or has committed after the snapshot was taken. Called with the page latched.
+   * @return true if the transaction may write the tuple
+   */
+  bool CheckWriteConflict(const RID &rid, Transaction *txn);
+
+  /**
+   * Saves the value a write is about to overwrite, unless the transaction has written the tuple before. Called with
+   * the page latched.
+   * @param old_tuple the value on the page, nullptr if there is no tuple
+   */
+  void SaveVersion(const RID &rid, Transaction *txn, const Tuple *old_tuple);
+
+  /**
+   * Picks the version of a tuple that the snapshot of the transaction sees. Called with the page latched.
+   * @param[in,out] tuple the value on the page on entry, the visible value on return
+   * @param on_page whether the page holds a tuple
+   * @return true if the transaction sees a tuple
+   */
+  bool ReadVersion(const RID &rid, Transaction *txn, Tuple *tuple, bool on_page);
+
+  /**
+   * Buffers an update or delete of an OPTIMISTIC transaction, to be applied at commit.
+   * @return true if the transaction sees the tuple
+   */
+  bool BufferWrite(const RID &rid, WType wtype, const Tuple &tuple, Transaction *txn);
+
+  /**
+   * Snapshot reads and the reads of an OPTIMISTIC transaction take no locks, and pick a version with ReadVersion.
+   * They also see tuples deleted since, so scans have to stop at every slot.
+   */
+  static bool ReadsVersions(Transaction *txn) {
+    return txn != nullptr && (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION || txn->InReadPhase());
+  }
+
+  /** Drops the versions older than the one current at the watermark; the caller holds version_latch_. */
+  static void PruneChain(VersionChain *chain, timestamp_t watermark);
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  table_oid_t oid_;
+
+  /** The version chains of the tuples written since the watermark, by rid. */
+  std::unordered_map<RID, VersionChain> version_chains_;
+  std::mutex version_latch_;
 };
 
 }  // namespace bustub
@@ -56,6 +56,12 @@ class TableIterator {
   }
 
  private:
+  /**
+   * Moves to the next slot that holds a tuple, or to the end of the table.
+   * @return false if the slot holds no tuple the transaction sees
+   */
+  bool Advance();
+
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
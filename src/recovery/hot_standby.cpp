@@ -0,0 +1,104 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hot_standby.cpp
+//
+// Identification: src/recovery/hot_standby.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/hot_standby.h"
+
+#include "common/exception.h"
+#include "common/logger.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+HotStandby::HotStandby(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager,
+                       bool from_checkpoint)
+    : disk_manager_(disk_manager),
+      log_manager_(log_manager),
+      log_recovery_(disk_manager, buffer_pool_manager) {
+  log_recovery_.TrackUncommittedWrites();
+  log_recovery_.BeginRedo(from_checkpoint);
+  disk_manager_->WriteRetentionRecord(log_recovery_.GetRetainOffset());
+}
+
+HotStandby::~HotStandby() {
+  Stop();
+  if (!promoted_) {
+    log_recovery_.EndRedo();
+    disk_manager_->DropRetentionRecord();
+  }
+}
+
+void HotStandby::Start() {
+  BUSTUB_ASSERT(!promoted_, "A promoted standby does not replay");
+  if (replay_thread_ != nullptr) {
+    return;
+  }
+  replaying_ = true;
+  replay_thread_ = new std::thread(&HotStandby::RunReplay, this);
+}
+
+void HotStandby::Stop() {
+  if (replay_thread_ == nullptr) {
+    return;
+  }
+  replaying_ = false;
+  replay_thread_->join();
+  delete replay_thread_;
+  replay_thread_ = nullptr;
+}
+
+lsn_t HotStandby::CatchUp() {
+  BUSTUB_ASSERT(!enable_logging, "Replaying the log of another database while logging");
+  BUSTUB_ASSERT(!promoted_, "A promoted standby does not replay");
+  // The primary may have started new segments since, or released old ones.
+  disk_manager_->RefreshLogSize();
+  // Reading released log fails like reading past its end, which would stall replay for good without a word.
+  if (log_recovery_.GetRedoOffset() < disk_manager_->GetLogStart()) {
+    throw Exception("The log the standby has to replay next has been released");
+  }
+  replay_latch_.WLock();
+  replayed_lsn_ = log_recovery_.RedoAvailableLog();
+  replay_latch_.WUnlock();
+  disk_manager_->WriteRetentionRecord(log_recovery_.GetRetainOffset());
+  return replayed_lsn_;
+}
+
+void HotStandby::RunReplay() {
+  while (replaying_) {
+    const lsn_t replayed_lsn = replayed_lsn_;
+    lsn_t caught_up_lsn;
+    try {
+      caught_up_lsn = CatchUp();
+    } catch (Exception &e) {
+      LOG_ERROR("Standby replay stopped: %s", e.what());
+      return;
+    }
+    // Poll right away while there is more log to replay.
+    if (caught_up_lsn == replayed_lsn) {
+      std::this_thread::sleep_for(standby_poll_interval);
+    }
+  }
+}
+
+lsn_t HotStandby::Promote() {
+  Stop();
+  const lsn_t last_lsn = CatchUp();
+  log_recovery_.EndRedo();
+  // The log is the standby's own from now on, released by its own checkpoints.
+  disk_manager_->DropRetentionRecord();
+  log_recovery_.ResumeLog(log_manager_);
+  log_recovery_.Undo();
+  promoted_ = true;
+  LOG_INFO("Promoted the standby after LSN %ld", static_cast<int64_t>(last_lsn));
+  return last_lsn;
+}
+
+}  // namespace bustub
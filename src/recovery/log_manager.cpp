@@ -12,7 +12,19 @@
 
 #include "recovery/log_manager.h"
 
+#include "common/macros.h"
+
 namespace bustub {
+
+namespace {
+/** Raises *target to value if value is larger. */
+void AtomicMax(std::atomic<uint64_t> *target, uint64_t value) {
+  uint64_t current = target->load();
+  while (current < value && !target->compare_exchange_weak(current, value)) {
+  }
+}
+}  // namespace
+
 /*
  * set enable_logging = true
  * Start a separate thread to execute flush to disk operation periodically
@@ -22,33 +34,374 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  if (enable_logging) {
+    return;
+  }
+  enable_logging = true;
+  flush_thread_ = new std::thread([this] {
+    while (true) {
+      bool running;
+      {
+        std::unique_lock<std::mutex> guard(latch_);
+        cv_.wait_for(guard, log_timeout,
+                     [this] { return flush_requested_ || pending_commits_ > 0 || !enable_logging; });
+        // Group commit: give other committers until the end of the window to join the flush, unless the buffer is
+        // full or somebody forces the log.
+        if (pending_commits_ > 0) {
+          cv_.wait_until(guard, first_commit_arrival_ + group_commit_window,
+                         [this] { return flush_requested_ || !enable_logging; });
+        }
+        flush_requested_ = false;
+        running = enable_logging;
+      }
+      // A final flush on the way out drains whatever was appended before the thread was stopped.
+      FlushLogBuffer();
+      if (!running) {
+        break;
+      }
+    }
+  });
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  if (flush_thread_ == nullptr) {
+    enable_logging = false;
+    return;
+  }
+  {
+    std::scoped_lock guard(latch_);
+    enable_logging = false;
+  }
+  cv_.notify_one();
+  flush_thread_->join();
+  delete flush_thread_;
+  flush_thread_ = nullptr;
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
  *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
+ * The record reserves its LSN and its range in the active buffer with one fetch-add on reservation_. A reservation
+ * that does not fit into the buffer still consumes an LSN, which is simply never used; the appender wakes up the
+ * flush thread, waits for the buffers to be swapped and tries again with a fresh reservation.
  */
-lsn_t LogManager::AppendLogRecord(LogRecord *log_record) { return INVALID_LSN; }
+lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
+  const auto size = static_cast<uint32_t>(log_record->GetSize());
+  BUSTUB_ASSERT(size <= static_cast<uint32_t>(LOG_BUFFER_SIZE), "Log record does not fit into the log buffer.");
+
+  while (true) {
+    const uint64_t reservation = reservation_.fetch_add(RESERVATION_COUNT_ONE + size, std::memory_order_acq_rel);
+    const uint32_t epoch = EpochOf(reservation);
+    const uint32_t buffer = epoch & 1;
+    const uint32_t offset = OffsetOf(reservation);
+
+    if (offset + size <= static_cast<uint32_t>(LOG_BUFFER_SIZE)) {
+      log_record->lsn_ = base_lsn_[buffer] + CountOf(reservation);
+      SerializeLogRecord(log_record, log_buffers_[buffer] + offset);
+      finished_[buffer].fetch_add(1, std::memory_order_release);
+      return log_record->lsn_;
+    }
+
+    // Exactly one reservation straddles the end of the buffer; it marks where the filled prefix ends.
+    if (offset <= static_cast<uint32_t>(LOG_BUFFER_SIZE)) {
+      overflow_offset_[buffer] = offset;
+    }
+    finished_[buffer].fetch_add(1, std::memory_order_release);
+
+    std::unique_lock<std::mutex> guard(latch_);
+    flush_requested_ = true;
+    cv_.notify_one();
+    if (!enable_logging) {
+      // Nobody is running the flush thread, so swap the buffers ourselves.
+      guard.unlock();
+      FlushLogBuffer();
+      continue;
+    }
+    flushed_cv_.wait(guard, [&] { return EpochOf(reservation_.load()) != epoch; });
+  }
+}
+
+void LogManager::Flush() {
+  const lsn_t target = GetNextLSN() - 1;
+  if (!enable_logging) {
+    while (persistent_lsn_ < target) {
+      FlushLogBuffer();
+    }
+    return;
+  }
+  std::unique_lock<std::mutex> guard(latch_);
+  while (persistent_lsn_ < target) {
+    flush_requested_ = true;
+    cv_.notify_one();
+    flushed_cv_.wait(guard);
+  }
+}
+
+void LogManager::WaitUntilPersistent(lsn_t lsn) {
+  const auto start = std::chrono::steady_clock::now();
+  if (persistent_lsn_ >= lsn) {
+    // Somebody else's flush already covered us.
+  } else if (!enable_logging) {
+    Flush();
+  } else {
+    std::unique_lock<std::mutex> guard(latch_);
+    if (persistent_lsn_ < lsn) {
+      if (pending_commits_++ == 0) {
+        first_commit_arrival_ = start;
+        cv_.notify_one();
+      }
+      flushed_cv_.wait(guard, [&] { return persistent_lsn_ >= lsn; });
+    }
+  }
+  const auto wait_us = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+  num_commits_++;
+  total_commit_wait_us_ += wait_us;
+  AtomicMax(&max_commit_wait_us_, wait_us);
+}
+
+GroupCommitStats LogManager::GetGroupCommitStats() {
+  GroupCommitStats stats;
+  stats.num_batches_ = num_commit_batches_;
+  stats.num_commits_ = num_commits_;
+  stats.max_batch_size_ = max_commit_batch_size_;
+  stats.total_wait_us_ = total_commit_wait_us_;
+  stats.max_wait_us_ = max_commit_wait_us_;
+  return stats;
+}
+
+int64_t LogManager::GetLogOffset(lsn_t lsn) {
+  std::scoped_lock guard(latch_);
+  auto it = buffer_offsets_.upper_bound(lsn);
+  if (it == buffer_offsets_.begin()) {
+    return 0;
+  }
+  return std::prev(it)->second;
+}
+
+void LogManager::DiscardLogOffsets(lsn_t lsn) {
+  std::scoped_lock guard(latch_);
+  auto it = buffer_offsets_.upper_bound(lsn);
+  if (it != buffer_offsets_.begin()) {
+    // Keep the buffer that contains lsn itself.
+    buffer_offsets_.erase(buffer_offsets_.begin(), std::prev(it));
+  }
+}
+
+lsn_t LogManager::GetNextLSN() {
+  const uint64_t reservation = reservation_.load();
+  return base_lsn_[EpochOf(reservation) & 1] + CountOf(reservation);
+}
+
+void LogManager::ResumeLog(lsn_t next_lsn) {
+  std::scoped_lock flush_guard(flush_latch_);
+  const uint64_t reservation = reservation_.load();
+  BUSTUB_ASSERT(CountOf(reservation) == 0 && OffsetOf(reservation) == 0, "Resuming a log after appending to it");
+  base_lsn_[EpochOf(reservation) & 1] = next_lsn;
+  persistent_lsn_ = next_lsn - 1;
+  log_end_offset_ = disk_manager_->GetLogSize();
+}
+
+void LogManager::FlushLogBuffer() {
+  std::scoped_lock flush_guard(flush_latch_);
+
+  // Seal the active buffer by moving every future reservation over to the other one.
+  uint64_t reservation = reservation_.load();
+  uint64_t next_reservation;
+  uint32_t buffer;
+  uint32_t count;
+  do {
+    count = CountOf(reservation);
+    if (count == 0) {
+      // Commits that registered after the previous seal but were already covered by it must not keep the flush
+      // thread spinning on an empty buffer.
+      std::scoped_lock guard(latch_);
+      pending_commits_ = 0;
+      return;
+    }
+    const uint32_t epoch = EpochOf(reservation);
+    buffer = epoch & 1;
+    // The other buffer was written out by the previous call, so nobody can be using it any more.
+    base_lsn_[buffer ^ 1] = base_lsn_[buffer] + count;
+    finished_[buffer ^ 1].store(0, std::memory_order_relaxed);
+    next_reservation = static_cast<uint64_t>((epoch + 1) & 0xFF) << RESERVATION_EPOCH_SHIFT;
+  } while (!reservation_.compare_exchange_weak(reservation, next_reservation, std::memory_order_acq_rel));
+
+  // The commits waiting so far are covered by the sealed buffer and form this flush's batch.
+  uint64_t batch_size;
+  {
+    // Also releases the appenders that overflowed the sealed buffer.
+    std::scoped_lock guard(latch_);
+    batch_size = pending_commits_;
+    pending_commits_ = 0;
+  }
+  flushed_cv_.notify_all();
+  if (batch_size > 0) {
+    num_commit_batches_++;
+    AtomicMax(&max_commit_batch_size_, batch_size);
+  }
+
+  // Only the prefix of the sealed buffer is written, and only once every reservation in it has been filled.
+  while (finished_[buffer].load(std::memory_order_acquire) != count) {
+    std::this_thread::yield();
+  }
+  const uint32_t offset = OffsetOf(reservation);
+  const uint32_t size = offset <= static_cast<uint32_t>(LOG_BUFFER_SIZE) ? offset : overflow_offset_[buffer];
+  StampSegments(log_buffers_[buffer], size);
+  disk_manager_->WriteLog(log_buffers_[buffer], static_cast<int>(size));
+
+  {
+    std::scoped_lock guard(latch_);
+    buffer_offsets_.emplace(base_lsn_[buffer], log_end_offset_);
+    persistent_lsn_ = base_lsn_[buffer] + static_cast<lsn_t>(count) - 1;
+  }
+  log_end_offset_ += size;
+  flushed_cv_.notify_all();
+}
+
+/*
+ * Walks the records of a sealed buffer, which only now has its place in the log, and writes the number of the segment
+ * each of them starts in into its header.
+ */
+void LogManager::StampSegments(char *buffer, uint32_t size) {
+  const int64_t log_offset = disk_manager_->GetLogSize();
+  const int segment_size = disk_manager_->GetLogSegmentSize();
+  uint32_t record = 0;
+  while (record < size) {
+    const char *pos = buffer + record;
+    uint64_t record_size;
+    const bool decoded = VarintUtil::Decode(&pos, buffer + size, &record_size);
+    BUSTUB_ASSERT(decoded && record_size > 0, "Log buffer holds something else than log records.");
+    const auto segment = static_cast<uint32_t>((log_offset + record) / segment_size);
+    memcpy(buffer + (pos - buffer) + 1 + sizeof(lsn_t), &segment, sizeof(uint32_t));
+    record += static_cast<uint32_t>(record_size);
+  }
+}
+
+/*
+ * Serialize the must have fields followed by the body of the record, see log_record.h for the layout of each record
+ * type. Exactly log_record->GetSize() bytes are written.
+ */
+void LogManager::SerializeLogRecord(LogRecord *log_record, char *dest) {
+  char *pos = VarintUtil::Encode(log_record->size_, dest);
+  *pos++ = static_cast<char>(log_record->log_record_type_);
+  memcpy(pos, &log_record->lsn_, sizeof(lsn_t));
+  pos += sizeof(lsn_t);
+  // the segment is filled in by StampSegments
+  memset(pos, 0, sizeof(uint32_t));
+  pos += sizeof(uint32_t);
+  pos = VarintUtil::EncodeSigned(log_record->txn_id_, pos);
+  pos = VarintUtil::EncodeSigned(log_record->prev_lsn_, pos);
+
+  auto serialize_rid = [&pos](const RID &rid) {
+    pos = VarintUtil::EncodeSigned(rid.GetPageId(), pos);
+    pos = VarintUtil::Encode(rid.GetSlotNum(), pos);
+  };
+  auto serialize_tuple = [&pos](const Tuple &tuple) {
+    pos = VarintUtil::Encode(tuple.GetLength(), pos);
+    memcpy(pos, tuple.GetData(), tuple.GetLength());
+    pos += tuple.GetLength();
+  };
+
+  // A compensation log record carries the body of the record it undid.
+  LogRecordType body_type = log_record->log_record_type_;
+  if (body_type == LogRecordType::CLR) {
+    pos = VarintUtil::EncodeSigned(log_record->undo_next_lsn_, pos);
+    *pos++ = static_cast<char>(log_record->undone_type_);
+    body_type = log_record->undone_type_;
+  }
+
+  switch (body_type) {
+    case LogRecordType::INSERT:
+      serialize_rid(log_record->insert_rid_);
+      serialize_tuple(log_record->insert_tuple_);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      serialize_rid(log_record->delete_rid_);
+      serialize_tuple(log_record->delete_tuple_);
+      break;
+    case LogRecordType::UPDATE: {
+      const Tuple &old_tuple = log_record->old_tuple_;
+      const Tuple &new_tuple = log_record->new_tuple_;
+      serialize_rid(log_record->update_rid_);
+      pos = VarintUtil::Encode(old_tuple.GetLength(), pos);
+      pos = VarintUtil::Encode(new_tuple.GetLength(), pos);
+      if (old_tuple.GetLength() != new_tuple.GetLength()) {
+        memcpy(pos, old_tuple.GetData(), old_tuple.GetLength());
+        pos += old_tuple.GetLength();
+        memcpy(pos, new_tuple.GetData(), new_tuple.GetLength());
+        pos += new_tuple.GetLength();
+        break;
+      }
+      pos = VarintUtil::Encode(log_record->update_ranges_.size(), pos);
+      uint32_t range_end = 0;
+      for (const auto &[offset, length] : log_record->update_ranges_) {
+        pos = VarintUtil::Encode(offset - range_end, pos);
+        pos = VarintUtil::Encode(length, pos);
+        memcpy(pos, old_tuple.GetData() + offset, length);
+        pos += length;
+        memcpy(pos, new_tuple.GetData() + offset, length);
+        pos += length;
+        range_end = offset + length;
+      }
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      pos = VarintUtil::EncodeSigned(log_record->prev_page_id_, pos);
+      pos = VarintUtil::EncodeSigned(log_record->page_id_, pos);
+      break;
+    case LogRecordType::CHECKPOINT_END:
+      pos = VarintUtil::EncodeSigned(log_record->redo_lsn_, pos);
+      pos = VarintUtil::Encode(log_record->scan_offset_, pos);
+      pos = VarintUtil::Encode(log_record->active_txns_.size(), pos);
+      for (const auto &[txn_id, last_lsn] : log_record->active_txns_) {
+        pos = VarintUtil::EncodeSigned(txn_id, pos);
+        pos = VarintUtil::EncodeSigned(last_lsn, pos);
+      }
+      pos = VarintUtil::Encode(log_record->dirty_pages_.size(), pos);
+      for (const auto &[page_id, rec_lsn] : log_record->dirty_pages_) {
+        pos = VarintUtil::EncodeSigned(page_id, pos);
+        pos = VarintUtil::EncodeSigned(rec_lsn, pos);
+      }
+      break;
+    case LogRecordType::BTREE_INSERT:
+    case LogRecordType::BTREE_DELETE:
+    case LogRecordType::HASH_INSERT:
+    case LogRecordType::HASH_DELETE:
+      pos = VarintUtil::Encode(log_record->index_id_, pos);
+      pos = VarintUtil::EncodeSigned(log_record->page_id_, pos);
+      pos = VarintUtil::Encode(log_record->slot_, pos);
+      pos = VarintUtil::Encode(log_record->index_data_.size(), pos);
+      memcpy(pos, log_record->index_data_.data(), log_record->index_data_.size());
+      pos += log_record->index_data_.size();
+      break;
+    case LogRecordType::INDEX_PAGE_WRITE: {
+      pos = VarintUtil::EncodeSigned(log_record->page_id_, pos);
+      pos = VarintUtil::Encode(log_record->update_ranges_.size(), pos);
+      const char *data = log_record->index_data_.data();
+      uint32_t range_end = 0;
+      for (const auto &[offset, length] : log_record->update_ranges_) {
+        pos = VarintUtil::Encode(offset - range_end, pos);
+        pos = VarintUtil::Encode(length, pos);
+        memcpy(pos, data, length);
+        pos += length;
+        data += length;
+        range_end = offset + length;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  BUSTUB_ASSERT(pos == dest + log_record->size_, "Log record size does not match its serialization.");
+}
 
 }  // namespace bustub
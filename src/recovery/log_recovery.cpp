@@ -12,6 +12,15 @@
 
 #include "recovery/log_recovery.h"
 
+#include <future>  // NOLINT
+#include <queue>
+#include <type_traits>
+#include <unordered_set>
+
+#include "common/logger.h"
+#include "storage/page/b_plus_tree_page.h"
+#include "storage/page/hash_table_bucket_page.h"
+#include "storage/page/header_page.h"
 #include "storage/page/table_page.h"
 
 namespace bustub {
@@ -19,8 +28,226 @@ namespace bustub {
  * deserialize a log record from log buffer
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
+ *
+ * The caller must make sure that the whole record, as announced by the size field, is readable at data, which was
+ * read from offset in the log.
  */
-bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) { return false; }
+bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record, int64_t offset) {
+  const int32_t size = PeekLogRecordSize(data, LogRecord::MIN_SIZE);
+  if (size <= 0) {
+    // Zeroed space past the end of the log, or a torn write.
+    return false;
+  }
+  const char *end = data + size;
+  const char *pos = data + VarintUtil::Size(size);
+  const auto type = static_cast<LogRecordType>(*pos++);
+  if (type <= LogRecordType::INVALID || type > LogRecordType::CLR) {
+    return false;
+  }
+
+  // Every field is bounds checked against the size of the record, so that garbage cannot be read as a record.
+  bool ok = true;
+  auto read_unsigned = [&](auto *value) {
+    uint64_t result = 0;
+    ok = ok && VarintUtil::Decode(&pos, end, &result);
+    *value = static_cast<std::remove_pointer_t<decltype(value)>>(result);
+  };
+  auto read_signed = [&](auto *value) {
+    int64_t result = 0;
+    ok = ok && VarintUtil::DecodeSigned(&pos, end, &result);
+    *value = static_cast<std::remove_pointer_t<decltype(value)>>(result);
+  };
+  auto read_bytes = [&](char *dest, uint32_t length) {
+    ok = ok && length <= static_cast<size_t>(end - pos);
+    if (ok) {
+      memcpy(dest, pos, length);
+      pos += length;
+    }
+  };
+  auto read_rid = [&](RID *rid) {
+    page_id_t page_id;
+    uint32_t slot_num;
+    read_signed(&page_id);
+    read_unsigned(&slot_num);
+    rid->Set(page_id, slot_num);
+  };
+  // Tuple::DeserializeFrom expects the size right in front of the data.
+  auto make_tuple = [](Tuple *tuple, std::vector<char> *storage) {
+    const auto length = static_cast<uint32_t>(storage->size() - sizeof(uint32_t));
+    memcpy(storage->data(), &length, sizeof(uint32_t));
+    tuple->DeserializeFrom(storage->data());
+  };
+  auto read_tuple = [&](Tuple *tuple) {
+    uint32_t length = 0;
+    read_unsigned(&length);
+    if (!ok || length > static_cast<size_t>(end - pos)) {
+      ok = false;
+      return;
+    }
+    std::vector<char> storage(sizeof(uint32_t) + length);
+    read_bytes(storage.data() + sizeof(uint32_t), length);
+    make_tuple(tuple, &storage);
+  };
+
+  log_record->size_ = size;
+  log_record->log_record_type_ = type;
+  memcpy(&log_record->lsn_, pos, sizeof(lsn_t));
+  pos += sizeof(lsn_t);
+  // Anything else was left behind by what the segment used to be before it was recycled.
+  uint32_t segment;
+  memcpy(&segment, pos, sizeof(uint32_t));
+  pos += sizeof(uint32_t);
+  if (segment != offset / disk_manager_->GetLogSegmentSize()) {
+    return false;
+  }
+  read_signed(&log_record->txn_id_);
+  read_signed(&log_record->prev_lsn_);
+
+  LogRecordType body_type = type;
+  if (type == LogRecordType::CLR) {
+    read_signed(&log_record->undo_next_lsn_);
+    if (!ok || pos == end) {
+      return false;
+    }
+    body_type = static_cast<LogRecordType>(*pos++);
+    if (body_type < LogRecordType::INSERT || body_type > LogRecordType::UPDATE) {
+      return false;
+    }
+    log_record->undone_type_ = body_type;
+  }
+
+  switch (body_type) {
+    case LogRecordType::INSERT:
+      read_rid(&log_record->insert_rid_);
+      read_tuple(&log_record->insert_tuple_);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      read_rid(&log_record->delete_rid_);
+      read_tuple(&log_record->delete_tuple_);
+      break;
+    case LogRecordType::UPDATE: {
+      read_rid(&log_record->update_rid_);
+      uint32_t old_length = 0;
+      uint32_t new_length = 0;
+      read_unsigned(&old_length);
+      read_unsigned(&new_length);
+      // A tuple always fits into a page, even if the record only holds a few bytes of it.
+      if (!ok || old_length > static_cast<uint32_t>(PAGE_SIZE) || new_length > static_cast<uint32_t>(PAGE_SIZE)) {
+        return false;
+      }
+      std::vector<char> old_storage(sizeof(uint32_t) + old_length);
+      std::vector<char> new_storage(sizeof(uint32_t) + new_length);
+      if (old_length != new_length) {
+        read_bytes(old_storage.data() + sizeof(uint32_t), old_length);
+        read_bytes(new_storage.data() + sizeof(uint32_t), new_length);
+      } else {
+        // Only the changed ranges are filled in, the rest of both tuples stays zero.
+        uint64_t range_count = 0;
+        read_unsigned(&range_count);
+        uint32_t range_end = 0;
+        for (uint64_t i = 0; ok && i < range_count; i++) {
+          uint32_t gap = 0;
+          uint32_t length = 0;
+          read_unsigned(&gap);
+          read_unsigned(&length);
+          const uint64_t offset = static_cast<uint64_t>(range_end) + gap;
+          if (!ok || offset + length > old_length) {
+            return false;
+          }
+          read_bytes(old_storage.data() + sizeof(uint32_t) + offset, length);
+          read_bytes(new_storage.data() + sizeof(uint32_t) + offset, length);
+          log_record->update_ranges_.emplace_back(offset, length);
+          range_end = offset + length;
+        }
+      }
+      make_tuple(&log_record->old_tuple_, &old_storage);
+      make_tuple(&log_record->new_tuple_, &new_storage);
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      read_signed(&log_record->prev_page_id_);
+      read_signed(&log_record->page_id_);
+      break;
+    case LogRecordType::CHECKPOINT_END: {
+      read_signed(&log_record->redo_lsn_);
+      read_unsigned(&log_record->scan_offset_);
+      uint64_t txn_count = 0;
+      read_unsigned(&txn_count);
+      for (uint64_t i = 0; ok && i < txn_count; i++) {
+        txn_id_t txn_id;
+        lsn_t last_lsn;
+        read_signed(&txn_id);
+        read_signed(&last_lsn);
+        log_record->active_txns_.emplace_back(txn_id, last_lsn);
+      }
+      uint64_t page_count = 0;
+      read_unsigned(&page_count);
+      for (uint64_t i = 0; ok && i < page_count; i++) {
+        page_id_t page_id;
+        lsn_t rec_lsn;
+        read_signed(&page_id);
+        read_signed(&rec_lsn);
+        log_record->dirty_pages_.emplace_back(page_id, rec_lsn);
+      }
+      break;
+    }
+    case LogRecordType::BTREE_INSERT:
+    case LogRecordType::BTREE_DELETE:
+    case LogRecordType::HASH_INSERT:
+    case LogRecordType::HASH_DELETE: {
+      read_unsigned(&log_record->index_id_);
+      read_signed(&log_record->page_id_);
+      read_unsigned(&log_record->slot_);
+      uint32_t entry_size = 0;
+      read_unsigned(&entry_size);
+      if (!ok || entry_size > static_cast<uint32_t>(PAGE_SIZE)) {
+        return false;
+      }
+      log_record->index_data_.resize(entry_size);
+      read_bytes(log_record->index_data_.data(), entry_size);
+      break;
+    }
+    case LogRecordType::INDEX_PAGE_WRITE: {
+      read_signed(&log_record->page_id_);
+      uint64_t range_count = 0;
+      read_unsigned(&range_count);
+      uint32_t range_end = 0;
+      for (uint64_t i = 0; ok && i < range_count; i++) {
+        uint32_t gap = 0;
+        uint32_t length = 0;
+        read_unsigned(&gap);
+        read_unsigned(&length);
+        const uint64_t offset = static_cast<uint64_t>(range_end) + gap;
+        if (!ok || offset + length > static_cast<uint64_t>(PAGE_SIZE)) {
+          return false;
+        }
+        const size_t data_size = log_record->index_data_.size();
+        log_record->index_data_.resize(data_size + length);
+        read_bytes(log_record->index_data_.data() + data_size, length);
+        log_record->update_ranges_.emplace_back(offset, length);
+        range_end = offset + length;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return ok && pos == end;
+}
+
+int32_t LogRecovery::PeekLogRecordSize(const char *data, size_t available) {
+  const char *pos = data;
+  uint64_t size;
+  if (!VarintUtil::Decode(&pos, data + std::min<size_t>(available, VarintUtil::Size(LOG_BUFFER_SIZE)), &size)) {
+    return available >= static_cast<size_t>(VarintUtil::Size(LOG_BUFFER_SIZE)) ? -1 : 0;
+  }
+  if (size < static_cast<uint64_t>(LogRecord::MIN_SIZE) || size > static_cast<uint64_t>(LOG_BUFFER_SIZE)) {
+    return -1;
+  }
+  return static_cast<int32_t>(size);
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
@@ -29,12 +256,571 @@ bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  BeginRedo();
+  RedoAvailableLog();
+  EndRedo();
+  ResumeLog(buffer_pool_manager_ == nullptr ? nullptr : buffer_pool_manager_->GetLogManager());
+}
+
+void LogRecovery::ResumeLog(LogManager *log_manager) {
+  disk_manager_->ResumeLogAt(offset_);
+  // A restarted log manager numbers its records from 0, which redo would take for the end of the log.
+  log_manager_ = log_manager;
+  if (log_manager_ != nullptr) {
+    log_manager_->ResumeLog(last_lsn_ + 1);
+  }
+}
+
+void LogRecovery::BeginRedo(bool from_checkpoint) {
+  active_txn_.clear();
+  txn_first_offsets_.clear();
+  lsn_mapping_.clear();
+  uncommitted_writes_.clear();
+  uncommitted_rids_.clear();
+  offset_ = 0;
+  last_lsn_ = INVALID_LSN;
+
+  // Records older than the last checkpoint only need to be redone if their page was dirty at the checkpoint and they
+  // are not older than its recLSN.
+  checkpoint_lsn_ = INVALID_LSN;
+  checkpoint_redo_lsn_ = INVALID_LSN;
+  checkpoint_dirty_pages_.clear();
+  LogRecord checkpoint_record;
+  if (from_checkpoint && ReadCheckpoint(&checkpoint_record)) {
+    offset_ = checkpoint_record.scan_offset_;
+    checkpoint_lsn_ = checkpoint_record.prev_lsn_;
+    checkpoint_redo_lsn_ = checkpoint_record.redo_lsn_;
+    checkpoint_dirty_pages_.insert(checkpoint_record.dirty_pages_.begin(), checkpoint_record.dirty_pages_.end());
+  }
+
+  // Every worker pins at most one page at a time, which leaves a frame for the reader to prefetch into.
+  const size_t pool_size = buffer_pool_manager_->GetPoolSize();
+  const size_t num_workers = std::min(num_redo_threads_, std::max<size_t>(pool_size, 2) - 1);
+  for (size_t i = 0; i < num_workers; i++) {
+    workers_.emplace_back(std::make_unique<RedoWorker>());
+    RedoWorker *worker = workers_.back().get();
+    worker->thread_ = std::thread([this, worker] { RunRedoWorker(worker); });
+  }
+}
+
+lsn_t LogRecovery::RedoAvailableLog() {
+  const size_t pool_size = buffer_pool_manager_->GetPoolSize();
+  auto read_chunk = [this](char *chunk, int64_t offset) {
+    return disk_manager_->ReadLog(chunk, RECOVERY_READ_SIZE, offset);
+  };
+  std::vector<char> chunk(RECOVERY_READ_SIZE);
+  std::vector<char> next_chunk(RECOVERY_READ_SIZE);
+  int64_t read_offset = offset_;
+  bool has_chunk = read_chunk(chunk.data(), read_offset);
+
+  // The unparsed bytes of the log starting at offset_; a record cut in two by a chunk boundary waits here for the
+  // rest of it.
+  std::vector<char> window;
+  std::vector<RedoTask> tasks;
+  bool end_of_log = false;
+  while (has_chunk && !end_of_log) {
+    // Read the next chunk while this one is parsed and handed out.
+    read_offset += RECOVERY_READ_SIZE;
+    auto next_read = std::async(std::launch::async, read_chunk, next_chunk.data(), read_offset);
+    window.insert(window.end(), chunk.begin(), chunk.end());
+
+    size_t pos = 0;
+    while (window.size() - pos >= static_cast<size_t>(LogRecord::MIN_SIZE)) {
+      const int32_t size = PeekLogRecordSize(window.data() + pos, window.size() - pos);
+      if (size > 0 && window.size() - pos < static_cast<size_t>(size)) {
+        break;
+      }
+      LogRecord log_record;
+      const int64_t record_offset = offset_ + static_cast<int64_t>(pos);
+      // LSNs only grow along the log, anything else is left over from an older, partially overwritten log.
+      if (!DeserializeLogRecord(window.data() + pos, &log_record, record_offset) || log_record.lsn_ <= last_lsn_) {
+        end_of_log = true;
+        break;
+      }
+      last_lsn_ = log_record.lsn_;
+      const txn_id_t txn_id = log_record.txn_id_;
+      lsn_mapping_[log_record.lsn_] = record_offset;
+      pos += size;
+
+      switch (log_record.log_record_type_) {
+        case LogRecordType::COMMIT:
+        case LogRecordType::ABORT:
+          active_txn_.erase(log_record.txn_id_);
+          if (auto it = uncommitted_rids_.find(log_record.txn_id_); it != uncommitted_rids_.end()) {
+            for (const RID &rid : it->second) {
+              auto &writes = uncommitted_writes_[rid];
+              writes.erase(std::remove_if(writes.begin(), writes.end(),
+                                          [&](const LogRecord &write) { return write.txn_id_ == it->first; }),
+                           writes.end());
+              if (writes.empty()) {
+                uncommitted_writes_.erase(rid);
+              }
+            }
+            uncommitted_rids_.erase(it);
+          }
+          break;
+        case LogRecordType::INSERT:
+          active_txn_[log_record.txn_id_] = log_record.lsn_;
+          if (track_uncommitted_) {
+            uncommitted_rids_[log_record.txn_id_].insert(log_record.insert_rid_);
+            uncommitted_writes_[log_record.insert_rid_].push_back(log_record);
+          }
+          if (NeedsRedo(log_record.insert_rid_.GetPageId(), log_record.lsn_)) {
+            tasks.push_back({log_record.insert_rid_.GetPageId(), std::move(log_record)});
+          }
+          break;
+        case LogRecordType::MARKDELETE:
+        case LogRecordType::APPLYDELETE:
+        case LogRecordType::ROLLBACKDELETE:
+          active_txn_[log_record.txn_id_] = log_record.lsn_;
+          if (track_uncommitted_) {
+            uncommitted_rids_[log_record.txn_id_].insert(log_record.delete_rid_);
+            uncommitted_writes_[log_record.delete_rid_].push_back(log_record);
+          }
+          if (NeedsRedo(log_record.delete_rid_.GetPageId(), log_record.lsn_)) {
+            tasks.push_back({log_record.delete_rid_.GetPageId(), std::move(log_record)});
+          }
+          break;
+        case LogRecordType::UPDATE:
+          active_txn_[log_record.txn_id_] = log_record.lsn_;
+          if (track_uncommitted_) {
+            uncommitted_rids_[log_record.txn_id_].insert(log_record.update_rid_);
+            uncommitted_writes_[log_record.update_rid_].push_back(log_record);
+          }
+          if (NeedsRedo(log_record.update_rid_.GetPageId(), log_record.lsn_)) {
+            tasks.push_back({log_record.update_rid_.GetPageId(), std::move(log_record)});
+          }
+          break;
+        case LogRecordType::CLR: {
+          active_txn_[log_record.txn_id_] = log_record.lsn_;
+          const page_id_t page_id = TablePageOf(log_record, log_record.undone_type_);
+          if (NeedsRedo(page_id, log_record.lsn_)) {
+            tasks.push_back({page_id, std::move(log_record)});
+          }
+          break;
+        }
+        case LogRecordType::NEWPAGE:
+          active_txn_[log_record.txn_id_] = log_record.lsn_;
+          // The new page is initialized, and the previous page of the heap gets linked to it.
+          if (log_record.prev_page_id_ != INVALID_PAGE_ID && NeedsRedo(log_record.prev_page_id_, log_record.lsn_)) {
+            tasks.push_back({log_record.prev_page_id_, log_record});
+          }
+          if (NeedsRedo(log_record.page_id_, log_record.lsn_)) {
+            tasks.push_back({log_record.page_id_, std::move(log_record)});
+          }
+          break;
+        case LogRecordType::BTREE_INSERT:
+        case LogRecordType::BTREE_DELETE:
+        case LogRecordType::HASH_INSERT:
+        case LogRecordType::HASH_DELETE:
+        case LogRecordType::INDEX_PAGE_WRITE:
+          // Structure modifications are logged outside of any transaction and are never undone.
+          if (log_record.txn_id_ != INVALID_TXN_ID) {
+            active_txn_[log_record.txn_id_] = log_record.lsn_;
+          }
+          if (NeedsRedo(log_record.page_id_, log_record.lsn_)) {
+            tasks.push_back({log_record.page_id_, std::move(log_record)});
+          }
+          break;
+        case LogRecordType::CHECKPOINT_BEGIN:
+        case LogRecordType::CHECKPOINT_END:
+          break;
+        default:
+          active_txn_[log_record.txn_id_] = log_record.lsn_;
+          break;
+      }
+      if (active_txn_.count(txn_id) != 0) {
+        txn_first_offsets_.emplace(txn_id, record_offset);
+      } else {
+        txn_first_offsets_.erase(txn_id);
+      }
+    }
+    window.erase(window.begin(), window.begin() + pos);
+    offset_ += static_cast<int64_t>(pos);
+
+    // Bring the pages of this chunk into the buffer pool ahead of the workers, without crowding out the pages they
+    // are still working on.
+    std::unordered_set<page_id_t> prefetched;
+    for (const auto &task : tasks) {
+      if (prefetched.size() >= pool_size / 2) {
+        break;
+      }
+      if (prefetched.insert(task.page_id_).second && buffer_pool_manager_->FetchPage(task.page_id_) != nullptr) {
+        buffer_pool_manager_->UnpinPage(task.page_id_, false);
+      }
+    }
+    for (auto &task : tasks) {
+      Dispatch(std::move(task));
+    }
+    tasks.clear();
+
+    has_chunk = next_read.get();
+    std::swap(chunk, next_chunk);
+  }
+
+  // Whatever follows offset_ is either not written yet or not a record, either way it is read again next time.
+  WaitForRedoWorkers();
+  return last_lsn_;
+}
+
+void LogRecovery::EndRedo() {
+  for (auto &worker : workers_) {
+    {
+      std::scoped_lock guard(worker->latch_);
+      worker->done_ = true;
+    }
+    worker->cv_.notify_all();
+  }
+  for (auto &worker : workers_) {
+    worker->thread_.join();
+  }
+  workers_.clear();
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
  *iterate through active txn map and undo each operation
+ *
+ * The records of all loser transactions are undone together, in reverse LSN order. Undoing a table record logs a
+ * compensation log record, so that an undo interrupted by a crash is repeated by redo and not undone twice: the
+ * undo after it skips the table records up to the undo next LSN of the transaction's last compensation log record.
+ * Index entries are undone logically and not logged, which is idempotent, so they are undone again either way.
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  std::priority_queue<lsn_t> to_undo;
+  for (const auto &[txn_id, lsn] : active_txn_) {
+    to_undo.push(lsn);
+  }
+  // The undo next LSN of the last compensation log record of each transaction, the newest one is met first.
+  std::unordered_map<txn_id_t, lsn_t> undo_next;
+  while (!to_undo.empty()) {
+    const lsn_t lsn = to_undo.top();
+    to_undo.pop();
+    auto it = lsn_mapping_.find(lsn);
+    if (it == lsn_mapping_.end() || !disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, it->second)) {
+      continue;
+    }
+    LogRecord log_record;
+    if (!DeserializeLogRecord(log_buffer_, &log_record, it->second) || log_record.lsn_ != lsn) {
+      continue;
+    }
+    if (log_record.log_record_type_ == LogRecordType::CLR) {
+      undo_next.emplace(log_record.txn_id_, log_record.undo_next_lsn_);
+    } else {
+      // Table records newer than the undo next LSN have been compensated already.
+      auto it = undo_next.find(log_record.txn_id_);
+      const bool compensated = it != undo_next.end() && lsn > it->second &&
+                               TablePageOf(log_record, log_record.log_record_type_) != INVALID_PAGE_ID;
+      if (!compensated) {
+        UndoRecord(&log_record);
+      }
+    }
+    if (log_record.log_record_type_ != LogRecordType::BEGIN && log_record.prev_lsn_ != INVALID_LSN) {
+      to_undo.push(log_record.prev_lsn_);
+    }
+  }
+  // The undo of index entries is not logged, so the pages it changed have to be on disk before an abort record keeps
+  // a later undo from reverting the transaction again, possibly over the records of a later transaction with the
+  // same id.
+  if (log_manager_ != nullptr && !active_txn_.empty()) {
+    buffer_pool_manager_->FlushAllPages();
+    for (const auto &[txn_id, lsn] : active_txn_) {
+      LogRecord abort_record(txn_id, lsn, LogRecordType::ABORT);
+      log_manager_->AppendLogRecord(&abort_record);
+    }
+    log_manager_->Flush();
+  }
+  active_txn_.clear();
+  txn_first_offsets_.clear();
+}
+
+int64_t LogRecovery::GetRetainOffset() const {
+  int64_t offset = offset_;
+  for (const auto &[txn_id, first_offset] : txn_first_offsets_) {
+    offset = std::min(offset, first_offset);
+  }
+  return offset;
+}
+
+bool LogRecovery::GetCommittedTuple(const RID &rid, Tuple *tuple, bool exists) const {
+  auto it = uncommitted_writes_.find(rid);
+  if (it == uncommitted_writes_.end()) {
+    return exists;
+  }
+  // Undo the writes in memory, the last one first.
+  for (auto write = it->second.rbegin(); write != it->second.rend(); ++write) {
+    switch (write->log_record_type_) {
+      case LogRecordType::INSERT:
+      case LogRecordType::ROLLBACKDELETE:
+        exists = false;
+        break;
+      case LogRecordType::MARKDELETE:
+      case LogRecordType::APPLYDELETE:
+        *tuple = write->delete_tuple_;
+        exists = true;
+        break;
+      case LogRecordType::UPDATE:
+        // The record may only hold the bytes that changed, the rest of the tuple comes from the newer version.
+        *tuple = write->UndoUpdate(*tuple);
+        break;
+      default:
+        break;
+    }
+  }
+  return exists;
+}
+
+bool LogRecovery::ReadCheckpoint(LogRecord *checkpoint_record) {
+  lsn_t checkpoint_lsn;
+  int64_t offset;
+  if (!disk_manager_->ReadMasterRecord(&checkpoint_lsn, &offset)) {
+    return false;
+  }
+  // The master record names the buffer the end record was flushed in, and a buffer never exceeds LOG_BUFFER_SIZE.
+  if (!disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, offset)) {
+    return false;
+  }
+  int pos = 0;
+  while (pos + LogRecord::MIN_SIZE <= LOG_BUFFER_SIZE) {
+    const int32_t size = PeekLogRecordSize(log_buffer_ + pos, LOG_BUFFER_SIZE - pos);
+    if (size <= 0 || pos + size > LOG_BUFFER_SIZE) {
+      return false;
+    }
+    LogRecord log_record;
+    if (!DeserializeLogRecord(log_buffer_ + pos, &log_record, offset + pos) || log_record.lsn_ > checkpoint_lsn) {
+      return false;
+    }
+    if (log_record.lsn_ == checkpoint_lsn) {
+      if (log_record.log_record_type_ != LogRecordType::CHECKPOINT_END) {
+        return false;
+      }
+      *checkpoint_record = log_record;
+      return true;
+    }
+    pos += size;
+  }
+  return false;
+}
+
+bool LogRecovery::NeedsRedo(page_id_t page_id, lsn_t lsn) const {
+  if (lsn >= checkpoint_lsn_) {
+    return true;
+  }
+  auto it = checkpoint_dirty_pages_.find(page_id);
+  return lsn >= checkpoint_redo_lsn_ && it != checkpoint_dirty_pages_.end() && lsn >= it->second;
+}
+
+void LogRecovery::Dispatch(RedoTask &&task) {
+  RedoWorker *worker = workers_[static_cast<size_t>(task.page_id_) % workers_.size()].get();
+  {
+    std::unique_lock<std::mutex> guard(worker->latch_);
+    worker->cv_.wait(guard, [worker] { return worker->tasks_.size() < RedoWorker::MAX_QUEUED_TASKS; });
+    worker->tasks_.push_back(std::move(task));
+  }
+  worker->cv_.notify_all();
+}
+
+void LogRecovery::RunRedoWorker(RedoWorker *worker) {
+  while (true) {
+    std::unique_lock<std::mutex> guard(worker->latch_);
+    worker->cv_.wait(guard, [worker] { return !worker->tasks_.empty() || worker->done_; });
+    if (worker->tasks_.empty()) {
+      return;
+    }
+    RedoTask task = std::move(worker->tasks_.front());
+    worker->tasks_.pop_front();
+    worker->busy_ = true;
+    guard.unlock();
+    worker->cv_.notify_all();
+    RedoPage(task);
+    guard.lock();
+    worker->busy_ = false;
+    guard.unlock();
+    worker->cv_.notify_all();
+  }
+}
+
+void LogRecovery::WaitForRedoWorkers() {
+  for (auto &worker : workers_) {
+    std::unique_lock<std::mutex> guard(worker->latch_);
+    worker->cv_.wait(guard, [&worker] { return worker->tasks_.empty() && !worker->busy_; });
+  }
+}
+
+void LogRecovery::RedoPage(const RedoTask &task) {
+  Page *page = FetchPage(task.page_id_);
+  auto *table_page = reinterpret_cast<TablePage *>(page);
+  const LogRecord &log_record = task.log_record_;
+  bool is_dirty = false;
+
+  if (log_record.log_record_type_ == LogRecordType::NEWPAGE && task.page_id_ != log_record.page_id_) {
+    // Linking the previous page is not logged on its own and so is not covered by its page LSN. It is idempotent
+    // though, since a table heap only ever links a page once.
+    if (table_page->GetNextPageId() == INVALID_PAGE_ID) {
+      table_page->SetNextPageId(log_record.page_id_);
+      is_dirty = true;
+    }
+  } else if (log_record.log_record_type_ == LogRecordType::NEWPAGE) {
+    // A page that never made it to disk reads back as zeros, whose LSN means nothing.
+    if (table_page->GetTablePageId() != log_record.page_id_ || page->GetLSN() < log_record.lsn_) {
+      table_page->Init(log_record.page_id_, PAGE_SIZE, log_record.prev_page_id_, nullptr, nullptr);
+      is_dirty = true;
+    }
+  } else if (log_record.log_record_type_ == LogRecordType::INDEX_PAGE_WRITE && task.page_id_ == HEADER_PAGE_ID) {
+    // The header page has no LSN. Writes to it only ever overwrite bytes though, so repeating them is harmless.
+    log_record.RedoPageWrite(page->GetData());
+    buffer_pool_manager_->UnpinPage(task.page_id_, true);
+    return;
+  } else if (page->GetLSN() < log_record.lsn_) {
+    RID rid;
+    Tuple old_tuple;
+    switch (log_record.log_record_type_) {
+      case LogRecordType::INSERT:
+        table_page->InsertTuple(log_record.insert_tuple_, &rid, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::MARKDELETE:
+        table_page->MarkDelete(log_record.delete_rid_, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::APPLYDELETE:
+        table_page->ApplyDelete(log_record.delete_rid_, nullptr, nullptr);
+        break;
+      case LogRecordType::ROLLBACKDELETE:
+        table_page->RollbackDelete(log_record.delete_rid_, nullptr, nullptr);
+        break;
+      case LogRecordType::UPDATE: {
+        // The record may only hold the bytes that changed, the rest of the tuple comes from the page.
+        Tuple tuple;
+        if (table_page->GetTuple(log_record.update_rid_, &tuple, nullptr, nullptr)) {
+          table_page->UpdateTuple(log_record.RedoUpdate(tuple), &old_tuple, log_record.update_rid_, nullptr, nullptr,
+                                  nullptr);
+        }
+        break;
+      }
+      case LogRecordType::BTREE_INSERT:
+        reinterpret_cast<BPlusTreePage *>(page->GetData())
+            ->InsertEntryAt(log_record.slot_, log_record.index_data_.data(), log_record.index_data_.size());
+        break;
+      case LogRecordType::BTREE_DELETE:
+        reinterpret_cast<BPlusTreePage *>(page->GetData())
+            ->RemoveEntryAt(log_record.slot_, log_record.index_data_.size());
+        break;
+      case LogRecordType::HASH_INSERT:
+        reinterpret_cast<HashTableBucketPageBase *>(page->GetData())
+            ->InsertEntryAt(log_record.slot_, log_record.index_data_.data(), log_record.index_data_.size());
+        break;
+      case LogRecordType::HASH_DELETE:
+        reinterpret_cast<HashTableBucketPageBase *>(page->GetData())
+            ->RemoveEntryAt(log_record.slot_, log_record.index_data_.size());
+        break;
+      case LogRecordType::INDEX_PAGE_WRITE:
+        log_record.RedoPageWrite(page->GetData());
+        break;
+      case LogRecordType::CLR:
+        UndoOnPage(table_page, log_record, log_record.undone_type_);
+        break;
+      default:
+        break;
+    }
+    is_dirty = true;
+  }
+
+  if (is_dirty && log_record.lsn_ > page->GetLSN()) {
+    page->SetLSN(log_record.lsn_);
+  }
+  buffer_pool_manager_->UnpinPage(task.page_id_, is_dirty);
+}
+
+page_id_t LogRecovery::TablePageOf(const LogRecord &log_record, LogRecordType type) {
+  switch (type) {
+    case LogRecordType::INSERT:
+      return log_record.insert_rid_.GetPageId();
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      return log_record.delete_rid_.GetPageId();
+    case LogRecordType::UPDATE:
+      return log_record.update_rid_.GetPageId();
+    default:
+      return INVALID_PAGE_ID;
+  }
+}
+
+void LogRecovery::UndoOnPage(TablePage *table_page, const LogRecord &log_record, LogRecordType type) {
+  RID rid;
+  Tuple old_tuple;
+  switch (type) {
+    case LogRecordType::INSERT:
+      table_page->ApplyDelete(log_record.insert_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::MARKDELETE:
+      table_page->RollbackDelete(log_record.delete_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      table_page->InsertTuple(log_record.delete_tuple_, &rid, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      table_page->MarkDelete(log_record.delete_rid_, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE: {
+      Tuple tuple;
+      if (table_page->GetTuple(log_record.update_rid_, &tuple, nullptr, nullptr)) {
+        table_page->UpdateTuple(log_record.UndoUpdate(tuple), &old_tuple, log_record.update_rid_, nullptr, nullptr,
+                                nullptr);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void LogRecovery::UndoRecord(LogRecord *log_record) {
+  switch (log_record->log_record_type_) {
+    case LogRecordType::BTREE_INSERT:
+    case LogRecordType::BTREE_DELETE:
+    case LogRecordType::HASH_INSERT:
+    case LogRecordType::HASH_DELETE: {
+      auto it = index_undo_handlers_.find(log_record->index_id_);
+      if (it == index_undo_handlers_.end()) {
+        LOG_WARN("No index registered for index id %u, cannot undo LSN %ld", log_record->index_id_,
+                 static_cast<int64_t>(log_record->lsn_));
+        return;
+      }
+      it->second(log_record);
+      return;
+    }
+    default:
+      break;
+  }
+  const page_id_t page_id = TablePageOf(*log_record, log_record->log_record_type_);
+  if (page_id == INVALID_PAGE_ID) {
+    // Neither transaction records nor new pages have anything to revert.
+    return;
+  }
+
+  auto *table_page = reinterpret_cast<TablePage *>(FetchPage(page_id));
+  // The compensation log record goes first and its LSN onto the page, like that of any other change to it.
+  if (log_manager_ != nullptr) {
+    LogRecord clr(log_record->txn_id_, active_txn_[log_record->txn_id_], *log_record);
+    const lsn_t lsn = log_manager_->AppendLogRecord(&clr);
+    active_txn_[log_record->txn_id_] = lsn;
+    table_page->SetLSN(lsn);
+  }
+  UndoOnPage(table_page, *log_record, log_record->log_record_type_);
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
+void LogRecovery::RegisterIndex(uint32_t index_id, IndexUndoHandler handler) {
+  index_undo_handlers_[index_id] = std::move(handler);
+}
+
+Page *LogRecovery::FetchPage(page_id_t page_id) {
+  Page *page;
+  while ((page = buffer_pool_manager_->FetchPage(page_id)) == nullptr) {
+    std::this_thread::yield();
+  }
+  return page;
+}
 
 }  // namespace bustub
@@ -10,13 +10,22 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <mutex>  // NOLINT
 #include <string>
 #include <thread>  // NOLINT
+#include <utility>
+#include <vector>
 
 #include "common/exception.h"
 #include "common/logger.h"
@@ -26,32 +35,113 @@ namespace bustub {
 
 static char *buffer_used;
 
+/** Mixed into the checksum of the master record. */
+static constexpr int64_t MASTER_RECORD_MAGIC = 0x6d6173746572;
+
+/** Mixed into the checksum of the retention record. */
+static constexpr int64_t RETENTION_RECORD_MAGIC = 0x72657461696e;
+
+/** Suffix of the spare log segment files, after the name of the log. */
+static const char *const SPARE_LOG_SEGMENT = "spare.";
+
+/**
+ * Lists the log segment files of a log, as pairs of path and what follows "<log name>." in the file name
+ */
+static std::vector<std::pair<std::string, std::string>> ListLogFiles(const std::string &log_name) {
+  std::string::size_type n = log_name.rfind('/');
+  const std::string dir_name = n == std::string::npos ? "." : log_name.substr(0, n + 1);
+  const std::string prefix = (n == std::string::npos ? log_name : log_name.substr(n + 1)) + ".";
+  std::vector<std::pair<std::string, std::string>> files;
+  DIR *dir = opendir(dir_name.c_str());
+  if (dir == nullptr) {
+    return files;
+  }
+  while (struct dirent *entry = readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0) {
+      files.emplace_back(n == std::string::npos ? name : dir_name + name, name.substr(prefix.size()));
+    }
+  }
+  closedir(dir);
+  return files;
+}
+
+/**
+ * Parses a string made up of nothing but decimal digits
+ * @return: the number, or -1 if the string is anything else
+ */
+static int ParseNumber(const std::string &str) {
+  if (str.empty() || str.size() > 9 ||
+      !std::all_of(str.begin(), str.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+    return -1;
+  }
+  return std::stoi(str);
+}
+
+/**
+ * Durably replaces a file holding two numbers and their checksum: the record is written into a temporary file that is
+ * renamed over the old one, so that a crash leaves either the old or the new record behind
+ * @return: false on an I/O error
+ */
+static bool WriteRecordFile(const std::string &name, int64_t first, int64_t second, int64_t magic) {
+  const int64_t record[3] = {first, second, first ^ second ^ magic};
+  const std::string tmp_name = name + ".tmp";
+  int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  if (write(fd, record, sizeof(record)) != static_cast<ssize_t>(sizeof(record)) || fsync(fd) != 0) {
+    close(fd);
+    return false;
+  }
+  close(fd);
+  return rename(tmp_name.c_str(), name.c_str()) == 0;
+}
+
+/**
+ * Reads a file written by WriteRecordFile
+ * @return: false if there is no such file, or it is torn
+ */
+static bool ReadRecordFile(const std::string &name, int64_t *first, int64_t *second, int64_t magic) {
+  int fd = open(name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  int64_t record[3];
+  ssize_t read_count = read(fd, record, sizeof(record));
+  close(fd);
+  if (read_count != static_cast<ssize_t>(sizeof(record)) || (record[0] ^ record[1] ^ magic) != record[2]) {
+    return false;
+  }
+  *first = record[0];
+  *second = record[1];
+  return true;
+}
+
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), num_flushes_(0), num_writes_(0), flush_log_(false), flush_log_f_(nullptr) {
-  std::string::size_type n = file_name_.rfind('.');
+DiskManager::DiskManager(const std::string &db_file, int log_segment_size, const std::string &log_db_file)
+    : log_segment_size_(log_segment_size),
+      file_name_(db_file),
+      num_flushes_(0),
+      num_writes_(0),
+      flush_log_(false),
+      flush_log_f_(nullptr) {
+  const std::string &log_source = log_db_file.empty() ? file_name_ : log_db_file;
+  std::string::size_type n = log_source.rfind('.');
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
     return;
   }
-  log_name_ = file_name_.substr(0, n) + ".log";
+  log_name_ = log_source.substr(0, n) + ".log";
+  master_name_ = log_source.substr(0, n) + ".master";
+  retention_name_ = log_source.substr(0, n) + ".retain";
 
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app | std::ios::out);
-    log_io_.close();
-    // reopen with original mode
-    log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-    if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
-    }
-  }
+  // Pick up the segments and spares left behind by an earlier run. Appending resumes at a fresh segment, since the
+  // end of the log inside a preallocated segment is only known to recovery, which moves it back there (ResumeLogAt).
+  ScanLogSegments();
 
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
   db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
@@ -78,7 +168,20 @@ void DiskManager::ShutDown() {
     std::scoped_lock scoped_db_io_latch(db_io_latch_);
     db_io_.close();
   }
-  log_io_.close();
+  if (next_log_segment_.valid()) {
+    next_log_segment_.wait();
+  }
+  if (log_fd_ >= 0) {
+    close(log_fd_);
+    log_fd_ = -1;
+    log_fd_segment_ = -1;
+  }
+  std::scoped_lock scoped_log_read_latch(log_read_latch_);
+  if (read_fd_ >= 0) {
+    close(read_fd_);
+    read_fd_ = -1;
+    read_fd_segment_ = -1;
+  }
 }
 
 /**
@@ -110,6 +213,8 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   if (offset > GetFileSize(file_name_)) {
     LOG_DEBUG("I/O error reading past end of file");
     // std::cerr << "I/O error while reading" << std::endl;
+    // a page that was never written reads back as zeros, as it would from a hole in the file
+    memset(page_data, 0, PAGE_SIZE);
   } else {
     // set read cursor to offset
     db_io_.seekp(offset);
@@ -150,16 +255,37 @@ void DiskManager::WriteLog(char *log_data, int size) {
   }
 
   num_flushes_ += 1;
-  // sequence write
-  log_io_.write(log_data, size);
-
-  // check for I/O error
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while writing log");
-    return;
+  // sequence write, moving on to the next segment whenever the current one is full
+  int written = 0;
+  while (written < size) {
+    const int64_t log_end = log_end_;
+    const auto segment = static_cast<int>(log_end / log_segment_size_);
+    const auto segment_offset = static_cast<int>(log_end % log_segment_size_);
+    if (segment != log_fd_segment_) {
+      SwitchLogSegment(segment);
+      if (log_fd_ < 0) {
+        LOG_DEBUG("I/O error while opening log segment");
+        return;
+      }
+    }
+    const int count = std::min(size - written, log_segment_size_ - segment_offset);
+    ssize_t rc = pwrite(log_fd_, log_data + written, count, segment_offset);
+    // check for I/O error
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_DEBUG("I/O error while writing log");
+      return;
+    }
+    written += static_cast<int>(rc);
+    log_end_ += rc;
+  }
+  // needs to sync to keep disk file durable, committing transactions wait on this; the file never grows, so this
+  // does not have to write any metadata
+  if (fdatasync(log_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing log");
   }
-  // needs to flush to keep disk file in sync
-  log_io_.flush();
   flush_log_ = false;
 }
 
@@ -168,29 +294,283 @@ void DiskManager::WriteLog(char *log_data, int size) {
  * Always read from the beginning and perform sequence read
  * @return: false means already reach the end
  */
-bool DiskManager::ReadLog(char *log_data, int size, int offset) {
-  if (offset >= GetFileSize(log_name_)) {
+bool DiskManager::ReadLog(char *log_data, int size, int64_t offset) {
+  if (offset >= log_end_ || offset < static_cast<int64_t>(first_log_segment_) * log_segment_size_) {
     // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
     return false;
   }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
-
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while reading log");
-    return false;
+  // the read may span several segments
+  std::scoped_lock scoped_log_read_latch(log_read_latch_);
+  int read_count = 0;
+  while (read_count < size && offset + read_count < log_end_) {
+    const auto segment = static_cast<int>((offset + read_count) / log_segment_size_);
+    const auto segment_offset = static_cast<int>((offset + read_count) % log_segment_size_);
+    if (segment != read_fd_segment_) {
+      if (read_fd_ >= 0) {
+        close(read_fd_);
+      }
+      read_fd_ = open(LogSegmentName(segment).c_str(), O_RDONLY);
+      read_fd_segment_ = read_fd_ < 0 ? -1 : segment;
+      if (read_fd_ < 0) {
+        break;
+      }
+    }
+    const int count = std::min(size - read_count, log_segment_size_ - segment_offset);
+    ssize_t rc = pread(read_fd_, log_data + read_count, count, segment_offset);
+    if (rc <= 0) {
+      if (rc < 0) {
+        LOG_DEBUG("I/O error while reading log");
+      }
+      break;
+    }
+    read_count += static_cast<int>(rc);
   }
-  // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
+  // if log ends before reading "size"
   if (read_count < size) {
-    log_io_.clear();
     memset(log_data + read_count, 0, size - read_count);
   }
 
   return true;
 }
 
+/**
+ * Returns the logical size of the log
+ */
+int64_t DiskManager::GetLogSize() { return log_end_; }
+
+/**
+ * Re-reads the segment files of the log, see ScanLogSegments
+ */
+int64_t DiskManager::RefreshLogSize() {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  ScanLogSegments();
+  return log_end_;
+}
+
+/**
+ * Sets the bounds of the log from the segment files there are, and collects the spares
+ */
+void DiskManager::ScanLogSegments() {
+  int last_segment = -1;
+  int first_segment = -1;
+  spare_log_segments_.clear();
+  for (const auto &[path, suffix] : ListLogFiles(log_name_)) {
+    int segment = ParseNumber(suffix);
+    if (segment >= 0) {
+      last_segment = std::max(last_segment, segment);
+      first_segment = first_segment < 0 ? segment : std::min(first_segment, segment);
+    } else if (suffix.compare(0, strlen(SPARE_LOG_SEGMENT), SPARE_LOG_SEGMENT) == 0) {
+      int spare_id = ParseNumber(suffix.substr(strlen(SPARE_LOG_SEGMENT)));
+      if (spare_id >= 0) {
+        spare_log_segments_.push_back(path);
+        next_spare_id_ = std::max(next_spare_id_, spare_id + 1);
+      }
+    }
+  }
+  first_log_segment_ = std::max(first_segment, 0);
+  log_end_ = static_cast<int64_t>(last_segment + 1) * log_segment_size_;
+}
+
+/**
+ * Move the end of the log back to where recovery found the last complete record
+ */
+void DiskManager::ResumeLogAt(int64_t offset) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  assert(offset <= log_end_);
+  log_end_ = offset;
+  const auto segment_offset = static_cast<int>(offset % log_segment_size_);
+  if (segment_offset == 0) {
+    return;
+  }
+  // Zeroed, like a fresh segment, so that the rest of a torn record does not turn up behind the records written next.
+  int fd = open(LogSegmentName(static_cast<int>(offset / log_segment_size_)).c_str(), O_WRONLY);
+  if (fd < 0) {
+    return;
+  }
+  std::vector<char> zeros(PAGE_SIZE, 0);
+  bool zeroed = true;
+  for (int pos = segment_offset; pos < log_segment_size_ && zeroed; pos += PAGE_SIZE) {
+    const int count = std::min(PAGE_SIZE, log_segment_size_ - pos);
+    zeroed = pwrite(fd, zeros.data(), count, pos) == count;
+  }
+  if (!zeroed || fdatasync(fd) != 0) {
+    LOG_DEBUG("I/O error while zeroing the end of the log");
+  }
+  close(fd);
+}
+
+/**
+ * Recycle or delete the segments before offset. A recycled segment is only renamed: the records left in it are told
+ * apart from the ones written into it later by their segment number, see LogRecord
+ */
+void DiskManager::TruncateLog(int64_t offset) {
+  int64_t retained;
+  if (ReadRetentionRecord(&retained)) {
+    offset = std::min(offset, retained);
+  }
+  std::vector<int> segments;
+  {
+    std::scoped_lock scoped_log_io_latch(log_io_latch_);
+    while (static_cast<int64_t>(first_log_segment_ + 1) * log_segment_size_ <= std::min<int64_t>(offset, log_end_)) {
+      segments.push_back(first_log_segment_++);
+    }
+  }
+
+  for (int segment : segments) {
+    const std::string name = LogSegmentName(segment);
+    std::string spare_name;
+    {
+      std::scoped_lock scoped_log_io_latch(log_io_latch_);
+      if (static_cast<int>(spare_log_segments_.size()) < LOG_SEGMENT_SPARES) {
+        spare_name = log_name_ + "." + SPARE_LOG_SEGMENT + std::to_string(next_spare_id_++);
+      }
+    }
+    if (spare_name.empty()) {
+      unlink(name.c_str());
+      continue;
+    }
+    if (rename(name.c_str(), spare_name.c_str()) != 0) {
+      LOG_DEBUG("I/O error while recycling log segment");
+      unlink(name.c_str());
+      continue;
+    }
+    std::scoped_lock scoped_log_io_latch(log_io_latch_);
+    spare_log_segments_.push_back(spare_name);
+  }
+}
+
+/**
+ * Returns the number of log segment files on disk
+ */
+int DiskManager::GetNumLogSegments() { return static_cast<int>(ListLogFiles(log_name_).size()); }
+
+/**
+ * Deletes all the log segment files of a database
+ */
+void DiskManager::RemoveLogFiles(const std::string &db_file) {
+  std::string::size_type n = db_file.rfind('.');
+  if (n == std::string::npos) {
+    return;
+  }
+  for (const auto &[path, suffix] : ListLogFiles(db_file.substr(0, n) + ".log")) {
+    unlink(path.c_str());
+  }
+}
+
+std::string DiskManager::LogSegmentName(int segment) const { return log_name_ + "." + std::to_string(segment); }
+
+/**
+ * Open a log segment, preferring a spare over allocating a new file
+ */
+int DiskManager::OpenLogSegment(int segment) {
+  const std::string name = LogSegmentName(segment);
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  int fd = open(name.c_str(), O_RDWR);
+  if (fd >= 0) {
+    return fd;
+  }
+  if (!spare_log_segments_.empty()) {
+    const std::string spare_name = spare_log_segments_.back();
+    spare_log_segments_.pop_back();
+    if (rename(spare_name.c_str(), name.c_str()) == 0) {
+      return open(name.c_str(), O_RDWR);
+    }
+  }
+  fd = open(name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return fd;
+  }
+  // allocate the whole segment up front, zero-filled
+  if (posix_fallocate(fd, 0, log_segment_size_) != 0) {
+    LOG_DEBUG("I/O error while preallocating log segment");
+  }
+  return fd;
+}
+
+/**
+ * Switch WriteLog over to another segment, syncing the one it leaves behind
+ */
+void DiskManager::SwitchLogSegment(int segment) {
+  if (log_fd_ >= 0) {
+    if (fdatasync(log_fd_) != 0) {
+      LOG_DEBUG("I/O error while syncing log");
+    }
+    close(log_fd_);
+  }
+  // normally the segment has been prepared by now
+  if (next_log_segment_.valid()) {
+    next_log_segment_.wait();
+  }
+  log_fd_ = OpenLogSegment(segment);
+  log_fd_segment_ = segment;
+  next_log_segment_ = std::async(std::launch::async, [this, segment] {
+    int fd = OpenLogSegment(segment + 1);
+    if (fd >= 0) {
+      close(fd);
+    }
+  });
+}
+
+/**
+ * Write the master record, see WriteRecordFile
+ */
+void DiskManager::WriteMasterRecord(lsn_t checkpoint_lsn, int64_t offset) {
+  if (!WriteRecordFile(master_name_, checkpoint_lsn, offset, MASTER_RECORD_MAGIC)) {
+    LOG_DEBUG("I/O error while writing master record");
+  }
+}
+
+/**
+ * Read the master record, rejecting it if it is torn or points past the end of the log
+ */
+bool DiskManager::ReadMasterRecord(lsn_t *checkpoint_lsn, int64_t *offset) {
+  int64_t record[2];
+  if (!ReadRecordFile(master_name_, &record[0], &record[1], MASTER_RECORD_MAGIC) ||
+      record[1] < static_cast<int64_t>(first_log_segment_) * log_segment_size_ || record[1] >= GetLogSize()) {
+    return false;
+  }
+  *checkpoint_lsn = record[0];
+  *offset = record[1];
+  return true;
+}
+
+/**
+ * Write the retention record, see WriteRecordFile
+ */
+void DiskManager::WriteRetentionRecord(int64_t offset) {
+  // Segments are only ever released whole, so the record only changes when the offset moves to another segment.
+  offset -= offset % log_segment_size_;
+  if (offset == retention_offset_) {
+    return;
+  }
+  if (!WriteRecordFile(retention_name_, offset, 0, RETENTION_RECORD_MAGIC)) {
+    LOG_DEBUG("I/O error while writing retention record");
+    return;
+  }
+  retention_offset_ = offset;
+}
+
+/**
+ * Delete the retention record
+ */
+void DiskManager::DropRetentionRecord() {
+  unlink(retention_name_.c_str());
+  retention_offset_ = -1;
+}
+
+/**
+ * Read the retention record, which a reader of the log keeps, perhaps in another process
+ */
+bool DiskManager::ReadRetentionRecord(int64_t *offset) {
+  int64_t unused;
+  return ReadRecordFile(retention_name_, offset, &unused, RETENTION_RECORD_MAGIC);
+}
+
+/**
+ * Returns the offset of the first segment of the log
+ */
+int64_t DiskManager::GetLogStart() const { return static_cast<int64_t>(first_log_segment_) * log_segment_size_; }
+
 /**
  * Returns number of flushes made so far
  */
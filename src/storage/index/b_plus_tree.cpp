@@ -9,30 +9,39 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <functional>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "common/exception.h"
 #include "common/logger.h"
 #include "common/rid.h"
+#include "common/util/hash_util.h"
 #include "storage/index/b_plus_tree.h"
 #include "storage/page/header_page.h"
 
 namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                          int leaf_max_size, int internal_max_size)
+                          int leaf_max_size, int internal_max_size, LockManager *lock_manager)
     : index_name_(std::move(name)),
       root_page_id_(INVALID_PAGE_ID),
       buffer_pool_manager_(buffer_pool_manager),
       comparator_(comparator),
       leaf_max_size_(leaf_max_size),
-      internal_max_size_(internal_max_size) {}
+      // an internal page holds one entry over its max size until it is split
+      internal_max_size_(std::min(internal_max_size, static_cast<int>(INTERNAL_PAGE_SIZE) - 1)),
+      index_id_(static_cast<uint32_t>(HashUtil::HashBytes(index_name_.data(), index_name_.size()))),
+      lock_manager_(lock_manager) {}
 
 /*
  * Helper function to decide whether current b+tree is empty
  */
 INDEX_TEMPLATE_ARGUMENTS
-bool BPLUSTREE_TYPE::IsEmpty() const { return true; }
+bool BPLUSTREE_TYPE::IsEmpty() const { return root_page_id_ == INVALID_PAGE_ID; }
 /*****************************************************************************
  * SEARCH
  *****************************************************************************/
@@ -43,7 +52,22 @@ bool BPLUSTREE_TYPE::IsEmpty() const { return true; }
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction) {
-  return false;
+  latch_.RLock();
+  Page *page = FindLeaf(key, false, false);
+  if (page == nullptr) {
+    latch_.RUnlock();
+    return false;
+  }
+  auto *leaf = reinterpret_cast<LeafPage *>(page->GetData());
+  ValueType value;
+  const bool found = leaf->Lookup(key, &value, comparator_);
+  page->RUnlatch();
+  if (found) {
+    result->push_back(value);
+  }
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  latch_.RUnlock();
+  return found;
 }
 
 /*****************************************************************************
@@ -57,7 +81,35 @@ bool BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result
  * keys return false, otherwise return true.
  */
 INDEX_TEMPLATE_ARGUMENTS
-bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transaction *transaction) { return false; }
+bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transaction *transaction) {
+  const bool locks_keys = LocksKeys(transaction);
+  if (!locks_keys) {
+    latch_.RLock();
+  } else if (!LockForWrite(key, transaction, false)) {
+    return false;
+  }
+  if (!IsEmpty()) {
+    const bool inserted = InsertIntoLeaf(key, value, transaction);
+    latch_.RUnlock();
+    return inserted;
+  }
+  latch_.RUnlock();
+
+  // A new tree needs a root: start over with the whole tree to ourselves.
+  if (!locks_keys) {
+    latch_.WLock();
+  } else if (!LockForWrite(key, transaction, true)) {
+    return false;
+  }
+  bool inserted = true;
+  if (IsEmpty()) {
+    StartNewTree(key, value, transaction);
+  } else {
+    inserted = InsertIntoLeaf(key, value, transaction);
+  }
+  latch_.WUnlock();
+  return inserted;
+}
 /*
  * Insert constant key & value pair into an empty tree
  * User needs to first ask for new page from buffer pool manager(NOTICE: throw
@@ -65,7 +117,25 @@ bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
  * tree's root page id and insert entry directly into leaf page.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {}
+void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value, Transaction *transaction) {
+  page_id_t page_id;
+  Page *page = buffer_pool_manager_->NewPage(&page_id);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot allocate a page for the root of a new tree");
+  }
+  auto *root = reinterpret_cast<LeafPage *>(page->GetData());
+  std::vector<char> before = root->CopyForLog(buffer_pool_manager_);
+  root->Init(page_id, INVALID_PAGE_ID, leaf_max_size_);
+  root->LogPageWrite(before, buffer_pool_manager_);
+  root_page_id_ = page_id;
+  UpdateRootPageId(1);
+
+  root->Insert(key, value, comparator_);
+  const MappingType item(key, value);
+  root->LogEntry(LogRecordType::BTREE_INSERT, index_id_, 0, reinterpret_cast<const char *>(&item), sizeof(MappingType),
+                 transaction, buffer_pool_manager_);
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
 
 /*
  * Insert constant key & value pair into leaf page
@@ -77,7 +147,27 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {}
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction) {
-  return false;
+  Page *page = FindLeaf(key, false, true);
+  auto *leaf = reinterpret_cast<LeafPage *>(page->GetData());
+  const int index = leaf->KeyIndex(key, comparator_);
+  if (index < leaf->GetSize() && comparator_(leaf->KeyAt(index), key) == 0) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    return false;
+  }
+  leaf->Insert(key, value, comparator_);
+  const MappingType item(key, value);
+  leaf->LogEntry(LogRecordType::BTREE_INSERT, index_id_, index, reinterpret_cast<const char *>(&item),
+                 sizeof(MappingType), transaction, buffer_pool_manager_);
+
+  if (leaf->GetSize() < leaf->GetMaxSize()) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+    return true;
+  }
+  LeafPage *new_leaf = Split(leaf);
+  InsertIntoParent(page, new_leaf->KeyAt(0), new_leaf, transaction);
+  return true;
 }
 
 /*
@@ -90,21 +180,235 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
 N *BPLUSTREE_TYPE::Split(N *node) {
-  return nullptr;
+  page_id_t page_id;
+  Page *page = buffer_pool_manager_->NewPage(&page_id);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot allocate a page to split into");
+  }
+  auto *new_node = reinterpret_cast<N *>(page->GetData());
+  std::vector<char> new_before = new_node->CopyForLog(buffer_pool_manager_);
+  std::vector<char> before = node->CopyForLog(buffer_pool_manager_);
+  if constexpr (std::is_same_v<N, LeafPage>) {
+    new_node->Init(page_id, node->GetParentPageId(), leaf_max_size_);
+    node->MoveHalfTo(new_node);
+  } else {
+    new_node->Init(page_id, node->GetParentPageId(), internal_max_size_);
+    node->MoveHalfTo(new_node, buffer_pool_manager_);
+  }
+  // The new page takes over the upper part of the range of node, up to where the next page starts.
+  new_node->SetNextPageId(node->GetNextPageId());
+  new_node->SetHighKey(node->GetHighKey());
+  node->SetNextPageId(page_id);
+  node->SetHighKey(new_node->KeyAt(0));
+  new_node->LogPageWrite(new_before, buffer_pool_manager_);
+  node->LogPageWrite(before, buffer_pool_manager_);
+  return new_node;
 }
 
 /*
  * Insert key & value pair into internal page after split
- * @param   old_node      input page from split() method
+ * @param   old_page      page of the input page from split() method, latched exclusively
  * @param   key
  * @param   new_node      returned page from split() method
  * User needs to first find the parent page of old_node, parent node must be
  * adjusted to take info of new_node into account. Remember to deal with split
  * recursively if necessary.
+ *
+ * The parent page id of old_node is only a hint: the parent may have split since, moving old_node to a page to its
+ * right, which the separator is looked up from by key.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &key, BPlusTreePage *new_node,
-                                      Transaction *transaction) {}
+void BPLUSTREE_TYPE::InsertIntoParent(Page *old_page, const KeyType &key, BPlusTreePage *new_node,
+                                      Transaction *transaction) {
+  auto *old_node = reinterpret_cast<BPlusTreePage *>(old_page->GetData());
+  if (old_node->GetPageId() == root_page_id_) {
+    page_id_t root_page_id;
+    Page *page = buffer_pool_manager_->NewPage(&root_page_id);
+    if (page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot allocate a page for a new root");
+    }
+    // Latched until the header page has it, so that a split of the new root does not change the root before that.
+    page->WLatch();
+    auto *root = reinterpret_cast<InternalPage *>(page->GetData());
+    std::vector<char> before = root->CopyForLog(buffer_pool_manager_);
+    root->Init(root_page_id, INVALID_PAGE_ID, internal_max_size_);
+    root->PopulateNewRoot(old_node->GetPageId(), key, new_node->GetPageId());
+    root->LogPageWrite(before, buffer_pool_manager_);
+    for (BPlusTreePage *child : {old_node, new_node}) {
+      std::vector<char> child_before = child->CopyForLog(buffer_pool_manager_);
+      child->SetParentPageId(root_page_id);
+      child->LogPageWrite(child_before, buffer_pool_manager_);
+    }
+    root_page_id_ = root_page_id;
+    UpdateRootPageId();
+    old_page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(old_node->GetPageId(), true);
+    buffer_pool_manager_->UnpinPage(new_node->GetPageId(), true);
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(root_page_id, true);
+    return;
+  }
+
+  const page_id_t parent_hint = old_node->GetParentPageId();
+  const page_id_t new_page_id = new_node->GetPageId();
+  old_page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(old_node->GetPageId(), true);
+  buffer_pool_manager_->UnpinPage(new_page_id, true);
+
+  Page *page = MoveRight(FetchLatched(parent_hint, true), key, true);
+  auto *parent = reinterpret_cast<InternalPage *>(page->GetData());
+  // Right after the child that key was in until the split, which may not be old_node if that split too since.
+  const int index = parent->ValueIndex(parent->Lookup(key, comparator_)) + 1;
+  parent->InsertNodeAfter(parent->ValueAt(index - 1), key, new_page_id);
+  const std::pair<KeyType, page_id_t> item(key, new_page_id);
+  parent->LogEntry(LogRecordType::BTREE_INSERT, index_id_, index, reinterpret_cast<const char *>(&item), sizeof(item),
+                   nullptr, buffer_pool_manager_);
+  parent->Adopt(new_page_id, buffer_pool_manager_);
+
+  if (parent->GetSize() <= parent->GetMaxSize()) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+    return;
+  }
+  InternalPage *new_parent = Split(parent);
+  InsertIntoParent(page, new_parent->KeyAt(0), new_parent, transaction);
+}
+
+/*****************************************************************************
+ * BULK LOAD
+ *****************************************************************************/
+namespace {
+
+/*
+ * The number of pages to spread entries over, filling them to fill_factor of capacity, but fewer, fuller pages where
+ * that leaves pages with less than min_size entries.
+ */
+size_t BulkPageCount(size_t entries, size_t capacity, size_t min_size, double fill_factor) {
+  const auto wanted = static_cast<size_t>(fill_factor * static_cast<double>(capacity));
+  const size_t fill = std::clamp(wanted, std::min<size_t>(2, capacity), capacity);
+  size_t pages = (entries + fill - 1) / fill;
+  while (pages > 1 && entries / pages < min_size && (entries + pages - 2) / (pages - 1) <= capacity) {
+    pages--;
+  }
+  return pages;
+}
+
+}  // namespace
+
+/*
+ * Build an empty tree from sorted entries
+ * Since the number of entries is known, so is the number of pages on every
+ * level, and every page can be filled to its share as the entries come: the
+ * tree keeps the page it fills on every level pinned, and starts a page on a
+ * level when the one before has its share, starting a page on the level above
+ * first if that one is full too. Every page is written once.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::BulkLoad(size_t count, const std::function<void(MappingType *)> &next, double fill_factor) {
+  latch_.WLock();
+  if (!IsEmpty()) {
+    latch_.WUnlock();
+    return false;
+  }
+  if (count == 0) {
+    latch_.WUnlock();
+    return true;
+  }
+
+  std::vector<BulkLevel> levels;
+  size_t entries = count;
+  do {
+    BulkLevel level;
+    level.entries_ = entries;
+    if (levels.empty()) {
+      // a leaf that reaches its max size is split
+      level.pages_ = BulkPageCount(entries, leaf_max_size_ - 1, leaf_max_size_ / 2, fill_factor);
+    } else {
+      level.pages_ = BulkPageCount(entries, internal_max_size_, (internal_max_size_ + 1) / 2, fill_factor);
+    }
+    levels.push_back(std::move(level));
+    entries = levels.back().pages_;
+  } while (entries > 1);
+
+  MappingType entry;
+  KeyType last_key;
+  for (size_t i = 0; i < count; i++) {
+    next(&entry);
+    BUSTUB_ASSERT(i == 0 || comparator_(last_key, entry.first) < 0, "Bulk loading keys out of order");
+    last_key = entry.first;
+    BulkLevel &leaves = levels[0];
+    if (leaves.page_ == nullptr ||
+        reinterpret_cast<LeafPage *>(leaves.page_->GetData())->GetSize() == leaves.full_size_) {
+      StartBulkPage(&levels, 0, entry.first);
+    }
+    reinterpret_cast<LeafPage *>(leaves.page_->GetData())->Append(entry.first, entry.second);
+  }
+
+  root_page_id_ = levels.back().page_->GetPageId();
+  for (BulkLevel &level : levels) {
+    FinishBulkPage(&level);
+  }
+  UpdateRootPageId(1);
+  latch_.WUnlock();
+  return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::StartBulkPage(std::vector<BulkLevel> *levels, size_t level, const KeyType &key) {
+  BulkLevel &current = (*levels)[level];
+  BulkLevel *parent = level + 1 < levels->size() ? &(*levels)[level + 1] : nullptr;
+  // The parent first, so that the new page knows it.
+  if (parent != nullptr &&
+      (parent->page_ == nullptr ||
+       reinterpret_cast<BPlusTreePage *>(parent->page_->GetData())->GetSize() == parent->full_size_)) {
+    StartBulkPage(levels, level + 1, key);
+  }
+  const page_id_t parent_id = parent == nullptr ? INVALID_PAGE_ID : parent->page_->GetPageId();
+
+  page_id_t page_id;
+  Page *page = buffer_pool_manager_->NewPage(&page_id);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot allocate a page to bulk load into");
+  }
+  std::vector<char> before = reinterpret_cast<BPlusTreePage *>(page->GetData())->CopyForLog(buffer_pool_manager_);
+  // The page before on the level ends where the new one starts.
+  if (level == 0) {
+    reinterpret_cast<LeafPage *>(page->GetData())->Init(page_id, parent_id, leaf_max_size_);
+    if (current.page_ != nullptr) {
+      auto *prev = reinterpret_cast<LeafPage *>(current.page_->GetData());
+      prev->SetNextPageId(page_id);
+      prev->SetHighKey(key);
+    }
+  } else {
+    reinterpret_cast<InternalPage *>(page->GetData())->Init(page_id, parent_id, internal_max_size_);
+    if (current.page_ != nullptr) {
+      auto *prev = reinterpret_cast<InternalPage *>(current.page_->GetData());
+      prev->SetNextPageId(page_id);
+      prev->SetHighKey(key);
+    }
+  }
+  FinishBulkPage(&current);
+
+  current.page_ = page;
+  current.before_ = std::move(before);
+  // The first pages take one entry more where the entries do not divide evenly.
+  current.full_size_ = static_cast<int>(current.entries_ / current.pages_ +
+                                        (current.pages_started_ < current.entries_ % current.pages_ ? 1 : 0));
+  current.pages_started_++;
+  if (parent != nullptr) {
+    reinterpret_cast<InternalPage *>(parent->page_->GetData())->Append(key, page_id);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::FinishBulkPage(BulkLevel *level) {
+  if (level->page_ == nullptr) {
+    return;
+  }
+  reinterpret_cast<BPlusTreePage *>(level->page_->GetData())->LogPageWrite(level->before_, buffer_pool_manager_);
+  buffer_pool_manager_->UnpinPage(level->page_->GetPageId(), true);
+  level->page_ = nullptr;
+}
 
 /*****************************************************************************
  * REMOVE
@@ -117,7 +421,77 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
  * necessary.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {}
+void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
+  const bool locks_keys = LocksKeys(transaction);
+  if (!locks_keys) {
+    latch_.RLock();
+  } else if (!LockForWrite(key, transaction, false)) {
+    return;
+  }
+  const bool done = RemoveOptimistic(key, transaction);
+  latch_.RUnlock();
+  if (done) {
+    return;
+  }
+
+  // The leaf would be left underfull: start over with the whole tree to ourselves.
+  if (!locks_keys) {
+    latch_.WLock();
+  } else if (!LockForWrite(key, transaction, true)) {
+    return;
+  }
+  Page *page = FindLeafPage(key);
+  if (page == nullptr) {
+    latch_.WUnlock();
+    return;
+  }
+  auto *leaf = reinterpret_cast<LeafPage *>(page->GetData());
+  const int index = leaf->KeyIndex(key, comparator_);
+  if (index == leaf->GetSize() || comparator_(leaf->KeyAt(index), key) != 0) {
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    latch_.WUnlock();
+    return;
+  }
+  const MappingType item = leaf->GetItem(index);
+  leaf->RemoveAndDeleteRecord(key, comparator_);
+  leaf->LogEntry(LogRecordType::BTREE_DELETE, index_id_, index, reinterpret_cast<const char *>(&item),
+                 sizeof(MappingType), transaction, buffer_pool_manager_);
+
+  const page_id_t page_id = page->GetPageId();
+  const bool deleted = CoalesceOrRedistribute(leaf, transaction);
+  buffer_pool_manager_->UnpinPage(page_id, true);
+  if (deleted) {
+    buffer_pool_manager_->DeletePage(page_id);
+  }
+  latch_.WUnlock();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::RemoveOptimistic(const KeyType &key, Transaction *transaction) {
+  Page *page = FindLeaf(key, false, true);
+  if (page == nullptr) {
+    return true;
+  }
+  auto *leaf = reinterpret_cast<LeafPage *>(page->GetData());
+  const int index = leaf->KeyIndex(key, comparator_);
+  bool done = true;
+  bool removed = false;
+  if (index == leaf->GetSize() || comparator_(leaf->KeyAt(index), key) != 0) {
+    // Nothing to remove.
+  } else if (leaf->IsRootPage() ? leaf->GetSize() > 1 : leaf->GetSize() > leaf->GetMinSize()) {
+    // See CoalesceOrRedistribute and AdjustRoot for when a leaf is left as it is.
+    const MappingType item = leaf->GetItem(index);
+    leaf->RemoveAndDeleteRecord(key, comparator_);
+    leaf->LogEntry(LogRecordType::BTREE_DELETE, index_id_, index, reinterpret_cast<const char *>(&item),
+                   sizeof(MappingType), transaction, buffer_pool_manager_);
+    removed = true;
+  } else {
+    done = false;
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), removed);
+  return done;
+}
 
 /*
  * User needs to first find the sibling of input page. If sibling's size + input
@@ -129,7 +503,56 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {}
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
 bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction) {
-  return false;
+  if (node->IsRootPage()) {
+    return AdjustRoot(node);
+  }
+  if (node->GetSize() >= node->GetMinSize()) {
+    return false;
+  }
+
+  const page_id_t parent_page_id = node->GetParentPageId();
+  Page *parent_page = buffer_pool_manager_->FetchPage(parent_page_id);
+  if (parent_page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch the parent page");
+  }
+  auto *parent = reinterpret_cast<InternalPage *>(parent_page->GetData());
+  const int index = parent->ValueIndex(node->GetPageId());
+  // The left sibling, unless node is the leftmost child.
+  const page_id_t neighbor_page_id = parent->ValueAt(index == 0 ? 1 : index - 1);
+  Page *neighbor_page = buffer_pool_manager_->FetchPage(neighbor_page_id);
+  if (neighbor_page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch the sibling page");
+  }
+  auto *neighbor = reinterpret_cast<N *>(neighbor_page->GetData());
+
+  // A leaf at its max size would have to be split right away.
+  const int merged_size = neighbor->GetSize() + node->GetSize();
+  const bool can_merge = node->IsLeafPage() ? merged_size < node->GetMaxSize() : merged_size <= node->GetMaxSize();
+  if (!can_merge) {
+    Redistribute(neighbor, node, index);
+    buffer_pool_manager_->UnpinPage(neighbor_page_id, true);
+    buffer_pool_manager_->UnpinPage(parent_page_id, true);
+    return false;
+  }
+
+  // The right one of the two always moves into the left one.
+  bool delete_node = true;
+  bool delete_parent;
+  if (index == 0) {
+    delete_parent = Coalesce(&node, &neighbor, &parent, 1, transaction);
+    delete_node = false;
+  } else {
+    delete_parent = Coalesce(&neighbor, &node, &parent, index, transaction);
+  }
+  buffer_pool_manager_->UnpinPage(neighbor_page_id, true);
+  if (!delete_node) {
+    buffer_pool_manager_->DeletePage(neighbor_page_id);
+  }
+  buffer_pool_manager_->UnpinPage(parent_page_id, true);
+  if (delete_parent) {
+    buffer_pool_manager_->DeletePage(parent_page_id);
+  }
+  return delete_node;
 }
 
 /*
@@ -143,13 +566,28 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction) {
  * @param   parent             parent page of input "node"
  * @return  true means parent node should be deleted, false means no deletion
  * happend
+ *
+ * Here node is always the right one of the two, at index in the parent, and the caller deletes it.
  */
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
 bool BPLUSTREE_TYPE::Coalesce(N **neighbor_node, N **node,
                               BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> **parent, int index,
                               Transaction *transaction) {
-  return false;
+  // The emptied page is deleted, so there is no need to log what happens to it.
+  std::vector<char> before = (*neighbor_node)->CopyForLog(buffer_pool_manager_);
+  if constexpr (std::is_same_v<N, LeafPage>) {
+    (*node)->MoveAllTo(*neighbor_node);
+  } else {
+    (*node)->MoveAllTo(*neighbor_node, (*parent)->KeyAt(index), buffer_pool_manager_);
+  }
+  (*neighbor_node)->LogPageWrite(before, buffer_pool_manager_);
+
+  const std::pair<KeyType, page_id_t> item((*parent)->KeyAt(index), (*parent)->ValueAt(index));
+  (*parent)->Remove(index);
+  (*parent)->LogEntry(LogRecordType::BTREE_DELETE, index_id_, index, reinterpret_cast<const char *>(&item),
+                      sizeof(item), nullptr, buffer_pool_manager_);
+  return CoalesceOrRedistribute(*parent, transaction);
 }
 
 /*
@@ -163,7 +601,39 @@ bool BPLUSTREE_TYPE::Coalesce(N **neighbor_node, N **node,
  */
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
-void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index) {}
+void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index) {
+  Page *parent_page = buffer_pool_manager_->FetchPage(node->GetParentPageId());
+  if (parent_page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch the parent page");
+  }
+  auto *parent = reinterpret_cast<InternalPage *>(parent_page->GetData());
+  std::vector<char> neighbor_before = neighbor_node->CopyForLog(buffer_pool_manager_);
+  std::vector<char> before = node->CopyForLog(buffer_pool_manager_);
+  std::vector<char> parent_before = parent->CopyForLog(buffer_pool_manager_);
+  if (index == 0) {
+    // The right sibling gives up its first entry, which changes the key that separates the two.
+    if constexpr (std::is_same_v<N, LeafPage>) {
+      neighbor_node->MoveFirstToEndOf(node);
+    } else {
+      neighbor_node->MoveFirstToEndOf(node, parent->KeyAt(1), buffer_pool_manager_);
+    }
+    parent->SetKeyAt(1, neighbor_node->KeyAt(0));
+    node->SetHighKey(parent->KeyAt(1));
+  } else {
+    // The left sibling gives up its last entry, which becomes the key that separates the two.
+    if constexpr (std::is_same_v<N, LeafPage>) {
+      neighbor_node->MoveLastToFrontOf(node);
+    } else {
+      neighbor_node->MoveLastToFrontOf(node, parent->KeyAt(index), buffer_pool_manager_);
+    }
+    parent->SetKeyAt(index, node->KeyAt(0));
+    neighbor_node->SetHighKey(parent->KeyAt(index));
+  }
+  neighbor_node->LogPageWrite(neighbor_before, buffer_pool_manager_);
+  node->LogPageWrite(before, buffer_pool_manager_);
+  parent->LogPageWrite(parent_before, buffer_pool_manager_);
+  buffer_pool_manager_->UnpinPage(parent->GetPageId(), true);
+}
 /*
  * Update root page if necessary
  * NOTE: size of root page can be less than min size and this method is only
@@ -175,7 +645,149 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index) {}
  * happend
  */
 INDEX_TEMPLATE_ARGUMENTS
-bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) { return false; }
+bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
+  if (old_root_node->IsLeafPage()) {
+    if (old_root_node->GetSize() > 0) {
+      return false;
+    }
+    root_page_id_ = INVALID_PAGE_ID;
+    UpdateRootPageId();
+    return true;
+  }
+  if (old_root_node->GetSize() > 1) {
+    return false;
+  }
+  root_page_id_ = reinterpret_cast<InternalPage *>(old_root_node)->RemoveAndReturnOnlyChild();
+  UpdateRootPageId();
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch the new root page");
+  }
+  auto *root = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  std::vector<char> before = root->CopyForLog(buffer_pool_manager_);
+  root->SetParentPageId(INVALID_PAGE_ID);
+  root->LogPageWrite(before, buffer_pool_manager_);
+  buffer_pool_manager_->UnpinPage(root_page_id_, true);
+  return true;
+}
+
+/*****************************************************************************
+ * NEXT-KEY LOCKING
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::LocksKeys(Transaction *transaction) const {
+  // An aborted transaction rolling back its entries keeps the locks it took writing them.
+  return lock_manager_ != nullptr && transaction != nullptr && transaction->GetState() != TransactionState::ABORTED &&
+         transaction->GetConcurrencyControl() == ConcurrencyControl::TWO_PHASE_LOCKING &&
+         transaction->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::LocksScans(Transaction *transaction) const {
+  return LocksKeys(transaction) && transaction->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int64_t BPLUSTREE_TYPE::KeyLockName(const KeyType *key) const {
+  return LockManager::KeyLockName(index_id_, reinterpret_cast<const char *>(key), sizeof(KeyType));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::FindNextEntry(const KeyType *after, MappingType *entry) {
+  if (IsEmpty()) {
+    return false;
+  }
+  Page *page = after == nullptr ? FindLeaf(KeyType(), true, false) : FindLeaf(*after, false, false);
+  auto *leaf = reinterpret_cast<LeafPage *>(page->GetData());
+  int index = 0;
+  if (after != nullptr) {
+    index = leaf->KeyIndex(*after, comparator_);
+    if (index < leaf->GetSize() && comparator_(leaf->KeyAt(index), *after) == 0) {
+      index++;
+    }
+  }
+  // Leaves are only unlinked under latch_ held exclusively, so the next one is still there.
+  while (index >= leaf->GetSize()) {
+    const page_id_t next_page_id = leaf->GetNextPageId();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    if (next_page_id == INVALID_PAGE_ID) {
+      return false;
+    }
+    page = buffer_pool_manager_->FetchPage(next_page_id);
+    page->RLatch();
+    leaf = reinterpret_cast<LeafPage *>(page->GetData());
+    index = 0;
+  }
+  *entry = leaf->GetItem(index);
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::LockForWrite(const KeyType &key, Transaction *transaction, bool exclusive) {
+  if (!lock_manager_->LockKey(transaction, KeyLockName(&key), LockMode::EXCLUSIVE)) {
+    return false;
+  }
+  while (true) {
+    MappingType next;
+    latch_.RLock();
+    const bool has_next = FindNextEntry(&key, &next);
+    latch_.RUnlock();
+    if (!lock_manager_->LockKey(transaction, KeyLockName(has_next ? &next.first : nullptr),
+                                LockMode::INTENTION_EXCLUSIVE)) {
+      return false;
+    }
+    if (exclusive) {
+      latch_.WLock();
+    } else {
+      latch_.RLock();
+    }
+    MappingType now_next;
+    const bool now_has_next = FindNextEntry(&key, &now_next);
+    if (now_has_next == has_next && (!has_next || comparator_(now_next.first, next.first) == 0)) {
+      return true;
+    }
+    if (exclusive) {
+      latch_.WUnlock();
+    } else {
+      latch_.RUnlock();
+    }
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::ScanNext(const KeyType *after, MappingType *entry, Transaction *transaction) {
+  // after may point into entry, which is overwritten below.
+  KeyType after_key;
+  if (after != nullptr) {
+    after_key = *after;
+    after = &after_key;
+  }
+  latch_.RLock();
+  bool found = FindNextEntry(after, entry);
+  latch_.RUnlock();
+  if (!LocksScans(transaction)) {
+    return found;
+  }
+  while (true) {
+    if (!lock_manager_->LockKey(transaction, KeyLockName(found ? &entry->first : nullptr), LockMode::SHARED)) {
+      return false;
+    }
+    // A key that went into the gap before the lock was granted is read, and locked, instead.
+    MappingType now_entry;
+    latch_.RLock();
+    const bool now_found = FindNextEntry(after, &now_entry);
+    latch_.RUnlock();
+    if (now_found == found && (!found || comparator_(now_entry.first, entry->first) == 0)) {
+      *entry = now_entry;
+      return found;
+    }
+    found = now_found;
+    *entry = now_entry;
+  }
+}
 
 /*****************************************************************************
  * INDEX ITERATOR
@@ -186,7 +798,12 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) { return false; }
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin() { return INDEXITERATOR_TYPE(); }
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin() {
+  latch_.RLock();
+  Page *page = FindLeafPage(KeyType(), true);
+  latch_.RUnlock();
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, 0);
+}
 
 /*
  * Input parameter is low key, find the leaf page that contains the input key
@@ -194,7 +811,16 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin() { return INDEXITERATOR_TYPE(); }
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) { return INDEXITERATOR_TYPE(); }
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) {
+  latch_.RLock();
+  Page *page = FindLeafPage(key);
+  latch_.RUnlock();
+  if (page == nullptr) {
+    return INDEXITERATOR_TYPE(buffer_pool_manager_, nullptr, 0);
+  }
+  const int index = reinterpret_cast<LeafPage *>(page->GetData())->KeyIndex(key, comparator_);
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, index);
+}
 
 /*
  * Input parameter is void, construct an index iterator representing the end
@@ -202,7 +828,40 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) { return INDEXITERA
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_TYPE::End() { return INDEXITERATOR_TYPE(); }
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::End() { return INDEXITERATOR_TYPE(buffer_pool_manager_, nullptr, 0); }
+
+/*****************************************************************************
+ * RECOVERY
+ *****************************************************************************/
+/*
+ * Undo the insert or delete of a leaf entry through the tree, wherever the entry is now
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::Undo(LogRecord *log_record) {
+  BUSTUB_ASSERT(log_record->GetIndexId() == index_id_ && log_record->GetEntry().size() == sizeof(MappingType),
+                "Undo of an entry of another index");
+  // After a restart, only the header page knows where the root is.
+  auto *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  if (header_page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch the header page");
+  }
+  page_id_t root_page_id;
+  if (!header_page->GetRootId(index_name_, &root_page_id)) {
+    root_page_id = INVALID_PAGE_ID;
+  }
+  latch_.WLock();
+  root_page_id_ = root_page_id;
+  latch_.WUnlock();
+  buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, false);
+
+  MappingType item;
+  memcpy(reinterpret_cast<void *>(&item), log_record->GetEntry().data(), sizeof(MappingType));
+  if (log_record->GetLogRecordType() == LogRecordType::BTREE_INSERT) {
+    Remove(item.first);
+  } else {
+    Insert(item.first, item.second);
+  }
+}
 
 /*****************************************************************************
  * UTILITIES AND DEBUG
@@ -213,7 +872,85 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::End() { return INDEXITERATOR_TYPE(); }
  */
 INDEX_TEMPLATE_ARGUMENTS
 Page *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, bool leftMost) {
-  throw Exception(ExceptionType::NOT_IMPLEMENTED, "Implement this for test");
+  Page *page = FindLeaf(key, leftMost, false);
+  if (page != nullptr) {
+    page->RUnlatch();
+  }
+  return page;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FindLeaf(const KeyType &key, bool left_most, bool exclusive) {
+  page_id_t page_id = root_page_id_;
+  if (page_id == INVALID_PAGE_ID) {
+    return nullptr;
+  }
+  // One page latched at a time: a page that split after its parent was read is made up for by moving right.
+  while (true) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch a page of the tree");
+    }
+    // The type of a page in the tree never changes, so it is read before latching, to latch a leaf in the right mode.
+    const bool is_leaf = reinterpret_cast<BPlusTreePage *>(page->GetData())->IsLeafPage();
+    const bool latch_exclusive = exclusive && is_leaf;
+    if (latch_exclusive) {
+      page->WLatch();
+    } else {
+      page->RLatch();
+    }
+    if (!left_most) {
+      page = MoveRight(page, key, latch_exclusive);
+    }
+    if (is_leaf) {
+      return page;
+    }
+    auto *internal = reinterpret_cast<InternalPage *>(page->GetData());
+    page_id = left_most ? internal->ValueAt(0) : internal->Lookup(key, comparator_);
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::MoveRight(Page *page, const KeyType &key, bool exclusive) {
+  while (true) {
+    auto *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    page_id_t next_page_id;
+    KeyType high_key;
+    if (node->IsLeafPage()) {
+      next_page_id = reinterpret_cast<LeafPage *>(node)->GetNextPageId();
+      high_key = reinterpret_cast<LeafPage *>(node)->GetHighKey();
+    } else {
+      next_page_id = reinterpret_cast<InternalPage *>(node)->GetNextPageId();
+      high_key = reinterpret_cast<InternalPage *>(node)->GetHighKey();
+    }
+    if (next_page_id == INVALID_PAGE_ID || comparator_(key, high_key) < 0) {
+      return page;
+    }
+    // Pages are only ever split to the right under latch_ held shared, so key is still to the right of this one.
+    if (exclusive) {
+      page->WUnlatch();
+    } else {
+      page->RUnlatch();
+    }
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    page = FetchLatched(next_page_id, exclusive);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FetchLatched(page_id_t page_id, bool exclusive) {
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch a page of the tree");
+  }
+  if (exclusive) {
+    page->WLatch();
+  } else {
+    page->RLatch();
+  }
+  return page;
 }
 
 /*
@@ -227,13 +964,25 @@ Page *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, bool leftMost) {
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
   HeaderPage *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
-  if (insert_record != 0) {
-    // create a new record<index_name + root_page_id> in header_page
-    header_page->InsertRecord(index_name_, root_page_id_);
-  } else {
+  const bool logged = BPlusTreePage::IsLogged(buffer_pool_manager_);
+  std::vector<char> before;
+  if (logged) {
+    before.assign(header_page->GetData(), header_page->GetData() + PAGE_SIZE);
+  }
+  // A tree that became empty and grows again still has its record.
+  if (insert_record == 0 || !header_page->InsertRecord(index_name_, root_page_id_)) {
     // update root_page_id in header_page
     header_page->UpdateRecord(index_name_, root_page_id_);
   }
+  if (logged) {
+    LogRecord log_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::INDEX_PAGE_WRITE, HEADER_PAGE_ID, before.data(),
+                         header_page->GetData());
+    LogManager *log_manager = buffer_pool_manager_->GetLogManager();
+    log_manager->AppendLogRecord(&log_record);
+    // The header page has no LSN that would keep the buffer pool from writing it before its log record, so wait for
+    // the record here. Roots change rarely.
+    log_manager->Flush();
+  }
   buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
 }
 
@@ -11,15 +11,23 @@
 
 #include "storage/index/b_plus_tree_index.h"
 
+#include <vector>
+
+#include "common/exception.h"
+#include "storage/index/external_sorter.h"
+
 namespace bustub {
 /*
  * Constructor
  */
 INDEX_TEMPLATE_ARGUMENTS
-BPLUSTREE_INDEX_TYPE::BPlusTreeIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager)
+BPLUSTREE_INDEX_TYPE::BPlusTreeIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager,
+                                     LockManager *lock_manager)
     : Index(std::move(metadata)),
       comparator_(GetMetadata()->GetKeySchema()),
-      container_(GetMetadata()->GetName(), buffer_pool_manager, comparator_) {}
+      buffer_pool_manager_(buffer_pool_manager),
+      container_(GetMetadata()->GetName(), buffer_pool_manager, comparator_, LEAF_PAGE_SIZE, INTERNAL_PAGE_SIZE,
+                 lock_manager) {}
 
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid, Transaction *transaction) {
@@ -36,7 +44,11 @@ void BPLUSTREE_INDEX_TYPE::DeleteEntry(const Tuple &key, RID rid, Transaction *t
   KeyType index_key;
   index_key.SetFromKey(key);
 
-  container_.Remove(index_key, transaction);
+  // The key may have been reinserted for another tuple since, whose entry stays.
+  std::vector<RID> rids;
+  if (container_.GetValue(index_key, &rids, transaction) && rids[0] == rid) {
+    container_.Remove(index_key, transaction);
+  }
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -48,6 +60,35 @@ void BPLUSTREE_INDEX_TYPE::ScanKey(const Tuple &key, std::vector<RID> *result, T
   container_.GetValue(index_key, result, transaction);
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::BulkLoad(const std::function<bool(Tuple *, RID *)> &next, Transaction *transaction) {
+  if (!container_.IsEmpty()) {
+    Index::BulkLoad(next, transaction);
+    return;
+  }
+  ExternalSorter<KeyType, ValueType, KeyComparator> sorter(buffer_pool_manager_, comparator_);
+  Tuple key;
+  RID rid;
+  size_t added = 0;
+  while (next(&key, &rid)) {
+    KeyType index_key;
+    index_key.SetFromKey(key);
+    sorter.Add(index_key, rid);
+    added++;
+  }
+  const size_t count = sorter.Finish();
+  if (count != added) {
+    throw Exception("Duplicate keys for a B+ tree index, which keeps every key once");
+  }
+  // A tree another thread inserted into meanwhile gets the entries one by one.
+  if (!container_.BulkLoad(count, [&sorter](MappingType *entry) { sorter.Next(entry); })) {
+    MappingType entry;
+    while (sorter.Next(&entry)) {
+      container_.Insert(entry.first, entry.second, transaction);
+    }
+  }
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator() { return container_.Begin(); }
 
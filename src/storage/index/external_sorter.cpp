@@ -0,0 +1,229 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// external_sorter.cpp
+//
+// Identification: src/storage/index/external_sorter.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/external_sorter.h"
+
+#include <algorithm>
+#include <iterator>
+#include <queue>
+
+#include "common/exception.h"
+#include "common/rid.h"
+#include "storage/index/generic_key.h"
+
+namespace bustub {
+
+INDEX_TEMPLATE_ARGUMENTS
+EXTERNAL_SORTER_TYPE::ExternalSorter(BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
+                                     size_t run_size)
+    : buffer_pool_manager_(buffer_pool_manager),
+      comparator_(comparator),
+      run_entries_(std::max<size_t>(1, run_size / sizeof(MappingType))) {}
+
+INDEX_TEMPLATE_ARGUMENTS
+EXTERNAL_SORTER_TYPE::~ExternalSorter() {
+  delete reader_;
+  for (const Run &run : runs_) {
+    for (page_id_t page_id : run.pages_) {
+      buffer_pool_manager_->DeletePage(page_id);
+    }
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void EXTERNAL_SORTER_TYPE::Add(const KeyType &key, const ValueType &value) {
+  BUSTUB_ASSERT(!finished_, "Adding to a finished sort");
+  entries_.emplace_back(key, value);
+  if (entries_.size() == run_entries_) {
+    Spill();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+size_t EXTERNAL_SORTER_TYPE::Finish() {
+  finished_ = true;
+  if (runs_.empty()) {
+    SortInMemory();
+    return entries_.size();
+  }
+  if (!entries_.empty()) {
+    Spill();
+  }
+  // Every run being merged pins a page, and so does the run merged into.
+  const size_t fan_in = std::max<size_t>(2, buffer_pool_manager_->GetPoolSize() / 2);
+  while (runs_.size() > 1) {
+    std::vector<Run> merged;
+    for (size_t i = 0; i < runs_.size(); i += fan_in) {
+      const auto end = runs_.begin() + std::min(i + fan_in, runs_.size());
+      std::vector<Run> group(std::make_move_iterator(runs_.begin() + i), std::make_move_iterator(end));
+      merged.push_back(group.size() == 1 ? std::move(group[0]) : Merge(std::move(group)));
+    }
+    runs_ = std::move(merged);
+  }
+  const size_t size = runs_[0].size_;
+  reader_ = new RunReader(buffer_pool_manager_, std::move(runs_[0]));
+  runs_.clear();
+  return size;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool EXTERNAL_SORTER_TYPE::Next(MappingType *entry) {
+  BUSTUB_ASSERT(finished_, "Reading an unfinished sort");
+  if (reader_ != nullptr) {
+    const MappingType *next = reader_->Next();
+    if (next == nullptr) {
+      return false;
+    }
+    *entry = *next;
+    return true;
+  }
+  if (next_entry_ == entries_.size()) {
+    return false;
+  }
+  *entry = entries_[next_entry_++];
+  return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void EXTERNAL_SORTER_TYPE::SortInMemory() {
+  // Stable, so that the first of the entries with the same key stays first.
+  std::stable_sort(entries_.begin(), entries_.end(), [this](const MappingType &a, const MappingType &b) {
+    return comparator_(a.first, b.first) < 0;
+  });
+  entries_.erase(std::unique(entries_.begin(), entries_.end(),
+                             [this](const MappingType &a, const MappingType &b) {
+                               return comparator_(a.first, b.first) == 0;
+                             }),
+                 entries_.end());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void EXTERNAL_SORTER_TYPE::Spill() {
+  SortInMemory();
+  Run run;
+  Page *page = nullptr;
+  for (const MappingType &entry : entries_) {
+    Append(&run, &page, entry);
+  }
+  if (page != nullptr) {
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+  }
+  runs_.push_back(std::move(run));
+  entries_.clear();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void EXTERNAL_SORTER_TYPE::Append(Run *run, Page **page, const MappingType &entry) {
+  const size_t offset = run->size_ % ENTRIES_PER_PAGE;
+  if (offset == 0) {
+    if (*page != nullptr) {
+      buffer_pool_manager_->UnpinPage((*page)->GetPageId(), true);
+    }
+    page_id_t page_id;
+    *page = buffer_pool_manager_->NewPage(&page_id);
+    if (*page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot allocate a page for a sorted run");
+    }
+    run->pages_.push_back(page_id);
+  }
+  reinterpret_cast<MappingType *>((*page)->GetData())[offset] = entry;
+  run->size_++;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+typename EXTERNAL_SORTER_TYPE::Run EXTERNAL_SORTER_TYPE::Merge(std::vector<Run> runs) {
+  std::vector<RunReader *> readers;
+  for (Run &run : runs) {
+    readers.push_back(new RunReader(buffer_pool_manager_, std::move(run)));
+  }
+  // The head of every run, the smallest key on top and, for the same key, the earliest run.
+  using Head = std::pair<MappingType, size_t>;
+  auto later = [this](const Head &a, const Head &b) {
+    const int order = comparator_(a.first.first, b.first.first);
+    return order > 0 || (order == 0 && a.second > b.second);
+  };
+  std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+  for (size_t i = 0; i < readers.size(); i++) {
+    const MappingType *entry = readers[i]->Next();
+    if (entry != nullptr) {
+      heads.emplace(*entry, i);
+    }
+  }
+
+  Run merged;
+  Page *page = nullptr;
+  MappingType last;
+  while (!heads.empty()) {
+    const Head head = heads.top();
+    heads.pop();
+    if (merged.size_ == 0 || comparator_(head.first.first, last.first) != 0) {
+      Append(&merged, &page, head.first);
+      last = head.first;
+    }
+    const MappingType *entry = readers[head.second]->Next();
+    if (entry != nullptr) {
+      heads.emplace(*entry, head.second);
+    }
+  }
+  if (page != nullptr) {
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+  }
+  for (RunReader *reader : readers) {
+    delete reader;
+  }
+  return merged;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+EXTERNAL_SORTER_TYPE::RunReader::~RunReader() {
+  ReleasePage();
+  for (size_t i = next_page_; i < run_.pages_.size(); i++) {
+    buffer_pool_manager_->DeletePage(run_.pages_[i]);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+const MappingType *EXTERNAL_SORTER_TYPE::RunReader::Next() {
+  if (position_ == run_.size_) {
+    ReleasePage();
+    return nullptr;
+  }
+  const size_t offset = position_ % ENTRIES_PER_PAGE;
+  if (offset == 0) {
+    ReleasePage();
+    page_ = buffer_pool_manager_->FetchPage(run_.pages_[next_page_++]);
+    if (page_ == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot fetch a page of a sorted run");
+    }
+  }
+  position_++;
+  return reinterpret_cast<const MappingType *>(page_->GetData()) + offset;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void EXTERNAL_SORTER_TYPE::RunReader::ReleasePage() {
+  if (page_ == nullptr) {
+    return;
+  }
+  const page_id_t page_id = page_->GetPageId();
+  buffer_pool_manager_->UnpinPage(page_id, false);
+  buffer_pool_manager_->DeletePage(page_id);
+  page_ = nullptr;
+}
+
+template class ExternalSorter<GenericKey<4>, RID, GenericComparator<4>>;
+template class ExternalSorter<GenericKey<8>, RID, GenericComparator<8>>;
+template class ExternalSorter<GenericKey<16>, RID, GenericComparator<16>>;
+template class ExternalSorter<GenericKey<32>, RID, GenericComparator<32>>;
+template class ExternalSorter<GenericKey<64>, RID, GenericComparator<64>>;
+
+}  // namespace bustub
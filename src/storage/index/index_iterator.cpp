@@ -7,24 +7,57 @@
 
 namespace bustub {
 
-/*
- * NOTE: you can change the destructor/constructor method here
- * set your own input parameters
- */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::IndexIterator() = default;
+INDEXITERATOR_TYPE::IndexIterator(BufferPoolManager *buffer_pool_manager, Page *page, int index)
+    : buffer_pool_manager_(buffer_pool_manager),
+      page_(page),
+      leaf_(page == nullptr ? nullptr : reinterpret_cast<LeafPage *>(page->GetData())),
+      index_(index) {
+  SkipExhaustedLeaves();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(IndexIterator &&other) noexcept
+    : buffer_pool_manager_(other.buffer_pool_manager_), page_(other.page_), leaf_(other.leaf_), index_(other.index_) {
+  other.page_ = nullptr;
+  other.leaf_ = nullptr;
+  other.index_ = 0;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::~IndexIterator() {  // NOLINT
+  if (page_ != nullptr) {
+    buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
+  }
+}
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::~IndexIterator() = default;  // NOLINT
+bool INDEXITERATOR_TYPE::IsEnd() { return page_ == nullptr; }
 
 INDEX_TEMPLATE_ARGUMENTS
-bool INDEXITERATOR_TYPE::IsEnd() { throw std::runtime_error("unimplemented"); }
+const MappingType &INDEXITERATOR_TYPE::operator*() {
+  assert(!IsEnd());
+  return leaf_->GetItem(index_);
+}
 
 INDEX_TEMPLATE_ARGUMENTS
-const MappingType &INDEXITERATOR_TYPE::operator*() { throw std::runtime_error("unimplemented"); }
+INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator++() {
+  assert(!IsEnd());
+  index_++;
+  SkipExhaustedLeaves();
+  return *this;
+}
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator++() { throw std::runtime_error("unimplemented"); }
+void INDEXITERATOR_TYPE::SkipExhaustedLeaves() {
+  while (page_ != nullptr && index_ >= leaf_->GetSize()) {
+    const page_id_t next_page_id = leaf_->GetNextPageId();
+    buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
+    page_ = next_page_id == INVALID_PAGE_ID ? nullptr : buffer_pool_manager_->FetchPage(next_page_id);
+    leaf_ = page_ == nullptr ? nullptr : reinterpret_cast<LeafPage *>(page_->GetData());
+    index_ = 0;
+  }
+}
 
 template class IndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
 
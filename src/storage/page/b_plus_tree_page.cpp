@@ -10,6 +10,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "storage/page/b_plus_tree_page.h"
+#include "storage/page/b_plus_tree_internal_page.h"
+#include "storage/page/b_plus_tree_leaf_page.h"
 
 namespace bustub {
 
@@ -17,45 +19,109 @@ namespace bustub {
  * Helper methods to get/set page type
  * Page type enum class is defined in b_plus_tree_page.h
  */
-bool BPlusTreePage::IsLeafPage() const { return false; }
-bool BPlusTreePage::IsRootPage() const { return false; }
-void BPlusTreePage::SetPageType(IndexPageType page_type) {}
+bool BPlusTreePage::IsLeafPage() const { return page_type_ == IndexPageType::LEAF_PAGE; }
+bool BPlusTreePage::IsRootPage() const { return parent_page_id_ == INVALID_PAGE_ID; }
+void BPlusTreePage::SetPageType(IndexPageType page_type) { page_type_ = page_type; }
 
 /*
  * Helper methods to get/set size (number of key/value pairs stored in that
  * page)
  */
-int BPlusTreePage::GetSize() const { return 0; }
-void BPlusTreePage::SetSize(int size) {}
-void BPlusTreePage::IncreaseSize(int amount) {}
+int BPlusTreePage::GetSize() const { return size_; }
+void BPlusTreePage::SetSize(int size) { size_ = size; }
+void BPlusTreePage::IncreaseSize(int amount) { size_ += amount; }
 
 /*
  * Helper methods to get/set max size (capacity) of the page
  */
-int BPlusTreePage::GetMaxSize() const { return 0; }
-void BPlusTreePage::SetMaxSize(int size) {}
+int BPlusTreePage::GetMaxSize() const { return max_size_; }
+void BPlusTreePage::SetMaxSize(int size) { max_size_ = size; }
 
 /*
  * Helper method to get min page size
  * Generally, min page size == max page size / 2
+ *
+ * A leaf splits as soon as it reaches its max size, while an internal page only splits once it exceeds it.
  */
-int BPlusTreePage::GetMinSize() const { return 0; }
+int BPlusTreePage::GetMinSize() const { return IsLeafPage() ? max_size_ / 2 : (max_size_ + 1) / 2; }
 
 /*
  * Helper methods to get/set parent page id
  */
-page_id_t BPlusTreePage::GetParentPageId() const { return 0; }
-void BPlusTreePage::SetParentPageId(page_id_t parent_page_id) {}
+page_id_t BPlusTreePage::GetParentPageId() const { return parent_page_id_; }
+void BPlusTreePage::SetParentPageId(page_id_t parent_page_id) { parent_page_id_ = parent_page_id; }
 
 /*
  * Helper methods to get/set self page id
  */
-page_id_t BPlusTreePage::GetPageId() const { return 0; }
-void BPlusTreePage::SetPageId(page_id_t page_id) {}
+page_id_t BPlusTreePage::GetPageId() const { return page_id_; }
+void BPlusTreePage::SetPageId(page_id_t page_id) { page_id_ = page_id; }
 
 /*
  * Helper methods to set lsn
  */
 void BPlusTreePage::SetLSN(lsn_t lsn) { lsn_ = lsn; }
 
+/*
+ * Untyped access to the entries, shared by the typed pages and recovery
+ */
+char *BPlusTreePage::EntryAt(int index, size_t entry_size) {
+  const size_t header_size = IsLeafPage() ? LEAF_PAGE_HEADER_SIZE : INTERNAL_PAGE_HEADER_SIZE;
+  return reinterpret_cast<char *>(this) + header_size + index * entry_size;
+}
+
+void BPlusTreePage::InsertEntryAt(int index, const char *entry, size_t entry_size) {
+  char *dest = EntryAt(index, entry_size);
+  memmove(dest + entry_size, dest, (size_ - index) * entry_size);
+  memcpy(dest, entry, entry_size);
+  size_++;
+}
+
+void BPlusTreePage::RemoveEntryAt(int index, size_t entry_size) {
+  char *dest = EntryAt(index, entry_size);
+  memmove(dest, dest + entry_size, (size_ - index - 1) * entry_size);
+  size_--;
+}
+
+/*
+ * Logging
+ */
+bool BPlusTreePage::IsLogged(BufferPoolManager *buffer_pool_manager) {
+  return enable_logging && buffer_pool_manager->GetLogManager() != nullptr;
+}
+
+void BPlusTreePage::LogEntry(LogRecordType log_record_type, uint32_t index_id, int index, const char *entry,
+                             size_t entry_size, Transaction *transaction, BufferPoolManager *buffer_pool_manager) {
+  if (!IsLogged(buffer_pool_manager)) {
+    return;
+  }
+  const txn_id_t txn_id = transaction == nullptr ? INVALID_TXN_ID : transaction->GetTransactionId();
+  const lsn_t prev_lsn = transaction == nullptr ? INVALID_LSN : transaction->GetPrevLSN();
+  LogRecord log_record(txn_id, prev_lsn, log_record_type, index_id, page_id_, index, entry, entry_size);
+  const lsn_t lsn = buffer_pool_manager->GetLogManager()->AppendLogRecord(&log_record);
+  lsn_ = lsn;
+  if (transaction != nullptr) {
+    transaction->SetPrevLSN(lsn);
+  }
+}
+
+std::vector<char> BPlusTreePage::CopyForLog(BufferPoolManager *buffer_pool_manager) const {
+  if (!IsLogged(buffer_pool_manager)) {
+    return {};
+  }
+  const auto *data = reinterpret_cast<const char *>(this);
+  return std::vector<char>(data, data + PAGE_SIZE);
+}
+
+void BPlusTreePage::LogPageWrite(const std::vector<char> &before, BufferPoolManager *buffer_pool_manager) {
+  if (before.empty()) {
+    return;
+  }
+  LogRecord log_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::INDEX_PAGE_WRITE, page_id_, before.data(),
+                       reinterpret_cast<const char *>(this));
+  if (!log_record.GetPageWriteRanges().empty()) {
+    lsn_ = buffer_pool_manager->GetLogManager()->AppendLogRecord(&log_record);
+  }
+}
+
 }  // namespace bustub
@@ -10,6 +10,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <cstring>
+
 #include "storage/page/hash_table_bucket_page.h"
 #include "common/logger.h"
 #include "common/util/hash_util.h"
@@ -19,63 +22,168 @@
 
 namespace bustub {
 
+/*
+ * Layout shared by all bucket pages
+ */
+page_id_t HashTableBucketPageBase::GetPageId() const { return page_id_; }
+
+void HashTableBucketPageBase::SetPageId(page_id_t page_id) { page_id_ = page_id; }
+
+lsn_t HashTableBucketPageBase::GetLSN() const { return lsn_; }
+
+void HashTableBucketPageBase::SetLSN(lsn_t lsn) { lsn_ = lsn; }
+
+void HashTableBucketPageBase::InsertEntryAt(uint32_t bucket_idx, const char *entry, size_t entry_size) {
+  memcpy(EntryAt(bucket_idx, entry_size), entry, entry_size);
+  SetOccupied(bucket_idx);
+  SetReadable(bucket_idx, entry_size, true);
+}
+
+void HashTableBucketPageBase::RemoveEntryAt(uint32_t bucket_idx, size_t entry_size) {
+  SetReadable(bucket_idx, entry_size, false);
+}
+
+char *HashTableBucketPageBase::EntryAt(uint32_t bucket_idx, size_t entry_size) {
+  return Bitmaps() + 2 * BitmapSize(entry_size) + bucket_idx * entry_size;
+}
+
+const char *HashTableBucketPageBase::EntryAt(uint32_t bucket_idx, size_t entry_size) const {
+  return Bitmaps() + 2 * BitmapSize(entry_size) + bucket_idx * entry_size;
+}
+
+bool HashTableBucketPageBase::IsOccupied(uint32_t bucket_idx) const {
+  return (Bitmaps()[bucket_idx / 8] & (1 << (bucket_idx % 8))) != 0;
+}
+
+bool HashTableBucketPageBase::IsReadable(uint32_t bucket_idx, size_t entry_size) const {
+  return (Bitmaps()[BitmapSize(entry_size) + bucket_idx / 8] & (1 << (bucket_idx % 8))) != 0;
+}
+
+void HashTableBucketPageBase::SetOccupied(uint32_t bucket_idx) { Bitmaps()[bucket_idx / 8] |= 1 << (bucket_idx % 8); }
+
+void HashTableBucketPageBase::SetReadable(uint32_t bucket_idx, size_t entry_size, bool readable) {
+  char &byte = Bitmaps()[BitmapSize(entry_size) + bucket_idx / 8];
+  if (readable) {
+    byte |= 1 << (bucket_idx % 8);
+  } else {
+    byte &= ~(1 << (bucket_idx % 8));
+  }
+}
+
+uint32_t HashTableBucketPageBase::NumReadable(size_t entry_size) const {
+  const char *readable = Bitmaps() + BitmapSize(entry_size);
+  uint32_t count = 0;
+  for (size_t i = 0; i < BitmapSize(entry_size); i++) {
+    count += __builtin_popcount(static_cast<uint8_t>(readable[i]));
+  }
+  return count;
+}
+
+/*
+ * Typed bucket pages
+ */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::GetValue(KeyType key, KeyComparator cmp, std::vector<ValueType> *result) {
-  return false;
+  bool found = false;
+  // Slots are taken front to back, so the occupied ones form a prefix.
+  for (uint32_t bucket_idx = 0; bucket_idx < BUCKET_ARRAY_SIZE && IsOccupied(bucket_idx); bucket_idx++) {
+    if (IsReadable(bucket_idx) && cmp(KeyAt(bucket_idx), key) == 0) {
+      result->push_back(ValueAt(bucket_idx));
+      found = true;
+    }
+  }
+  return found;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-bool HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator cmp) {
+bool HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator cmp, uint32_t *bucket_idx) {
+  uint32_t free_idx = BUCKET_ARRAY_SIZE;
+  uint32_t idx = 0;
+  for (; idx < BUCKET_ARRAY_SIZE && IsOccupied(idx); idx++) {
+    if (!IsReadable(idx)) {
+      free_idx = std::min(free_idx, idx);
+    } else if (cmp(KeyAt(idx), key) == 0 && ValueAt(idx) == value) {
+      return false;
+    }
+  }
+  free_idx = std::min(free_idx, idx);
+  if (free_idx == BUCKET_ARRAY_SIZE) {
+    return false;
+  }
+  const MappingType item(key, value);
+  InsertEntryAt(free_idx, reinterpret_cast<const char *>(&item), sizeof(MappingType));
+  if (bucket_idx != nullptr) {
+    *bucket_idx = free_idx;
+  }
   return true;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-bool HASH_TABLE_BUCKET_TYPE::Remove(KeyType key, ValueType value, KeyComparator cmp) {
+bool HASH_TABLE_BUCKET_TYPE::Remove(KeyType key, ValueType value, KeyComparator cmp, uint32_t *bucket_idx) {
+  for (uint32_t idx = 0; idx < BUCKET_ARRAY_SIZE && IsOccupied(idx); idx++) {
+    if (IsReadable(idx) && cmp(KeyAt(idx), key) == 0 && ValueAt(idx) == value) {
+      RemoveAt(idx);
+      if (bucket_idx != nullptr) {
+        *bucket_idx = idx;
+      }
+      return true;
+    }
+  }
   return false;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 KeyType HASH_TABLE_BUCKET_TYPE::KeyAt(uint32_t bucket_idx) const {
-  return {};
+  MappingType item;
+  memcpy(reinterpret_cast<void *>(&item), EntryAt(bucket_idx, sizeof(MappingType)), sizeof(MappingType));
+  return item.first;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 ValueType HASH_TABLE_BUCKET_TYPE::ValueAt(uint32_t bucket_idx) const {
-  return {};
+  MappingType item;
+  memcpy(reinterpret_cast<void *>(&item), EntryAt(bucket_idx, sizeof(MappingType)), sizeof(MappingType));
+  return item.second;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-void HASH_TABLE_BUCKET_TYPE::RemoveAt(uint32_t bucket_idx) {}
+void HASH_TABLE_BUCKET_TYPE::RemoveAt(uint32_t bucket_idx) {
+  RemoveEntryAt(bucket_idx, sizeof(MappingType));
+}
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::IsOccupied(uint32_t bucket_idx) const {
-  return false;
+  return HashTableBucketPageBase::IsOccupied(bucket_idx);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-void HASH_TABLE_BUCKET_TYPE::SetOccupied(uint32_t bucket_idx) {}
+void HASH_TABLE_BUCKET_TYPE::SetOccupied(uint32_t bucket_idx) {
+  HashTableBucketPageBase::SetOccupied(bucket_idx);
+}
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::IsReadable(uint32_t bucket_idx) const {
-  return false;
+  return HashTableBucketPageBase::IsReadable(bucket_idx, sizeof(MappingType));
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-void HASH_TABLE_BUCKET_TYPE::SetReadable(uint32_t bucket_idx) {}
+void HASH_TABLE_BUCKET_TYPE::SetReadable(uint32_t bucket_idx) {
+  HashTableBucketPageBase::SetReadable(bucket_idx, sizeof(MappingType), true);
+}
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::IsFull() {
-  return false;
+  return NumReadable() == BUCKET_ARRAY_SIZE;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 uint32_t HASH_TABLE_BUCKET_TYPE::NumReadable() {
-  return 0;
+  return HashTableBucketPageBase::NumReadable(sizeof(MappingType));
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::IsEmpty() {
-  return false;
+  return NumReadable() == 0;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
@@ -10,7 +10,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 #include "common/logger.h"
 #include "storage/table/table_heap.h"
@@ -18,15 +20,16 @@
 namespace bustub {
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                     page_id_t first_page_id)
+                     page_id_t first_page_id, table_oid_t oid)
     : buffer_pool_manager_(buffer_pool_manager),
       lock_manager_(lock_manager),
       log_manager_(log_manager),
-      first_page_id_(first_page_id) {}
+      first_page_id_(first_page_id),
+      oid_(oid) {}
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                     Transaction *txn)
-    : buffer_pool_manager_(buffer_pool_manager), lock_manager_(lock_manager), log_manager_(log_manager) {
+                     Transaction *txn, table_oid_t oid)
+    : buffer_pool_manager_(buffer_pool_manager), lock_manager_(lock_manager), log_manager_(log_manager), oid_(oid) {
   // Initialize the first table page.
   auto first_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(&first_page_id_));
   BUSTUB_ASSERT(first_page != nullptr, "Couldn't create a page for the table heap.");
@@ -37,7 +40,8 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_m
 }
 
 bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
-  if (tuple.size_ + 32 > PAGE_SIZE) {  // larger than one page size
+  // A read-only transaction aborts on its first write, as it would on a failed one.
+  if (tuple.size_ + 32 > PAGE_SIZE || txn->IsReadOnly()) {  // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
@@ -51,7 +55,7 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
   cur_page->WLatch();
   // Insert into the first page with enough space. If no such page exists, create a new page and insert into that.
   // INVARIANT: cur_page is WLatched if you leave the loop normally.
-  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_)) {
+  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_, oid_)) {
     auto next_page_id = cur_page->GetNextPageId();
     // If the next page is a valid page,
     if (next_page_id != INVALID_PAGE_ID) {
@@ -81,6 +85,8 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
       cur_page = new_page;
     }
   }
+  // Snapshots older than the insert do not see the tuple.
+  SaveVersion(*rid, txn, nullptr);
   // This line has caused most of us to double-take and "whoa double unlatch".
   // We are not, in fact, double unlatching. See the invariant above.
   cur_page->WUnlatch();
@@ -91,6 +97,13 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
 }
 
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  if (txn->InReadPhase()) {
+    return BufferWrite(rid, WType::DELETE, Tuple{}, txn);
+  }
   // TODO(Amadou): remove empty page
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -99,9 +112,19 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
-  // Otherwise, mark the tuple as deleted.
+  // Otherwise, mark the tuple as deleted, saving its value for the snapshots that still see it.
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  if (!CheckWriteConflict(rid, txn)) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  Tuple old_tuple;
+  const bool exists = page->ReadTuple(rid, &old_tuple);
+  if (page->MarkDelete(rid, txn, lock_manager_, log_manager_, oid_) && exists) {
+    SaveVersion(rid, txn, &old_tuple);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   // Update the transaction's write set.
@@ -110,6 +133,13 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  if (txn->InReadPhase()) {
+    return BufferWrite(rid, WType::UPDATE, tuple, txn);
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -120,7 +150,16 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
   page->WLatch();
-  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  if (!CheckWriteConflict(rid, txn)) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_, oid_);
+  if (is_updated) {
+    SaveVersion(rid, txn, &old_tuple);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
   // Update the transaction's write set.
@@ -154,6 +193,18 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
 }
 
 bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
+  // An optimistic transaction reads its own buffered writes.
+  if (txn->InReadPhase()) {
+    auto buffered = txn->GetBufferedWriteSet()->find(rid);
+    if (buffered != txn->GetBufferedWriteSet()->end()) {
+      if (buffered->second.wtype_ == WType::DELETE) {
+        return false;
+      }
+      *tuple = buffered->second.tuple_;
+      tuple->rid_ = rid;
+      return true;
+    }
+  }
   // Find the page which contains the tuple.
   auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -161,24 +212,41 @@ bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
-  // Read the tuple from the page.
+  // Read the tuple from the page. Snapshot and optimistic reads take no lock, and may see an older version than the
+  // page's.
   page->RLatch();
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool res;
+  if (ReadsVersions(txn)) {
+    res = ReadVersion(rid, txn, tuple, page->ReadTuple(rid, tuple));
+    if (txn->InReadPhase()) {
+      txn->GetReadSet()->insert(rid);
+    }
+  } else {
+    res = page->GetTuple(rid, tuple, txn, lock_manager_, oid_);
+  }
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
   return res;
 }
 
+bool TableHeap::LockTable(Transaction *txn, LockMode mode) {
+  if (lock_manager_ == nullptr || ReadsVersions(txn)) {
+    return true;
+  }
+  return lock_manager_->LockTable(txn, oid_, mode);
+}
+
 TableIterator TableHeap::Begin(Transaction *txn) {
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
   RID rid;
+  const bool all_slots = ReadsVersions(txn);
   auto page_id = first_page_id_;
   while (page_id != INVALID_PAGE_ID) {
     auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
     page->RLatch();
     // If this fails because there is no tuple, then RID will be the default-constructed value, which means EOF.
-    auto found_tuple = page->GetFirstTupleRid(&rid);
+    auto found_tuple = page->GetFirstTupleRid(&rid, all_slots);
     page->RUnlatch();
     buffer_pool_manager_->UnpinPage(page_id, false);
     if (found_tuple) {
@@ -189,6 +257,145 @@ TableIterator TableHeap::Begin(Transaction *txn) {
   return TableIterator(this, rid, txn);
 }
 
+void TableHeap::CommitVersion(const RID &rid, Transaction *txn, timestamp_t commit_ts) {
+  std::scoped_lock guard(version_latch_);
+  auto it = version_chains_.find(rid);
+  // The write set may name the tuple more than once.
+  if (it == version_chains_.end() || it->second.writer_ != txn->GetTransactionId()) {
+    return;
+  }
+  it->second.writer_ = INVALID_TXN_ID;
+  it->second.head_ts_ = commit_ts;
+}
+
+void TableHeap::AbortVersion(const RID &rid, Transaction *txn) {
+  std::scoped_lock guard(version_latch_);
+  auto it = version_chains_.find(rid);
+  if (it == version_chains_.end() || it->second.writer_ != txn->GetTransactionId()) {
+    return;
+  }
+  // The page holds the saved value again, which was committed at head_ts_.
+  VersionChain &chain = it->second;
+  chain.writer_ = INVALID_TXN_ID;
+  chain.versions_.pop_front();
+  if (chain.versions_.empty()) {
+    version_chains_.erase(it);
+  }
+}
+
+void TableHeap::PruneVersions(const RID &rid, timestamp_t watermark) {
+  std::scoped_lock guard(version_latch_);
+  auto it = version_chains_.find(rid);
+  if (it == version_chains_.end()) {
+    return;
+  }
+  PruneChain(&it->second, watermark);
+  if (it->second.writer_ == INVALID_TXN_ID && it->second.versions_.empty()) {
+    version_chains_.erase(it);
+  }
+}
+
+void TableHeap::GarbageCollect(timestamp_t watermark) {
+  std::scoped_lock guard(version_latch_);
+  for (auto it = version_chains_.begin(); it != version_chains_.end();) {
+    PruneChain(&it->second, watermark);
+    if (it->second.writer_ == INVALID_TXN_ID && it->second.versions_.empty()) {
+      it = version_chains_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t TableHeap::GetVersionCount() {
+  std::scoped_lock guard(version_latch_);
+  size_t count = 0;
+  for (const auto &[rid, chain] : version_chains_) {
+    count += chain.versions_.size();
+  }
+  return count;
+}
+
+bool TableHeap::CheckWriteConflict(const RID &rid, Transaction *txn) {
+  if (txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION) {
+    return true;
+  }
+  std::scoped_lock guard(version_latch_);
+  auto it = version_chains_.find(rid);
+  if (it == version_chains_.end() || it->second.writer_ == txn->GetTransactionId()) {
+    return true;
+  }
+  return it->second.writer_ == INVALID_TXN_ID && it->second.head_ts_ <= txn->GetReadTs();
+}
+
+void TableHeap::SaveVersion(const RID &rid, Transaction *txn, const Tuple *old_tuple) {
+  std::scoped_lock guard(version_latch_);
+  VersionChain &chain = version_chains_[rid];
+  if (chain.writer_ == txn->GetTransactionId()) {
+    // The value before the first write of the transaction is saved already.
+    return;
+  }
+  // If another writer has not finished, which only happens without locking or when an insert reuses the slot of an
+  // insert that is being rolled back, the value it saved is still the last committed one.
+  if (chain.writer_ == INVALID_TXN_ID) {
+    if (old_tuple == nullptr) {
+      chain.versions_.push_front(TupleVersion{chain.head_ts_, true, Tuple{}});
+    } else {
+      chain.versions_.push_front(TupleVersion{chain.head_ts_, false, *old_tuple});
+    }
+  }
+  chain.writer_ = txn->GetTransactionId();
+}
+
+bool TableHeap::ReadVersion(const RID &rid, Transaction *txn, Tuple *tuple, bool on_page) {
+  std::scoped_lock guard(version_latch_);
+  auto it = version_chains_.find(rid);
+  if (it == version_chains_.end()) {
+    return on_page;
+  }
+  const VersionChain &chain = it->second;
+  // An optimistic transaction reads the last committed version.
+  const timestamp_t read_ts =
+      txn->InReadPhase() ? std::numeric_limits<timestamp_t>::max() : txn->GetReadTs();
+  if (chain.writer_ == txn->GetTransactionId() || (chain.writer_ == INVALID_TXN_ID && chain.head_ts_ <= read_ts)) {
+    return on_page;
+  }
+  for (const TupleVersion &version : chain.versions_) {
+    if (version.begin_ts_ <= read_ts) {
+      if (version.deleted_) {
+        return false;
+      }
+      *tuple = version.tuple_;
+      tuple->rid_ = rid;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TableHeap::BufferWrite(const RID &rid, WType wtype, const Tuple &tuple, Transaction *txn) {
+  // Reading the tuple puts it into the read set, so that validation catches a concurrent write to it.
+  Tuple old_tuple;
+  if (!GetTuple(rid, &old_tuple, txn)) {
+    return false;
+  }
+  txn->GetBufferedWriteSet()->insert_or_assign(rid, TableWriteRecord{rid, wtype, tuple, this});
+  return true;
+}
+
+void TableHeap::PruneChain(VersionChain *chain, timestamp_t watermark) {
+  // Every snapshot in use sees the page, or a version newer than the first one current at the watermark.
+  if (chain->writer_ == INVALID_TXN_ID && chain->head_ts_ <= watermark) {
+    chain->versions_.clear();
+    return;
+  }
+  auto it = std::find_if(chain->versions_.begin(), chain->versions_.end(),
+                         [watermark](const TupleVersion &version) { return version.begin_ts_ <= watermark; });
+  if (it != chain->versions_.end()) {
+    chain->versions_.erase(it + 1, chain->versions_.end());
+  }
+}
+
 TableIterator TableHeap::End() { return TableIterator(this, RID(INVALID_PAGE_ID, 0), nullptr); }
 
 }  // namespace bustub
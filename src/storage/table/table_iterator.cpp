@@ -18,8 +18,9 @@ namespace bustub {
 
 TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
     : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
-  if (rid.GetPageId() != INVALID_PAGE_ID) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+  if (rid.GetPageId() != INVALID_PAGE_ID && !table_heap_->GetTuple(tuple_->rid_, tuple_, txn_) &&
+      TableHeap::ReadsVersions(txn_)) {
+    ++(*this);
   }
 }
 
@@ -34,34 +35,42 @@ Tuple *TableIterator::operator->() {
 }
 
 TableIterator &TableIterator::operator++() {
+  // A scan that reads versions skips the slots of tuples it does not see.
+  while (!Advance() && TableHeap::ReadsVersions(txn_)) {
+  }
+  return *this;
+}
+
+bool TableIterator::Advance() {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
   auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
   cur_page->RLatch();
   assert(cur_page != nullptr);  // all pages are pinned
 
   RID next_tuple_rid;
-  if (!cur_page->GetNextTupleRid(tuple_->rid_,
-                                 &next_tuple_rid)) {  // end of this page
+  const bool all_slots = TableHeap::ReadsVersions(txn_);
+  if (!cur_page->GetNextTupleRid(tuple_->rid_, &next_tuple_rid, all_slots)) {  // end of this page
     while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
       auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
       cur_page->RUnlatch();
       buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
       cur_page = next_page;
       cur_page->RLatch();
-      if (cur_page->GetFirstTupleRid(&next_tuple_rid)) {
+      if (cur_page->GetFirstTupleRid(&next_tuple_rid, all_slots)) {
         break;
       }
     }
   }
   tuple_->rid_ = next_tuple_rid;
 
+  bool found = true;
   if (*this != table_heap_->End()) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    found = table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
   }
   // release until copy the tuple
   cur_page->RUnlatch();
   buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
-  return *this;
+  return found;
 }
 
 TableIterator TableIterator::operator++(int) {
@@ -688,4 +688,110 @@ TEST(CatalogTest, DISABLED_IndexInteraction3) {
   remove("catalog_test.log");
 }
 
+// An index created on a table that has tuples already is bulk loaded with them
+TEST(CatalogTest, CreateIndexOnFilledTable) {
+  auto disk_manager = std::make_unique<DiskManager>("catalog_test.db");
+  auto bpm = std::make_unique<BufferPoolManagerInstance>(32, disk_manager.get());
+  auto catalog = std::make_unique<Catalog>(bpm.get(), nullptr, nullptr);
+  auto txn = std::make_unique<Transaction>(0);
+
+  std::vector<Column> columns{{"A", TypeId::BIGINT}, {"B", TypeId::INTEGER}};
+  Schema table_schema{columns};
+  auto *table_info = catalog->CreateTable(txn.get(), "foobar", table_schema);
+  ASSERT_NE(Catalog::NULL_TABLE_INFO, table_info);
+
+  // Keys go in out of order
+  const int num_tuples = 2000;
+  auto key_of = [&](int i) { return ValueFactory::GetBigIntValue((i * 7919) % num_tuples); };
+  std::vector<RID> rids(num_tuples);
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple{std::vector<Value>{key_of(i), ValueFactory::GetIntegerValue(i)}, &table_schema};
+    ASSERT_TRUE(table_info->table_->InsertTuple(tuple, &rids[i], txn.get()));
+  }
+
+  std::vector<Column> key_columns{{"A", TypeId::BIGINT}};
+  Schema key_schema{key_columns};
+  auto *index_info = catalog->CreateIndex<BigintKeyType, BigintValueType, BigintComparatorType>(
+      txn.get(), "index1", "foobar", table_schema, key_schema, {0}, BIGINT_SIZE, BigintHashFunctionType{},
+      IndexType::BPlusTreeIndex);
+  ASSERT_NE(Catalog::NULL_INDEX_INFO, index_info);
+  auto *index = index_info->index_.get();
+  EXPECT_NE(nullptr, (dynamic_cast<BPlusTreeIndex<BigintKeyType, BigintValueType, BigintComparatorType> *>(index)));
+
+  for (int i = 0; i < num_tuples; i++) {
+    std::vector<RID> results{};
+    index->ScanKey(Tuple{std::vector<Value>{key_of(i)}, &key_schema}, &results, txn.get());
+    ASSERT_EQ(1, results.size());
+    EXPECT_EQ(rids[i], results[0]);
+  }
+
+  // The table is intact, and so is a hash index built from it
+  index_info = catalog->CreateIndex<BigintKeyType, BigintValueType, BigintComparatorType>(
+      txn.get(), "index2", "foobar", table_schema, key_schema, {0}, BIGINT_SIZE, BigintHashFunctionType{});
+  ASSERT_NE(Catalog::NULL_INDEX_INFO, index_info);
+  for (int i = 0; i < num_tuples; i++) {
+    std::vector<RID> results{};
+    index_info->index_->ScanKey(Tuple{std::vector<Value>{key_of(i)}, &key_schema}, &results, txn.get());
+    ASSERT_EQ(1, results.size());
+    EXPECT_EQ(rids[i], results[0]);
+  }
+
+  remove("catalog_test.db");
+  DiskManager::RemoveLogFiles("catalog_test.db");
+}
+
+// A hash index, the default, keeps duplicate keys, which a B+ tree index refuses
+TEST(CatalogTest, CreateIndexOnDuplicateKeys) {
+  auto disk_manager = std::make_unique<DiskManager>("catalog_test.db");
+  auto bpm = std::make_unique<BufferPoolManagerInstance>(32, disk_manager.get());
+  auto catalog = std::make_unique<Catalog>(bpm.get(), nullptr, nullptr);
+  auto txn = std::make_unique<Transaction>(0);
+
+  std::vector<Column> columns{{"A", TypeId::BIGINT}, {"B", TypeId::INTEGER}};
+  Schema table_schema{columns};
+  auto *table_info = catalog->CreateTable(txn.get(), "foobar", table_schema);
+  ASSERT_NE(Catalog::NULL_TABLE_INFO, table_info);
+  std::vector<RID> rids(2);
+  for (int i = 0; i < 2; i++) {
+    Tuple tuple{std::vector<Value>{ValueFactory::GetBigIntValue(7), ValueFactory::GetIntegerValue(i)}, &table_schema};
+    ASSERT_TRUE(table_info->table_->InsertTuple(tuple, &rids[i], txn.get()));
+  }
+
+  std::vector<Column> key_columns{{"A", TypeId::BIGINT}};
+  Schema key_schema{key_columns};
+  const Tuple key{std::vector<Value>{ValueFactory::GetBigIntValue(7)}, &key_schema};
+  auto *index_info = catalog->CreateIndex<BigintKeyType, BigintValueType, BigintComparatorType>(
+      txn.get(), "index1", "foobar", table_schema, key_schema, {0}, BIGINT_SIZE, BigintHashFunctionType{});
+  ASSERT_NE(Catalog::NULL_INDEX_INFO, index_info);
+  std::vector<RID> results{};
+  index_info->index_->ScanKey(key, &results, txn.get());
+  EXPECT_EQ(2, results.size());
+
+  EXPECT_THROW((catalog->CreateIndex<BigintKeyType, BigintValueType, BigintComparatorType>(
+                   txn.get(), "index2", "foobar", table_schema, key_schema, {0}, BIGINT_SIZE,
+                   BigintHashFunctionType{}, IndexType::BPlusTreeIndex)),
+               Exception);
+  EXPECT_EQ(nullptr, catalog->GetIndex("index2", "foobar"));
+
+  // Deleting the entry of a key for another tuple leaves the entry in a B+ tree index
+  ASSERT_NE(Catalog::NULL_TABLE_INFO, catalog->CreateTable(txn.get(), "empty", table_schema));
+  index_info = catalog->CreateIndex<BigintKeyType, BigintValueType, BigintComparatorType>(
+      txn.get(), "index3", "empty", table_schema, key_schema, {0}, BIGINT_SIZE, BigintHashFunctionType{},
+      IndexType::BPlusTreeIndex);
+  ASSERT_NE(Catalog::NULL_INDEX_INFO, index_info);
+  index_info->index_->InsertEntry(key, rids[0], txn.get());
+  index_info->index_->DeleteEntry(key, rids[1], txn.get());
+  results.clear();
+  index_info->index_->ScanKey(key, &results, txn.get());
+  ASSERT_EQ(1, results.size());
+  EXPECT_EQ(rids[0], results[0]);
+  index_info->index_->DeleteEntry(key, rids[0], txn.get());
+  results.clear();
+  index_info->index_->ScanKey(key, &results, txn.get());
+  EXPECT_TRUE(results.empty());
+
+  remove("catalog_test.db");
+  DiskManager::RemoveLogFiles("catalog_test.db");
+}
+
 }  // namespace bustub
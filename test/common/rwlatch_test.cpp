@@ -10,14 +10,19 @@
 //
 //===----------------------------------------------------------------------===//
 
-#include <thread>  // NOLINT
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <thread>              // NOLINT
 #include <vector>
 
+#include "common/logger.h"
 #include "common/rwlatch.h"
 #include "gtest/gtest.h"
 
 namespace bustub {
 
+template <typename Latch>
 class Counter {
  public:
   Counter() = default;
@@ -36,13 +41,19 @@ class Counter {
 
  private:
   int count_{0};
-  ReaderWriterLatch mutex_{};
+  Latch mutex_{};
 };
 
+template <typename Latch>
+class RWLatchTest : public ::testing::Test {};
+
+using Latches = ::testing::Types<ReaderWriterLatch, DistributedReaderWriterLatch>;
+TYPED_TEST_SUITE(RWLatchTest, Latches);
+
 // NOLINTNEXTLINE
-TEST(RWLatchTest, BasicTest) {
+TYPED_TEST(RWLatchTest, BasicTest) {
   int num_threads = 100;
-  Counter counter{};
+  Counter<TypeParam> counter{};
   counter.Add(5);
   std::vector<std::thread> threads;
   for (int tid = 0; tid < num_threads; tid++) {
@@ -57,4 +68,115 @@ TEST(RWLatchTest, BasicTest) {
   }
   EXPECT_EQ(counter.Read(), 55);
 }
+
+// NOLINTNEXTLINE
+TYPED_TEST(RWLatchTest, WriterPreferenceTest) {
+  TypeParam latch;
+  latch.RLock();
+  std::atomic<bool> writer_in{false};
+  std::atomic<bool> reader_in{false};
+  std::thread writer([&] {
+    latch.WLock();
+    writer_in = true;
+    latch.WUnlock();
+  });
+  // Wait until the writer has entered and waits for the reader, then a new reader has to queue up behind it.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  std::thread reader([&] {
+    latch.RLock();
+    reader_in = true;
+    EXPECT_TRUE(writer_in);
+    latch.RUnlock();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(writer_in);
+  EXPECT_FALSE(reader_in);
+  latch.RUnlock();
+  writer.join();
+  reader.join();
+  EXPECT_TRUE(writer_in);
+  EXPECT_TRUE(reader_in);
+}
+
+/** The latch ReaderWriterLatch used to be, on one mutex and two condition variables, to compare against. */
+class MutexReaderWriterLatch {
+ public:
+  void WLock() {
+    std::unique_lock<std::mutex> latch(mutex_);
+    reader_.wait(latch, [this] { return !writer_entered_; });
+    writer_entered_ = true;
+    writer_.wait(latch, [this] { return reader_count_ == 0; });
+  }
+  void WUnlock() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    writer_entered_ = false;
+    reader_.notify_all();
+  }
+  void RLock() {
+    std::unique_lock<std::mutex> latch(mutex_);
+    reader_.wait(latch, [this] { return !writer_entered_; });
+    reader_count_++;
+  }
+  void RUnlock() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    reader_count_--;
+    if (writer_entered_ && reader_count_ == 0) {
+      writer_.notify_one();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable writer_;
+  std::condition_variable reader_;
+  uint32_t reader_count_{0};
+  bool writer_entered_{false};
+};
+
+/** Runs num_threads threads that each take the latch ops times, one time in write_every exclusively. */
+template <typename Latch>
+int64_t RunLatchBenchmark(int num_threads, int ops, int write_every) {
+  Latch latch;
+  int64_t shared_value = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&] {
+      int64_t sum = 0;
+      for (int i = 1; i <= ops; i++) {
+        if (i % write_every == 0) {
+          latch.WLock();
+          shared_value++;
+          latch.WUnlock();
+        } else {
+          latch.RLock();
+          sum += shared_value;
+          latch.RUnlock();
+        }
+      }
+      EXPECT_GE(sum, 0);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(shared_value, num_threads * (ops / write_every));
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// NOLINTNEXTLINE
+TEST(RWLatchBenchmark, DISABLED_ReadMostlyTest) {
+  const int num_threads = 8;
+  const int ops = 200000;
+  for (int write_every : {10, 1000}) {
+    const int64_t mutex_ms = RunLatchBenchmark<MutexReaderWriterLatch>(num_threads, ops, write_every);
+    const int64_t atomic_ms = RunLatchBenchmark<ReaderWriterLatch>(num_threads, ops, write_every);
+    const int64_t distributed_ms = RunLatchBenchmark<DistributedReaderWriterLatch>(num_threads, ops, write_every);
+    LOG_INFO("1 write in %d: mutex %ld ms, atomic %ld ms, distributed %ld ms", write_every,
+             static_cast<long>(mutex_ms), static_cast<long>(atomic_ms),  // NOLINT
+             static_cast<long>(distributed_ms));                         // NOLINT
+  }
+}
+
 }  // namespace bustub
@@ -0,0 +1,57 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// varint_util_test.cpp
+//
+// Identification: test/common/varint_util_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "common/util/varint_util.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(VarintUtilTest, RoundTripTest) {
+  const std::vector<int64_t> values{0,
+                                    1,
+                                    -1,
+                                    63,
+                                    -64,
+                                    64,
+                                    1LL << 31,
+                                    (1LL << 32) + 1,
+                                    std::numeric_limits<int64_t>::max(),
+                                    std::numeric_limits<int64_t>::min()};
+  char buf[VarintUtil::MAX_SIZE];
+  for (int64_t value : values) {
+    char *end = VarintUtil::EncodeSigned(value, buf);
+    EXPECT_EQ(end - buf, VarintUtil::SignedSize(value));
+    const char *pos = buf;
+    int64_t decoded;
+    ASSERT_TRUE(VarintUtil::DecodeSigned(&pos, end, &decoded));
+    EXPECT_EQ(decoded, value);
+    EXPECT_EQ(pos, end);
+
+    // A value cut short is rejected.
+    pos = buf;
+    EXPECT_FALSE(VarintUtil::DecodeSigned(&pos, end - 1, &decoded));
+  }
+
+  // Small values, and the invalid ids, take a single byte.
+  EXPECT_EQ(VarintUtil::SignedSize(-1), 1);
+  EXPECT_EQ(VarintUtil::SignedSize(63), 1);
+  EXPECT_EQ(VarintUtil::Size(127), 1);
+  EXPECT_EQ(VarintUtil::Size(128), 2);
+  EXPECT_EQ(VarintUtil::Size(std::numeric_limits<uint64_t>::max()), VarintUtil::MAX_SIZE);
+}
+
+}  // namespace bustub
@@ -2,13 +2,21 @@
  * lock_manager_test.cpp
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <future>  // NOLINT
 #include <random>
 #include <thread>  // NOLINT
 
+#include "buffer/buffer_pool_manager_instance.h"
 #include "common/config.h"
+#include "common/logger.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "gtest/gtest.h"
+#include "storage/index/b_plus_tree.h"
+#include "test_util.h"  // NOLINT
 
 namespace bustub {
 
@@ -77,7 +85,7 @@ void BasicTest1() {
     delete txns[i];
   }
 }
-TEST(LockManagerTest, DISABLED_BasicTest) { BasicTest1(); }
+TEST(LockManagerTest, BasicTest) { BasicTest1(); }
 
 void TwoPLTest() {
   LockManager lock_mgr{};
@@ -123,7 +131,7 @@ void TwoPLTest() {
 
   delete txn;
 }
-TEST(LockManagerTest, DISABLED_TwoPLTest) { TwoPLTest(); }
+TEST(LockManagerTest, TwoPLTest) { TwoPLTest(); }
 
 void UpgradeTest() {
   LockManager lock_mgr{};
@@ -150,11 +158,152 @@ void UpgradeTest() {
   txn_mgr.Commit(&txn);
   CheckCommitted(&txn);
 }
-TEST(LockManagerTest, DISABLED_UpgradeLockTest) { UpgradeTest(); }
+TEST(LockManagerTest, UpgradeLockTest) { UpgradeTest(); }
 
-void WoundWaitBasicTest() {
+void HierarchyTest() {
   LockManager lock_mgr{};
   TransactionManager txn_mgr{&lock_mgr};
+  const table_oid_t oid = 0;
+  RID rid0{0, 0};
+  RID rid1{1, 0};
+  auto *writer = txn_mgr.Begin();
+  auto *reader = txn_mgr.Begin();
+
+  EXPECT_TRUE(LockManager::AreCompatible(LockMode::INTENTION_SHARED, LockMode::SHARED_INTENTION_EXCLUSIVE));
+  EXPECT_TRUE(LockManager::AreCompatible(LockMode::INTENTION_EXCLUSIVE, LockMode::INTENTION_EXCLUSIVE));
+  EXPECT_FALSE(LockManager::AreCompatible(LockMode::SHARED, LockMode::INTENTION_EXCLUSIVE));
+  EXPECT_FALSE(LockManager::AreCompatible(LockMode::SHARED_INTENTION_EXCLUSIVE, LockMode::SHARED));
+
+  // A record lock takes the intention locks on its page and table first.
+  EXPECT_TRUE(lock_mgr.LockExclusive(writer, rid0, oid));
+  EXPECT_EQ(writer->GetTableLockSet()->at(oid), LockMode::INTENTION_EXCLUSIVE);
+  EXPECT_EQ(writer->GetPageLockSet()->at(rid0.GetPageId()), LockMode::INTENTION_EXCLUSIVE);
+  CheckTxnLockSize(writer, 0, 1);
+
+  // A shared page lock covers the records on the page.
+  EXPECT_TRUE(lock_mgr.LockPage(reader, oid, rid1.GetPageId(), LockMode::SHARED));
+  EXPECT_EQ(reader->GetTableLockSet()->at(oid), LockMode::INTENTION_SHARED);
+  EXPECT_TRUE(lock_mgr.LockShared(reader, rid1, oid));
+  CheckTxnLockSize(reader, 0, 0);
+
+  // A shared table lock waits for the writer's intention lock.
+  std::atomic<bool> granted{false};
+  std::thread upgrade_thread([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(reader, oid, LockMode::SHARED));
+    granted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  txn_mgr.Commit(writer);
+  upgrade_thread.join();
+  EXPECT_TRUE(granted);
+  EXPECT_EQ(reader->GetTableLockSet()->at(oid), LockMode::SHARED);
+
+  // Writing a record under a shared table lock makes it SHARED_INTENTION_EXCLUSIVE.
+  EXPECT_TRUE(lock_mgr.LockExclusive(reader, rid0, oid));
+  EXPECT_EQ(reader->GetTableLockSet()->at(oid), LockMode::SHARED_INTENTION_EXCLUSIVE);
+  CheckTxnLockSize(reader, 0, 1);
+
+  txn_mgr.Commit(reader);
+  CheckTxnLockSize(reader, 0, 0);
+  EXPECT_TRUE(reader->GetPageLockSet()->empty());
+  EXPECT_TRUE(reader->GetTableLockSet()->empty());
+  delete writer;
+  delete reader;
+}
+TEST(LockManagerTest, HierarchyTest) { HierarchyTest(); }
+
+void EscalationTest() {
+  const size_t threshold = 10;
+  LockManager lock_mgr{DeadlockPolicy::DETECTION, threshold};
+  TransactionManager txn_mgr{&lock_mgr};
+  const table_oid_t oid0 = 0;
+  const table_oid_t oid1 = 1;
+  auto *reader = txn_mgr.Begin();
+  auto *writer = txn_mgr.Begin();
+
+  // Shared record locks spread over two pages escalate to a shared table lock.
+  for (size_t i = 0; i < threshold - 1; i++) {
+    EXPECT_TRUE(lock_mgr.LockShared(reader, RID{static_cast<page_id_t>(i % 2), static_cast<uint32_t>(i)}, oid0));
+  }
+  CheckTxnLockSize(reader, threshold - 1, 0);
+  EXPECT_EQ(reader->GetTableLockSet()->at(oid0), LockMode::INTENTION_SHARED);
+  EXPECT_TRUE(lock_mgr.LockShared(reader, RID{0, static_cast<uint32_t>(threshold)}, oid0));
+  CheckTxnLockSize(reader, 0, 0);
+  EXPECT_EQ(reader->GetTableLockSet()->at(oid0), LockMode::SHARED);
+  EXPECT_TRUE(reader->GetPageLockSet()->empty());
+  EXPECT_TRUE(reader->GetTableRowLockSet()->empty());
+  CheckGrowing(reader);
+
+  // A single exclusive record lock makes the table lock exclusive.
+  EXPECT_TRUE(lock_mgr.LockShared(writer, RID{2, 0}, oid0));
+  for (size_t i = 1; i < threshold; i++) {
+    EXPECT_TRUE(lock_mgr.LockShared(writer, RID{3, static_cast<uint32_t>(i)}, oid1));
+  }
+  EXPECT_TRUE(lock_mgr.LockExclusive(writer, RID{3, 0}, oid1));
+  EXPECT_EQ(writer->GetTableLockSet()->at(oid1), LockMode::EXCLUSIVE);
+  EXPECT_EQ(writer->GetTableLockSet()->at(oid0), LockMode::INTENTION_SHARED);
+  CheckTxnLockSize(writer, 1, 0);
+  CheckGrowing(writer);
+
+  txn_mgr.Commit(reader);
+  txn_mgr.Commit(writer);
+  EXPECT_TRUE(writer->GetTableLockSet()->empty());
+  EXPECT_TRUE(writer->GetPageLockSet()->empty());
+  delete reader;
+  delete writer;
+}
+TEST(LockManagerTest, EscalationTest) { EscalationTest(); }
+
+TEST(LockManagerTest, GraphEdgeTest) {
+  LockManager lock_mgr{};
+  lock_mgr.AddEdge(0, 1);
+  lock_mgr.AddEdge(1, 2);
+  lock_mgr.AddEdge(0, 1);
+  EXPECT_EQ(lock_mgr.GetEdgeList().size(), 2);
+  txn_id_t victim = INVALID_TXN_ID;
+  EXPECT_FALSE(lock_mgr.HasCycle(&victim));
+
+  // The youngest transaction of the cycle is the victim.
+  lock_mgr.AddEdge(2, 0);
+  lock_mgr.AddEdge(3, 4);
+  EXPECT_TRUE(lock_mgr.HasCycle(&victim));
+  EXPECT_EQ(victim, 2);
+  lock_mgr.RemoveEdge(1, 2);
+  EXPECT_FALSE(lock_mgr.HasCycle(&victim));
+  EXPECT_EQ(lock_mgr.GetEdgeList().size(), 3);
+}
+
+void DeadlockDetectionTest() {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid0));
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn1, rid1));
+
+  std::thread waiter([&] {
+    // Waits for txn1 until the detector aborts txn1.
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid1));
+    CheckGrowing(txn0);
+    txn_mgr.Commit(txn0);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_FALSE(lock_mgr.LockExclusive(txn1, rid0));
+  CheckAborted(txn1);
+  txn_mgr.Abort(txn1);
+  waiter.join();
+  CheckCommitted(txn0);
+  delete txn0;
+  delete txn1;
+}
+TEST(LockManagerTest, DeadlockDetectionTest) { DeadlockDetectionTest(); }
+
+void WoundWaitBasicTest() {
+  LockManager lock_mgr{DeadlockPolicy::WOUND_WAIT};
+  TransactionManager txn_mgr{&lock_mgr};
   RID rid{0, 0};
 
   int id_hold = 0;
@@ -202,6 +351,284 @@ void WoundWaitBasicTest() {
   txn_mgr.Commit(&txn_hold);
   CheckCommitted(&txn_hold);
 }
-TEST(LockManagerTest, DISABLED_WoundWaitBasicTest) { WoundWaitBasicTest(); }
+TEST(LockManagerTest, WoundWaitBasicTest) { WoundWaitBasicTest(); }
+
+void WaitDieBasicTest() {
+  LockManager lock_mgr{DeadlockPolicy::WAIT_DIE};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+  auto *txn_old = txn_mgr.Begin();
+  auto *txn_young = txn_mgr.Begin();
+
+  // The younger transaction dies instead of waiting for the older one.
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn_old, rid));
+  EXPECT_FALSE(lock_mgr.LockShared(txn_young, rid));
+  CheckAborted(txn_young);
+  txn_mgr.Abort(txn_young);
+
+  // The older transaction waits for the younger one.
+  auto *txn_holder = txn_mgr.Begin();
+  RID rid1{0, 1};
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn_holder, rid1));
+  std::thread waiter([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn_old, rid1));
+    CheckGrowing(txn_old);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CheckGrowing(txn_holder);
+  txn_mgr.Commit(txn_holder);
+  waiter.join();
+  txn_mgr.Commit(txn_old);
+  delete txn_old;
+  delete txn_young;
+  delete txn_holder;
+}
+TEST(LockManagerTest, WaitDieBasicTest) { WaitDieBasicTest(); }
+
+// The lock manager counts the locks it grants, the waits and the aborts, and lists the records waited for the most.
+void StatsTest() {
+  LockManager lock_mgr{DeadlockPolicy::WAIT_DIE};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0{0, 0};
+  RID rid1{0, 1};
+  auto *txn_old = txn_mgr.Begin();
+  auto *txn_young = txn_mgr.Begin();
+
+  // The older transaction waits for the younger one, and then a younger one dies waiting for it.
+  EXPECT_TRUE(lock_mgr.LockShared(txn_young, rid0));
+  std::thread waiter([&] { EXPECT_TRUE(lock_mgr.LockExclusive(txn_old, rid0)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  txn_mgr.Commit(txn_young);
+  waiter.join();
+  auto *txn_die = txn_mgr.Begin();
+  EXPECT_FALSE(lock_mgr.LockShared(txn_die, rid0));
+  txn_mgr.Abort(txn_die);
+  txn_mgr.Commit(txn_old);
+
+  // Two transactions upgrade the same record: the second one is refused.
+  auto *txn_a = txn_mgr.Begin();
+  auto *txn_b = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockShared(txn_a, rid1));
+  EXPECT_TRUE(lock_mgr.LockShared(txn_b, rid1));
+  std::thread upgrader([&] { EXPECT_TRUE(lock_mgr.LockUpgrade(txn_a, rid1)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_THROW(lock_mgr.LockUpgrade(txn_b, rid1), TransactionAbortException);
+  txn_mgr.Abort(txn_b);
+  upgrader.join();
+  txn_mgr.Commit(txn_a);
+
+  LockStats stats = lock_mgr.GetStats();
+  EXPECT_EQ(stats.acquisitions_[static_cast<size_t>(LockMode::SHARED)], 3U);
+  EXPECT_EQ(stats.acquisitions_[static_cast<size_t>(LockMode::EXCLUSIVE)], 2U);
+  EXPECT_EQ(stats.waits_, 3U);
+  EXPECT_GT(stats.wait_time_.count(), 0);
+  uint64_t histogram_waits = 0;
+  for (uint64_t waits : stats.wait_histogram_) {
+    histogram_waits += waits;
+  }
+  EXPECT_EQ(histogram_waits, stats.waits_);
+  EXPECT_EQ(stats.upgrade_conflicts_, 1U);
+  EXPECT_EQ(stats.deadlock_aborts_, 1U);
+  EXPECT_EQ(stats.max_queue_depth_, 2U);
+  ASSERT_EQ(stats.hot_targets_.size(), 2U);
+  EXPECT_EQ(stats.hot_targets_[0].target_, "row 0:0");
+  EXPECT_EQ(stats.hot_targets_[0].waits_, 2U);
+  EXPECT_EQ(stats.hot_targets_[1].target_, "row 0:1");
+  EXPECT_EQ(stats.hot_targets_[1].waits_, 1U);
+  EXPECT_EQ(lock_mgr.GetStats(1).hot_targets_.size(), 1U);
+  EXPECT_NE(stats.ToString().find("row 0:0"), std::string::npos);
+
+  // Resetting the hottest targets keeps the counters.
+  lock_mgr.ResetHotTargets();
+  stats = lock_mgr.GetStats();
+  EXPECT_TRUE(stats.hot_targets_.empty());
+  EXPECT_EQ(stats.waits_, 3U);
+
+  delete txn_old;
+  delete txn_young;
+  delete txn_die;
+  delete txn_a;
+  delete txn_b;
+}
+TEST(LockManagerTest, StatsTest) { StatsTest(); }
+
+// A REPEATABLE_READ scan of a B+ tree keeps other transactions from inserting into the range it read, but not into
+// the gaps past it, and writers into the same gap do not wait for each other.
+void NextKeyLockingTest() {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  page_id_t header_page_id;
+  bpm->NewPage(&header_page_id);
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  // Small pages, so that the keys after a key are on other leaves now and then.
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 3, 3, &lock_mgr);
+  auto key_of = [](int64_t value) {
+    GenericKey<8> key;
+    key.SetFromInteger(value);
+    return key;
+  };
+  for (int64_t value : {10, 20, 30}) {
+    tree.Insert(key_of(value), RID(0, value));
+  }
+
+  // Reads the keys below 25, and the one after them.
+  auto scan = [&](Transaction *txn) {
+    std::vector<int64_t> values;
+    std::pair<GenericKey<8>, RID> entry;
+    const GenericKey<8> *after = nullptr;
+    while (tree.ScanNext(after, &entry, txn)) {
+      values.push_back(entry.first.ToString());
+      if (entry.first.ToString() >= 25) {
+        break;
+      }
+      after = &entry.first;
+    }
+    return values;
+  };
+  Transaction *scanner = txn_mgr.Begin();
+  EXPECT_EQ(scan(scanner), (std::vector<int64_t>{10, 20, 30}));
+  EXPECT_EQ(scanner->GetKeyLockSet()->size(), 3);
+
+  // 15 goes into the range, and waits for the scan's transaction.
+  Transaction *writer = txn_mgr.Begin();
+  std::promise<void> inserted;
+  auto inserted_future = inserted.get_future();
+  std::thread writer_thread([&] {
+    EXPECT_TRUE(tree.Insert(key_of(15), RID(0, 15), writer));
+    inserted.set_value();
+  });
+  EXPECT_EQ(inserted_future.wait_for(std::chrono::milliseconds(100)), std::future_status::timeout);
+
+  // 35 goes into a gap the scan did not read.
+  Transaction *other_writer = txn_mgr.Begin();
+  EXPECT_TRUE(tree.Insert(key_of(35), RID(0, 35), other_writer));
+  txn_mgr.Commit(other_writer);
+
+  EXPECT_EQ(scan(scanner), (std::vector<int64_t>{10, 20, 30}));
+  txn_mgr.Commit(scanner);
+  writer_thread.join();
+  txn_mgr.Commit(writer);
+
+  // 12 and 13 both go into the gap before 15.
+  Transaction *first = txn_mgr.Begin();
+  Transaction *second = txn_mgr.Begin();
+  EXPECT_TRUE(tree.Insert(key_of(12), RID(0, 12), first));
+  EXPECT_TRUE(tree.Insert(key_of(13), RID(0, 13), second));
+  txn_mgr.Commit(first);
+  txn_mgr.Commit(second);
+
+  Transaction *reader = txn_mgr.Begin();
+  EXPECT_EQ(scan(reader), (std::vector<int64_t>{10, 12, 13, 15, 20, 30}));
+  txn_mgr.Commit(reader);
+
+  for (Transaction *txn : {scanner, writer, other_writer, first, second, reader}) {
+    delete txn;
+  }
+  bpm->UnpinPage(header_page_id, true);
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+TEST(LockManagerTest, NextKeyLockingTest) { NextKeyLockingTest(); }
+
+// Throughput and abort rate of each deadlock policy, with transactions that lock a few of a small set of records in
+// random order and thus deadlock now and then.
+TEST(LockManagerTest, DISABLED_DeadlockPolicyBenchmark) {
+  const int num_threads = 4;
+  const int txns_per_thread = 50;
+  const int locks_per_txn = 4;
+  const int num_rids = 16;
+  const std::pair<DeadlockPolicy, const char *> policies[] = {{DeadlockPolicy::DETECTION, "detection"},
+                                                               {DeadlockPolicy::WOUND_WAIT, "wound-wait"},
+                                                               {DeadlockPolicy::WAIT_DIE, "wait-die"}};
+  for (const auto &[policy, name] : policies) {
+    LockManager lock_mgr{policy};
+    TransactionManager txn_mgr{&lock_mgr};
+    std::atomic<int> aborts{0};
+    auto task = [&](int thread_id) {
+      std::mt19937 generator(thread_id);
+      std::uniform_int_distribution<int> rid_distribution(0, num_rids - 1);
+      for (int i = 0; i < txns_per_thread; i++) {
+        Transaction *txn = txn_mgr.Begin();
+        bool locked = true;
+        try {
+          for (int j = 0; j < locks_per_txn && locked; j++) {
+            locked = lock_mgr.LockExclusive(txn, RID{0, static_cast<uint32_t>(rid_distribution(generator))});
+            // Some work between the lock requests lets the transactions interleave.
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+          }
+        } catch (TransactionAbortException &e) {
+          locked = false;
+        }
+        if (locked && txn->GetState() != TransactionState::ABORTED) {
+          txn_mgr.Commit(txn);
+        } else {
+          txn_mgr.Abort(txn);
+          aborts++;
+        }
+        delete txn;
+      }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto elapsed_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("%s: %d transactions, %d aborted, in %ld ms", name, num_threads * txns_per_thread, aborts.load(),
+             static_cast<long>(elapsed_ms));  // NOLINT
+  }
+}
+
+// Lock and unlock throughput as the number of threads grows. Every thread locks records of its own, so the threads
+// only contend on the partitions of the lock table.
+TEST(LockManagerTest, DISABLED_ThroughputBenchmark) {
+  const int locks_per_txn = 100;
+  const int txns_per_thread = 200;
+  for (int num_threads : {1, 2, 4, 8}) {
+    LockManager lock_mgr{};
+    std::atomic<txn_id_t> next_txn_id{0};
+    auto task = [&](int thread_id) {
+      for (int i = 0; i < txns_per_thread; i++) {
+        Transaction txn(next_txn_id++);
+        for (int j = 0; j < locks_per_txn; j++) {
+          RID rid{thread_id, static_cast<uint32_t>(j)};
+          bool res = j % 2 == 0 ? lock_mgr.LockShared(&txn, rid) : lock_mgr.LockExclusive(&txn, rid);
+          EXPECT_TRUE(res);
+        }
+        for (int j = 0; j < locks_per_txn; j++) {
+          EXPECT_TRUE(lock_mgr.Unlock(&txn, RID{thread_id, static_cast<uint32_t>(j)}));
+        }
+        CheckTxnLockSize(&txn, 0, 0);
+      }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto elapsed_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    const int64_t num_ops = static_cast<int64_t>(num_threads) * txns_per_thread * locks_per_txn * 2;
+    const int64_t calls_per_sec = num_ops * 1000000 / std::max<int64_t>(elapsed_us, 1);
+    LOG_INFO("%d threads: %ld lock and unlock calls in %ld us, %ld calls/s", num_threads, static_cast<long>(num_ops),
+             static_cast<long>(elapsed_us), static_cast<long>(calls_per_sec));  // NOLINT
+  }
+}
 
 }  // namespace bustub
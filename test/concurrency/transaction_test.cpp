@@ -11,15 +11,19 @@
 //===----------------------------------------------------------------------===//
 
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
 #include <memory>
 #include <random>
+#include <set>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 
 #include "buffer/buffer_pool_manager_instance.h"
 #include "catalog/table_generator.h"
+#include "common/bustub_instance.h"
 #include "concurrency/transaction.h"
 #include "concurrency/transaction_manager.h"
 #include "execution/execution_engine.h"
@@ -253,4 +257,489 @@ TEST_F(TransactionTest, DISABLED_DirtyReadsTest) {
   delete txn2;
 }
 
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, SnapshotReadTest) {
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  TableHeap *table = table_info->table_.get();
+  auto make_tuple = [&schema](int32_t a) {
+    return Tuple{{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(0)}, &schema};
+  };
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  // SELECT colA FROM empty_table2, as of the snapshot of txn.
+  auto scan = [&](Transaction *txn) {
+    ExecutorContext exec_ctx(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(&scan_plan, &result_set, txn, &exec_ctx);
+    std::vector<int32_t> values;
+    for (const auto &tuple : result_set) {
+      values.push_back(tuple.GetValue(out_schema, 0).GetAs<int32_t>());
+    }
+    return values;
+  };
+  auto read = [&](const RID &rid, Transaction *txn) {
+    Tuple tuple;
+    return table->GetTuple(rid, &tuple, txn) ? tuple.GetValue(&schema, 0).GetAs<int32_t>() : -1;
+  };
+
+  RID rid1;
+  RID rid2;
+  auto txn1 = GetTxnManager()->Begin();
+  ASSERT_TRUE(table->InsertTuple(make_tuple(1), &rid1, txn1));
+  GetTxnManager()->Commit(txn1);
+  // With no snapshot running, the commit takes no timestamp of its own and keeps no old versions.
+  EXPECT_EQ(txn1->GetCommitTs(), GetTxnManager()->GetLastCommitTs());
+  EXPECT_EQ(table->GetVersionCount(), 0);
+
+  // The reader's snapshot has the first insert only.
+  auto reader1 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto txn2 = GetTxnManager()->Begin();
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(2), rid1, txn2));
+  ASSERT_TRUE(table->InsertTuple(make_tuple(3), &rid2, txn2));
+  EXPECT_EQ(read(rid1, reader1), 1);
+  EXPECT_EQ(read(rid2, reader1), -1);
+  EXPECT_EQ(scan(reader1), std::vector<int32_t>{1});
+  GetTxnManager()->Commit(txn2);
+  EXPECT_EQ(scan(reader1), std::vector<int32_t>{1});
+
+  auto reader2 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ(reader2->GetReadTs(), txn2->GetCommitTs());
+  auto txn3 = GetTxnManager()->Begin();
+  ASSERT_TRUE(table->MarkDelete(rid1, txn3));
+  GetTxnManager()->Commit(txn3);
+  // The deleted tuple is gone from its page, but both snapshots still see it.
+  EXPECT_EQ(scan(reader1), std::vector<int32_t>{1});
+  EXPECT_EQ(scan(reader2), (std::vector<int32_t>{2, 3}));
+  EXPECT_EQ(read(rid1, reader2), 2);
+  EXPECT_EQ(GetTxnManager()->GetWatermark(), reader1->GetReadTs());
+  EXPECT_GT(table->GetVersionCount(), 0);
+  // Snapshot reads take no locks.
+  EXPECT_TRUE(reader1->GetSharedLockSet()->empty());
+  EXPECT_TRUE(reader2->GetSharedLockSet()->empty());
+
+  GetTxnManager()->Commit(reader1);
+  GetTxnManager()->Commit(reader2);
+  auto reader3 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ(scan(reader3), std::vector<int32_t>{3});
+  GetTxnManager()->Commit(reader3);
+
+  // No snapshot reads the old versions anymore.
+  table->GarbageCollect(GetTxnManager()->GetWatermark());
+  EXPECT_EQ(table->GetVersionCount(), 0);
+
+  for (auto txn : {txn1, txn2, txn3, reader1, reader2, reader3}) {
+    delete txn;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, SnapshotWriteConflictTest) {
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  TableHeap *table = table_info->table_.get();
+  auto make_tuple = [&schema](int32_t a) {
+    return Tuple{{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(0)}, &schema};
+  };
+  auto read = [&](const RID &rid, Transaction *txn) {
+    Tuple tuple;
+    return table->GetTuple(rid, &tuple, txn) ? tuple.GetValue(&schema, 0).GetAs<int32_t>() : -1;
+  };
+
+  RID rid;
+  auto txn0 = GetTxnManager()->Begin();
+  ASSERT_TRUE(table->InsertTuple(make_tuple(0), &rid, txn0));
+  GetTxnManager()->Commit(txn0);
+
+  // Two concurrent writers: the first one wins.
+  auto txn1 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto txn2 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(1), rid, txn1));
+  EXPECT_EQ(read(rid, txn1), 1);
+  EXPECT_EQ(read(rid, txn2), 0);
+  EXPECT_FALSE(table->UpdateTuple(make_tuple(2), rid, txn2));
+  CheckAborted(txn2);
+  GetTxnManager()->Abort(txn2);
+  GetTxnManager()->Commit(txn1);
+
+  // A writer that committed after the snapshot was taken wins too.
+  auto txn3 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto txn4 = GetTxnManager()->Begin();
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(4), rid, txn4));
+  GetTxnManager()->Commit(txn4);
+  EXPECT_EQ(read(rid, txn3), 1);
+  EXPECT_FALSE(table->MarkDelete(rid, txn3));
+  CheckAborted(txn3);
+  GetTxnManager()->Abort(txn3);
+
+  // A rolled back write leaves the committed value behind.
+  auto txn5 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(5), rid, txn5));
+  GetTxnManager()->Abort(txn5);
+  auto txn6 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ(read(rid, txn6), 4);
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(6), rid, txn6));
+  GetTxnManager()->Commit(txn6);
+  EXPECT_EQ(table->GetVersionCount(), 0);
+
+  for (auto txn : {txn0, txn1, txn2, txn3, txn4, txn5, txn6}) {
+    delete txn;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, OptimisticValidationTest) {
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  TableHeap *table = table_info->table_.get();
+  auto make_tuple = [&schema](int32_t a) {
+    return Tuple{{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(0)}, &schema};
+  };
+  auto read = [&](const RID &rid, Transaction *txn) {
+    Tuple tuple;
+    return table->GetTuple(rid, &tuple, txn) ? tuple.GetValue(&schema, 0).GetAs<int32_t>() : -1;
+  };
+  auto begin_optimistic = [this]() {
+    return GetTxnManager()->Begin(nullptr, IsolationLevel::REPEATABLE_READ, DurabilityMode::GROUP,
+                                  ConcurrencyControl::OPTIMISTIC);
+  };
+
+  RID rid_a;
+  RID rid_b;
+  auto txn0 = GetTxnManager()->Begin();
+  ASSERT_TRUE(table->InsertTuple(make_tuple(0), &rid_a, txn0));
+  ASSERT_TRUE(table->InsertTuple(make_tuple(0), &rid_b, txn0));
+  GetTxnManager()->Commit(txn0);
+
+  // The update is buffered: only the writer sees it before it commits.
+  auto txn1 = begin_optimistic();
+  EXPECT_EQ(read(rid_a, txn1), 0);
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(1), rid_b, txn1));
+  EXPECT_EQ(read(rid_b, txn1), 1);
+  auto txn2 = GetTxnManager()->Begin();
+  EXPECT_EQ(read(rid_b, txn2), 0);
+  // txn2 overwrites what txn1 read, so txn1 fails validation.
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(2), rid_a, txn2));
+  GetTxnManager()->Commit(txn2);
+  GetTxnManager()->Commit(txn1);
+  CheckAborted(txn1);
+
+  auto txn3 = begin_optimistic();
+  EXPECT_EQ(read(rid_a, txn3), 2);
+  EXPECT_EQ(read(rid_b, txn3), 0);
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(3), rid_b, txn3));
+  // A read-only transaction is validated too.
+  auto txn4 = begin_optimistic();
+  EXPECT_EQ(read(rid_b, txn4), 0);
+  GetTxnManager()->Commit(txn3);
+  CheckCommitted(txn3);
+  EXPECT_TRUE(txn3->GetSharedLockSet()->empty());
+  GetTxnManager()->Commit(txn4);
+  CheckAborted(txn4);
+
+  // Deletes are buffered too.
+  auto txn5 = begin_optimistic();
+  ASSERT_TRUE(table->MarkDelete(rid_a, txn5));
+  EXPECT_EQ(read(rid_a, txn5), -1);
+  EXPECT_FALSE(table->UpdateTuple(make_tuple(5), rid_a, txn5));
+  GetTxnManager()->Commit(txn5);
+  CheckCommitted(txn5);
+
+  auto txn6 = GetTxnManager()->Begin();
+  EXPECT_EQ(read(rid_a, txn6), -1);
+  EXPECT_EQ(read(rid_b, txn6), 3);
+  GetTxnManager()->Commit(txn6);
+
+  for (auto txn : {txn0, txn1, txn2, txn3, txn4, txn5, txn6}) {
+    delete txn;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, ReadOnlyTest) {
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  TableHeap *table = table_info->table_.get();
+  auto make_tuple = [&schema](int32_t a) {
+    return Tuple{{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(0)}, &schema};
+  };
+  auto read = [&](const RID &rid, Transaction *txn) {
+    Tuple tuple;
+    return table->GetTuple(rid, &tuple, txn) ? tuple.GetValue(&schema, 0).GetAs<int32_t>() : -1;
+  };
+
+  RID rid;
+  auto txn1 = GetTxnManager()->Begin();
+  ASSERT_TRUE(table->InsertTuple(make_tuple(1), &rid, txn1));
+  GetTxnManager()->Commit(txn1);
+
+  // A read-only transaction reads from a snapshot, whatever isolation level it asks for.
+  auto reader = GetTxnManager()->Begin(nullptr, IsolationLevel::REPEATABLE_READ, DurabilityMode::GROUP,
+                                       ConcurrencyControl::READ_ONLY);
+  EXPECT_TRUE(reader->IsReadOnly());
+  EXPECT_EQ(reader->GetIsolationLevel(), IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ(reader->GetSharedLockSet(), nullptr);
+  EXPECT_EQ(reader->GetWriteSet(), nullptr);
+  EXPECT_EQ(GetTxnManager()->GetTransaction(reader->GetTransactionId()), reader);
+  auto txn2 = GetTxnManager()->Begin();
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(2), rid, txn2));
+  EXPECT_EQ(read(rid, reader), 1);
+  GetTxnManager()->Commit(txn2);
+  EXPECT_EQ(read(rid, reader), 1);
+  EXPECT_EQ(GetTxnManager()->GetWatermark(), reader->GetReadTs());
+  GetTxnManager()->Commit(reader);
+  EXPECT_EQ(reader->GetState(), TransactionState::COMMITTED);
+  EXPECT_EQ(GetTxnManager()->GetTransaction(reader->GetTransactionId()), nullptr);
+  EXPECT_EQ(GetTxnManager()->GetWatermark(), GetTxnManager()->GetLastCommitTs());
+
+  // Writing aborts it.
+  auto writer = GetTxnManager()->Begin(nullptr, IsolationLevel::REPEATABLE_READ, DurabilityMode::GROUP,
+                                       ConcurrencyControl::READ_ONLY);
+  EXPECT_FALSE(table->UpdateTuple(make_tuple(3), rid, writer));
+  EXPECT_EQ(writer->GetState(), TransactionState::ABORTED);
+  GetTxnManager()->Abort(writer);
+  EXPECT_EQ(read(rid, txn2), 2);
+
+  delete txn1;
+  delete txn2;
+  delete reader;
+  delete writer;
+}
+
+// The cost of a transaction that reads a few tuples, as a locking transaction and as a read-only one.
+// NOLINTNEXTLINE
+TEST(ConcurrencyControlTest, DISABLED_ReadOnlyBenchmark) {
+  const int num_threads = 4;
+  const int txns_per_thread = 2000;
+  const int reads_per_txn = 4;
+  const int num_tuples = 1000;
+  remove("ro_test.db");
+  DiskManager::RemoveLogFiles("ro_test.db");
+  auto *bustub = new BustubInstance("ro_test.db");
+  TransactionManager *txn_mgr = bustub->transaction_manager_;
+  bustub->log_manager_->RunFlushThread();
+
+  Schema schema{{Column{"a", TypeId::INTEGER}}};
+  auto txn0 = txn_mgr->Begin();
+  TableHeap table(bustub->buffer_pool_manager_, bustub->lock_manager_, bustub->log_manager_, txn0);
+  std::vector<RID> rids(num_tuples);
+  for (auto &rid : rids) {
+    ASSERT_TRUE(table.InsertTuple(Tuple{{ValueFactory::GetIntegerValue(1)}, &schema}, &rid, txn0));
+  }
+  txn_mgr->Commit(txn0);
+  delete txn0;
+
+  const std::pair<ConcurrencyControl, const char *> modes[] = {{ConcurrencyControl::TWO_PHASE_LOCKING, "2PL"},
+                                                               {ConcurrencyControl::READ_ONLY, "read-only"}};
+  for (const auto &[mode, name] : modes) {
+    std::atomic<int64_t> sum{0};
+    auto task = [&, mode = mode](int thread_id) {
+      std::mt19937 generator(thread_id);
+      std::uniform_int_distribution<int> tuple_distribution(0, num_tuples - 1);
+      for (int i = 0; i < txns_per_thread; i++) {
+        Transaction *txn =
+            txn_mgr->Begin(nullptr, IsolationLevel::REPEATABLE_READ, DurabilityMode::ASYNCHRONOUS, mode);
+        for (int j = 0; j < reads_per_txn; j++) {
+          Tuple tuple;
+          if (table.GetTuple(rids[tuple_distribution(generator)], &tuple, txn)) {
+            sum += tuple.GetValue(&schema, 0).GetAs<int32_t>();
+          }
+        }
+        txn_mgr->Commit(txn);
+        delete txn;
+      }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto elapsed_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("%s: %d transactions in %ld us, %.2f us each", name, num_threads * txns_per_thread,
+             static_cast<long>(elapsed_us),  // NOLINT
+             static_cast<double>(elapsed_us) / (num_threads * txns_per_thread));
+    EXPECT_EQ(sum.load(), num_threads * txns_per_thread * reads_per_txn);
+  }
+
+  delete bustub;
+  remove("ro_test.db");
+  DiskManager::RemoveLogFiles("ro_test.db");
+}
+
+// Read-mostly transactions under both concurrency controls: each one reads a few random tuples and increments one of
+// them. Locking transactions lock their tuples up front in RID order, as an executor would, so they never deadlock.
+// Every committed transaction adds one to the table, which checks that optimistic ones lose no updates.
+// NOLINTNEXTLINE
+TEST(ConcurrencyControlTest, DISABLED_OptimisticBenchmark) {
+  const int num_threads = 4;
+  const int txns_per_thread = 200;
+  const int reads_per_txn = 8;
+  const int num_tuples = 1000;
+  const std::pair<ConcurrencyControl, const char *> modes[] = {{ConcurrencyControl::TWO_PHASE_LOCKING, "2PL"},
+                                                               {ConcurrencyControl::OPTIMISTIC, "OCC"}};
+  for (const auto &[mode, name] : modes) {
+    remove("occ_test.db");
+    DiskManager::RemoveLogFiles("occ_test.db");
+    auto *bustub = new BustubInstance("occ_test.db");
+    TransactionManager *txn_mgr = bustub->transaction_manager_;
+    bustub->log_manager_->RunFlushThread();
+
+    Schema schema{{Column{"a", TypeId::INTEGER}}};
+    auto txn0 = txn_mgr->Begin();
+    TableHeap table(bustub->buffer_pool_manager_, bustub->lock_manager_, bustub->log_manager_, txn0);
+    std::vector<RID> rids(num_tuples);
+    for (auto &rid : rids) {
+      ASSERT_TRUE(table.InsertTuple(Tuple{{ValueFactory::GetIntegerValue(0)}, &schema}, &rid, txn0));
+    }
+    txn_mgr->Commit(txn0);
+    delete txn0;
+
+    std::atomic<int> commits{0};
+    std::atomic<int> aborts{0};
+    auto task = [&, mode = mode](int thread_id) {
+      std::mt19937 generator(thread_id);
+      std::uniform_int_distribution<int> tuple_distribution(0, num_tuples - 1);
+      for (int i = 0; i < txns_per_thread; i++) {
+        Transaction *txn =
+            txn_mgr->Begin(nullptr, IsolationLevel::REPEATABLE_READ, DurabilityMode::ASYNCHRONOUS, mode);
+        const RID write_rid = rids[tuple_distribution(generator)];
+        std::set<int64_t> read_rids{write_rid.Get()};
+        while (read_rids.size() < reads_per_txn) {
+          read_rids.insert(rids[tuple_distribution(generator)].Get());
+        }
+        bool ok = true;
+        try {
+          if (mode == ConcurrencyControl::TWO_PHASE_LOCKING) {
+            for (int64_t rid : read_rids) {
+              ok = ok && (rid == write_rid.Get() ? bustub->lock_manager_->LockExclusive(txn, RID{rid})
+                                                 : bustub->lock_manager_->LockShared(txn, RID{rid}));
+            }
+          }
+          Tuple tuple;
+          int32_t value = 0;
+          for (int64_t rid : read_rids) {
+            ok = ok && table.GetTuple(RID{rid}, &tuple, txn);
+            if (ok && rid == write_rid.Get()) {
+              value = tuple.GetValue(&schema, 0).GetAs<int32_t>();
+            }
+          }
+          ok = ok && table.UpdateTuple(Tuple{{ValueFactory::GetIntegerValue(value + 1)}, &schema}, write_rid, txn);
+        } catch (TransactionAbortException &e) {
+          ok = false;
+        }
+        if (ok && txn->GetState() != TransactionState::ABORTED) {
+          txn_mgr->Commit(txn);
+        } else {
+          txn_mgr->Abort(txn);
+        }
+        txn->GetState() == TransactionState::COMMITTED ? commits++ : aborts++;
+        delete txn;
+      }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto elapsed_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("%s: %d transactions, %d aborted, in %ld ms", name, num_threads * txns_per_thread, aborts.load(),
+             static_cast<long>(elapsed_ms));  // NOLINT
+
+    auto txn = txn_mgr->Begin();
+    int64_t sum = 0;
+    for (auto it = table.Begin(txn); it != table.End(); ++it) {
+      sum += it->GetValue(&schema, 0).GetAs<int32_t>();
+    }
+    txn_mgr->Commit(txn);
+    delete txn;
+    EXPECT_EQ(sum, commits.load());
+
+    delete bustub;
+    remove("occ_test.db");
+    DiskManager::RemoveLogFiles("occ_test.db");
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TransactionManagerTest, BlockAllTransactionsTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  auto txn1 = txn_mgr.Begin();
+
+  // Blocking waits for the running transactions.
+  std::atomic<bool> blocked{false};
+  std::thread blocker([&] {
+    txn_mgr.BlockAllTransactions();
+    blocked = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(blocked);
+  txn_mgr.Commit(txn1);
+  blocker.join();
+  EXPECT_TRUE(blocked);
+
+  // New transactions wait until the checkpoint resumes them.
+  std::atomic<bool> begun{false};
+  Transaction *txn2 = nullptr;
+  std::thread beginner([&] {
+    txn2 = txn_mgr.Begin();
+    begun = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(begun);
+  txn_mgr.ResumeTransactions();
+  beginner.join();
+  EXPECT_TRUE(begun);
+  txn_mgr.Commit(txn2);
+
+  delete txn1;
+  delete txn2;
+}
+
+// NOLINTNEXTLINE
+TEST(TransactionManagerTest, GetTransactionTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  auto txn0 = txn_mgr.Begin();
+  EXPECT_EQ(txn_mgr.GetTransaction(txn0->GetTransactionId()), txn0);
+
+  // Run through every slot of the registry while txn0 keeps its own, so that the last transaction finds it taken.
+  std::vector<Transaction *> txns;
+  for (int i = 0; i < TXN_REGISTRY_SLOTS; i++) {
+    txns.push_back(txn_mgr.Begin());
+    if (i + 1 < TXN_REGISTRY_SLOTS) {
+      txn_mgr.Commit(txns.back());
+      EXPECT_EQ(txn_mgr.GetTransaction(txns.back()->GetTransactionId()), nullptr);
+    }
+  }
+  Transaction *overflow_txn = txns.back();
+  EXPECT_EQ(overflow_txn->GetTransactionId() % TXN_REGISTRY_SLOTS, txn0->GetTransactionId() % TXN_REGISTRY_SLOTS);
+  EXPECT_EQ(txn_mgr.GetTransaction(txn0->GetTransactionId()), txn0);
+  EXPECT_EQ(txn_mgr.GetTransaction(overflow_txn->GetTransactionId()), overflow_txn);
+
+  txn_mgr.Commit(txn0);
+  EXPECT_EQ(txn_mgr.GetTransaction(txn0->GetTransactionId()), nullptr);
+  EXPECT_EQ(txn_mgr.GetTransaction(overflow_txn->GetTransactionId()), overflow_txn);
+  txn_mgr.Abort(overflow_txn);
+  EXPECT_EQ(txn_mgr.GetTransaction(overflow_txn->GetTransactionId()), nullptr);
+
+  delete txn0;
+  for (auto txn : txns) {
+    delete txn;
+  }
+}
+
 }  // namespace bustub
@@ -10,9 +10,12 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <memory>
 #include <numeric>
 #include <string>
+#include <thread>  // NOLINT
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -31,6 +34,7 @@
 #include "execution/plans/delete_plan.h"
 #include "execution/plans/distinct_plan.h"
 #include "execution/plans/hash_join_plan.h"
+#include "execution/plans/index_scan_plan.h"
 #include "execution/plans/limit_plan.h"
 #include "execution/plans/seq_scan_plan.h"
 #include "execution/plans/update_plan.h"
@@ -87,7 +91,7 @@ using ComparatorType = GenericComparator<8>;
 using HashFunctionType = HashFunction<KeyType>;
 
 // SELECT col_a, col_b FROM test_1 WHERE col_a < 500
-TEST_F(ExecutorTest, DISABLED_SimpleSeqScanTest) {
+TEST_F(ExecutorTest, SimpleSeqScanTest) {
   // Construct query plan
   TableInfo *table_info = GetExecutorContext()->GetCatalog()->GetTable("test_1");
   const Schema &schema = table_info->schema_;
@@ -653,4 +657,172 @@ TEST_F(ExecutorTest, DISABLED_SimpleDistinctTest) {
   ASSERT_TRUE(std::equal(results.cbegin(), results.cend(), expected.cbegin()));
 }
 
+// A repeatable read index scan keeps other transactions from inserting into the range it read until it commits
+TEST_F(ExecutorTest, IndexScanPhantomTest) {
+  auto schema = ParseCreateStatement("a bigint");
+  TableInfo *table_info = GetCatalog()->CreateTable(GetTxn(), "phantom_table", *schema);
+  auto *index_info = GetCatalog()->CreateIndex<KeyType, ValueType, ComparatorType>(
+      GetTxn(), "phantom_index", "phantom_table", *schema, *schema, {0}, 8, HashFunctionType{},
+      IndexType::BPlusTreeIndex);
+  auto insert = [&](int64_t key, Transaction *txn) {
+    Tuple tuple{std::vector<Value>{ValueFactory::GetBigIntValue(key)}, schema.get()};
+    RID rid;
+    ASSERT_TRUE(table_info->table_->InsertTuple(tuple, &rid, txn));
+    index_info->index_->InsertEntry(tuple.KeyFromTuple(*schema, *schema, {0}), rid, txn);
+  };
+  Transaction *txn = GetTxnManager()->Begin();
+  for (int64_t key : {0, 10, 20}) {
+    insert(key, txn);
+  }
+  GetTxnManager()->Commit(txn);
+  delete txn;
+
+  auto *col_a = MakeColumnValueExpression(*schema, 0, "a");
+  auto *out_schema = MakeOutputSchema({{"a", col_a}});
+  IndexScanPlanNode plan{out_schema, nullptr, index_info->index_oid_};
+  auto scan = [&](Transaction *txn) {
+    ExecutorContext exec_ctx(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set{};
+    GetExecutionEngine()->Execute(&plan, &result_set, txn, &exec_ctx);
+    return result_set.size();
+  };
+
+  Transaction *reader = GetTxnManager()->Begin(nullptr, IsolationLevel::REPEATABLE_READ);
+  ASSERT_EQ(3, scan(reader));
+
+  // The insert into the scanned range waits for the lock on the next key
+  std::atomic<bool> inserted{false};
+  Transaction *writer = GetTxnManager()->Begin();
+  std::thread writer_thread([&] {
+    insert(15, writer);
+    inserted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(3, scan(reader));
+  GetTxnManager()->Commit(reader);
+  delete reader;
+
+  writer_thread.join();
+  EXPECT_TRUE(inserted);
+  GetTxnManager()->Commit(writer);
+  delete writer;
+
+  txn = GetTxnManager()->Begin();
+  EXPECT_EQ(4, scan(txn));
+  GetTxnManager()->Commit(txn);
+  delete txn;
+}
+
+// A snapshot index scan returns tuples as of the snapshot, under the keys they have there
+TEST_F(ExecutorTest, SnapshotIndexScanTest) {
+  auto schema = ParseCreateStatement("a bigint");
+  TableInfo *table_info = GetCatalog()->CreateTable(GetTxn(), "snapshot_table", *schema);
+  auto *index_info = GetCatalog()->CreateIndex<KeyType, ValueType, ComparatorType>(
+      GetTxn(), "snapshot_index", "snapshot_table", *schema, *schema, {0}, 8, HashFunctionType{},
+      IndexType::BPlusTreeIndex);
+  auto make_tuple = [&](int64_t key) {
+    return Tuple{std::vector<Value>{ValueFactory::GetBigIntValue(key)}, schema.get()};
+  };
+  std::vector<RID> rids(3);
+  Transaction *txn = GetTxnManager()->Begin();
+  for (int i = 0; i < 3; i++) {
+    Tuple tuple = make_tuple(i * 10);
+    ASSERT_TRUE(table_info->table_->InsertTuple(tuple, &rids[i], txn));
+    index_info->index_->InsertEntry(tuple.KeyFromTuple(*schema, *schema, {0}), rids[i], txn);
+  }
+  GetTxnManager()->Commit(txn);
+  delete txn;
+
+  auto *col_a = MakeColumnValueExpression(*schema, 0, "a");
+  auto *out_schema = MakeOutputSchema({{"a", col_a}});
+  IndexScanPlanNode plan{out_schema, nullptr, index_info->index_oid_};
+  auto scan = [&](Transaction *txn) {
+    ExecutorContext exec_ctx(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set{};
+    GetExecutionEngine()->Execute(&plan, &result_set, txn, &exec_ctx);
+    std::vector<int64_t> keys;
+    for (const auto &tuple : result_set) {
+      keys.push_back(tuple.GetValue(out_schema, 0).GetAs<int64_t>());
+    }
+    return keys;
+  };
+
+  // After the snapshot is taken, 20 becomes 25
+  Transaction *reader = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  txn = GetTxnManager()->Begin();
+  ASSERT_TRUE(table_info->table_->UpdateTuple(make_tuple(25), rids[2], txn));
+  index_info->index_->DeleteEntry(make_tuple(20).KeyFromTuple(*schema, *schema, {0}), rids[2], txn);
+  index_info->index_->InsertEntry(make_tuple(25).KeyFromTuple(*schema, *schema, {0}), rids[2], txn);
+  GetTxnManager()->Commit(txn);
+  delete txn;
+
+  // The entry of 25 does not match the tuple in the snapshot, and the index no longer has the entry of 20: the tuple
+  // is missing from the scan, which the index scan documents.
+  EXPECT_EQ((std::vector<int64_t>{0, 10}), scan(reader));
+  GetTxnManager()->Commit(reader);
+  delete reader;
+
+  reader = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ((std::vector<int64_t>{0, 10, 25}), scan(reader));
+  GetTxnManager()->Commit(reader);
+  delete reader;
+}
+
+// A repeatable read sequential scan locks its table shared, which keeps a delete out of it until the scan commits
+TEST_F(ExecutorTest, SeqScanTableLockTest) {
+  auto schema = ParseCreateStatement("a bigint");
+  TableInfo *table_info = GetCatalog()->CreateTable(GetTxn(), "locked_table", *schema);
+  Transaction *txn = GetTxnManager()->Begin();
+  for (int64_t key : {0, 10, 20}) {
+    Tuple tuple{std::vector<Value>{ValueFactory::GetBigIntValue(key)}, schema.get()};
+    RID rid;
+    ASSERT_TRUE(table_info->table_->InsertTuple(tuple, &rid, txn));
+  }
+  GetTxnManager()->Commit(txn);
+  delete txn;
+
+  auto *col_a = MakeColumnValueExpression(*schema, 0, "a");
+  auto *out_schema = MakeOutputSchema({{"a", col_a}});
+  auto *const10 = MakeConstantValueExpression(ValueFactory::GetBigIntValue(10));
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  SeqScanPlanNode filter_plan{out_schema, MakeComparisonExpression(col_a, const10, ComparisonType::Equal),
+                              table_info->oid_};
+  DeletePlanNode delete_plan{&filter_plan, table_info->oid_};
+  auto execute = [&](const AbstractPlanNode *plan, Transaction *txn) {
+    ExecutorContext exec_ctx(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set{};
+    GetExecutionEngine()->Execute(plan, &result_set, txn, &exec_ctx);
+    return result_set.size();
+  };
+
+  Transaction *reader = GetTxnManager()->Begin(nullptr, IsolationLevel::REPEATABLE_READ);
+  ASSERT_EQ(3, execute(&scan_plan, reader));
+  EXPECT_EQ(LockMode::SHARED, reader->GetTableLockSet()->at(table_info->oid_));
+
+  // The delete waits for its INTENTION_EXCLUSIVE lock on the table
+  std::atomic<bool> deleted{false};
+  Transaction *writer = GetTxnManager()->Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  std::thread writer_thread([&] {
+    execute(&delete_plan, writer);
+    deleted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(deleted);
+  EXPECT_EQ(3, execute(&scan_plan, reader));
+  GetTxnManager()->Commit(reader);
+  delete reader;
+
+  writer_thread.join();
+  EXPECT_TRUE(deleted);
+  EXPECT_EQ(LockMode::INTENTION_EXCLUSIVE, writer->GetTableLockSet()->at(table_info->oid_));
+  GetTxnManager()->Commit(writer);
+  delete writer;
+
+  txn = GetTxnManager()->Begin();
+  EXPECT_EQ(2, execute(&scan_plan, txn));
+  GetTxnManager()->Commit(txn);
+  delete txn;
+}
+
 }  // namespace bustub
@@ -0,0 +1,242 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_manager_test.cpp
+//
+// Identification: test/recovery/log_manager_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <cstring>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/config.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "gtest/gtest.h"
+#include "recovery/log_manager.h"
+#include "recovery/log_recovery.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+class LogManagerTest : public ::testing::Test {
+ protected:
+  // This function is called before every test.
+  void SetUp() override {
+    remove("test.db");
+    DiskManager::RemoveLogFiles("test.db");
+  }
+
+  // This function is called after every test.
+  void TearDown() override {
+    remove("test.db");
+    DiskManager::RemoveLogFiles("test.db");
+  };
+};
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, ConcurrentAppendTest) {
+  const int num_threads = 4;
+  const int num_records = 2000;
+
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+  EXPECT_TRUE(enable_logging);
+
+  // Enough records to overflow the log buffer several times.
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([log_manager, tid] {
+      lsn_t prev_lsn = INVALID_LSN;
+      for (int i = 0; i < num_records; i++) {
+        LogRecord log_record(tid, prev_lsn, LogRecordType::BEGIN);
+        lsn_t lsn = log_manager->AppendLogRecord(&log_record);
+        EXPECT_GT(lsn, prev_lsn);
+        prev_lsn = lsn;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  log_manager->StopFlushThread();
+  EXPECT_FALSE(enable_logging);
+  EXPECT_EQ(log_manager->GetPersistentLSN(), log_manager->GetNextLSN() - 1);
+
+  // Every record must be on disk, intact and in LSN order, and each thread's chain of prev LSNs must be complete.
+  std::vector<lsn_t> last_lsn(num_threads, INVALID_LSN);
+  std::vector<int> count(num_threads, 0);
+  LogRecovery log_recovery(disk_manager, nullptr);
+  // A BEGIN record is just a header, which is never longer than this.
+  char header[32];
+  int64_t offset = 0;
+  lsn_t last = INVALID_LSN;
+  while (disk_manager->ReadLog(header, sizeof(header), offset)) {
+    LogRecord log_record;
+    if (!log_recovery.DeserializeLogRecord(header, &log_record, offset)) {
+      break;
+    }
+    const txn_id_t txn_id = log_record.GetTxnId();
+    ASSERT_EQ(log_record.GetLogRecordType(), LogRecordType::BEGIN);
+    ASSERT_GT(log_record.GetLSN(), last);
+    ASSERT_GE(txn_id, 0);
+    ASSERT_LT(txn_id, num_threads);
+    EXPECT_EQ(log_record.GetPrevLSN(), last_lsn[txn_id]);
+    last = log_record.GetLSN();
+    last_lsn[txn_id] = log_record.GetLSN();
+    count[txn_id]++;
+    offset += log_record.GetSize();
+  }
+  EXPECT_EQ(offset, disk_manager->GetLogSize());
+  for (int tid = 0; tid < num_threads; tid++) {
+    EXPECT_EQ(count[tid], num_records);
+  }
+
+  disk_manager->ShutDown();
+  delete log_manager;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, RecycledSegmentTest) {
+  const int segment_size = 1024;
+  auto *disk_manager = new DiskManager("test.db", segment_size);
+  auto *log_manager = new LogManager(disk_manager);
+  auto append = [log_manager](int num_records) {
+    for (int i = 0; i < num_records; i++) {
+      LogRecord log_record(0, INVALID_LSN, LogRecordType::BEGIN);
+      log_manager->AppendLogRecord(&log_record);
+    }
+    log_manager->Flush();
+  };
+
+  // Records that fit a segment exactly line the records left in a recycled segment up with the ones written over them.
+  LogRecord begin_record(0, INVALID_LSN, LogRecordType::BEGIN);
+  ASSERT_EQ(segment_size % begin_record.GetSize(), 0);
+  const int records_per_segment = segment_size / begin_record.GetSize();
+  append(6 * records_per_segment);
+  const int64_t log_start = disk_manager->GetLogSize();
+  disk_manager->TruncateLog(log_start);
+  EXPECT_EQ(disk_manager->GetLogStart(), log_start);
+  // The second segment from here on is a recycled one, which is only half overwritten.
+  append(records_per_segment + records_per_segment / 2);
+  const int64_t log_end = disk_manager->GetLogSize();
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+
+  // A restarted disk manager reads the whole last segment, but the records left in it are not taken for the log's.
+  disk_manager = new DiskManager("test.db", segment_size);
+  LogRecovery log_recovery(disk_manager, nullptr);
+  char header[32];
+  int64_t offset = log_start;
+  int count = 0;
+  while (disk_manager->ReadLog(header, sizeof(header), offset)) {
+    LogRecord log_record;
+    if (!log_recovery.DeserializeLogRecord(header, &log_record, offset)) {
+      break;
+    }
+    count++;
+    offset += log_record.GetSize();
+  }
+  EXPECT_EQ(count, records_per_segment + records_per_segment / 2);
+  EXPECT_EQ(offset, log_end);
+  EXPECT_GT(disk_manager->GetLogSize(), log_end);
+
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, GroupCommitTest) {
+  const int num_threads = 8;
+  const int num_commits = 20;
+
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  // Keep the timeout long so that only committers trigger flushes.
+  auto saved_log_timeout = log_timeout;
+  auto saved_group_commit_window = group_commit_window;
+  log_timeout = std::chrono::seconds(15);
+  group_commit_window = std::chrono::milliseconds(5);
+  log_manager->RunFlushThread();
+
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([log_manager, tid] {
+      for (int i = 0; i < num_commits; i++) {
+        LogRecord log_record(tid, INVALID_LSN, LogRecordType::COMMIT);
+        lsn_t lsn = log_manager->AppendLogRecord(&log_record);
+        log_manager->WaitUntilPersistent(lsn);
+        EXPECT_GE(log_manager->GetPersistentLSN(), lsn);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  GroupCommitStats stats = log_manager->GetGroupCommitStats();
+  EXPECT_EQ(stats.num_commits_, static_cast<uint64_t>(num_threads * num_commits));
+  EXPECT_GE(stats.num_batches_, 1U);
+  EXPECT_LE(stats.num_batches_, stats.num_commits_);
+  EXPECT_LE(stats.max_batch_size_, static_cast<uint64_t>(num_threads));
+  EXPECT_GE(stats.total_wait_us_, stats.max_wait_us_);
+  // Each flush is one log write, so batching shows up as fewer writes than commits.
+  EXPECT_LT(disk_manager->GetNumFlushes(), num_threads * num_commits);
+
+  log_manager->StopFlushThread();
+  log_timeout = saved_log_timeout;
+  group_commit_window = saved_group_commit_window;
+  disk_manager->ShutDown();
+  delete log_manager;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, DurabilityModeTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *lock_manager = new LockManager();
+  auto *txn_manager = new TransactionManager(lock_manager, log_manager);
+  // With a long timeout nothing but a commit makes the flush thread write the log.
+  auto saved_log_timeout = log_timeout;
+  log_timeout = std::chrono::seconds(15);
+  log_manager->RunFlushThread();
+
+  // An asynchronous commit returns before its commit record is persistent.
+  Transaction *async_txn = txn_manager->Begin(nullptr, IsolationLevel::REPEATABLE_READ, DurabilityMode::ASYNCHRONOUS);
+  txn_manager->Commit(async_txn);
+  EXPECT_EQ(async_txn->GetState(), TransactionState::COMMITTED);
+  EXPECT_LT(log_manager->GetPersistentLSN(), async_txn->GetPrevLSN());
+
+  // The next durable commit persists it as well, whether it waits for a group or forces the log itself.
+  Transaction *sync_txn = txn_manager->Begin(nullptr, IsolationLevel::REPEATABLE_READ, DurabilityMode::SYNCHRONOUS);
+  txn_manager->Commit(sync_txn);
+  EXPECT_GE(log_manager->GetPersistentLSN(), sync_txn->GetPrevLSN());
+  EXPECT_GE(log_manager->GetPersistentLSN(), async_txn->GetPrevLSN());
+
+  Transaction *group_txn = txn_manager->Begin();
+  EXPECT_EQ(group_txn->GetDurabilityMode(), DurabilityMode::GROUP);
+  txn_manager->Commit(group_txn);
+  EXPECT_GE(log_manager->GetPersistentLSN(), group_txn->GetPrevLSN());
+
+  log_manager->StopFlushThread();
+  log_timeout = saved_log_timeout;
+  delete async_txn;
+  delete sync_txn;
+  delete group_txn;
+  delete txn_manager;
+  delete lock_manager;
+  delete log_manager;
+  delete disk_manager;
+}
+
+}  // namespace bustub
@@ -10,12 +10,16 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>  // NOLINT
 #include <cstdio>
 #include <functional>
+#include <random>
 #include <thread>  // NOLINT
 
 #include "buffer/buffer_pool_manager_instance.h"
+#include "common/logger.h"
 #include "gtest/gtest.h"
 #include "storage/index/b_plus_tree.h"
 #include "test_util.h"  // NOLINT
@@ -100,7 +104,7 @@ void DeleteHelperSplit(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree
   delete transaction;
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest1) {
+TEST(BPlusTreeConcurrentTest, InsertTest1) {
   // create KeyComparator and index schema
   auto key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema.get());
@@ -152,7 +156,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest1) {
   remove("test.log");
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest2) {
+TEST(BPlusTreeConcurrentTest, InsertTest2) {
   // create KeyComparator and index schema
   auto key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema.get());
@@ -203,7 +207,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest2) {
   remove("test.log");
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest1) {
+TEST(BPlusTreeConcurrentTest, DeleteTest1) {
   // create KeyComparator and index schema
   auto key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema.get());
@@ -245,7 +249,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest1) {
   remove("test.log");
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest2) {
+TEST(BPlusTreeConcurrentTest, DeleteTest2) {
   // create KeyComparator and index schema
   auto key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema.get());
@@ -288,7 +292,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest2) {
   remove("test.log");
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_MixTest) {
+TEST(BPlusTreeConcurrentTest, MixTest) {
   // create KeyComparator and index schema
   auto key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema.get());
@@ -333,4 +337,133 @@ TEST(BPlusTreeConcurrentTest, DISABLED_MixTest) {
   remove("test.log");
 }
 
+// Readers look up keys that are in the tree while writers split the pages they are on, down to the root. Small pages
+// make for a deep tree and many splits.
+TEST(BPlusTreeConcurrentTest, ReadDuringSplitTest) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(1000, disk_manager);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 4);
+
+  const int64_t num_keys = 4000;
+  GenericKey<8> index_key;
+  for (int64_t key = 0; key < num_keys; key += 2) {
+    index_key.SetFromInteger(key);
+    tree.Insert(index_key, RID(key));
+  }
+
+  const int num_writers = 2;
+  std::atomic<int> writers_left{num_writers};
+  auto writer = [&](int thread_id) {
+    GenericKey<8> key_to_insert;
+    for (int64_t key = 1 + 2 * thread_id; key < num_keys; key += 2 * num_writers) {
+      key_to_insert.SetFromInteger(key);
+      EXPECT_TRUE(tree.Insert(key_to_insert, RID(key)));
+    }
+    writers_left--;
+  };
+  auto reader = [&](int thread_id) {
+    GenericKey<8> key_to_read;
+    std::vector<RID> result;
+    std::mt19937 rng(thread_id);
+    while (writers_left > 0) {
+      const int64_t key = 2 * static_cast<int64_t>(rng() % (num_keys / 2));
+      key_to_read.SetFromInteger(key);
+      result.clear();
+      ASSERT_TRUE(tree.GetValue(key_to_read, &result)) << key;
+      EXPECT_EQ(result[0].Get(), key);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_writers; i++) {
+    threads.emplace_back(writer, i);
+    threads.emplace_back(reader, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  int64_t expected = 0;
+  for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.Get(), expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, num_keys);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+// Every thread inserts, looks up and removes keys of its own, in random order, on 1 to 8 threads. Only the few
+// inserts that split a leaf, and removes that merge one, take the tree latch exclusively.
+TEST(BPlusTreeConcurrentTest, DISABLED_ThroughputBenchmark) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  const int total_keys = 40000;
+  for (int num_threads : {1, 2, 4, 8}) {
+    auto *disk_manager = new DiskManager("test.db");
+    auto *bpm = new BufferPoolManagerInstance(1000, disk_manager);
+    page_id_t page_id;
+    bpm->NewPage(&page_id);
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator);
+
+    auto task = [&](int thread_id) {
+      std::vector<int64_t> keys;
+      for (int64_t key = thread_id; key < total_keys; key += num_threads) {
+        keys.push_back(key);
+      }
+      std::shuffle(keys.begin(), keys.end(), std::mt19937(thread_id));
+      GenericKey<8> index_key;
+      for (int64_t key : keys) {
+        index_key.SetFromInteger(key);
+        EXPECT_TRUE(tree.Insert(index_key, RID(key)));
+      }
+      std::vector<RID> result;
+      for (int64_t key : keys) {
+        index_key.SetFromInteger(key);
+        EXPECT_TRUE(tree.GetValue(index_key, &result));
+      }
+      EXPECT_EQ(result.size(), keys.size());
+      for (size_t i = 0; i < keys.size(); i += 2) {
+        index_key.SetFromInteger(keys[i]);
+        tree.Remove(index_key);
+      }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto elapsed_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    int64_t left = 0;
+    for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+      left++;
+    }
+    EXPECT_EQ(left, total_keys / 2);
+    const int64_t num_ops = total_keys * 5 / 2;
+    LOG_INFO("%d threads: %ld operations in %ld us, %ld operations/s", num_threads, static_cast<long>(num_ops),
+             static_cast<long>(elapsed_us),                                             // NOLINT
+             static_cast<long>(num_ops * 1000000 / std::max<int64_t>(elapsed_us, 1)));  // NOLINT
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete bpm;
+    delete disk_manager;
+    remove("test.db");
+    remove("test.log");
+  }
+}
+
 }  // namespace bustub
@@ -12,15 +12,17 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <random>
 
 #include "buffer/buffer_pool_manager_instance.h"
 #include "gtest/gtest.h"
 #include "storage/index/b_plus_tree.h"
+#include "storage/index/external_sorter.h"
 #include "test_util.h"  // NOLINT
 
 namespace bustub {
 
-TEST(BPlusTreeTests, DISABLED_InsertTest1) {
+TEST(BPlusTreeTests, InsertTest1) {
   // create KeyComparator and index schema
   auto key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema.get());
@@ -78,7 +80,7 @@ TEST(BPlusTreeTests, DISABLED_InsertTest1) {
   remove("test.log");
 }
 
-TEST(BPlusTreeTests, DISABLED_InsertTest2) {
+TEST(BPlusTreeTests, InsertTest2) {
   // create KeyComparator and index schema
   auto key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema.get());
@@ -145,4 +147,85 @@ TEST(BPlusTreeTests, DISABLED_InsertTest2) {
   remove("test.db");
   remove("test.log");
 }
+
+TEST(BPlusTreeTests, BulkLoadTest) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 8, 6);
+  GenericKey<8> index_key;
+  RID rid;
+  Transaction *transaction = new Transaction(0);
+
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  // Runs of 64 entries, more than the buffer pool merges at once; every tenth key comes twice, first from page 0.
+  const int64_t scale = 5000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= scale; key++) {
+    keys.push_back(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+  {
+    ExternalSorter<GenericKey<8>, RID, GenericComparator<8>> sorter(bpm, comparator,
+                                                                    64 * sizeof(std::pair<GenericKey<8>, RID>));
+    for (int page = 0; page < 2; page++) {
+      for (auto key : keys) {
+        if (page == 0 || key % 10 == 0) {
+          rid.Set(page, key);
+          index_key.SetFromInteger(key);
+          sorter.Add(index_key, rid);
+        }
+      }
+    }
+    ASSERT_EQ(sorter.Finish(), scale);
+    EXPECT_TRUE(tree.BulkLoad(scale, [&sorter](std::pair<GenericKey<8>, RID> *entry) { sorter.Next(entry); }, 0.75));
+  }
+
+  // 5 of the 7 entries a leaf holds, on every leaf
+  index_key.SetFromInteger(scale / 2);
+  Page *leaf_page = tree.FindLeafPage(index_key);
+  EXPECT_EQ(reinterpret_cast<BPlusTreePage *>(leaf_page->GetData())->GetSize(), 5);
+  bpm->UnpinPage(leaf_page->GetPageId(), false);
+
+  std::vector<RID> rids;
+  for (int64_t key = 1; key <= scale; key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    ASSERT_TRUE(tree.GetValue(index_key, &rids));
+    EXPECT_EQ(rids[0].GetPageId(), 0);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+
+  // The tree grows and shrinks as usual afterwards.
+  for (int64_t key = scale + 1; key <= 2 * scale; key++) {
+    rid.Set(0, key);
+    index_key.SetFromInteger(key);
+    tree.Insert(index_key, rid, transaction);
+  }
+  for (int64_t key = 1; key <= 2 * scale; key += 2) {
+    index_key.SetFromInteger(key);
+    tree.Remove(index_key, transaction);
+  }
+  int64_t current_key = 2;
+  for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+    current_key += 2;
+  }
+  EXPECT_EQ(current_key, 2 * scale + 2);
+
+  // Only into an empty tree.
+  EXPECT_FALSE(tree.BulkLoad(1, [](std::pair<GenericKey<8>, RID> *entry) { FAIL(); }));
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
 }  // namespace bustub
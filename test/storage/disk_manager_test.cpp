@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 
 #include <cstring>
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
@@ -23,13 +24,13 @@ class DiskManagerTest : public ::testing::Test {
   // This function is called before every test.
   void SetUp() override {
     remove("test.db");
-    remove("test.log");
+    DiskManager::RemoveLogFiles("test.db");
   }
 
   // This function is called after every test.
   void TearDown() override {
     remove("test.db");
-    remove("test.log");
+    DiskManager::RemoveLogFiles("test.db");
   };
 };
 
@@ -72,6 +73,73 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LogSegmentTest) {
+  const int segment_size = 1024;
+  // WriteLog expects the log manager's alternating buffers.
+  std::vector<char> data[2] = {std::vector<char>(100), std::vector<char>(100)};
+  std::vector<char> buf(300);
+  auto dm = DiskManager("test.db", segment_size);
+
+  // Writes of 100 bytes cross the segment boundaries at odd offsets.
+  for (int i = 0; i < 50; i++) {
+    std::fill(data[i % 2].begin(), data[i % 2].end(), static_cast<char>(i + 1));
+    dm.WriteLog(data[i % 2].data(), 100);
+  }
+  EXPECT_EQ(dm.GetLogSize(), 5000);
+  ASSERT_TRUE(dm.ReadLog(buf.data(), static_cast<int>(buf.size()), 950));
+  for (int i = 0; i < static_cast<int>(buf.size()); i++) {
+    EXPECT_EQ(buf[i], static_cast<char>((950 + i) / 100 + 1));
+  }
+  // Reading past the end of the log pads with zeros.
+  ASSERT_TRUE(dm.ReadLog(buf.data(), static_cast<int>(buf.size()), 4900));
+  EXPECT_EQ(buf[99], static_cast<char>(50));
+  EXPECT_EQ(buf[100], 0);
+  EXPECT_FALSE(dm.ReadLog(buf.data(), static_cast<int>(buf.size()), 5000));
+
+  // Only whole segments before the offset are released.
+  dm.TruncateLog(2500);
+  EXPECT_FALSE(dm.ReadLog(buf.data(), static_cast<int>(buf.size()), 2047));
+  ASSERT_TRUE(dm.ReadLog(buf.data(), static_cast<int>(buf.size()), 2048));
+  EXPECT_EQ(buf[0], static_cast<char>(21));
+  EXPECT_EQ(dm.GetLogSize(), 5000);
+
+  // Writing on reuses the spares instead of growing the number of files.
+  const int num_segments = dm.GetNumLogSegments();
+  EXPECT_LE(num_segments, 5 - 2 + LOG_SEGMENT_SPARES + 1);
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < 20; i++) {
+      dm.WriteLog(data[i % 2].data(), 100);
+    }
+    dm.TruncateLog(dm.GetLogSize() - segment_size);
+    EXPECT_LE(dm.GetNumLogSegments(), 2 + LOG_SEGMENT_SPARES + 1);
+  }
+
+  // A restarted disk manager finds the segments that are still in use.
+  const int64_t log_size = dm.GetLogSize();
+  dm.ShutDown();
+  auto restarted = DiskManager("test.db", segment_size);
+  EXPECT_GE(restarted.GetLogSize(), log_size);
+  EXPECT_TRUE(restarted.ReadLog(buf.data(), static_cast<int>(buf.size()), log_size - 100));
+  EXPECT_EQ(buf[0], data[1][0]);
+  EXPECT_FALSE(restarted.ReadLog(buf.data(), static_cast<int>(buf.size()), log_size - 2 * segment_size - 100));
+
+  // Appending resumes where recovery says the log ends, here in front of a torn record of 50 bytes.
+  restarted.ResumeLogAt(log_size - 50);
+  EXPECT_EQ(restarted.GetLogSize(), log_size - 50);
+  std::fill(data[0].begin(), data[0].end(), static_cast<char>(99));
+  restarted.WriteLog(data[0].data(), 20);
+  EXPECT_EQ(restarted.GetLogSize(), log_size - 30);
+  ASSERT_TRUE(restarted.ReadLog(buf.data(), static_cast<int>(buf.size()), log_size - 100));
+  EXPECT_EQ(buf[49], data[1][0]);
+  EXPECT_EQ(buf[50], static_cast<char>(99));
+  EXPECT_EQ(buf[69], static_cast<char>(99));
+  // The rest of the torn record is gone.
+  EXPECT_EQ(buf[70], 0);
+  EXPECT_EQ(buf[99], 0);
+  restarted.ShutDown();
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 